@@ -0,0 +1,164 @@
+/*
+    INI LIBRARY
+
+    Arena that holds memory of the parsed values.
+
+    Copyright (C) Dmitri Pal <dpal@redhat.com> 2026
+
+    INI Library is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    INI Library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with INI Library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "config.h"
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <sys/mman.h>
+#include "trace.h"
+#include "ini_defines.h"
+#include "ini_config_priv.h"
+
+/* Size of the regular block */
+#define INI_ARENA_BLOCK 65536
+
+/* Allocations are aligned to this */
+#define INI_ARENA_ALIGN (sizeof(void *) > sizeof(uint64_t) ? \
+                         sizeof(void *) : sizeof(uint64_t))
+
+/* Block of memory */
+struct ini_arena_block {
+    struct ini_arena_block *next;
+    size_t size;
+    size_t used;
+    /* Keeps the data aligned */
+    uint64_t data[];
+};
+
+struct ini_arena {
+    /* Block that is filled now, it is the first in the list */
+    struct ini_arena_block *blocks;
+    /* File the values point into, NULL if none */
+    void *map;
+    size_t map_len;
+};
+
+/* Create arena */
+int ini_arena_create(struct ini_arena **arena)
+{
+    struct ini_arena *new_arena;
+
+    TRACE_FLOW_ENTRY();
+
+    new_arena = malloc(sizeof(struct ini_arena));
+    if (!new_arena) {
+        TRACE_ERROR_NUMBER("Failed to allocate arena", ENOMEM);
+        return ENOMEM;
+    }
+
+    new_arena->blocks = NULL;
+    new_arena->map = NULL;
+    new_arena->map_len = 0;
+    *arena = new_arena;
+
+    TRACE_FLOW_EXIT();
+    return EOK;
+}
+
+/* Free all memory of the arena */
+void ini_arena_destroy(struct ini_arena *arena)
+{
+    struct ini_arena_block *block;
+
+    TRACE_FLOW_ENTRY();
+
+    if (arena) {
+        while (arena->blocks) {
+            block = arena->blocks;
+            arena->blocks = block->next;
+            free(block);
+        }
+        if (arena->map) munmap(arena->map, arena->map_len);
+        free(arena);
+    }
+
+    TRACE_FLOW_EXIT();
+}
+
+/* Take over the mapped file */
+void ini_arena_own_map(struct ini_arena *arena, void *map, size_t len)
+{
+    TRACE_FLOW_ENTRY();
+
+    if (arena->map) munmap(arena->map, arena->map_len);
+    arena->map = map;
+    arena->map_len = len;
+
+    TRACE_FLOW_EXIT();
+}
+
+/* Allocate memory from the arena */
+void *ini_arena_alloc(struct ini_arena *arena, size_t size)
+{
+    struct ini_arena_block *block;
+    size_t block_size;
+    void *ptr;
+
+    size = (size + INI_ARENA_ALIGN - 1) & ~(INI_ARENA_ALIGN - 1);
+
+    block = arena->blocks;
+    if ((block) && (block->size - block->used >= size)) {
+        ptr = (char *)block->data + block->used;
+        block->used += size;
+        return ptr;
+    }
+
+    /* Big allocations get a block of their own */
+    block_size = size > INI_ARENA_BLOCK / 4 ? size : INI_ARENA_BLOCK;
+
+    block = malloc(offsetof(struct ini_arena_block, data) + block_size);
+    if (!block) {
+        TRACE_ERROR_NUMBER("Failed to allocate block", ENOMEM);
+        return NULL;
+    }
+    block->size = block_size;
+    block->used = size;
+
+    /* Keep filling the current block
+     * if the new one is already full.
+     */
+    if ((arena->blocks) && (block_size != INI_ARENA_BLOCK)) {
+        block->next = arena->blocks->next;
+        arena->blocks->next = block;
+    }
+    else {
+        block->next = arena->blocks;
+        arena->blocks = block;
+    }
+
+    return block->data;
+}
+
+/* Copy string into the arena */
+char *ini_arena_strndup(struct ini_arena *arena, const char *str, size_t len)
+{
+    char *copy;
+
+    copy = ini_arena_alloc(arena, len + 1);
+    if (copy) {
+        memcpy(copy, str, len);
+        copy[len] = '\0';
+    }
+
+    return copy;
+}
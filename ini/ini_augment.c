@@ -26,12 +26,16 @@
 #include <stdarg.h>
 #include <dirent.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <stddef.h>
 #include <limits.h>
 #include <sys/types.h>
 #include <regex.h>
 #include <unistd.h>
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
 #include "trace.h"
 #include "collection.h"
 #include "collection_tools.h"
@@ -47,6 +51,86 @@
 /* Size of incremental growth for ref of the array of strings */
 #define INI_AUG_ARR_SIZE_INC 50
 
+/* Compiled set of patterns */
+struct ini_aug_patterns {
+    /* Patterns compiled one by one */
+    struct ref_array *ra_regex;
+    /* All patterns combined into one expression */
+    regex_t combined;
+    bool is_combined;
+    /* Messages about patterns that failed to compile */
+    struct ref_array *ra_err;
+};
+
+/* Patterns prepared once and used for many augmentations */
+struct ini_augment_ctx {
+    struct ini_aug_patterns *files;
+    struct ini_aug_patterns *sections;
+};
+
+/* Snippet name and its collation key */
+struct ini_aug_sort_key {
+    char *name;
+    char *key;
+    uint32_t pos;
+};
+
+/* Upper limit of the threads parsing snippets */
+#define INI_AUG_MAX_THREADS 8
+
+/* Result of reading one snippet */
+struct ini_aug_snippet {
+    char *name;
+    struct ini_cfgobj *cfg;
+    /* Error creating the object, opening or parsing the file */
+    int create_error;
+    int open_error;
+    int parse_error;
+};
+
+/* File that is part of the reloaded configuration */
+struct ini_reload_file {
+    /* Name, parsed configuration and errors */
+    struct ini_aug_snippet snip;
+    /* Metadata and hash of the contents when it was parsed */
+    struct stat stats;
+    uint64_t hash;
+};
+
+/* State of the incremental reload */
+struct ini_reload {
+    /* Main configuration file */
+    struct ini_reload_file base;
+    /* Snippets in the sorted order */
+    struct ini_reload_file *files;
+    uint32_t count;
+    /* Snippet directory, can be NULL */
+    char *dir;
+    /* Patterns */
+    struct ini_augment_ctx *ctx;
+    struct ini_augment_ctx *own_ctx;
+    /* Access check */
+    struct access_check check;
+    struct access_check *check_perm;
+    int error_level;
+    uint32_t collision_flags;
+    uint32_t parse_flags;
+    uint32_t merge_flags;
+};
+
+#ifdef HAVE_PTHREAD
+/* Snippets shared by the parsing threads */
+struct ini_aug_pool {
+    struct ini_aug_snippet *snippets;
+    uint32_t count;
+    uint32_t next;
+    pthread_mutex_t lock;
+    int error_level;
+    uint32_t collision_flags;
+    uint32_t parse_flags;
+};
+#endif
+
 
 /* Function to add an error to the array */
 static void ini_aug_add_string(struct ref_array *ra,
@@ -126,92 +210,226 @@ static void regex_cleanup(void *elem,
     TRACE_FLOW_EXIT();
 }
 
+/* Cleanup callback for string arrays */
+static void array_cleanup(void *elem,
+                          ref_array_del_enum type,
+                          void *data)
+{
+    TRACE_FLOW_ENTRY();
+    free(*((char **)elem));
+    TRACE_FLOW_EXIT();
+}
+
+/* Check that the regex library supports alternation
+ * of basic expressions so patterns can be combined.
+ */
+static bool ini_aug_can_combine(void)
+{
+    regex_t probe;
+    bool ret;
+
+    if (regcomp(&probe, "\\(^a$\\)\\|\\(^b$\\)", REG_NOSUB)) return false;
+    ret = (regexec(&probe, "b", 0, NULL, 0) == 0) &&
+          (regexec(&probe, "ab", 0, NULL, 0) != 0);
+    regfree(&probe);
+
+    return ret;
+}
+
+/* Try to build one expression out of all patterns */
+static void ini_aug_combine(struct ini_aug_patterns *pats,
+                            const char *patterns[])
+{
+    size_t size = 1;
+    size_t i;
+    const char *pat;
+    char *buf = NULL;
+    char *cur = NULL;
+
+    TRACE_FLOW_ENTRY();
+
+    for (i = 0; patterns[i] != NULL; i++) {
+        pat = patterns[i];
+        /* Back references would be renumbered - keep patterns apart */
+        for (; *pat; pat++) {
+            if ((*pat == '\\') && (*(pat + 1) >= '1') && (*(pat + 1) <= '9')) {
+                TRACE_INFO_STRING("Pattern has back reference", patterns[i]);
+                return;
+            }
+        }
+        size += strlen(patterns[i]) + sizeof("\\(\\)\\|");
+    }
+
+    if (!ini_aug_can_combine()) {
+        TRACE_INFO_STRING("Patterns can't be combined", "");
+        return;
+    }
+
+    buf = malloc(size);
+    if (!buf) {
+        /* Not fatal - patterns will be matched one by one */
+        TRACE_ERROR_NUMBER("Failed to allocate buffer", ENOMEM);
+        return;
+    }
+
+    cur = buf;
+    for (i = 0; patterns[i] != NULL; i++) {
+        cur += sprintf(cur, "%s\\(%s\\)", (i == 0) ? "" : "\\|", patterns[i]);
+    }
+
+    if (regcomp(&(pats->combined), buf, REG_NOSUB) == 0) {
+        TRACE_INFO_STRING("Combined pattern", buf);
+        pats->is_combined = true;
+    }
+
+    free(buf);
+
+    TRACE_FLOW_EXIT();
+}
+
+/* Free compiled patterns */
+static void ini_aug_patterns_destroy(struct ini_aug_patterns *pats)
+{
+    TRACE_FLOW_ENTRY();
+
+    if (pats) {
+        ref_array_destroy(pats->ra_regex);
+        ref_array_destroy(pats->ra_err);
+        if (pats->is_combined) regfree(&(pats->combined));
+        free(pats);
+    }
+
+    TRACE_FLOW_EXIT();
+}
 
-/* Prepare array of regular expressions */
-static int ini_aug_regex_prepare(const char *patterns[],
-                                 struct ref_array *ra_err,
-                                 struct ref_array **ra_regex)
+/* Compile the patterns. Patterns that fail to compile
+ * are reported each time the patterns are used.
+ */
+static int ini_aug_patterns_create(const char *patterns[],
+                                   struct ini_aug_patterns **pats_out)
 {
     int error = EOK;
     int reg_err = 0;
     char const *pat = NULL;
-    struct ref_array *ra = NULL;
+    struct ini_aug_patterns *pats = NULL;
     regex_t *preg = NULL;
     size_t buf_size = 0;
     char *err_str = NULL;
+    char *msg = NULL;
     size_t i;
 
     TRACE_FLOW_ENTRY();
 
-    if (patterns) {
+    /* No patterns - everything matches */
+    if (!patterns) {
+        *pats_out = NULL;
+        TRACE_FLOW_EXIT();
+        return EOK;
+    }
 
-        /* Create array to mark bad patterns */
-        error = ref_array_create(&ra,
-                                 sizeof(regex_t *),
-                                 INI_AUG_ARR_SIZE_INC,
-                                 regex_cleanup,
-                                 NULL);
-        if (error) {
-            TRACE_ERROR_NUMBER("Failed to create array.", error);
-            return error;
-        }
+    pats = calloc(1, sizeof(struct ini_aug_patterns));
+    if (!pats) {
+        TRACE_ERROR_NUMBER("Failed to allocate patterns.", ENOMEM);
+        return ENOMEM;
+    }
+
+    /* Create array to mark bad patterns */
+    if ((ref_array_create(&(pats->ra_regex),
+                          sizeof(regex_t *),
+                          INI_AUG_ARR_SIZE_INC,
+                          regex_cleanup,
+                          NULL) != 0) ||
+        (ref_array_create(&(pats->ra_err),
+                          sizeof(char *),
+                          INI_AUG_ARR_SIZE_INC,
+                          array_cleanup,
+                          NULL) != 0)) {
+        TRACE_ERROR_NUMBER("Failed to create array.", ENOMEM);
+        ini_aug_patterns_destroy(pats);
+        return ENOMEM;
+    }
 
-        /* Run through the list and save precompiled patterns */
-        for (i = 0; patterns[i] != NULL; i++) {
-            pat = patterns[i];
+    /* Run through the list and save precompiled patterns */
+    for (i = 0; patterns[i] != NULL; i++) {
+        pat = patterns[i];
 
-            TRACE_INFO_STRING("Pattern:", pat);
+        TRACE_INFO_STRING("Pattern:", pat);
 
-            preg = calloc(1, sizeof(regex_t));
-            if (preg == NULL) {
+        preg = calloc(1, sizeof(regex_t));
+        if (preg == NULL) {
+            TRACE_ERROR_NUMBER("Failed to create array.", ENOMEM);
+            ini_aug_patterns_destroy(pats);
+            return ENOMEM;
+        }
+        reg_err = regcomp(preg, pat, REG_NOSUB);
+        if (reg_err) {
+            /* Get size, allocate buffer, record error... */
+            buf_size = regerror(reg_err, preg, NULL, 0);
+            err_str = malloc (buf_size);
+            if (err_str == NULL) {
                 TRACE_ERROR_NUMBER("Failed to create array.", ENOMEM);
-                ref_array_destroy(ra);
-                return ENOMEM;
-            }
-            reg_err = regcomp(preg, pat, REG_NOSUB);
-            if (reg_err) {
-                /* Get size, allocate buffer, record error... */
-                buf_size = regerror(reg_err, preg, NULL, 0);
-                err_str = malloc (buf_size);
-                if (err_str == NULL) {
-                    TRACE_ERROR_NUMBER("Failed to create array.", ENOMEM);
-                    ref_array_destroy(ra);
-                    free(preg);
-                    return ENOMEM;
-                }
-                regerror(reg_err, preg, err_str, buf_size);
+                ini_aug_patterns_destroy(pats);
                 free(preg);
-                ini_aug_add_string(ra_err,
-                                   "Failed to process expression: %s."
-                                   " Compilation returned error: %s",
-                                   pat, err_str);
-                free(err_str);
-
-                /* All error processing is done - advance to next pattern */
-                pat++;
-                continue;
+                return ENOMEM;
             }
-            /* In case of no error add compiled expression into the buffer */
-            error = ref_array_append(ra, (void *)&preg);
-            if (error) {
-                TRACE_ERROR_NUMBER("Failed to add element to array.", error);
-                ref_array_destroy(ra);
-                free(preg);
-                return error;
+            regerror(reg_err, preg, err_str, buf_size);
+            free(preg);
+            if (asprintf(&msg, "Failed to process expression: %s."
+                               " Compilation returned error: %s",
+                         pat, err_str) != -1) {
+                /* This is a best effort assignment. error is not checked */
+                if (ref_array_append(pats->ra_err, (void *)&msg)) free(msg);
             }
+            free(err_str);
+
+            /* All error processing is done - advance to next pattern */
+            continue;
         }
+        /* In case of no error add compiled expression into the buffer */
+        error = ref_array_append(pats->ra_regex, (void *)&preg);
+        if (error) {
+            TRACE_ERROR_NUMBER("Failed to add element to array.", error);
+            ini_aug_patterns_destroy(pats);
+            regfree(preg);
+            free(preg);
+            return error;
+        }
+    }
+
+    /* One expression is faster to match than many */
+    if ((ref_array_len(pats->ra_err) == 0) &&
+        (ref_array_len(pats->ra_regex) > 1)) {
+        ini_aug_combine(pats, patterns);
     }
 
-    *ra_regex = ra;
-    /* ref_array_debug(*ra_regex, 1); */
+    *pats_out = pats;
 
     TRACE_FLOW_EXIT();
     return EOK;
 }
 
+/* Report patterns that failed to compile */
+static void ini_aug_patterns_report(struct ini_aug_patterns *pats,
+                                    struct ref_array *ra_err)
+{
+    uint32_t i = 0;
+    char *msg = NULL;
+
+    TRACE_FLOW_ENTRY();
+
+    if (pats) {
+        for (i = 0; i < ref_array_len(pats->ra_err); i++) {
+            ref_array_get(pats->ra_err, i, &msg);
+            ini_aug_add_string(ra_err, "%s", msg);
+        }
+    }
+
+    TRACE_FLOW_EXIT();
+}
+
 /* Match file name */
 static bool ini_aug_match_name(char *name,
-                               struct ref_array *ra_regex)
+                               struct ini_aug_patterns *pats)
 {
     uint32_t len = 0;
     uint32_t i = 0;
@@ -220,7 +438,7 @@ static bool ini_aug_match_name(char *name,
 
     TRACE_FLOW_ENTRY();
 
-    len = ref_array_len(ra_regex);
+    len = pats ? ref_array_len(pats->ra_regex) : 0;
     if (len == 0) {
         /* List is empty - nothing to do */
         TRACE_FLOW_EXIT();
@@ -228,11 +446,17 @@ static bool ini_aug_match_name(char *name,
     }
 
     TRACE_INFO_STRING("Name to match:", name);
+
+    if (pats->is_combined) {
+        match = (regexec(&(pats->combined), name, 0, NULL, 0) == 0);
+        TRACE_FLOW_EXIT();
+        return match;
+    }
+
     TRACE_INFO_NUMBER("Number of regexes:", len);
-    /* ref_array_debug(ra_regex, 1);*/
 
     for (i = 0; i < len; i++) {
-        preg = *((regex_t **)ref_array_get(ra_regex, i, NULL));
+        preg = *((regex_t **)ref_array_get(pats->ra_regex, i, NULL));
         if (preg == NULL) continue;
         if (regexec(preg, name, 0, NULL, 0) == 0) {
             TRACE_INFO_NUMBER("Name matched regex number:", i);
@@ -296,68 +520,84 @@ static bool ini_check_file_perm(char *name,
     return ret;
 }
 
-/* Sort array */
-static void ini_aug_sort_list(struct ref_array *ra_list)
+/* Compare collation keys, keep the original order of equal names */
+static int ini_aug_sort_cmp(const void *a, const void *b)
+{
+    const struct ini_aug_sort_key *key1 = a;
+    const struct ini_aug_sort_key *key2 = b;
+    int ret;
+
+    ret = strcmp(key1->key, key2->key);
+    if (ret) return ret;
+
+    return (key1->pos > key2->pos) - (key1->pos < key2->pos);
+}
+
+/* Sort array.
+ * Names are transformed once so that the sort itself
+ * can use plain string comparison.
+ */
+static int ini_aug_sort_list(struct ref_array *ra_list)
 {
-    unsigned len = 0, j = 0, k = 0;
-    char **item1 = NULL;
-    char **item2 = NULL;
+    int error = EOK;
+    uint32_t len = 0;
+    uint32_t i = 0;
+    size_t size = 0;
+    struct ini_aug_sort_key *keys = NULL;
 
     TRACE_FLOW_ENTRY();
 
     len = ref_array_len(ra_list);
-    if (len == 0) return;
-
-    /* If have trace output array before sorting */
-/*
-#ifdef HAVE_TRACE
-    for (i = 0; i < len; i++) {
-        TRACE_INFO_STRING("Before:",
-                          *((char **) ref_array_get(ra_list, i, NULL)));
+    if (len < 2) {
+        TRACE_FLOW_EXIT();
+        return EOK;
+    }
 
+    keys = calloc(len, sizeof(struct ini_aug_sort_key));
+    if (!keys) {
+        TRACE_ERROR_NUMBER("Failed to allocate sort keys.", ENOMEM);
+        return ENOMEM;
     }
-#endif
-*/
 
-    for (k = 0; k < len-1; k++) {
-        j = k + 1;
-        while (j > 0) {
-            item1 = (char **) ref_array_get(ra_list, j - 1, NULL);
-            item2 = (char **) ref_array_get(ra_list, j, NULL);
-            /* Swap items if they are not NULL and string comparison
-             * indicates that they need to be swapped or if the first
-             * one is NULL but second is not. That would push
-             * NULL elements of the array to the end of the array.
-             */
-            if (((item1 && item2) &&
-                (strcoll(*item1,*item2)) > 0) ||
-                (!item1 && item2)) {
-                    ref_array_swap(ra_list, j - 1, j);
-            }
-            j--;
+    for (i = 0; i < len; i++) {
+        keys[i].name = *((char **)ref_array_get(ra_list, i, NULL));
+        keys[i].pos = i;
+
+        size = strxfrm(NULL, keys[i].name, 0) + 1;
+        keys[i].key = malloc(size);
+        if (!keys[i].key) {
+            TRACE_ERROR_NUMBER("Failed to allocate sort key.", ENOMEM);
+            error = ENOMEM;
+            goto done;
         }
+        strxfrm(keys[i].key, keys[i].name, size);
     }
 
-    /* And after sorting */
-/*
-#ifdef HAVE_TRACE
-    for (i = 0; i < len; i++) {
-        TRACE_INFO_STRING("After:",
-                          *((char **) ref_array_get(ra_list, i, NULL)));
+    qsort(keys, len, sizeof(struct ini_aug_sort_key), ini_aug_sort_cmp);
 
+    /* Put names back in the sorted order.
+     * The array owns the strings so they are not freed here.
+     */
+    for (i = 0; i < len; i++) {
+        *((char **)ref_array_get(ra_list, i, NULL)) = keys[i].name;
+        TRACE_INFO_STRING("Sorted:", keys[i].name);
     }
-#endif
-*/
+
+done:
+    for (i = 0; i < len; i++) free(keys[i].key);
+    free(keys);
 
     TRACE_FLOW_EXIT();
+    return error;
 }
 
 /* Construct snippet lists based on the directory */
 static int ini_aug_construct_list(char *dirname ,
-                                  const char *patterns[],
+                                  struct ini_aug_patterns *pats,
                                   struct access_check *check_perm,
                                   struct ref_array *ra_list,
-                                  struct ref_array *ra_err)
+                                  struct ref_array *ra_err,
+                                  struct stat *dir_stats)
 {
 
     int error = EOK;
@@ -365,19 +605,15 @@ static int ini_aug_construct_list(char *dirname ,
     struct dirent *entryp = NULL;
     char *snipname = NULL;
     char fullname[PATH_MAX + 1] = {0};
-    struct ref_array *ra_regex = NULL;
     bool match = false;
 
     TRACE_FLOW_ENTRY();
 
-    /* Prepare patterns */
-    error = ini_aug_regex_prepare(patterns,
-                                  ra_err,
-                                  &ra_regex);
-    if (error) {
-        TRACE_ERROR_NUMBER("Failed to prepare regex array.", error);
-        return error;
-    }
+    /* Report bad patterns */
+    ini_aug_patterns_report(pats, ra_err);
+
+    /* Missing directory is recorded with zero stats */
+    memset(dir_stats, 0, sizeof(struct stat));
 
     /* Open directory */
     errno = 0;
@@ -386,15 +622,20 @@ static int ini_aug_construct_list(char *dirname ,
         error = errno;
         if (error == ENOMEM) {
             TRACE_ERROR_NUMBER("No memory to open dir.", ENOMEM);
-            ref_array_destroy(ra_regex);
             return ENOMEM;
         }
         /* Log an error, it is a recoverable error */
         add_dir_open_error(error, dirname, ra_err);
-        ref_array_destroy(ra_regex);
         return EOK;
     }
 
+    /* Take the stats before reading so that files
+     * added during the scan change the directory later.
+     */
+    if (fstat(dirfd(dir), dir_stats) == -1) {
+        memset(dir_stats, 0, sizeof(struct stat));
+    }
+
     /* Loop through the directory */
     while (true)
     {
@@ -403,7 +644,6 @@ static int ini_aug_construct_list(char *dirname ,
         if (entryp == NULL && errno != 0) {
             error = errno;
             TRACE_ERROR_NUMBER("Failed to read directory.", error);
-            ref_array_destroy(ra_regex);
             closedir(dir);
             return error;
         }
@@ -424,13 +664,12 @@ static int ini_aug_construct_list(char *dirname ,
         error = path_concat(fullname, PATH_MAX, dirname, entryp->d_name);
         if (error != EOK) {
             TRACE_ERROR_NUMBER("path_concat failed.", error);
-            ref_array_destroy(ra_regex);
             closedir(dir);
             return error;
         }
 
         /* Match names */
-        match = ini_aug_match_name(entryp->d_name, ra_regex);
+        match = ini_aug_match_name(entryp->d_name, pats);
         if (match) {
             if(ini_check_file_perm(fullname, check_perm, ra_err)) {
 
@@ -439,8 +678,7 @@ static int ini_aug_construct_list(char *dirname ,
                 snipname = strdup(fullname);
                 if (snipname == NULL) {
                     TRACE_ERROR_NUMBER("Failed to dup string.", ENOMEM);
-                    ref_array_destroy(ra_regex);
-                    closedir(dir);
+                            closedir(dir);
                     return ENOMEM;
                 }
 
@@ -449,8 +687,7 @@ static int ini_aug_construct_list(char *dirname ,
                     TRACE_ERROR_NUMBER("No memory to add file to "
                                        "the snippet list.",
                                        ENOMEM);
-                    ref_array_destroy(ra_regex);
-                    closedir(dir);
+                            closedir(dir);
                     return ENOMEM;
                 }
             }
@@ -463,12 +700,11 @@ static int ini_aug_construct_list(char *dirname ,
     }
 
     closedir(dir);
-    ref_array_destroy(ra_regex);
 
-    ini_aug_sort_list(ra_list);
+    error = ini_aug_sort_list(ra_list);
 
     TRACE_FLOW_EXIT();
-    return EOK;
+    return error;
 }
 
 /* Construct the full dir path */
@@ -504,18 +740,24 @@ static int ini_aug_expand_path(const char *path, char **fullname)
     return EOK;
 }
 
-/* Prepare the lists of the files that need to be merged */
+/* Prepare the lists of the files that need to be merged.
+ * Path and stats of the directory are returned in dir_src,
+ * the path is NULL if it could not be resolved.
+ */
 static int ini_aug_preprare(const char *path,
-                            const char *patterns[],
+                            struct ini_aug_patterns *pats,
                             struct access_check *check_perm,
                             struct ref_array *ra_list,
-                            struct ref_array *ra_err)
+                            struct ref_array *ra_err,
+                            struct ini_source *dir_src)
 {
     int error = EOK;
     char *dirname = NULL;
 
     TRACE_FLOW_ENTRY();
 
+    dir_src->path = NULL;
+
     /* Contruct path */
     error = ini_aug_expand_path(path, &dirname);
     if (error) {
@@ -534,29 +776,21 @@ static int ini_aug_preprare(const char *path,
 
     /* Construct snipet lists */
     error = ini_aug_construct_list(dirname,
-                                   patterns,
+                                   pats,
                                    check_perm,
                                    ra_list,
-                                   ra_err);
-    free(dirname);
+                                   ra_err,
+                                   &(dir_src->stats));
+    if (error) free(dirname);
+    else dir_src->path = dirname;
 
     TRACE_FLOW_EXIT();
     return error;
 }
 
-/* Cleanup callback for string arrays */
-static void array_cleanup(void *elem,
-                          ref_array_del_enum type,
-                          void *data)
-{
-    TRACE_FLOW_ENTRY();
-    free(*((char **)elem));
-    TRACE_FLOW_EXIT();
-}
-
 /* Check that sections are in the given list */
 static int ini_aug_match_sec(struct ini_cfgobj *snip_cfg,
-                             struct ref_array *ra_regex,
+                             struct ini_aug_patterns *pats,
                              struct ref_array *ra_err,
                              char *snip_name,
                              bool *skip)
@@ -589,7 +823,7 @@ static int ini_aug_match_sec(struct ini_cfgobj *snip_cfg,
     section_iter = section_list;
 
     while (*section_iter) {
-        match = ini_aug_match_name(*section_iter, ra_regex);
+        match = ini_aug_match_name(*section_iter, pats);
         if (match) {
             match_count++;
             TRACE_INFO_STRING("Matched section", *section_iter);
@@ -634,10 +868,179 @@ static int ini_aug_match_sec(struct ini_cfgobj *snip_cfg,
 }
 
 
+/* Open and parse one snippet */
+static void ini_aug_parse(struct ini_aug_snippet *snippet,
+                          int error_level,
+                          uint32_t collision_flags,
+                          uint32_t parse_flags)
+{
+    struct ini_cfgfile *file_ctx = NULL;
+
+    TRACE_FLOW_ENTRY();
+
+    TRACE_INFO_STRING("Processing", snippet->name);
+
+    /* Prepare config object */
+    snippet->create_error = ini_config_create(&(snippet->cfg));
+    if (snippet->create_error) {
+        TRACE_ERROR_NUMBER("Failed to create config object",
+                           snippet->create_error);
+        return;
+    }
+
+    /* Open file */
+    snippet->open_error = ini_config_file_open(snippet->name,
+                                               INI_META_NONE,
+                                               &file_ctx);
+    if (snippet->open_error) {
+        TRACE_ERROR_NUMBER("Failed to open snippet.", snippet->open_error);
+        return;
+    }
+
+    TRACE_INFO_NUMBER("Error level:", error_level);
+    TRACE_INFO_NUMBER("Collision flags:", collision_flags);
+    TRACE_INFO_NUMBER("Parse level:", parse_flags);
+
+    /* Read config */
+    snippet->parse_error = ini_config_parse(file_ctx,
+                                            error_level,
+                                            collision_flags,
+                                            parse_flags,
+                                            snippet->cfg);
+
+    ini_config_file_destroy(file_ctx);
+
+    TRACE_FLOW_EXIT();
+}
+
+#ifdef HAVE_PTHREAD
+/* Parsing thread - takes the next unparsed snippet until none is left */
+static void *ini_aug_worker(void *data)
+{
+    struct ini_aug_pool *pool = (struct ini_aug_pool *)data;
+    uint32_t i;
+
+    TRACE_FLOW_ENTRY();
+
+    for (;;) {
+        pthread_mutex_lock(&(pool->lock));
+        i = pool->next;
+        if (i < pool->count) pool->next++;
+        pthread_mutex_unlock(&(pool->lock));
+
+        if (i >= pool->count) break;
+
+        ini_aug_parse(&(pool->snippets[i]),
+                      pool->error_level,
+                      pool->collision_flags,
+                      pool->parse_flags);
+    }
+
+    TRACE_FLOW_EXIT();
+    return NULL;
+}
+#endif
+
+/* Parse all snippets ahead of merging using a pool of threads.
+ * Returns array of results in the order of the list or NULL
+ * if snippets should be parsed one by one while merging.
+ */
+static struct ini_aug_snippet *ini_aug_parse_all(struct ref_array *ra_list,
+                                                 int error_level,
+                                                 uint32_t collision_flags,
+                                                 uint32_t parse_flags)
+{
+#ifdef HAVE_PTHREAD
+    struct ini_aug_pool pool;
+    pthread_t threads[INI_AUG_MAX_THREADS];
+    char **snip_name_ptr = NULL;
+    long cpus;
+    uint32_t num = 0;
+    uint32_t started = 0;
+    uint32_t i;
+
+    TRACE_FLOW_ENTRY();
+
+    pool.count = ref_array_len(ra_list);
+
+    /* Use one thread less since the caller parses too */
+    cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpus > 1) num = (uint32_t)(cpus - 1);
+    if (num > INI_AUG_MAX_THREADS) num = INI_AUG_MAX_THREADS;
+    if (num > pool.count - 1) num = pool.count - 1;
+    if (num == 0) {
+        TRACE_FLOW_EXIT();
+        return NULL;
+    }
+
+    pool.snippets = calloc(pool.count, sizeof(struct ini_aug_snippet));
+    if (!pool.snippets) {
+        TRACE_ERROR_NUMBER("Failed to allocate snippets", ENOMEM);
+        return NULL;
+    }
+
+    if (pthread_mutex_init(&(pool.lock), NULL)) {
+        TRACE_ERROR_STRING("Failed to initialize mutex", "");
+        free(pool.snippets);
+        return NULL;
+    }
+
+    for (i = 0; i < pool.count; i++) {
+        snip_name_ptr = (char **)ref_array_get(ra_list, i, NULL);
+        if (snip_name_ptr) pool.snippets[i].name = *snip_name_ptr;
+    }
+
+    pool.next = 0;
+    pool.error_level = error_level;
+    pool.collision_flags = collision_flags;
+    pool.parse_flags = parse_flags;
+
+    /* If a thread can't be started the rest do its share */
+    for (started = 0; started < num; started++) {
+        if (pthread_create(&threads[started], NULL,
+                           ini_aug_worker, &pool)) {
+            TRACE_ERROR_NUMBER("Failed to start thread", started);
+            break;
+        }
+    }
+
+    ini_aug_worker(&pool);
+
+    for (i = 0; i < started; i++) pthread_join(threads[i], NULL);
+
+    pthread_mutex_destroy(&(pool.lock));
+
+    TRACE_FLOW_EXIT();
+    return pool.snippets;
+#else
+    TRACE_FLOW_ENTRY();
+    TRACE_INFO_STRING("Threads are not supported", "");
+    TRACE_FLOW_EXIT();
+    return NULL;
+#endif
+}
+
+/* Free snippets that were parsed ahead */
+static void ini_aug_free_snippets(struct ini_aug_snippet *snippets,
+                                  uint32_t count)
+{
+    uint32_t i;
+
+    TRACE_FLOW_ENTRY();
+
+    if (snippets) {
+        for (i = 0; i < count; i++) ini_config_destroy(snippets[i].cfg);
+        free(snippets);
+    }
+
+    TRACE_FLOW_EXIT();
+}
+
 /* Apply snippets */
 static int ini_aug_apply(struct ini_cfgobj *cfg,
                          struct ref_array *ra_list,
-                         const char *sections[],
+                         struct ini_aug_snippet *parsed,
+                         struct ini_aug_patterns *sec_pats,
                          int error_level,
                          uint32_t collision_flags,
                          uint32_t parse_flags,
@@ -650,14 +1053,15 @@ static int ini_aug_apply(struct ini_cfgobj *cfg,
     uint32_t len = 0;
     uint32_t i = 0;
     uint32_t j = 0;
-    struct ini_cfgfile *file_ctx = NULL;
     struct ini_cfgobj *snip_cfg = NULL;
+    struct ini_cfgobj *owned_cfg = NULL;
     struct ini_cfgobj *res_cfg = NULL;
-    struct ini_cfgobj *tmp_cfg = NULL;
+    struct ini_aug_snippet *snippets = parsed;
+    struct ini_aug_snippet *snippet = NULL;
+    struct ini_aug_snippet current;
     char **error_list = NULL;
     unsigned cnt = 0;
     bool skip = false;
-    struct ref_array *ra_regex = NULL;
     char *snip_name = NULL;
     char **snip_name_ptr = NULL;
 
@@ -678,60 +1082,65 @@ static int ini_aug_apply(struct ini_cfgobj *cfg,
         return EOK;
     }
 
-    /* Prepare patterns */
-    error = ini_aug_regex_prepare(sections,
-                                  ra_err,
-                                  &ra_regex);
-    if (error) {
-        TRACE_ERROR_NUMBER("Failed to prepare regex array.", error);
-        *out_cfg = res_cfg;
-        return error;
+    /* Report bad patterns */
+    ini_aug_patterns_report(sec_pats, ra_err);
+
+    /* Parse snippets ahead if asked to */
+    if ((!snippets) && (merge_flags & INI_AUG_PARALLEL)) {
+        snippets = ini_aug_parse_all(ra_list,
+                                     error_level,
+                                     collision_flags,
+                                     parse_flags);
     }
+    merge_flags &= ~INI_AUG_PARALLEL;
 
     /* Loop through the snippets */
     for (i = 0; i < len; i++) {
 
-        /* Prepare config object */
-        error = ini_config_create(&snip_cfg);
-        if (error) {
-            TRACE_ERROR_NUMBER("Failed to create config object", error);
-            goto err;
+        if (snippets) {
+            snippet = &snippets[i];
+        }
+        else {
+            memset(&current, 0, sizeof(current));
+            snippet = &current;
+            snip_name_ptr = (char **)ref_array_get (ra_list, i, NULL);
+            if (snip_name_ptr) snippet->name = *snip_name_ptr;
         }
 
         /* Process snippet */
-        snip_name_ptr = (char **)ref_array_get (ra_list, i, NULL);
-        if (snip_name_ptr == NULL) continue;
-        snip_name = *snip_name_ptr;
+        snip_name = snippet->name;
         if (snip_name == NULL) continue;
 
-        TRACE_INFO_STRING("Processing", snip_name);
+        if (!snippets) {
+            ini_aug_parse(snippet, error_level, collision_flags, parse_flags);
+        }
 
-        /* Open file */
-        error = ini_config_file_open(snip_name,
-                                     INI_META_NONE,
-                                     &file_ctx);
-        if (error) {
-            TRACE_ERROR_NUMBER("Failed to open snippet.", error);
+        /* The object is owned by the loop from now on
+         * unless it was parsed by the caller.
+         */
+        snip_cfg = snippet->cfg;
+        owned_cfg = NULL;
+        if (!parsed) {
+            owned_cfg = snip_cfg;
+            snippet->cfg = NULL;
+        }
+
+        if (snippet->create_error) {
+            error = snippet->create_error;
+            TRACE_ERROR_NUMBER("Failed to create config object", error);
+            goto err;
+        }
+
+        if (snippet->open_error) {
+            TRACE_ERROR_NUMBER("Failed to open snippet.",
+                               snippet->open_error);
             ini_aug_add_string(ra_err, "Failed to open file %s.", snip_name);
-            ini_config_destroy(snip_cfg);
+            ini_config_destroy(owned_cfg);
             /* We can recover so go on */
             continue;
         }
 
-        TRACE_INFO_NUMBER("Error level:", error_level);
-        TRACE_INFO_NUMBER("Collision flags:", collision_flags);
-        TRACE_INFO_NUMBER("Parse level:", parse_flags);
-
-        /* Read config */
-        error = ini_config_parse(file_ctx,
-                                 error_level,
-                                 collision_flags,
-                                 parse_flags,
-                                 snip_cfg);
-
-        ini_config_file_destroy(file_ctx);
-        file_ctx = NULL;
-
+        error = snippet->parse_error;
         if (error) {
             TRACE_ERROR_NUMBER("Failed to parse configuration.", error);
             cnt = ini_config_error_count(snip_cfg);
@@ -744,7 +1153,7 @@ static int ini_aug_apply(struct ini_cfgobj *cfg,
                 error = ini_config_get_errors(snip_cfg, &error_list);
                 if (error) {
                     TRACE_ERROR_NUMBER("Can't get errors.", error);
-                    ini_config_destroy(snip_cfg);
+                    ini_config_destroy(owned_cfg);
                     goto err;
                 }
 
@@ -760,22 +1169,22 @@ static int ini_aug_apply(struct ini_cfgobj *cfg,
                                    "Due to errors file %s is not considered."
                                    " Skipping.",
                                    snip_name);
-                ini_config_destroy(snip_cfg);
+                ini_config_destroy(owned_cfg);
                 continue;
             }
             /* If we are told to not stop try to process anyway */
         }
 
         /* Validate that file contains only allowed sections */
-        if (sections) {
+        if (sec_pats) {
             /* Use a safe default, function should update it anyways
              * but it is better to not merge than to allow bad snippet */
             skip = true;
-            error = ini_aug_match_sec(snip_cfg, ra_regex, ra_err,
+            error = ini_aug_match_sec(snip_cfg, sec_pats, ra_err,
                                       snip_name, &skip);
             if (error) {
                 TRACE_ERROR_NUMBER("Failed to validate section.", error);
-                ini_config_destroy(snip_cfg);
+                ini_config_destroy(owned_cfg);
                 goto err;
             }
         }
@@ -783,11 +1192,12 @@ static int ini_aug_apply(struct ini_cfgobj *cfg,
         /* Merge */
         if (!skip) {
             /* col_debug_collection(res_cfg->cfg, COL_TRAVERSE_DEFAULT); */
-            error = ini_config_merge(res_cfg, snip_cfg, merge_flags, &tmp_cfg);
+            /* Merge in place - a failed merge leaves res_cfg intact */
+            error = ini_config_merge_into(res_cfg, snip_cfg, merge_flags);
             if (error) {
                 if (error == ENOMEM) {
                     TRACE_ERROR_NUMBER("Merge failed.", error);
-                    ini_config_destroy(snip_cfg);
+                    ini_config_destroy(owned_cfg);
                     goto err;
                 }
                 else if
@@ -808,30 +1218,28 @@ static int ini_aug_apply(struct ini_cfgobj *cfg,
                                        snip_name);
                     /* The snippet failed to merge, this is OK, go on */
                     TRACE_INFO_NUMBER("Merge failure.Continue. Error", error);
-                    ini_config_destroy(snip_cfg);
+                    ini_config_destroy(owned_cfg);
                     continue;
                 }
             }
             TRACE_INFO_STRING("Merged file.", snip_name);
-            /* col_debug_collection(tmp_cfg->cfg, COL_TRAVERSE_DEFAULT); */
-            ini_config_destroy(res_cfg);
-            res_cfg = tmp_cfg;
+            /* col_debug_collection(res_cfg->cfg, COL_TRAVERSE_DEFAULT); */
 
             /* Record that snippet was successfully merged */
             ini_aug_add_string(ra_ok, "%s", snip_name);
         }
         /* Cleanup */
-        ini_config_destroy(snip_cfg);
+        ini_config_destroy(owned_cfg);
     }
 
-    ref_array_destroy(ra_regex);
+    if (!parsed) ini_aug_free_snippets(snippets, len);
     *out_cfg = res_cfg;
     TRACE_FLOW_EXIT();
     return error;
 
 err:
     ini_config_destroy(res_cfg);
-    ref_array_destroy(ra_regex);
+    if (!parsed) ini_aug_free_snippets(snippets, len);
 
     if (ini_config_copy(cfg, &res_cfg)) {
         TRACE_ERROR_NUMBER("Failed to copy config object", error);
@@ -845,28 +1253,30 @@ err:
 }
 
 /* Function to merge additional snippets of the config file
- * from a provided directory.
+ * from a provided directory using prepared patterns.
  */
-int ini_config_augment(struct ini_cfgobj *base_cfg,
-                       const char *path,
-                       const char *patterns[],
-                       const char *sections[],
-                       struct access_check *check_perm,
-                       int error_level,
-                       uint32_t collision_flags,
-                       uint32_t parse_flags,
-                       uint32_t merge_flags,
-                       struct ini_cfgobj **result_cfg,
-                       struct ref_array **error_list,
-                       struct ref_array **success_list)
+int ini_config_augment_ctx(struct ini_cfgobj *base_cfg,
+                           const char *path,
+                           struct ini_augment_ctx *ctx,
+                           struct access_check *check_perm,
+                           int error_level,
+                           uint32_t collision_flags,
+                           uint32_t parse_flags,
+                           uint32_t merge_flags,
+                           struct ini_cfgobj **result_cfg,
+                           struct ref_array **error_list,
+                           struct ref_array **success_list)
 {
     int error = EOK;
+    int error2 = EOK;
     /* The internal list that will hold snippet file names */
     struct ref_array *ra_list = NULL;
     /* List of error strings that will be returned to the caller */
     struct ref_array *ra_err = NULL;
     /* List of files that were merged */
     struct ref_array *ra_ok = NULL;
+    /* Snippet directory */
+    struct ini_source dir_src;
 
     /* Check arguments */
     if (base_cfg == NULL) {
@@ -874,7 +1284,7 @@ int ini_config_augment(struct ini_cfgobj *base_cfg,
         return EINVAL;
     }
 
-    if (result_cfg == NULL) {
+    if ((result_cfg == NULL) || (ctx == NULL)) {
         TRACE_ERROR_NUMBER("Invalid argument", EINVAL);
         return EINVAL;
     }
@@ -906,10 +1316,11 @@ int ini_config_augment(struct ini_cfgobj *base_cfg,
 
     /* Construct snipet lists */
     error = ini_aug_preprare(path,
-                             patterns,
+                             ctx->files,
                              check_perm,
                              ra_list,
-                             ra_err);
+                             ra_err,
+                             &dir_src);
     if (error) {
         TRACE_ERROR_NUMBER("Failed to prepare lists of snippets.",
                            error);
@@ -922,7 +1333,8 @@ int ini_config_augment(struct ini_cfgobj *base_cfg,
     /* Apply snippets */
     error = ini_aug_apply(base_cfg,
                           ra_list,
-                          sections,
+                          NULL,
+                          ctx->sections,
                           error_level,
                           collision_flags,
                           parse_flags,
@@ -931,7 +1343,22 @@ int ini_config_augment(struct ini_cfgobj *base_cfg,
                           ra_ok,
                           result_cfg);
 
+    /* Added or removed snippets make the cache stale */
+    if ((*result_cfg) && (dir_src.path)) {
+        error2 = ini_config_add_source(*result_cfg,
+                                       dir_src.path,
+                                       &(dir_src.stats),
+                                       0);
+        if (error2) {
+            TRACE_ERROR_NUMBER("Failed to record directory", error2);
+            ini_config_destroy(*result_cfg);
+            *result_cfg = NULL;
+            error = error2;
+        }
+    }
+
     /* Cleanup */
+    free(dir_src.path);
     ref_array_destroy(ra_list);
 
     if (error_list) {
@@ -951,3 +1378,781 @@ int ini_config_augment(struct ini_cfgobj *base_cfg,
     TRACE_FLOW_EXIT();
     return error;
 }
+
+/* Prepare context for repeated augmentation */
+int ini_augment_ctx_create(const char *patterns[],
+                           const char *sections[],
+                           struct ini_augment_ctx **ctx)
+{
+    int error = EOK;
+    struct ini_augment_ctx *new_ctx = NULL;
+
+    TRACE_FLOW_ENTRY();
+
+    if (ctx == NULL) {
+        TRACE_ERROR_NUMBER("Invalid argument", EINVAL);
+        return EINVAL;
+    }
+
+    new_ctx = calloc(1, sizeof(struct ini_augment_ctx));
+    if (new_ctx == NULL) {
+        TRACE_ERROR_NUMBER("Failed to allocate context", ENOMEM);
+        return ENOMEM;
+    }
+
+    error = ini_aug_patterns_create(patterns, &(new_ctx->files));
+    if (error) {
+        TRACE_ERROR_NUMBER("Failed to prepare file patterns.", error);
+        ini_augment_ctx_destroy(new_ctx);
+        return error;
+    }
+
+    error = ini_aug_patterns_create(sections, &(new_ctx->sections));
+    if (error) {
+        TRACE_ERROR_NUMBER("Failed to prepare section patterns.", error);
+        ini_augment_ctx_destroy(new_ctx);
+        return error;
+    }
+
+    *ctx = new_ctx;
+
+    TRACE_FLOW_EXIT();
+    return EOK;
+}
+
+/* Free augmentation context */
+void ini_augment_ctx_destroy(struct ini_augment_ctx *ctx)
+{
+    TRACE_FLOW_ENTRY();
+
+    if (ctx) {
+        ini_aug_patterns_destroy(ctx->files);
+        ini_aug_patterns_destroy(ctx->sections);
+        free(ctx);
+    }
+
+    TRACE_FLOW_EXIT();
+}
+
+/* Function to merge additional snippets of the config file
+ * from a provided directory.
+ */
+int ini_config_augment(struct ini_cfgobj *base_cfg,
+                       const char *path,
+                       const char *patterns[],
+                       const char *sections[],
+                       struct access_check *check_perm,
+                       int error_level,
+                       uint32_t collision_flags,
+                       uint32_t parse_flags,
+                       uint32_t merge_flags,
+                       struct ini_cfgobj **result_cfg,
+                       struct ref_array **error_list,
+                       struct ref_array **success_list)
+{
+    int error = EOK;
+    struct ini_augment_ctx *ctx = NULL;
+
+    TRACE_FLOW_ENTRY();
+
+    /* Check arguments */
+    if ((base_cfg == NULL) || (result_cfg == NULL)) {
+        TRACE_ERROR_NUMBER("Invalid argument", EINVAL);
+        return EINVAL;
+    }
+
+    error = ini_augment_ctx_create(patterns, sections, &ctx);
+    if (error) {
+        TRACE_ERROR_NUMBER("Failed to prepare patterns.", error);
+        return error;
+    }
+
+    error = ini_config_augment_ctx(base_cfg,
+                                   path,
+                                   ctx,
+                                   check_perm,
+                                   error_level,
+                                   collision_flags,
+                                   parse_flags,
+                                   merge_flags,
+                                   result_cfg,
+                                   error_list,
+                                   success_list);
+
+    ini_augment_ctx_destroy(ctx);
+
+    TRACE_FLOW_EXIT();
+    return error;
+}
+
+/* Free reload state of one file */
+static void ini_reload_file_free(struct ini_reload_file *file)
+{
+    TRACE_FLOW_ENTRY();
+
+    free(file->snip.name);
+    ini_config_destroy(file->snip.cfg);
+    memset(file, 0, sizeof(struct ini_reload_file));
+
+    TRACE_FLOW_EXIT();
+}
+
+/* Check if file still looks the same */
+static bool ini_reload_same_stats(struct stat *stats1, struct stat *stats2)
+{
+    return (stats1->st_dev == stats2->st_dev) &&
+           (stats1->st_ino == stats2->st_ino) &&
+           (stats1->st_size == stats2->st_size) &&
+           (stats1->st_mtime == stats2->st_mtime) &&
+           (INI_MTIME_NSEC(stats1) == INI_MTIME_NSEC(stats2));
+}
+
+/* Parse the file again if it changed */
+static int ini_reload_refresh(struct ini_reload *reload,
+                              struct ini_reload_file *file,
+                              bool *changed)
+{
+    int error = EOK;
+    struct stat stats;
+    struct ini_cfgfile *file_ctx = NULL;
+    struct ini_cfgobj *new_cfg = NULL;
+
+    TRACE_FLOW_ENTRY();
+
+    /* Do not even read the file if the metadata did not change */
+    if ((file->snip.cfg) &&
+        (stat(file->snip.name, &stats) == 0) &&
+        (ini_reload_same_stats(&stats, &(file->stats)))) {
+        TRACE_INFO_STRING("File did not change", file->snip.name);
+        TRACE_FLOW_EXIT();
+        return EOK;
+    }
+
+    error = ini_config_file_open(file->snip.name,
+                                 INI_META_STATS,
+                                 &file_ctx);
+    if (error) {
+        TRACE_ERROR_NUMBER("Failed to open file.", error);
+        if (error == ENOMEM) return error;
+        if ((file->snip.cfg) || (file->snip.open_error != error)) {
+            *changed = true;
+        }
+        ini_config_destroy(file->snip.cfg);
+        file->snip.cfg = NULL;
+        file->snip.open_error = error;
+        return EOK;
+    }
+
+    /* Touched but not modified */
+    if ((file->snip.cfg) && (file_ctx->content_hash == file->hash)) {
+        TRACE_INFO_STRING("File contents did not change", file->snip.name);
+        file->stats = file_ctx->file_stats;
+        ini_config_file_destroy(file_ctx);
+        TRACE_FLOW_EXIT();
+        return EOK;
+    }
+
+    error = ini_config_create(&new_cfg);
+    if (error) {
+        TRACE_ERROR_NUMBER("Failed to create config object", error);
+        ini_config_file_destroy(file_ctx);
+        return error;
+    }
+
+    file->snip.parse_error = ini_config_parse(file_ctx,
+                                              reload->error_level,
+                                              reload->collision_flags,
+                                              reload->parse_flags,
+                                              new_cfg);
+    file->snip.open_error = 0;
+    file->stats = file_ctx->file_stats;
+    file->hash = file_ctx->content_hash;
+    ini_config_file_destroy(file_ctx);
+
+    ini_config_destroy(file->snip.cfg);
+    file->snip.cfg = new_cfg;
+    *changed = true;
+
+    TRACE_FLOW_EXIT();
+    return EOK;
+}
+
+/* Refresh the snippets found in the directory */
+static int ini_reload_snippets(struct ini_reload *reload,
+                               struct ref_array *ra_list,
+                               bool *changed)
+{
+    int error = EOK;
+    struct ini_reload_file *files = NULL;
+    uint32_t len;
+    uint32_t i;
+    uint32_t j;
+    uint32_t next = 0;
+    char *name;
+
+    TRACE_FLOW_ENTRY();
+
+    len = ref_array_len(ra_list);
+    if (len != reload->count) *changed = true;
+
+    if (len) {
+        files = calloc(len, sizeof(struct ini_reload_file));
+        if (!files) {
+            TRACE_ERROR_NUMBER("Failed to allocate files", ENOMEM);
+            return ENOMEM;
+        }
+    }
+
+    for (i = 0; i < len; i++) {
+        ref_array_get(ra_list, i, &name);
+
+        /* The list is sorted so the file is most likely the next one */
+        for (j = next; j < reload->count; j++) {
+            if ((reload->files[j].snip.name) &&
+                (strcmp(reload->files[j].snip.name, name) == 0)) break;
+        }
+        if (j == reload->count) {
+            for (j = 0; j < next; j++) {
+                if ((reload->files[j].snip.name) &&
+                    (strcmp(reload->files[j].snip.name, name) == 0)) break;
+            }
+            if (j == next) j = reload->count;
+        }
+
+        if (j < reload->count) {
+            files[i] = reload->files[j];
+            memset(&(reload->files[j]), 0, sizeof(struct ini_reload_file));
+            if (j != i) *changed = true;
+            next = j + 1;
+        }
+        else {
+            files[i].snip.name = strdup(name);
+            if (!(files[i].snip.name)) {
+                TRACE_ERROR_NUMBER("Failed to allocate name", ENOMEM);
+                error = ENOMEM;
+                break;
+            }
+            *changed = true;
+        }
+
+        error = ini_reload_refresh(reload, &files[i], changed);
+        if (error) {
+            TRACE_ERROR_NUMBER("Failed to refresh file", error);
+            break;
+        }
+    }
+
+    /* Files that are left are gone from the directory.
+     * On error the files that were processed are dropped
+     * so that they are parsed again next time.
+     */
+    for (j = 0; j < reload->count; j++) {
+        if (reload->files[j].snip.name) *changed = true;
+        ini_reload_file_free(&(reload->files[j]));
+    }
+    free(reload->files);
+
+    if (error) {
+        for (j = 0; j < len; j++) ini_reload_file_free(&files[j]);
+        free(files);
+        files = NULL;
+        len = 0;
+    }
+
+    reload->files = files;
+    reload->count = len;
+
+    TRACE_FLOW_EXIT();
+    return error;
+}
+
+/* Section that the reload brings in */
+struct ini_reload_swap {
+    /* Position in the list of the new sections */
+    int idx;
+    struct collection_item *new_item;
+    /* NULL if the section is new */
+    struct collection_item *old_item;
+    /* What was done and has to be undone on failure */
+    int added;
+    int swapped;
+};
+
+/* Swap the sections of two items */
+static void ini_reload_swap_sec(struct collection_item *item1,
+                                struct collection_item *item2)
+{
+    struct collection_item *sec;
+
+    sec = *((struct collection_item **)col_get_item_data(item1));
+    *((struct collection_item **)col_get_item_data(item1)) =
+        *((struct collection_item **)col_get_item_data(item2));
+    *((struct collection_item **)col_get_item_data(item2)) = sec;
+}
+
+/* Move changed sections from the new configuration into the old one.
+ * Nothing is removed before everything else succeeded, so on
+ * failure the configuration is restored as it was.
+ */
+static int ini_reload_patch(struct ini_cfgobj *ini_config,
+                            struct ini_cfgobj *new_cfg,
+                            char ***changed_sections)
+{
+    int error = EOK;
+    char **new_list = NULL;
+    char **old_list = NULL;
+    char **changed = NULL;
+    struct ini_reload_swap *swaps = NULL;
+    int new_size = 0;
+    int old_size = 0;
+    int count = 0;
+    int num = 0;
+    int i;
+    const struct ini_index_sec *new_isec;
+    const struct ini_index_sec *old_isec;
+    struct collection_item *item = NULL;
+    struct collection_item *sec = NULL;
+    struct ini_comment *ic = NULL;
+    struct ref_array *sources = NULL;
+
+    TRACE_FLOW_ENTRY();
+
+    new_list = ini_get_section_list(new_cfg, &new_size, &error);
+    if (error) {
+        TRACE_ERROR_NUMBER("Failed to get section list", error);
+        return error;
+    }
+
+    old_list = ini_get_section_list(ini_config, &old_size, &error);
+    if (error) {
+        TRACE_ERROR_NUMBER("Failed to get section list", error);
+        ini_free_section_list(new_list);
+        return error;
+    }
+
+    changed = calloc(new_size + old_size + 1, sizeof(char *));
+    swaps = calloc(new_size + 1, sizeof(struct ini_reload_swap));
+    if ((!changed) || (!swaps)) {
+        TRACE_ERROR_NUMBER("Failed to allocate list", ENOMEM);
+        error = ENOMEM;
+        goto done;
+    }
+
+    /* Find sections that were added or modified
+     * without touching the configuration.
+     */
+    for (i = 0; i < new_size; i++) {
+        new_isec = ini_index_find_sec(new_cfg->index, new_list[i]);
+        old_isec = ini_index_find_sec(ini_config->index, new_list[i]);
+        if ((old_isec) &&
+            (ini_index_sec_content_hash(old_isec) ==
+             ini_index_sec_content_hash(new_isec))) continue;
+
+        swaps[num].idx = i;
+        error = col_get_item(new_cfg->cfg, new_list[i],
+                             COL_TYPE_COLLECTIONREF,
+                             COL_TRAVERSE_ONELEVEL, &(swaps[num].new_item));
+        if ((!error) && (!(swaps[num].new_item))) error = ENOENT;
+        if ((!error) && (old_isec)) {
+            error = col_get_item(ini_config->cfg, new_list[i],
+                                 COL_TYPE_COLLECTIONREF,
+                                 COL_TRAVERSE_ONELEVEL,
+                                 &(swaps[num].old_item));
+            if ((!error) && (!(swaps[num].old_item))) error = ENOENT;
+        }
+        if (error) {
+            TRACE_ERROR_NUMBER("Failed to find section", error);
+            goto done;
+        }
+        num++;
+    }
+
+    /* New sections are added at the end */
+    for (i = 0; i < num; i++) {
+        if (swaps[i].old_item) continue;
+
+        TRACE_INFO_STRING("Section added", new_list[swaps[i].idx]);
+        sec = *((struct collection_item **)
+                col_get_item_data(swaps[i].new_item));
+        error = col_add_collection_to_collection(ini_config->cfg,
+                                                 NULL, NULL,
+                                                 sec,
+                                                 COL_ADD_MODE_REFERENCE);
+        if (error) {
+            TRACE_ERROR_NUMBER("Failed to add section", error);
+            goto done;
+        }
+        swaps[i].added = 1;
+    }
+
+    /* Swap the changed sections, the old ones go away
+     * together with the new configuration.
+     */
+    for (i = 0; i < num; i++) {
+        if (!(swaps[i].old_item)) continue;
+
+        TRACE_INFO_STRING("Section changed", new_list[swaps[i].idx]);
+        ini_reload_swap_sec(swaps[i].old_item, swaps[i].new_item);
+        swaps[i].swapped = 1;
+    }
+
+    for (i = 0; i < num; i++) {
+        error = ini_index_update_section(ini_config->index,
+                                         ini_config->cfg,
+                                         new_list[swaps[i].idx]);
+        if (error) {
+            TRACE_ERROR_NUMBER("Failed to index section", error);
+            goto done;
+        }
+    }
+
+    /* Sections that were removed, nothing fails after this */
+    for (i = 0; i < old_size; i++) {
+        if (ini_index_find_sec(new_cfg->index, old_list[i])) continue;
+
+        TRACE_INFO_STRING("Section removed", old_list[i]);
+        error = col_extract_item(ini_config->cfg, NULL, COL_DSP_FIRSTDUP,
+                                 old_list[i], 0, COL_TYPE_COLLECTIONREF,
+                                 &item);
+        if (error) {
+            /* Can't happen, the section is in the list */
+            TRACE_ERROR_NUMBER("Failed to extract section", error);
+            continue;
+        }
+
+        /* Update the index while the section still exists */
+        ini_index_remove_section(ini_config->index, old_list[i]);
+        col_delete_item_with_cb(item, ini_cleanup_cb, NULL);
+
+        /* Pass the ownership of the name to the list of changes */
+        changed[count++] = old_list[i];
+        old_list[i] = NULL;
+    }
+    error = EOK;
+
+    /* Pass the ownership of the names to the list of changes */
+    for (i = 0; i < num; i++) {
+        changed[count++] = new_list[swaps[i].idx];
+        new_list[swaps[i].idx] = NULL;
+    }
+
+    /* Take the comment at the end of the file */
+    ic = ini_config->last_comment;
+    ini_config->last_comment = new_cfg->last_comment;
+    new_cfg->last_comment = ic;
+
+    /* And what the configuration was read from */
+    sources = ini_config->sources;
+    ini_config->sources = new_cfg->sources;
+    new_cfg->sources = sources;
+
+done:
+    if (error) {
+        /* Put back what was changed */
+        for (i = 0; i < num; i++) {
+            if (swaps[i].swapped) {
+                ini_reload_swap_sec(swaps[i].old_item, swaps[i].new_item);
+            }
+            if ((swaps[i].added) &&
+                (col_extract_item(ini_config->cfg, NULL, COL_DSP_FIRSTDUP,
+                                  new_list[swaps[i].idx], 0,
+                                  COL_TYPE_COLLECTIONREF, &item) == EOK)) {
+                /* The section itself stays with the new configuration */
+                col_delete_item_with_cb(item, ini_cleanup_cb, NULL);
+            }
+        }
+    }
+
+    /* The section lists might have holes now */
+    for (i = 0; i < new_size; i++) free(new_list[i]);
+    free(new_list);
+    for (i = 0; i < old_size; i++) free(old_list[i]);
+    free(old_list);
+    free(swaps);
+
+    ini_config_clean_state(ini_config);
+
+    if (error) {
+        /* Sections are back, make the index match them */
+        (void)ini_index_build(ini_config->index, ini_config->cfg);
+        ini_free_section_list(changed);
+        return error;
+    }
+
+    if (count == 0) {
+        free(changed);
+        changed = NULL;
+    }
+
+    *changed_sections = changed;
+
+    TRACE_FLOW_EXIT();
+    return EOK;
+}
+
+/* Prepare state for incremental reloads */
+int ini_reload_create(const char *path,
+                      const char *snip_dir,
+                      struct ini_augment_ctx *ctx,
+                      struct access_check *check_perm,
+                      int error_level,
+                      uint32_t collision_flags,
+                      uint32_t parse_flags,
+                      uint32_t merge_flags,
+                      struct ini_reload **reload)
+{
+    int error = EOK;
+    struct ini_reload *new_reload = NULL;
+
+    TRACE_FLOW_ENTRY();
+
+    if ((path == NULL) || (reload == NULL)) {
+        TRACE_ERROR_NUMBER("Invalid argument", EINVAL);
+        return EINVAL;
+    }
+
+    new_reload = calloc(1, sizeof(struct ini_reload));
+    if (new_reload == NULL) {
+        TRACE_ERROR_NUMBER("Failed to allocate reload state", ENOMEM);
+        return ENOMEM;
+    }
+
+    new_reload->base.snip.name = strdup(path);
+    if ((new_reload->base.snip.name == NULL) ||
+        ((snip_dir) &&
+         ((new_reload->dir = strdup(snip_dir)) == NULL))) {
+        TRACE_ERROR_NUMBER("Failed to allocate path", ENOMEM);
+        ini_reload_destroy(new_reload);
+        return ENOMEM;
+    }
+
+    /* Without a context all files and sections are accepted */
+    if (ctx) {
+        new_reload->ctx = ctx;
+    }
+    else {
+        error = ini_augment_ctx_create(NULL, NULL, &(new_reload->own_ctx));
+        if (error) {
+            TRACE_ERROR_NUMBER("Failed to create context", error);
+            ini_reload_destroy(new_reload);
+            return error;
+        }
+        new_reload->ctx = new_reload->own_ctx;
+    }
+
+    if (check_perm) {
+        new_reload->check = *check_perm;
+        new_reload->check_perm = &(new_reload->check);
+    }
+
+    new_reload->error_level = error_level;
+    new_reload->collision_flags = collision_flags;
+    new_reload->parse_flags = parse_flags;
+    new_reload->merge_flags = merge_flags & ~INI_AUG_PARALLEL;
+
+    *reload = new_reload;
+
+    TRACE_FLOW_EXIT();
+    return EOK;
+}
+
+/* Free reload state */
+void ini_reload_destroy(struct ini_reload *reload)
+{
+    uint32_t i;
+
+    TRACE_FLOW_ENTRY();
+
+    if (reload) {
+        ini_reload_file_free(&(reload->base));
+        for (i = 0; i < reload->count; i++) {
+            ini_reload_file_free(&(reload->files[i]));
+        }
+        free(reload->files);
+        free(reload->dir);
+        ini_augment_ctx_destroy(reload->own_ctx);
+        free(reload);
+    }
+
+    TRACE_FLOW_EXIT();
+}
+
+/* Hash of what the reload read last time */
+uint64_t ini_reload_hash(struct ini_reload *reload)
+{
+    uint64_t hash = INI_HASH_INIT;
+    struct ini_reload_file *file;
+    uint32_t i;
+
+    for (i = 0; i <= reload->count; i++) {
+        file = (i == 0) ? &(reload->base) : &(reload->files[i - 1]);
+        hash = ini_hash_data(hash, &(file->hash), sizeof(file->hash));
+        hash = ini_hash_data(hash, &(file->snip.open_error),
+                             sizeof(file->snip.open_error));
+        hash = ini_hash_data(hash, &(file->snip.parse_error),
+                             sizeof(file->snip.parse_error));
+    }
+
+    return hash;
+}
+
+/* Reparse changed files and update the configuration */
+int ini_config_reload(struct ini_reload *reload,
+                      struct ini_cfgobj *ini_config,
+                      char ***changed_sections,
+                      struct ref_array **error_list)
+{
+    int error = EOK;
+    int merge_error = EOK;
+    bool changed = false;
+    struct ref_array *ra_list = NULL;
+    struct ref_array *ra_err = NULL;
+    struct ref_array *ra_ok = NULL;
+    struct ini_aug_snippet *parsed = NULL;
+    struct ini_cfgobj *new_cfg = NULL;
+    struct ini_source dir_src;
+    uint32_t i;
+
+    TRACE_FLOW_ENTRY();
+
+    dir_src.path = NULL;
+
+    if ((reload == NULL) ||
+        (ini_config == NULL) ||
+        (changed_sections == NULL)) {
+        TRACE_ERROR_NUMBER("Invalid argument", EINVAL);
+        return EINVAL;
+    }
+
+    *changed_sections = NULL;
+
+    if ((ref_array_create(&ra_list,
+                          sizeof(char *),
+                          INI_AUG_ARR_SIZE_INC,
+                          array_cleanup,
+                          NULL) != 0) ||
+        (ref_array_create(&ra_err,
+                          sizeof(char *),
+                          INI_AUG_ARR_SIZE_INC * 5,
+                          array_cleanup,
+                          NULL) != 0) ||
+        (ref_array_create(&ra_ok,
+                          sizeof(char *),
+                          INI_AUG_ARR_SIZE_INC * 5,
+                          array_cleanup,
+                          NULL) != 0)) {
+        TRACE_ERROR_NUMBER("Failed to allocate memory for arrays.",
+                           ENOMEM);
+        error = ENOMEM;
+        goto done;
+    }
+
+    /* Main file */
+    error = ini_reload_refresh(reload, &(reload->base), &changed);
+    if (!error) {
+        error = reload->base.snip.open_error;
+        if (!error) error = reload->base.snip.parse_error;
+    }
+    if (error) {
+        TRACE_ERROR_NUMBER("Failed to read main file", error);
+        /* Make sure it is read again next time */
+        ini_config_destroy(reload->base.snip.cfg);
+        reload->base.snip.cfg = NULL;
+        goto done;
+    }
+
+    /* Snippets */
+    if (reload->dir) {
+        error = ini_aug_preprare(reload->dir,
+                                 reload->ctx->files,
+                                 reload->check_perm,
+                                 ra_list,
+                                 ra_err,
+                                 &dir_src);
+        if (error) {
+            TRACE_ERROR_NUMBER("Failed to prepare lists of snippets.",
+                               error);
+            goto done;
+        }
+    }
+
+    error = ini_reload_snippets(reload, ra_list, &changed);
+    if (error) {
+        TRACE_ERROR_NUMBER("Failed to refresh snippets", error);
+        goto done;
+    }
+
+    if (!changed) {
+        TRACE_INFO_STRING("Nothing changed", "");
+        goto done;
+    }
+
+    /* Merge everything again, only changed files were parsed */
+    if (reload->count) {
+        parsed = calloc(reload->count, sizeof(struct ini_aug_snippet));
+        if (parsed == NULL) {
+            TRACE_ERROR_NUMBER("Failed to allocate snippets", ENOMEM);
+            error = ENOMEM;
+            goto done;
+        }
+        for (i = 0; i < reload->count; i++) {
+            parsed[i] = reload->files[i].snip;
+        }
+    }
+
+    error = ini_aug_apply(reload->base.snip.cfg,
+                          ra_list,
+                          parsed,
+                          reload->ctx->sections,
+                          reload->error_level,
+                          reload->collision_flags,
+                          reload->parse_flags,
+                          reload->merge_flags,
+                          ra_err,
+                          ra_ok,
+                          &new_cfg);
+    if ((!new_cfg) || (error == ENOMEM)) {
+        TRACE_ERROR_NUMBER("Failed to merge snippets", error);
+        goto done;
+    }
+
+    /* Same as in ini_config_augment_ctx() the result is
+     * valid even if some snippets failed to merge,
+     * the error is returned as a warning.
+     */
+    if (error) {
+        TRACE_INFO_NUMBER("Snippets merged with errors", error);
+        merge_error = error;
+        error = EOK;
+    }
+
+    if (dir_src.path) {
+        error = ini_config_add_source(new_cfg,
+                                      dir_src.path,
+                                      &(dir_src.stats),
+                                      0);
+        if (error) {
+            TRACE_ERROR_NUMBER("Failed to record directory", error);
+            goto done;
+        }
+    }
+
+    error = ini_reload_patch(ini_config, new_cfg, changed_sections);
+    if (error) {
+        TRACE_ERROR_NUMBER("Failed to update configuration", error);
+    }
+    else error = merge_error;
+
+done:
+    free(dir_src.path);
+    free(parsed);
+    ini_config_destroy(new_cfg);
+    ref_array_destroy(ra_list);
+    ref_array_destroy(ra_ok);
+
+    if (error_list) *error_list = ra_err;
+    else ref_array_destroy(ra_err);
+
+    TRACE_FLOW_EXIT();
+    return error;
+}
@@ -25,6 +25,10 @@
 #include <string.h>
 #include <stdlib.h>
 #include <sys/wait.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include <poll.h>
 /* #define TRACE_LEVEL 7 */
 #define TRACE_HOME
 #include "trace.h"
@@ -32,8 +36,11 @@
 #include "ini_config_priv.h"
 #include "collection_tools.h"
 #include "path_utils.h"
+#include "simplebuffer.h"
 
 int verbose = 0;
+/* Run the timing tests at full size */
+int perf = 0;
 
 #define INIOUT(foo) \
     do { \
@@ -42,6 +49,11 @@ int verbose = 0;
 
 typedef int (*test_fn)(void);
 
+/* Number of snippets for the timing test,
+ * the full size is used only with -p */
+#define NUM_SNIPPETS 10000
+#define NUM_SNIPPETS_CHECK 100
+
 void print_list(struct ref_array *list);
 int print_list_to_file(struct ref_array *list,
                        const char *filename,
@@ -359,21 +371,700 @@ static int basic_test(void)
     return error;
 }
 
+/* Compare two lists of strings */
+static int compare_lists(struct ref_array *list1, struct ref_array *list2)
+{
+    uint32_t i = 0;
+    char *str1 = NULL;
+    char *str2 = NULL;
+
+    if (ref_array_len(list1) != ref_array_len(list2)) return -1;
+
+    for (i = 0; i < ref_array_len(list1); i++) {
+        ref_array_get(list1, i, &str1);
+        ref_array_get(list2, i, &str2);
+        if (strcmp(str1, str2) != 0) {
+            INIOUT(printf("Got '%s' expected '%s'\n", str2, str1));
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/* Parallel parsing must give the same result as serial */
+static int parallel_test(void)
+{
+    int error = EOK;
+    int i;
+    char indir[PATH_MAX];
+    char *srcdir = NULL;
+    struct ini_cfgobj *in_cfg = NULL;
+    struct ini_cfgobj *result_cfg[2] = { NULL, NULL };
+    struct ref_array *error_list[2] = { NULL, NULL };
+    struct ref_array *success_list[2] = { NULL, NULL };
+    struct simplebuffer *sb[2] = { NULL, NULL };
+    uint32_t flags[2] = { INI_MV2S_DETECT | INI_MS_DETECT,
+                          INI_MV2S_DETECT | INI_MS_DETECT | INI_AUG_PARALLEL };
+    const char *patterns[] = { "#",
+                               "^[^r][a-z]*\\.conf$",
+                               "^real\\.conf$",
+                               NULL };
+
+    INIOUT(printf("<==== Start ====>\n"));
+
+    srcdir = getenv("srcdir");
+    snprintf(indir, PATH_MAX, "%s/ini/ini.d",
+                    (srcdir == NULL) ? "." : srcdir);
+
+    error = ini_config_create(&in_cfg);
+    if (error) {
+        INIOUT(printf("Failed to create collection. Error %d.\n", error));
+        return error;
+    }
+
+    for (i = 0; i < 2; i++) {
+        error = ini_config_augment(in_cfg,
+                                   indir,
+                                   patterns,
+                                   NULL,
+                                   NULL,
+                                   INI_STOP_ON_NONE,
+                                   INI_MV1S_DETECT|INI_MV2S_DETECT|
+                                   INI_MS_DETECT,
+                                   INI_PARSE_NOSPACE|INI_PARSE_NOTAB,
+                                   flags[i],
+                                   &result_cfg[i],
+                                   &error_list[i],
+                                   &success_list[i]);
+        if ((error) || (!result_cfg[i])) {
+            printf("Augmentation failed with error %d!\n", error);
+            if (!error) error = -1;
+            goto done;
+        }
+
+        error = simplebuffer_alloc(&sb[i]);
+        if (!error) error = ini_config_serialize(result_cfg[i], sb[i]);
+        if (error) {
+            printf("Failed to serialize. Error %d.\n", error);
+            goto done;
+        }
+    }
+
+    if ((compare_lists(error_list[0], error_list[1])) ||
+        (compare_lists(success_list[0], success_list[1])) ||
+        (simplebuffer_get_len(sb[0]) != simplebuffer_get_len(sb[1])) ||
+        (memcmp(simplebuffer_get_buf(sb[0]), simplebuffer_get_buf(sb[1]),
+                simplebuffer_get_len(sb[0])) != 0)) {
+        printf("Parallel augmentation gave a different result.\n");
+        error = -1;
+    }
+
+done:
+    for (i = 0; i < 2; i++) {
+        ref_array_destroy(error_list[i]);
+        ref_array_destroy(success_list[i]);
+        ini_config_destroy(result_cfg[i]);
+        simplebuffer_free(sb[i]);
+    }
+    ini_config_destroy(in_cfg);
+
+    INIOUT(printf("<==== End ====>\n"));
+
+    return error;
+}
+
+/* Augment from a big snippet directory, it is timed with -p */
+static int perf_test(void)
+{
+    int error = EOK;
+    int i;
+    int round;
+    int num = perf ? NUM_SNIPPETS : NUM_SNIPPETS_CHECK;
+    char dirname[] = "./aug_perf.d";
+    char name[PATH_MAX];
+    char command[PATH_MAX];
+    FILE *file = NULL;
+    struct timespec start, end;
+    struct ini_cfgobj *in_cfg = NULL;
+    struct ini_cfgobj *result_cfg = NULL;
+    struct ref_array *success_list = NULL;
+    struct ini_augment_ctx *ctx = NULL;
+    char *prev = NULL;
+    char *cur = NULL;
+    const char *patterns[] = { "^a[0-9]*\\.conf$",
+                               "^b[0-9]*\\.conf$",
+                               "^c[0-9]*\\.conf$",
+                               "^s[0-9]*\\.conf$",
+                               NULL };
+
+    INIOUT(printf("<==== Start ====>\n"));
+
+    snprintf(command, PATH_MAX, "rm -rf %s", dirname);
+    (void)system(command);
+    if (mkdir(dirname, 0755) == -1) {
+        error = errno;
+        printf("Failed to create directory %d.\n", error);
+        return error;
+    }
+
+    /* Create files in reverse order */
+    for (i = num; i > 0; i--) {
+        snprintf(name, PATH_MAX, "%s/s%05d.conf", dirname, i);
+        file = fopen(name, "w");
+        if (!file) {
+            error = errno;
+            printf("Failed to create file %d.\n", error);
+            goto done;
+        }
+        fprintf(file, "[section%d]\nkey = %d\n", i, i);
+        fclose(file);
+    }
+
+    error = ini_config_create(&in_cfg);
+    if (error) goto done;
+
+    error = ini_augment_ctx_create(patterns, NULL, &ctx);
+    if (error) {
+        printf("Failed to create context %d.\n", error);
+        goto done;
+    }
+
+    for (round = 0; round < 2; round++) {
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        error = ini_config_augment_ctx(in_cfg,
+                                       dirname,
+                                       ctx,
+                                       NULL,
+                                       INI_STOP_ON_ANY,
+                                       0,
+                                       0,
+                                       INI_MS_MERGE,
+                                       &result_cfg,
+                                       NULL,
+                                       &success_list);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        if (error) {
+            printf("Augmentation failed with error %d!\n", error);
+            goto done;
+        }
+
+        INIOUT(printf("Round %d: %d snippets in %.3f seconds\n",
+                      round, num,
+                      (end.tv_sec - start.tv_sec) +
+                      (end.tv_nsec - start.tv_nsec) / 1e9));
+
+        if (ref_array_len(success_list) != (uint32_t)num) {
+            printf("Expected %d snippets got %u.\n",
+                   num, ref_array_len(success_list));
+            error = -1;
+            goto done;
+        }
+
+        /* Snippets must be merged in sorted order */
+        prev = NULL;
+        for (i = 0; i < num; i++) {
+            ref_array_get(success_list, i, &cur);
+            if ((prev) && (strcmp(prev, cur) >= 0)) {
+                printf("Snippets are not sorted: %s %s.\n", prev, cur);
+                error = -1;
+                goto done;
+            }
+            prev = cur;
+        }
+
+        ref_array_destroy(success_list);
+        success_list = NULL;
+        ini_config_destroy(result_cfg);
+        result_cfg = NULL;
+    }
+
+done:
+    ref_array_destroy(success_list);
+    ini_config_destroy(result_cfg);
+    ini_config_destroy(in_cfg);
+    ini_augment_ctx_destroy(ctx);
+    (void)system(command);
+
+    INIOUT(printf("<==== End ====>\n"));
+
+    return error;
+}
+
+/* Write file with the given contents */
+static int write_file(const char *name, const char *contents)
+{
+    FILE *file = NULL;
+
+    file = fopen(name, "w");
+    if (!file) {
+        printf("Failed to create file %s.\n", name);
+        return errno;
+    }
+    fprintf(file, "%s", contents);
+    fclose(file);
+    return 0;
+}
+
+/* Reload and check the list of changed sections */
+static int check_reload(struct ini_reload *reload,
+                        struct ini_cfgobj *cfg,
+                        const char *expected[])
+{
+    int error = EOK;
+    char **changed = NULL;
+    int i;
+
+    error = ini_config_reload(reload, cfg, &changed, NULL);
+    if (error) {
+        printf("Reload failed with error %d!\n", error);
+        return error;
+    }
+
+    for (i = 0; expected[i]; i++) {
+        if ((!changed) || (!changed[i]) ||
+            (strcmp(changed[i], expected[i]) != 0)) {
+            printf("Expected changed section %s.\n", expected[i]);
+            error = -1;
+            break;
+        }
+        INIOUT(printf("Changed: %s\n", changed[i]));
+    }
+
+    if ((!error) && (changed) && (changed[i])) {
+        printf("Unexpected changed section %s.\n", changed[i]);
+        error = -1;
+    }
+
+    ini_free_section_list(changed);
+    return error;
+}
+
+/* Incremental reload */
+static int reload_test(void)
+{
+    int error = EOK;
+    char dirname[] = "./reload_test.d";
+    char command[PATH_MAX];
+    struct ini_cfgobj *cfg = NULL;
+    struct ini_cfgobj *cached = NULL;
+    struct ini_reload *reload = NULL;
+    struct value_obj *vo = NULL;
+    struct value_obj *vo_other = NULL;
+    const char *all[] = { "main", "other", "snip_a", "snip_b", NULL };
+    const char *none[] = { NULL };
+    const char *snip_b[] = { "snip_b", NULL };
+    const char *snip_a[] = { "snip_a", NULL };
+
+    INIOUT(printf("<==== Start ====>\n"));
+
+    snprintf(command, PATH_MAX, "rm -rf %s ./reload_test.conf", dirname);
+    (void)system(command);
+    if (mkdir(dirname, 0755) == -1) {
+        error = errno;
+        printf("Failed to create directory %d.\n", error);
+        return error;
+    }
+
+    if ((error = write_file("./reload_test.conf",
+                            "[main]\nkey = 1\n[other]\nkey = 2\n")) ||
+        (error = write_file("./reload_test.d/a.conf",
+                            "[snip_a]\nkey = 1\n")) ||
+        (error = write_file("./reload_test.d/b.conf",
+                            "[snip_b]\nkey = 2\n"))) goto done;
+
+    error = ini_config_create(&cfg);
+    if (error) goto done;
+
+    error = ini_reload_create("./reload_test.conf", dirname, NULL, NULL,
+                              INI_STOP_ON_ANY, 0, 0, INI_MS_MERGE, &reload);
+    if (error) {
+        printf("Failed to create reload state %d.\n", error);
+        goto done;
+    }
+
+    /* First time everything is new */
+    if ((error = check_reload(reload, cfg, all)) ||
+        (error = check_reload(reload, cfg, none))) goto done;
+
+    error = ini_get_config_valueobj("other", "key", cfg,
+                                    INI_GET_FIRST_VALUE, &vo_other);
+    if ((error) || (!vo_other)) {
+        printf("Value not found.\n");
+        error = -1;
+        goto done;
+    }
+
+    /* Same size, possibly the same time stamp */
+    if ((error = write_file("./reload_test.d/b.conf",
+                            "[snip_b]\nkey = 3\n")) ||
+        (error = check_reload(reload, cfg, snip_b))) goto done;
+
+    error = ini_get_config_valueobj("snip_b", "key", cfg,
+                                    INI_GET_FIRST_VALUE, &vo);
+    if ((error) || (!vo) ||
+        (ini_get_int_config_value(vo, 1, 0, &error) != 3)) {
+        printf("Value was not updated.\n");
+        error = -1;
+        goto done;
+    }
+
+    /* Values of the unchanged sections stay in place */
+    vo = NULL;
+    error = ini_get_config_valueobj("other", "key", cfg,
+                                    INI_GET_FIRST_VALUE, &vo);
+    if ((error) || (vo != vo_other)) {
+        printf("Unchanged value was replaced.\n");
+        error = -1;
+        goto done;
+    }
+
+    /* Rewriting with the same contents is not a change */
+    if ((error = write_file("./reload_test.d/a.conf",
+                            "[snip_a]\nkey = 1\n")) ||
+        (error = check_reload(reload, cfg, none))) goto done;
+
+    /* Comment only edits are changes too */
+    if ((error = write_file("./reload_test.d/a.conf",
+                            "[snip_a]\n# note\nkey = 1\n")) ||
+        (error = check_reload(reload, cfg, snip_a)) ||
+        (error = write_file("./reload_test.d/a.conf",
+                            "# section note\n[snip_a]\n# note\nkey = 1\n")) ||
+        (error = check_reload(reload, cfg, snip_a))) goto done;
+
+    /* Removed snippet removes its section */
+    unlink("./reload_test.d/a.conf");
+    error = check_reload(reload, cfg, snip_a);
+    if (error) goto done;
+
+    vo = NULL;
+    error = ini_get_config_valueobj("snip_a", "key", cfg,
+                                    INI_GET_FIRST_VALUE, &vo);
+    if ((error) || (vo)) {
+        printf("Removed section is still found.\n");
+        error = -1;
+        goto done;
+    }
+
+    /* Reloaded configuration records the snippet directory */
+    error = ini_config_cache_save(cfg, "./reload_test.d.cache");
+    if (!error) error = ini_config_cache_load("./reload_test.d.cache",
+                                              &cached);
+    if (error) {
+        printf("Failed to use cache %d.\n", error);
+        goto done;
+    }
+    ini_config_destroy(cached);
+    cached = NULL;
+
+    error = write_file("./reload_test.d/c.conf", "[snip_c]\nkey = 1\n");
+    if (error) goto done;
+    error = ini_config_cache_load("./reload_test.d.cache", &cached);
+    if (error != ESTALE) {
+        printf("New snippet did not make the cache stale %d.\n", error);
+        error = -1;
+        goto done;
+    }
+    error = EOK;
+
+done:
+    ini_reload_destroy(reload);
+    ini_config_destroy(cfg);
+    ini_config_destroy(cached);
+    unlink("./reload_test.d.cache");
+    (void)system(command);
+
+    INIOUT(printf("<==== End ====>\n"));
+
+    return error;
+}
+
+/* Reload with a duplicate snippet in the detect mode */
+static int reload_detect_test(void)
+{
+    int error = EOK;
+    char command[PATH_MAX];
+    struct ini_cfgobj *cfg = NULL;
+    struct ini_reload *reload = NULL;
+    struct value_obj *vo = NULL;
+    char **changed = NULL;
+
+    INIOUT(printf("<==== Start ====>\n"));
+
+    snprintf(command, PATH_MAX, "rm -rf ./detect_test.d ./detect_test.conf");
+    (void)system(command);
+    if (mkdir("./detect_test.d", 0755) == -1) {
+        error = errno;
+        printf("Failed to create directory %d.\n", error);
+        return error;
+    }
+
+    if ((error = write_file("./detect_test.conf", "[main]\nkey = 1\n")) ||
+        (error = write_file("./detect_test.d/a.conf",
+                            "[snip]\nkey = 1\n")) ||
+        (error = write_file("./detect_test.d/b.conf",
+                            "[snip]\nother = 2\n"))) goto done;
+
+    error = ini_config_create(&cfg);
+    if (error) goto done;
+
+    error = ini_reload_create("./detect_test.conf", "./detect_test.d",
+                              NULL, NULL, INI_STOP_ON_ANY, 0, 0,
+                              INI_MS_DETECT, &reload);
+    if (error) {
+        printf("Failed to create reload state %d.\n", error);
+        goto done;
+    }
+
+    /* The last snippet is a duplicate, it is a warning */
+    error = ini_config_reload(reload, cfg, &changed, NULL);
+    ini_free_section_list(changed);
+    if ((error != EEXIST) || (!changed)) {
+        printf("Expected EEXIST with changes, got %d.\n", error);
+        error = -1;
+        goto done;
+    }
+
+    /* Later changes are applied too */
+    if ((error = write_file("./detect_test.d/b.conf",
+                            "[snip]\nother = 3\n"))) goto done;
+    error = ini_config_reload(reload, cfg, &changed, NULL);
+    ini_free_section_list(changed);
+    if ((error != EEXIST) || (!changed)) {
+        printf("Expected EEXIST with changes, got %d.\n", error);
+        error = -1;
+        goto done;
+    }
+
+    error = ini_get_config_valueobj("snip", "other", cfg,
+                                    INI_GET_FIRST_VALUE, &vo);
+    if ((error) || (!vo) ||
+        (ini_get_int_config_value(vo, 1, 0, &error) != 3)) {
+        printf("Duplicate snippet was not applied.\n");
+        error = -1;
+        goto done;
+    }
+
+done:
+    ini_reload_destroy(reload);
+    ini_config_destroy(cfg);
+    (void)system(command);
+
+    INIOUT(printf("<==== End ====>\n"));
+
+    return error;
+}
+
+/* What the watcher reported */
+struct watch_result {
+    int pipe[2];
+    int error;
+    char changed[PATH_MAX];
+};
+
+static void watch_cb(struct ini_cfgobj *ini_config,
+                     char **changed_sections,
+                     struct ref_array *error_list,
+                     int error,
+                     void *data)
+{
+    struct watch_result *result = (struct watch_result *)data;
+    int i;
+
+    result->error = error;
+    result->changed[0] = '\0';
+    for (i = 0; changed_sections && changed_sections[i]; i++) {
+        strncat(result->changed, changed_sections[i],
+                PATH_MAX - strlen(result->changed) - 2);
+        strcat(result->changed, " ");
+    }
+    ini_config_destroy(ini_config);
+
+    (void)write(result->pipe[1], "x", 1);
+}
+
+/* Wait for the watcher and check what it reported */
+static int check_watch(struct watch_result *result, const char *expected)
+{
+    struct pollfd fd;
+    char c;
+
+    fd.fd = result->pipe[0];
+    fd.events = POLLIN;
+    if (poll(&fd, 1, 5000) != 1) {
+        printf("Change was not detected.\n");
+        return -1;
+    }
+    (void)read(result->pipe[0], &c, 1);
+
+    INIOUT(printf("Watcher reported: %s\n", result->changed));
+
+    if ((result->error) || (strcmp(result->changed, expected) != 0)) {
+        printf("Expected %s, got %s (error %d).\n",
+               expected, result->changed, result->error);
+        return -1;
+    }
+    return EOK;
+}
+
+/* Watch files for changes */
+static int watch_test(void)
+{
+    int error = EOK;
+    char dirname[] = "./watch_test.d";
+    char command[PATH_MAX];
+    struct ini_cfgfile *file_ctx = NULL;
+    struct ini_watch *watch = NULL;
+    struct watch_result result;
+    struct pollfd fd;
+    char value[50];
+    int i;
+
+    INIOUT(printf("<==== Start ====>\n"));
+
+    memset(&result, 0, sizeof(result));
+    if (pipe(result.pipe) == -1) {
+        error = errno;
+        printf("Failed to create pipe %d.\n", error);
+        return error;
+    }
+
+    snprintf(command, PATH_MAX, "rm -rf %s ./watch_test.*", dirname);
+    (void)system(command);
+    if (mkdir(dirname, 0755) == -1) {
+        error = errno;
+        printf("Failed to create directory %d.\n", error);
+        goto done;
+    }
+
+    if ((error = write_file("./watch_test.conf", "[main]\nkey = 1\n")) ||
+        (error = write_file("./watch_test.d/a.conf",
+                            "[snip_a]\nkey = 1\n"))) goto done;
+
+    error = ini_config_file_open("./watch_test.conf", 0, &file_ctx);
+    if (error) {
+        printf("Failed to open file %d.\n", error);
+        goto done;
+    }
+
+    error = ini_watch_create(file_ctx, dirname, NULL, NULL,
+                             INI_STOP_ON_ANY, 0, 0, INI_MS_MERGE, 50,
+                             watch_cb, &result, &watch);
+    if (error == ENOSYS) {
+        INIOUT(printf("Watching is not supported, skipping.\n"));
+        error = EOK;
+        goto done;
+    }
+    if (error) {
+        printf("Failed to create watcher %d.\n", error);
+        goto done;
+    }
+
+    /* Snippet is modified in place */
+    if ((error = write_file("./watch_test.d/a.conf",
+                            "[snip_a]\nkey = 2\n")) ||
+        (error = check_watch(&result, "snip_a "))) goto done;
+
+    /* Main file is replaced atomically */
+    if ((error = write_file("./watch_test.tmp", "[main]\nkey = 2\n")))
+        goto done;
+    if (rename("./watch_test.tmp", "./watch_test.conf") == -1) {
+        error = errno;
+        printf("Failed to rename file %d.\n", error);
+        goto done;
+    }
+    if ((error = check_watch(&result, "main "))) goto done;
+
+    /* Snippet directory is removed */
+    (void)system("rm -rf ./watch_test.d");
+    if ((error = check_watch(&result, "snip_a "))) goto done;
+
+    /* New directory is renamed into its place */
+    if ((mkdir("./watch_test.new", 0755) == -1) ||
+        (write_file("./watch_test.new/b.conf", "[snip_b]\nkey = 1\n")) ||
+        (rename("./watch_test.new", dirname) == -1)) {
+        printf("Failed to replace directory.\n");
+        error = -1;
+        goto done;
+    }
+    if ((error = check_watch(&result, "snip_b "))) goto done;
+
+    /* The new directory is watched */
+    if ((error = write_file("./watch_test.d/b.conf",
+                            "[snip_b]\nkey = 2\n")) ||
+        (error = check_watch(&result, "snip_b "))) goto done;
+
+    /* Steady stream of changes does not postpone the reload forever.
+     * The file is written in place so the reload can catch it
+     * half written, which must not be reported as an error.
+     */
+    for (i = 0; i < 200; i++) {
+        snprintf(value, sizeof(value), "[main]\nkey = %d\n", i + 3);
+        if ((error = write_file("./watch_test.conf", value))) goto done;
+        fd.fd = result.pipe[0];
+        fd.events = POLLIN;
+        if (poll(&fd, 1, 20) == 1) break;
+    }
+    if (i == 200) {
+        printf("Reload was postponed.\n");
+        error = -1;
+        goto done;
+    }
+    error = check_watch(&result, "main ");
+    if (error) goto done;
+
+    /* Broken file is reported after it reads the same twice */
+    if ((error = write_file("./watch_test.conf", "[main\nkey = 1\n")))
+        goto done;
+    fd.fd = result.pipe[0];
+    fd.events = POLLIN;
+    /* Reloads of the earlier writes might still come */
+    do {
+        if (poll(&fd, 1, 5000) != 1) {
+            printf("Parse error was not reported.\n");
+            error = -1;
+            goto done;
+        }
+        (void)read(result.pipe[0], value, 1);
+    } while (result.error == EOK);
+
+done:
+    ini_watch_destroy(watch);
+    ini_config_file_destroy(file_ctx);
+    close(result.pipe[0]);
+    close(result.pipe[1]);
+    (void)system(command);
+
+    INIOUT(printf("<==== End ====>\n"));
+
+    return error;
+}
+
 
 int main(int argc, char *argv[])
 {
     int error = EOK;
     test_fn tests[] = { basic_test,
+                        parallel_test,
+                        perf_test,
+                        reload_test,
+                        reload_detect_test,
+                        watch_test,
                         NULL };
     test_fn t;
     int i = 0;
     char *var;
 
-    if ((argc > 1) && (strcmp(argv[1], "-v") == 0)) verbose = 1;
-    else {
-        var = getenv("COMMON_TEST_VERBOSE");
-        if (var) verbose = 1;
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-v") == 0) verbose = 1;
+        else if (strcmp(argv[i], "-p") == 0) perf = 1;
     }
+    var = getenv("COMMON_TEST_VERBOSE");
+    if (var) verbose = 1;
+    var = getenv("COMMON_TEST_PERF");
+    if (var) perf = 1;
+
+    i = 0;
 
     INIOUT(printf("Start\n"));
 
@@ -0,0 +1,254 @@
+/*
+    INI LIBRARY
+
+    Functions to store values of the options
+    into the fields of a caller provided structure.
+
+    Copyright (C) Dmitri Pal <dpal@redhat.com> 2026
+
+    INI Library is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    INI Library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with INI Library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "config.h"
+#include <errno.h>
+#include <string.h>
+#include <strings.h>
+#include <stdlib.h>
+#include "trace.h"
+#include "collection.h"
+#include "ini_defines.h"
+#include "ini_configobj.h"
+#include "ini_config_priv.h"
+#include "ini_valueobj.h"
+#include "ini_index.h"
+
+/* Convert value and store it in the field */
+static int bind_value(struct value_obj *vo,
+                      const struct ini_binding *binding,
+                      int strict,
+                      void *data)
+{
+    int error = EOK;
+    void *field;
+
+    TRACE_FLOW_ENTRY();
+
+    field = (char *)data + binding->offset;
+
+    switch (binding->type) {
+    case INI_BIND_INT:
+        *((int *)field) = ini_get_int_config_value(vo, strict,
+                                                   *((int *)field),
+                                                   &error);
+        break;
+    case INI_BIND_UNSIGNED:
+        *((unsigned *)field) = ini_get_unsigned_config_value(
+                                            vo, strict,
+                                            *((unsigned *)field),
+                                            &error);
+        break;
+    case INI_BIND_LONG:
+        *((long *)field) = ini_get_long_config_value(vo, strict,
+                                                     *((long *)field),
+                                                     &error);
+        break;
+    case INI_BIND_ULONG:
+        *((unsigned long *)field) = ini_get_ulong_config_value(
+                                            vo, strict,
+                                            *((unsigned long *)field),
+                                            &error);
+        break;
+    case INI_BIND_INT32:
+        *((int32_t *)field) = ini_get_int32_config_value(
+                                            vo, strict,
+                                            *((int32_t *)field),
+                                            &error);
+        break;
+    case INI_BIND_UINT32:
+        *((uint32_t *)field) = ini_get_uint32_config_value(
+                                            vo, strict,
+                                            *((uint32_t *)field),
+                                            &error);
+        break;
+    case INI_BIND_INT64:
+        *((int64_t *)field) = ini_get_int64_config_value(
+                                            vo, strict,
+                                            *((int64_t *)field),
+                                            &error);
+        break;
+    case INI_BIND_UINT64:
+        *((uint64_t *)field) = ini_get_uint64_config_value(
+                                            vo, strict,
+                                            *((uint64_t *)field),
+                                            &error);
+        break;
+    case INI_BIND_DOUBLE:
+        *((double *)field) = ini_get_double_config_value(
+                                            vo, strict,
+                                            *((double *)field),
+                                            &error);
+        break;
+    case INI_BIND_BOOL:
+        *((unsigned char *)field) = ini_get_bool_config_value(
+                                            vo,
+                                            *((unsigned char *)field),
+                                            &error);
+        break;
+    case INI_BIND_STRING:
+        /* Do not lose the old value if allocation fails */
+        field = ini_get_string_config_value(vo, &error);
+        if (!error) *((char **)((char *)data + binding->offset)) = field;
+        break;
+    case INI_BIND_CONST_STRING:
+        *((const char **)field) = ini_get_const_string_config_value(vo,
+                                                                    &error);
+        break;
+    default:
+        error = EINVAL;
+    }
+
+    TRACE_FLOW_NUMBER("bind_value returning", error);
+    return error;
+}
+
+/* Store the default value in the field */
+static int bind_default(const struct ini_binding *binding,
+                        int strict,
+                        void *data)
+{
+    int error = EOK;
+    struct value_obj *vo = NULL;
+    char *str = NULL;
+
+    TRACE_FLOW_ENTRY();
+
+    /* Strings do not need conversion */
+    if (binding->type == INI_BIND_CONST_STRING) {
+        *((const char **)((char *)data + binding->offset)) = binding->def;
+        TRACE_FLOW_EXIT();
+        return EOK;
+    }
+
+    if (binding->type == INI_BIND_STRING) {
+        str = strdup(binding->def);
+        if (!str) {
+            TRACE_ERROR_NUMBER("Failed to allocate string", ENOMEM);
+            return ENOMEM;
+        }
+        *((char **)((char *)data + binding->offset)) = str;
+        TRACE_FLOW_EXIT();
+        return EOK;
+    }
+
+    /* Convert default the same way as a real value */
+    error = value_create_new(binding->def,
+                             strlen(binding->def),
+                             INI_VALUE_CREATED,
+                             strlen(binding->name),
+                             INI_WRAP_BOUNDARY,
+                             NULL,
+                             &vo);
+    if (error) {
+        TRACE_ERROR_NUMBER("Failed to create value", error);
+        return error;
+    }
+
+    error = bind_value(vo, binding, strict, data);
+    value_destroy(vo);
+
+    TRACE_FLOW_NUMBER("bind_default returning", error);
+    return error;
+}
+
+/* Fill the structure with the values of the options */
+int ini_config_bind(struct ini_cfgobj *ini_config,
+                    const struct ini_binding *bindings,
+                    int strict,
+                    void *data,
+                    struct ini_errobj *errobj)
+{
+    int error = EOK;
+    int ret = EOK;
+    const struct ini_binding *binding;
+    const struct ini_index_sec *isec = NULL;
+    const struct ini_index_key *key = NULL;
+    const char *section = NULL;
+    const char *last_section = NULL;
+
+    TRACE_FLOW_ENTRY();
+
+    if ((!ini_config) || (!bindings) || (!data)) {
+        TRACE_ERROR_NUMBER("Invalid argument", EINVAL);
+        return EINVAL;
+    }
+
+    for (binding = bindings; binding->name; binding++) {
+
+        section = binding->section ? binding->section : INI_DEFAULT_SECTION;
+
+        /* Look up the section only when it changes */
+        if ((!last_section) || (strcasecmp(section, last_section) != 0)) {
+            isec = ini_index_find_sec(ini_config->index, section);
+            last_section = section;
+        }
+
+        key = ini_index_find_key(isec, binding->name);
+        if (key) {
+            error = bind_value(ini_index_key_value(key, 0),
+                               binding, strict, data);
+            if (!error) continue;
+            if (error == ENOMEM) {
+                TRACE_ERROR_NUMBER("Failed to store value", error);
+                return error;
+            }
+            TRACE_ERROR_STRING("Failed to convert value", binding->name);
+            ret = EIO;
+            if (errobj) {
+                error = ini_errobj_add_msg(errobj,
+                                           "[%s]: Failed to convert "
+                                           "value of '%s' (error %d)",
+                                           section, binding->name, error);
+                if (error) {
+                    TRACE_ERROR_NUMBER("Failed to add message", error);
+                    return error;
+                }
+            }
+        }
+
+        if (!(binding->def)) continue;
+
+        error = bind_default(binding, strict, data);
+        if (error) {
+            if (error == ENOMEM) {
+                TRACE_ERROR_NUMBER("Failed to store default", error);
+                return error;
+            }
+            TRACE_ERROR_STRING("Failed to convert default", binding->name);
+            ret = EIO;
+            if (errobj) {
+                error = ini_errobj_add_msg(errobj,
+                                           "[%s]: Failed to convert "
+                                           "default of '%s' (error %d)",
+                                           section, binding->name, error);
+                if (error) {
+                    TRACE_ERROR_NUMBER("Failed to add message", error);
+                    return error;
+                }
+            }
+        }
+    }
+
+    TRACE_FLOW_NUMBER("ini_config_bind returning", ret);
+    return ret;
+}
@@ -0,0 +1,853 @@
+/*
+    INI LIBRARY
+
+    Binary cache of the configuration object.
+
+    Copyright (C) Dmitri Pal <dpal@redhat.com> 2026
+
+    INI Library is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    INI Library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with INI Library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "config.h"
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include "trace.h"
+#include "collection.h"
+#include "ref_array.h"
+#include "ini_defines.h"
+#include "ini_comment.h"
+#include "ini_valueobj.h"
+#include "ini_configobj.h"
+#include "ini_config_priv.h"
+
+/* Layout of the cache file. All numbers are in host byte order.
+ *
+ * Header:  magic, version, boundary, number of sources,
+ *          number of sections
+ * Source:  path, dev, ino, size, mtime seconds, mtime nanoseconds,
+ *          content hash
+ * Section: name, number of values, values
+ * Value:   key, line, origin, number of raw lines, raw lines,
+ *          comment
+ * Comment: number of lines, lines
+ * Trailer: comment at the end of the file
+ *
+ * Strings are stored as the length followed by the characters
+ * and the terminating zero so they can be used in place.
+ * The loaded configuration keeps the file mapped and
+ * the raw lines of the values point into it.
+ */
+#define INI_CACHE_MAGIC     "INICACHE"
+#define INI_CACHE_MAGIC_LEN 8
+#define INI_CACHE_VERSION   3
+
+/* Cache file being read */
+struct cache_reader {
+    const unsigned char *buf;
+    size_t len;
+    size_t pos;
+};
+
+/* Write number */
+static int cache_write_u32(FILE *file, uint32_t num)
+{
+    return (fwrite(&num, sizeof(num), 1, file) == 1) ? EOK : EIO;
+}
+
+static int cache_write_u64(FILE *file, uint64_t num)
+{
+    return (fwrite(&num, sizeof(num), 1, file) == 1) ? EOK : EIO;
+}
+
+/* Write string of given length */
+static int cache_write_str(FILE *file, const char *str, uint32_t len)
+{
+    int error = EOK;
+
+    error = cache_write_u32(file, len);
+    if (error) return error;
+
+    if ((len) && (fwrite(str, len, 1, file) != 1)) return EIO;
+    if (fputc('\0', file) == EOF) return EIO;
+
+    return EOK;
+}
+
+/* Write stats of one source as they were when it was read */
+static int cache_write_source(FILE *file, struct ini_source *src)
+{
+    int error = EOK;
+    struct stat *stats = &(src->stats);
+
+    TRACE_FLOW_ENTRY();
+
+    if ((error = cache_write_str(file, src->path, strlen(src->path))) ||
+        (error = cache_write_u64(file, (uint64_t)stats->st_dev)) ||
+        (error = cache_write_u64(file, (uint64_t)stats->st_ino)) ||
+        (error = cache_write_u64(file, (uint64_t)stats->st_size)) ||
+        (error = cache_write_u64(file, (uint64_t)stats->st_mtime)) ||
+        (error = cache_write_u64(file, (uint64_t)INI_MTIME_NSEC(stats))) ||
+        (error = cache_write_u64(file, src->hash))) {
+        TRACE_ERROR_NUMBER("Failed to write source", error);
+        return error;
+    }
+
+    TRACE_FLOW_EXIT();
+    return EOK;
+}
+
+/* Write comment, NULL is written as no lines */
+static int cache_write_comment(FILE *file, struct ini_comment *ic)
+{
+    int error = EOK;
+    uint32_t num = 0;
+    uint32_t len = 0;
+    uint32_t i;
+    char *comment;
+
+    if (ic) ini_comment_get_numlines(ic, &num);
+
+    error = cache_write_u32(file, num);
+    for (i = 0; (!error) && (i < num); i++) {
+        ini_comment_get_line(ic, i, &comment, &len);
+        error = cache_write_str(file, comment, len);
+    }
+
+    return error;
+}
+
+/* Write one value */
+static int cache_write_value(FILE *file,
+                             const char *key,
+                             int key_len,
+                             struct value_obj *vo)
+{
+    int error = EOK;
+    struct ini_comment *ic = NULL;
+    uint32_t origin = 0;
+    uint32_t line = 0;
+    uint32_t num = 0;
+    uint32_t len = 0;
+    uint32_t i;
+    const char *str;
+
+    TRACE_FLOW_ENTRY();
+
+    error = value_get_raw_parts(vo, &num, &ic);
+    if (error) {
+        TRACE_ERROR_NUMBER("Failed to get value", error);
+        return error;
+    }
+    value_get_origin(vo, &origin);
+    value_get_line(vo, &line);
+
+    if ((error = cache_write_str(file, key, key_len)) ||
+        (error = cache_write_u32(file, line)) ||
+        (error = cache_write_u32(file, origin)) ||
+        (error = cache_write_u32(file, num))) {
+        TRACE_ERROR_NUMBER("Failed to write value", error);
+        return error;
+    }
+
+    for (i = 0; i < num; i++) {
+        value_get_raw_line(vo, i, &str, &len);
+        error = cache_write_str(file, str, len);
+        if (error) {
+            TRACE_ERROR_NUMBER("Failed to write line", error);
+            return error;
+        }
+    }
+
+    error = cache_write_comment(file, ic);
+    if (error) {
+        TRACE_ERROR_NUMBER("Failed to write comment", error);
+        return error;
+    }
+
+    TRACE_FLOW_EXIT();
+    return EOK;
+}
+
+/* Write one section */
+static int cache_write_section(FILE *file,
+                               struct collection_item *ref)
+{
+    int error = EOK;
+    struct collection_item *sec = NULL;
+    struct collection_iterator *iterator = NULL;
+    struct collection_item *item = NULL;
+    const char *name;
+    int name_len = 0;
+    unsigned count = 0;
+
+    TRACE_FLOW_ENTRY();
+
+    sec = *((struct collection_item **)(col_get_item_data(ref)));
+    name = col_get_item_property(ref, &name_len);
+
+    /* Count includes the header */
+    col_get_collection_count(sec, &count);
+
+    if ((error = cache_write_str(file, name, name_len)) ||
+        (error = cache_write_u32(file, (uint32_t)(count - 1)))) {
+        TRACE_ERROR_NUMBER("Failed to write section", error);
+        return error;
+    }
+
+    error = col_bind_iterator(&iterator, sec, COL_TRAVERSE_ONELEVEL);
+    if (error) {
+        TRACE_ERROR_NUMBER("Failed to bind iterator", error);
+        return error;
+    }
+
+    while (1) {
+        error = col_iterate_collection(iterator, &item);
+        if ((error) || (!item)) break;
+        if (col_get_item_type(item) != COL_TYPE_BINARY) continue;
+
+        name = col_get_item_property(item, &name_len);
+        error = cache_write_value(file,
+                                  name,
+                                  name_len,
+                                  *((struct value_obj **)
+                                    (col_get_item_data(item))));
+        if (error) break;
+    }
+
+    col_unbind_iterator(iterator);
+
+    TRACE_FLOW_NUMBER("cache_write_section returning", error);
+    return error;
+}
+
+/* Write the whole cache */
+static int cache_write(FILE *file,
+                       struct ini_cfgobj *ini_config)
+{
+    int error = EOK;
+    struct collection_iterator *iterator = NULL;
+    struct collection_item *item = NULL;
+    uint32_t num_sources = 0;
+    uint32_t num_sections = 0;
+    uint32_t i;
+
+    TRACE_FLOW_ENTRY();
+
+    if (ini_config->sources) {
+        num_sources = ref_array_len(ini_config->sources);
+    }
+
+    /* Count sections */
+    error = col_bind_iterator(&iterator, ini_config->cfg,
+                              COL_TRAVERSE_ONELEVEL);
+    if (error) {
+        TRACE_ERROR_NUMBER("Failed to bind iterator", error);
+        return error;
+    }
+
+    while (1) {
+        error = col_iterate_collection(iterator, &item);
+        if ((error) || (!item)) break;
+        if (col_get_item_type(item) == COL_TYPE_COLLECTIONREF) {
+            num_sections++;
+        }
+    }
+
+    if (error) {
+        TRACE_ERROR_NUMBER("Failed to iterate", error);
+        col_unbind_iterator(iterator);
+        return error;
+    }
+
+    if ((fwrite(INI_CACHE_MAGIC, INI_CACHE_MAGIC_LEN, 1, file) != 1) ||
+        (error = cache_write_u32(file, INI_CACHE_VERSION)) ||
+        (error = cache_write_u32(file, ini_config->boundary)) ||
+        (error = cache_write_u32(file, num_sources)) ||
+        (error = cache_write_u32(file, num_sections))) {
+        TRACE_ERROR_NUMBER("Failed to write header", EIO);
+        col_unbind_iterator(iterator);
+        return EIO;
+    }
+
+    for (i = 0; i < num_sources; i++) {
+        error = cache_write_source(file,
+                                   ref_array_get(ini_config->sources,
+                                                 i, NULL));
+        if (error) {
+            TRACE_ERROR_NUMBER("Failed to write source", error);
+            col_unbind_iterator(iterator);
+            return error;
+        }
+    }
+
+    col_rewind_iterator(iterator);
+    while (1) {
+        error = col_iterate_collection(iterator, &item);
+        if ((error) || (!item)) break;
+        if (col_get_item_type(item) != COL_TYPE_COLLECTIONREF) continue;
+
+        error = cache_write_section(file, item);
+        if (error) break;
+    }
+
+    col_unbind_iterator(iterator);
+
+    if (!error) error = cache_write_comment(file, ini_config->last_comment);
+
+    TRACE_FLOW_NUMBER("cache_write returning", error);
+    return error;
+}
+
+/* Save configuration into the cache file */
+int ini_config_cache_save(struct ini_cfgobj *ini_config,
+                          const char *cache_file)
+{
+    int error = EOK;
+    char *tmp_name = NULL;
+    size_t len;
+    int fd = -1;
+    FILE *file = NULL;
+
+    TRACE_FLOW_ENTRY();
+
+    if ((!ini_config) || (!cache_file)) {
+        TRACE_ERROR_NUMBER("Invalid argument", EINVAL);
+        return EINVAL;
+    }
+
+    if (ini_config->lean) {
+        TRACE_ERROR_NUMBER("Configuration was parsed in lean mode", ENOTSUP);
+        return ENOTSUP;
+    }
+
+    /* Write into a temporary file in the same directory */
+    len = strlen(cache_file);
+    tmp_name = malloc(len + sizeof(".XXXXXX"));
+    if (!tmp_name) {
+        TRACE_ERROR_NUMBER("Failed to allocate name", ENOMEM);
+        return ENOMEM;
+    }
+    memcpy(tmp_name, cache_file, len);
+    memcpy(tmp_name + len, ".XXXXXX", sizeof(".XXXXXX"));
+
+    errno = 0;
+    fd = mkstemp(tmp_name);
+    if (fd == -1) {
+        error = errno;
+        TRACE_ERROR_NUMBER("Failed to create file", error);
+        free(tmp_name);
+        return error;
+    }
+
+    file = fdopen(fd, "w");
+    if (!file) {
+        error = errno;
+        TRACE_ERROR_NUMBER("Failed to open stream", error);
+        close(fd);
+        unlink(tmp_name);
+        free(tmp_name);
+        return error;
+    }
+
+    error = cache_write(file, ini_config);
+    if (fclose(file) == EOF) {
+        if (!error) error = errno;
+    }
+
+    if (!error) {
+        errno = 0;
+        if (rename(tmp_name, cache_file) == -1) error = errno;
+    }
+
+    if (error) {
+        TRACE_ERROR_NUMBER("Failed to save cache", error);
+        unlink(tmp_name);
+        free(tmp_name);
+        return error;
+    }
+
+    free(tmp_name);
+
+    TRACE_FLOW_EXIT();
+    return EOK;
+}
+
+/* Read number */
+static int cache_read_u32(struct cache_reader *rd, uint32_t *num)
+{
+    if (rd->len - rd->pos < sizeof(uint32_t)) return EIO;
+    memcpy(num, rd->buf + rd->pos, sizeof(uint32_t));
+    rd->pos += sizeof(uint32_t);
+    return EOK;
+}
+
+static int cache_read_u64(struct cache_reader *rd, uint64_t *num)
+{
+    if (rd->len - rd->pos < sizeof(uint64_t)) return EIO;
+    memcpy(num, rd->buf + rd->pos, sizeof(uint64_t));
+    rd->pos += sizeof(uint64_t);
+    return EOK;
+}
+
+/* Get string from the mapped file */
+static int cache_read_str(struct cache_reader *rd,
+                          const char **str,
+                          uint32_t *len)
+{
+    int error = EOK;
+
+    error = cache_read_u32(rd, len);
+    if (error) return error;
+
+    /* There should be room for the terminating zero */
+    if ((rd->len - rd->pos <= *len) ||
+        (rd->buf[rd->pos + *len] != '\0')) return EIO;
+
+    *str = (const char *)(rd->buf + rd->pos);
+    rd->pos += *len + 1;
+    return EOK;
+}
+
+/* Check that the contents of the file did not change */
+static int cache_check_hash(const char *path,
+                            uint64_t hash,
+                            struct stat *file_stats)
+{
+    int error = EOK;
+    struct ini_cfgfile *file_ctx = NULL;
+
+    TRACE_FLOW_ENTRY();
+
+    error = ini_config_file_open(path, INI_META_NONE, &file_ctx);
+    if (error) {
+        TRACE_ERROR_NUMBER("Failed to read source", error);
+        return (error == ENOMEM) ? ENOMEM : ESTALE;
+    }
+
+    if (file_ctx->content_hash != hash) error = ESTALE;
+    else *file_stats = file_ctx->file_stats;
+
+    ini_config_file_destroy(file_ctx);
+
+    TRACE_FLOW_EXIT();
+    return error;
+}
+
+/* Check that the source did not change and record it */
+static int cache_check_source(struct cache_reader *rd,
+                              struct ini_cfgobj *ini_config)
+{
+    int error = EOK;
+    const char *path;
+    uint32_t len;
+    uint64_t dev;
+    uint64_t ino;
+    uint64_t size;
+    uint64_t mtime;
+    uint64_t mtime_nsec;
+    uint64_t hash;
+    struct stat file_stats;
+
+    TRACE_FLOW_ENTRY();
+
+    if ((error = cache_read_str(rd, &path, &len)) ||
+        (error = cache_read_u64(rd, &dev)) ||
+        (error = cache_read_u64(rd, &ino)) ||
+        (error = cache_read_u64(rd, &size)) ||
+        (error = cache_read_u64(rd, &mtime)) ||
+        (error = cache_read_u64(rd, &mtime_nsec)) ||
+        (error = cache_read_u64(rd, &hash))) {
+        TRACE_ERROR_NUMBER("Failed to read source", error);
+        return error;
+    }
+
+    errno = 0;
+    if (stat(path, &file_stats) == -1) {
+        /* Source that did not exist must still be missing */
+        if ((errno != ENOENT) || (dev) || (ino)) {
+            TRACE_INFO_STRING("Source is gone:", path);
+            return ESTALE;
+        }
+        memset(&file_stats, 0, sizeof(struct stat));
+    }
+    else if ((dev != (uint64_t)file_stats.st_dev) ||
+             (ino != (uint64_t)file_stats.st_ino) ||
+             (size != (uint64_t)file_stats.st_size)) {
+        TRACE_INFO_STRING("Source changed:", path);
+        return ESTALE;
+    }
+    else if ((mtime != (uint64_t)file_stats.st_mtime) ||
+             (mtime_nsec != (uint64_t)INI_MTIME_NSEC(&file_stats))) {
+        /* Touched file is fine if the contents are the same */
+        if ((!S_ISREG(file_stats.st_mode)) || (!hash)) {
+            TRACE_INFO_STRING("Source changed:", path);
+            return ESTALE;
+        }
+        error = cache_check_hash(path, hash, &file_stats);
+        if (error) {
+            TRACE_INFO_STRING("Source changed:", path);
+            return error;
+        }
+    }
+
+    /* Keep the list so the configuration can be cached again */
+    error = ini_config_add_source(ini_config, path, &file_stats, hash);
+    if (error) {
+        TRACE_ERROR_NUMBER("Failed to record source", error);
+        return error;
+    }
+
+    TRACE_FLOW_EXIT();
+    return EOK;
+}
+
+/* Read comment, NULL if it has no lines */
+static int cache_read_comment(struct cache_reader *rd,
+                              struct ini_comment **ic)
+{
+    int error = EOK;
+    const char *str;
+    uint32_t num;
+    uint32_t len;
+    uint32_t i;
+
+    *ic = NULL;
+
+    error = cache_read_u32(rd, &num);
+    if ((error) || (num == 0)) return error;
+
+    error = ini_comment_create(ic);
+    for (i = 0; (!error) && (i < num); i++) {
+        error = cache_read_str(rd, &str, &len);
+        if (!error) error = ini_comment_build_wl(*ic, str, len);
+    }
+
+    if (error) {
+        ini_comment_destroy(*ic);
+        *ic = NULL;
+    }
+
+    return error;
+}
+
+/* Build value from the cache, the lines are used in place */
+static int cache_read_value(struct cache_reader *rd,
+                            struct ini_arena *arena,
+                            uint32_t boundary,
+                            struct collection_item *sec)
+{
+    int error = EOK;
+    const char *key;
+    const char *str;
+    const char *single = NULL;
+    uint32_t single_len = 0;
+    uint32_t key_len;
+    uint32_t line;
+    uint32_t origin;
+    uint32_t num;
+    uint32_t len;
+    uint32_t i;
+    struct ref_array *raw_lines = NULL;
+    struct ref_array *raw_lengths = NULL;
+    struct ini_comment *ic = NULL;
+    struct value_obj *vo = NULL;
+
+    TRACE_FLOW_ENTRY();
+
+    if ((error = cache_read_str(rd, &key, &key_len)) ||
+        (error = cache_read_u32(rd, &line)) ||
+        (error = cache_read_u32(rd, &origin)) ||
+        (error = cache_read_u32(rd, &num))) {
+        TRACE_ERROR_NUMBER("Failed to read value", error);
+        return error;
+    }
+
+    /* Single line is kept inside the value */
+    if (num == 1) error = cache_read_str(rd, &single, &single_len);
+    else error = value_create_arena_arrays(&raw_lines, &raw_lengths);
+    if (error) {
+        TRACE_ERROR_NUMBER("Failed to read value", error);
+        return error;
+    }
+
+    for (i = 0; (raw_lines) && (i < num); i++) {
+        error = cache_read_str(rd, &str, &len);
+        if (error) break;
+        error = value_add_to_arrays(str, len, raw_lines, raw_lengths);
+        if (error) break;
+    }
+
+    if (!error) error = cache_read_comment(rd, &ic);
+
+    if (error) {
+        TRACE_ERROR_NUMBER("Failed to read value parts", error);
+        value_destroy_arrays(raw_lines, raw_lengths);
+        ini_comment_destroy(ic);
+        return error;
+    }
+
+    if (raw_lines) error = value_create_in_arena(arena,
+                                                 raw_lines,
+                                                 raw_lengths,
+                                                 line,
+                                                 origin,
+                                                 key_len,
+                                                 boundary,
+                                                 ic,
+                                                 &vo);
+    else error = value_create_from_line(arena,
+                                        single,
+                                        single_len,
+                                        line,
+                                        origin,
+                                        key_len,
+                                        boundary,
+                                        ic,
+                                        &vo);
+    if (error) {
+        TRACE_ERROR_NUMBER("Failed to create value", error);
+        value_destroy_arrays(raw_lines, raw_lengths);
+        ini_comment_destroy(ic);
+        return error;
+    }
+
+    error = col_insert_binary_property(sec,
+                                       NULL,
+                                       COL_DSP_END,
+                                       NULL,
+                                       0,
+                                       COL_INSERT_NOCHECK,
+                                       key,
+                                       &vo,
+                                       sizeof(struct value_obj *));
+    if (error) {
+        TRACE_ERROR_NUMBER("Failed to add value", error);
+        value_destroy(vo);
+        return error;
+    }
+
+    TRACE_FLOW_EXIT();
+    return EOK;
+}
+
+/* Build section from the cache */
+static int cache_read_section(struct cache_reader *rd,
+                              struct ini_arena *arena,
+                              uint32_t boundary,
+                              struct collection_item *cfg)
+{
+    int error = EOK;
+    const char *name;
+    uint32_t len;
+    uint32_t num;
+    uint32_t i;
+    struct collection_item *sec = NULL;
+
+    TRACE_FLOW_ENTRY();
+
+    if ((error = cache_read_str(rd, &name, &len)) ||
+        (error = cache_read_u32(rd, &num))) {
+        TRACE_ERROR_NUMBER("Failed to read section", error);
+        return error;
+    }
+
+    error = col_create_collection(&sec, name, COL_CLASS_INI_SECTION);
+    if (error) {
+        TRACE_ERROR_NUMBER("Failed to create section", error);
+        return error;
+    }
+
+    for (i = 0; i < num; i++) {
+        error = cache_read_value(rd, arena, boundary, sec);
+        if (error) {
+            TRACE_ERROR_NUMBER("Failed to read value", error);
+            col_destroy_collection_with_cb(sec, ini_cleanup_cb, NULL);
+            return error;
+        }
+    }
+
+    error = col_add_collection_to_collection(cfg, NULL, NULL, sec,
+                                             COL_ADD_MODE_EMBED);
+    if (error) {
+        TRACE_ERROR_NUMBER("Failed to embed section", error);
+        col_destroy_collection_with_cb(sec, ini_cleanup_cb, NULL);
+        return error;
+    }
+
+    TRACE_FLOW_EXIT();
+    return EOK;
+}
+
+/* Build configuration from the mapped cache */
+static int cache_read(struct cache_reader *rd,
+                      struct ini_cfgobj *ini_config)
+{
+    int error = EOK;
+    uint32_t version;
+    uint32_t boundary;
+    uint32_t num_sources;
+    uint32_t num_sections;
+    uint32_t i;
+
+    TRACE_FLOW_ENTRY();
+
+    if ((rd->len < INI_CACHE_MAGIC_LEN) ||
+        (memcmp(rd->buf, INI_CACHE_MAGIC, INI_CACHE_MAGIC_LEN) != 0)) {
+        TRACE_ERROR_NUMBER("Not a cache file", EIO);
+        return EIO;
+    }
+    rd->pos = INI_CACHE_MAGIC_LEN;
+
+    if ((error = cache_read_u32(rd, &version)) ||
+        (error = cache_read_u32(rd, &boundary)) ||
+        (error = cache_read_u32(rd, &num_sources)) ||
+        (error = cache_read_u32(rd, &num_sections))) {
+        TRACE_ERROR_NUMBER("Failed to read header", error);
+        return error;
+    }
+
+    if (version != INI_CACHE_VERSION) {
+        TRACE_ERROR_NUMBER("Unsupported version", version);
+        return EIO;
+    }
+
+    /* Check all sources before doing any real work */
+    for (i = 0; i < num_sources; i++) {
+        error = cache_check_source(rd, ini_config);
+        if (error) {
+            TRACE_ERROR_NUMBER("Cache can't be used", error);
+            return error;
+        }
+    }
+
+    ini_config->boundary = boundary;
+
+    for (i = 0; i < num_sections; i++) {
+        error = cache_read_section(rd,
+                                   ini_config->arena,
+                                   boundary,
+                                   ini_config->cfg);
+        if (error) {
+            TRACE_ERROR_NUMBER("Failed to read section", error);
+            return error;
+        }
+    }
+
+    error = cache_read_comment(rd, &(ini_config->last_comment));
+    if (error) {
+        TRACE_ERROR_NUMBER("Failed to read trailing comment", error);
+        return error;
+    }
+
+    if (rd->pos != rd->len) {
+        TRACE_ERROR_NUMBER("Unexpected data at the end", EIO);
+        return EIO;
+    }
+
+    error = ini_index_build(ini_config->index, ini_config->cfg);
+    if (error) {
+        TRACE_ERROR_NUMBER("Failed to build index", error);
+        return error;
+    }
+
+    TRACE_FLOW_EXIT();
+    return EOK;
+}
+
+/* Load configuration from the cache file */
+int ini_config_cache_load(const char *cache_file,
+                          struct ini_cfgobj **ini_config)
+{
+    int error = EOK;
+    int fd = -1;
+    struct stat file_stats;
+    struct cache_reader rd;
+    void *map = NULL;
+    struct ini_cfgobj *new_co = NULL;
+
+    TRACE_FLOW_ENTRY();
+
+    if ((!cache_file) || (!ini_config)) {
+        TRACE_ERROR_NUMBER("Invalid argument", EINVAL);
+        return EINVAL;
+    }
+
+    errno = 0;
+    fd = open(cache_file, O_RDONLY);
+    if (fd == -1) {
+        error = errno;
+        TRACE_ERROR_NUMBER("Failed to open cache", error);
+        return error;
+    }
+
+    errno = 0;
+    if (fstat(fd, &file_stats) == -1) {
+        error = errno;
+        TRACE_ERROR_NUMBER("Failed to get stats", error);
+        close(fd);
+        return error;
+    }
+
+    if (file_stats.st_size == 0) {
+        TRACE_ERROR_NUMBER("Cache file is empty", EIO);
+        close(fd);
+        return EIO;
+    }
+
+    errno = 0;
+    map = mmap(NULL, file_stats.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED) {
+        error = errno;
+        TRACE_ERROR_NUMBER("Failed to map cache", error);
+        close(fd);
+        return error;
+    }
+    close(fd);
+
+    error = ini_config_create(&new_co);
+    if (!error) error = ini_arena_create(&(new_co->arena));
+    if (error) {
+        TRACE_ERROR_NUMBER("Failed to create config", error);
+        ini_config_destroy(new_co);
+        munmap(map, file_stats.st_size);
+        return error;
+    }
+
+    /* Values point into the file so it lives as long as they do */
+    ini_arena_own_map(new_co->arena, map, file_stats.st_size);
+
+    rd.buf = map;
+    rd.len = file_stats.st_size;
+    rd.pos = 0;
+
+    error = cache_read(&rd, new_co);
+    if (error) {
+        TRACE_ERROR_NUMBER("Failed to load cache", error);
+        ini_config_destroy(new_co);
+        return error;
+    }
+
+    *ini_config = new_co;
+
+    TRACE_FLOW_EXIT();
+    return EOK;
+}
@@ -28,6 +28,64 @@
 #include "collection.h"
 #include "simplebuffer.h"
 #include "ini_comment.h"
+#include "ini_configobj.h"
+#include "ini_index.h"
+
+/* Interpretations of the value that can be cached
+ * in the value object. Only one interpretation is
+ * cached for the value, the first one that is requested.
+ */
+enum value_cache_type {
+    VALUE_CACHE_LLONG = 1,
+    VALUE_CACHE_ULLONG,
+    VALUE_CACHE_DOUBLE,
+    VALUE_CACHE_BOOL
+};
+
+/* Result of the value conversion */
+struct value_cache {
+    union {
+        long long llval;
+        unsigned long long ullval;
+        double dval;
+        unsigned char bval;
+    } val;
+    /* Conversion error */
+    int error;
+    /* Set if there are characters after the converted part */
+    int partial;
+};
+
+/* Maximum number of separators in the array of strings */
+#define VALUE_ARRAY_SEP_LEN 3
+
+/* Array interpretations of the value */
+enum value_array_type {
+    VALUE_ARRAY_STRING = 1,
+    VALUE_ARRAY_RAW_STRING,
+    VALUE_ARRAY_LONG,
+    VALUE_ARRAY_DOUBLE
+};
+
+/* Array cached in the value object.
+ * It is allocated as one block and is not
+ * changed after it is added to the value.
+ */
+struct value_array {
+    struct value_array *next;
+    enum value_array_type type;
+    /* Separators the string was split with */
+    char sep[VALUE_ARRAY_SEP_LEN + 1];
+    /* Conversion error */
+    int error;
+    /* Number of items */
+    int size;
+    /* Length of the strings or of the numbers */
+    size_t len;
+    /* Items are in the data */
+    void *items;
+    uint64_t data[];
+};
 
 /* Configuration object */
 struct ini_cfgobj {
@@ -37,16 +95,21 @@ struct ini_cfgobj {
     uint32_t boundary;
     /* Last comment */
     struct ini_comment *last_comment;
+    /* Index of sections and keys */
+    struct ini_index *index;
     /* Last search state */
-    char *section;
-    char *name;
-    int section_len;
-    int name_len;
-    struct collection_iterator *iterator;
+    struct ini_cursor cursor;
     /* Collection of errors detected during parsing */
     struct collection_item *error_list;
     /* Count of error lines */
     unsigned count;
+    /* Memory of the values parsed with INI_PARSE_ARENA */
+    struct ini_arena *arena;
+    /* Parsed with INI_PARSE_LEAN, comments and folding are lost */
+    int lean;
+    /* Files and directories the configuration was read from,
+     * NULL if there are none */
+    struct ref_array *sources;
 
     /*...         */
     /* Statistics? Timestamps? When created? Modified? - TBD */
@@ -72,18 +135,76 @@ struct ini_cfgfile {
     struct stat file_stats;
     /* Were stats read ? */
     int stats_read;
+    /* Hash of the file contents */
+    uint64_t content_hash;
     /* Internal buffer */
     struct simplebuffer *file_data;
+    /* Caller's memory that is read instead of
+     * the internal buffer, NULL if not borrowed */
+    unsigned char *borrowed;
+    uint32_t borrowed_len;
+    /* What was passed by the caller and
+     * the callback to give it back */
+    void *borrowed_buf;
+    ini_mem_release_func *release;
+    void *release_data;
     /* BOM indicator */
     enum index_utf_t bom;
 };
 
+/* Decoder that converts a file to UTF-8 as it is read */
+struct ini_decoder;
+
+/* Open the file for decoding, the stream is owned by the decoder.
+ * Returns ENOSYS if the platform can't stream. */
+int ini_decoder_open(const char *filename,
+                     struct ini_decoder **decoder,
+                     FILE **file);
+
+/* Close the decoder and return the first decoding error */
+int ini_decoder_close(struct ini_decoder *decoder);
+
 /* Parsing error */
 struct ini_parse_error {
     unsigned line;
     int error;
 };
 
+/* Initial value of the content hash */
+#define INI_HASH_INIT 0xcbf29ce484222325ULL
+
+/* Nanoseconds of the modification time if available */
+#ifdef HAVE_STRUCT_STAT_ST_MTIM
+#define INI_MTIME_NSEC(st) ((st)->st_mtim.tv_nsec)
+#else
+#define INI_MTIME_NSEC(st) 0
+#endif
+
+/* Add data to the content hash */
+uint64_t ini_hash_data(uint64_t hash, const void *data, size_t len);
+
+/* File or directory the configuration was read from.
+ * Stats are taken when the source is read and are all zero
+ * if it did not exist. Hash of the contents is zero for
+ * the directories.
+ */
+struct ini_source {
+    char *path;
+    struct stat stats;
+    uint64_t hash;
+};
+
+/* Record the source of the configuration.
+ * Existing record for the same path is replaced.
+ */
+int ini_config_add_source(struct ini_cfgobj *ini_config,
+                          const char *path,
+                          const struct stat *stats,
+                          uint64_t hash);
+
+/* Record all sources of the other configuration */
+int ini_config_add_sources(struct ini_cfgobj *ini_config,
+                           struct ini_cfgobj *other);
 /* Internal cleanup callback */
 void ini_cleanup_cb(const char *property,
                     int property_len,
@@ -92,6 +213,11 @@ void ini_cleanup_cb(const char *property,
                     int length,
                     void *custom_data);
 
+/* Internal copy callback, values are copied with the items */
+int ini_copy_cb(struct collection_item *item,
+                void *ext_data,
+                int *skip);
+
 /* Get parsing error */
 const char *ini_get_error_str(int parsing_error, int family);
 
@@ -123,4 +249,120 @@ struct ini_errmsg {
     struct ini_errmsg *next;
 };
 
+/* Get the cached conversion result.
+ * Returns ENOENT if the value was not converted
+ * to the requested type yet.
+ */
+int value_get_cache(struct value_obj *vo,
+                    enum value_cache_type type,
+                    struct value_cache *cache);
+
+/* Get the number of raw lines and the comment of the value.
+ * Folds the value if it was changed since it was folded last.
+ * The comment is still owned by the value.
+ */
+int value_get_raw_parts(struct value_obj *vo,
+                        uint32_t *num_lines,
+                        struct ini_comment **ic);
+
+/* Get the comment of the value without folding it.
+ * The comment is still owned by the value, NULL if there is none.
+ */
+struct ini_comment *value_get_comment(struct value_obj *vo);
+
+/* Get one raw line of the value, it is not NUL terminated */
+void value_get_raw_line(struct value_obj *vo,
+                        uint32_t idx,
+                        const char **line,
+                        uint32_t *len);
+
+/* Save the conversion result in the value object.
+ * Safe to call from several threads that read
+ * the same value: only the first result is saved.
+ */
+void value_set_cache(struct value_obj *vo,
+                     enum value_cache_type type,
+                     const struct value_cache *cache);
+
+/* Find the array cached in the value.
+ * Separators are checked only for the arrays of strings.
+ * Returns NULL if there is no such array.
+ */
+struct value_array *value_get_array(struct value_obj *vo,
+                                    enum value_array_type type,
+                                    const char *sep);
+
+/* Add the array to the value. The value owns the array after that.
+ * Arrays stay valid until the value is updated or destroyed
+ * so the callers can keep pointers into them.
+ */
+void value_add_array(struct value_obj *vo,
+                     struct value_array *array);
+
+/* Arena allocator. Memory is released only
+ * when the whole arena is destroyed.
+ */
+struct ini_arena;
+
+int ini_arena_create(struct ini_arena **arena);
+void ini_arena_destroy(struct ini_arena *arena);
+void *ini_arena_alloc(struct ini_arena *arena, size_t size);
+char *ini_arena_strndup(struct ini_arena *arena, const char *str, size_t len);
+
+/* Unmap the file when the arena is destroyed */
+void ini_arena_own_map(struct ini_arena *arena, void *map, size_t len);
+
+/* Create the arrays for the lines that live in the arena.
+ * Lines are not freed when the arrays are destroyed.
+ */
+int value_create_arena_arrays(struct ref_array **raw_lines,
+                              struct ref_array **raw_lengths);
+
+/* Create value from a single line that is kept
+ * inside the value object. The line is copied.
+ * The arena can be NULL.
+ */
+int value_create_from_line(struct ini_arena *arena,
+                           const char *strvalue,
+                           uint32_t length,
+                           uint32_t line,
+                           uint32_t origin,
+                           uint32_t key_len,
+                           uint32_t boundary,
+                           struct ini_comment *ic,
+                           struct value_obj **vo);
+
+/* Same as value_create_from_refarray() but the value object
+ * is allocated from the arena. The arrays must be created
+ * with value_create_arena_arrays().
+ */
+int value_create_in_arena(struct ini_arena *arena,
+                          struct ref_array *raw_lines,
+                          struct ref_array *raw_lengths,
+                          uint32_t line,
+                          uint32_t origin,
+                          uint32_t key_len,
+                          uint32_t boundary,
+                          struct ini_comment *ic,
+                          struct value_obj **vo);
+
+/* Hash of what the reload read last time,
+ * changes if any of the files was read with
+ * different contents or failed differently.
+ */
+uint64_t ini_reload_hash(struct ini_reload *reload);
+
+/* Receives the serialized configuration in portions */
+typedef int (*ini_serialize_sink)(void *buf,
+                                  uint32_t len,
+                                  void *data);
+
+/* Serialize the configuration and pass the output to the sink
+ * each time at least limit bytes are collected.
+ */
+int ini_config_serialize_to(struct ini_cfgobj *ini_config,
+                            uint32_t limit,
+                            ini_serialize_sink sink,
+                            void *sink_data);
+
 #endif
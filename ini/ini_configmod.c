@@ -23,6 +23,7 @@
 #include <errno.h>
 #include <string.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <inttypes.h>
 #include "trace.h"
 #include "ref_array.h"
@@ -34,10 +35,14 @@
 #include "ini_configobj.h"
 #include "ini_config_priv.h"
 #include "ini_configmod.h"
+#include "ini_index.h"
 
 /* Which kind of search we should use? */
 #define EXACT(a) ((a == INI_VA_MOD_E) || (a == INI_VA_MODADD_E)) ? 1 : 0
 
+/* Number of edits the batch grows by */
+#define INI_BATCH_GROW 64
+
 static void cb(const char *property,
                int property_len,
                int type,
@@ -45,6 +50,29 @@ static void cb(const char *property,
                int length,
                void *ext_data);
 
+/* Refresh the index after the section changed */
+static int reindex_section(struct ini_cfgobj *ini_config,
+                           const char *section)
+{
+    int error = EOK;
+
+    TRACE_FLOW_ENTRY();
+
+    /* Positions saved by the last search are not valid any more */
+    ini_config_clean_state(ini_config);
+
+    error = ini_index_update_section(ini_config->index,
+                                     ini_config->cfg,
+                                     section);
+    if (error) {
+        TRACE_ERROR_NUMBER("Failed to reindex section.", error);
+        return error;
+    }
+
+    TRACE_FLOW_EXIT();
+    return EOK;
+}
+
 
 /* Delete value by key or position */
 int ini_config_delete_value(struct ini_cfgobj *ini_config,
@@ -93,6 +121,8 @@ int ini_config_delete_value(struct ini_cfgobj *ini_config,
         return error;
     }
 
+    error = reindex_section(ini_config, section);
+
     vo = *((struct value_obj **)(col_get_item_data(item)));
     value_destroy(vo);
 
@@ -1132,6 +1162,13 @@ int ini_config_add_str_value(struct ini_cfgobj *ini_config,
                                     else break;
                                 }
                             }
+                            error = reindex_section(ini_config, section);
+                            if (error) {
+                                TRACE_ERROR_NUMBER("Failed to reindex "
+                                                   "the section.",
+                                                   error);
+                                return error;
+                            }
                             break;
     default:                /* The new ones should be added here */
                             TRACE_ERROR_NUMBER("Flag is not implemented",
@@ -1197,11 +1234,18 @@ int ini_config_add_str_value(struct ini_cfgobj *ini_config,
                                            key,
                                            &vo,
                                            sizeof(struct value_obj *));
-    }
-    if (error) {
-        TRACE_ERROR_NUMBER("Failed to insert value.", error);
-        value_destroy(vo);
-        return error;
+        if (error) {
+            TRACE_ERROR_NUMBER("Failed to insert value.", error);
+            value_destroy(vo);
+            return error;
+        }
+
+        /* New item has to be added to the index */
+        error = reindex_section(ini_config, section);
+        if (error) {
+            TRACE_ERROR_NUMBER("Failed to reindex section.", error);
+            return error;
+        }
     }
 
     TRACE_FLOW_EXIT();
@@ -1339,6 +1383,12 @@ int ini_config_add_section(struct ini_cfgobj *ini_config,
         return error;
     }
 
+    error = reindex_section(ini_config, section);
+    if (error) {
+        TRACE_ERROR_NUMBER("Failed to index section", error);
+        return error;
+    }
+
     TRACE_FLOW_EXIT();
     return EOK;
 }
@@ -1484,6 +1534,10 @@ int ini_config_rename_section(struct ini_cfgobj *ini_config,
     /* Item is actually a section reference */
     sec = *((struct collection_item **)col_get_item_data(item));
 
+    /* Drop the section from the index while it has the old name */
+    ini_config_clean_state(ini_config);
+    ini_index_remove_section(ini_config->index, section);
+
     /* Change name only */
     error = col_modify_item(item,
                             newname,
@@ -1507,6 +1561,16 @@ int ini_config_rename_section(struct ini_cfgobj *ini_config,
         return error;
     }
 
+    /* Index the section under the new name. Another section
+     * with the old name might now be the one to be found.
+     */
+    error = reindex_section(ini_config, newname);
+    if (!error) error = reindex_section(ini_config, section);
+    if (error) {
+        TRACE_ERROR_NUMBER("Failed to reindex section.", error);
+        return error;
+    }
+
     TRACE_FLOW_EXIT();
     return EOK;
 }
@@ -1598,9 +1662,808 @@ int ini_config_delete_section_by_position(struct ini_cfgobj *ini_config,
         return ENOENT;
     }
 
+    /* Update the index while the section item still exists */
+    error = reindex_section(ini_config, col_get_item_property(item, NULL));
+
     /* Delete item and subcollection */
     col_delete_item_with_cb(item, cb, NULL);
 
     TRACE_FLOW_EXIT();
+    return error;
+}
+
+/* Kinds of edits in the batch */
+enum batch_op_type {
+    BATCH_OP_ADD,
+    BATCH_OP_DELETE,
+    BATCH_OP_COMMENT
+};
+
+/* One edit of the batch */
+struct batch_op {
+    enum batch_op_type type;
+    char *section;
+    char *key;
+    char *other_key;
+    /* Prepared value or comment, owned by
+     * the batch until the edit is applied.
+     */
+    struct value_obj *vo;
+    struct ini_comment *ic;
+    int position;
+    int idx;
+    enum INI_VA flags;
+};
+
+/* Batch of edits */
+struct ini_cfgbatch {
+    struct ref_array *ops;
+};
+
+/* Edit ordered by the section it changes */
+struct batch_ref {
+    struct collection_item *sec_item;
+    /* First edit of the section */
+    uint32_t first;
+    uint32_t pos;
+};
+
+/* Section replaced by the copy while the batch is applied */
+struct batch_section {
+    struct collection_item **slot;
+    struct collection_item *original;
+    const char *name;
+};
+
+/* Free the edit */
+static void batch_op_cleanup(void *elem,
+                             ref_array_del_enum type,
+                             void *data)
+{
+    struct batch_op *op;
+
+    TRACE_FLOW_ENTRY();
+
+    op = (struct batch_op *)elem;
+    free(op->section);
+    free(op->key);
+    free(op->other_key);
+    value_destroy(op->vo);
+    ini_comment_destroy(op->ic);
+
+    TRACE_FLOW_EXIT();
+}
+
+/* Create batch */
+int ini_config_batch_create(struct ini_cfgbatch **batch)
+{
+    int error = EOK;
+    struct ini_cfgbatch *new_batch = NULL;
+
+    TRACE_FLOW_ENTRY();
+
+    if (!batch) {
+        TRACE_ERROR_NUMBER("Invalid argument", EINVAL);
+        return EINVAL;
+    }
+
+    new_batch = malloc(sizeof(struct ini_cfgbatch));
+    if (!new_batch) {
+        TRACE_ERROR_NUMBER("Failed to allocate batch", ENOMEM);
+        return ENOMEM;
+    }
+
+    error = ref_array_create(&(new_batch->ops),
+                             sizeof(struct batch_op),
+                             INI_BATCH_GROW,
+                             batch_op_cleanup,
+                             NULL);
+    if (error) {
+        TRACE_ERROR_NUMBER("Failed to create array", error);
+        free(new_batch);
+        return error;
+    }
+
+    *batch = new_batch;
+
+    TRACE_FLOW_EXIT();
+    return EOK;
+}
+
+/* Destroy batch */
+void ini_config_batch_destroy(struct ini_cfgbatch *batch)
+{
+    TRACE_FLOW_ENTRY();
+
+    if (batch) {
+        ref_array_destroy(batch->ops);
+        free(batch);
+    }
+
+    TRACE_FLOW_EXIT();
+}
+
+/* Get number of edits in the batch */
+uint32_t ini_config_batch_count(struct ini_cfgbatch *batch)
+{
+    if (!batch) return 0;
+    return ref_array_len(batch->ops);
+}
+
+/* Copy the names and put the edit into the batch */
+static int batch_append(struct ini_cfgbatch *batch,
+                        struct batch_op *op,
+                        const char *section,
+                        const char *key,
+                        const char *other_key)
+{
+    int error = EOK;
+
+    TRACE_FLOW_ENTRY();
+
+    op->section = strdup(section);
+    op->key = strdup(key);
+    op->other_key = other_key ? strdup(other_key) : NULL;
+    if ((!(op->section)) || (!(op->key)) ||
+        ((other_key) && (!(op->other_key)))) {
+        TRACE_ERROR_NUMBER("Failed to copy names", ENOMEM);
+        error = ENOMEM;
+    }
+    else {
+        error = ref_array_append(batch->ops, op);
+        if (error) {
+            TRACE_ERROR_NUMBER("Failed to add edit", error);
+        }
+    }
+
+    if (error) {
+        batch_op_cleanup(op, REF_ARRAY_DELETE, NULL);
+        return error;
+    }
+
+    TRACE_FLOW_EXIT();
+    return EOK;
+}
+
+/* Add or modify a string value as a part of the batch */
+int ini_config_batch_add_str_value(struct ini_cfgbatch *batch,
+                                   const char *section,
+                                   const char *key,
+                                   const char *value,
+                                   const char **comments,
+                                   size_t count_comment,
+                                   int border,
+                                   int position,
+                                   const char *other_key,
+                                   int idx,
+                                   enum INI_VA flags)
+{
+    int error = EOK;
+    struct batch_op op;
+
+    TRACE_FLOW_ENTRY();
+
+    /* Check arguments */
+    if (!batch) {
+        TRACE_ERROR_STRING("Invalid argument","batch");
+        return EINVAL;
+    }
+
+    if (!section) {
+        TRACE_ERROR_STRING("Invalid argument","section");
+        return EINVAL;
+    }
+
+    if (!key) {
+        TRACE_ERROR_STRING("Invalid argument","key");
+        return EINVAL;
+    }
+
+    if (!value) {
+        TRACE_ERROR_STRING("Invalid argument","value");
+        return EINVAL;
+    }
+
+    if (idx < 0) {
+        TRACE_ERROR_STRING("Invalid argument","idx");
+        return EINVAL;
+    }
+
+    if ((flags < INI_VA_NOCHECK) || (flags > INI_VA_DUPERROR)) {
+        TRACE_ERROR_NUMBER("Flag is not implemented", ENOSYS);
+        return ENOSYS;
+    }
+
+    memset(&op, 0, sizeof(struct batch_op));
+    op.type = BATCH_OP_ADD;
+    op.position = position;
+    op.idx = idx;
+    op.flags = flags;
+
+    /* Value is prepared now so that applying
+     * the batch does not need to build it.
+     */
+    if (comments) {
+        error = ini_comment_construct(comments,
+                                      count_comment,
+                                      &(op.ic));
+        if (error) {
+            TRACE_ERROR_NUMBER("Failed to construct comment", error);
+            return error;
+        }
+    }
+
+    error =  value_create_new(value,
+                              strnlen(value, MAX_VALUE -1),
+                              INI_VALUE_CREATED,
+                              strnlen(key, MAX_KEY -1),
+                              border,
+                              op.ic,
+                              &(op.vo));
+    if (error) {
+        TRACE_ERROR_NUMBER("Failed to construct value object.", error);
+        ini_comment_destroy(op.ic);
+        return error;
+    }
+    /* Comment is now a part of value */
+    op.ic = NULL;
+
+    error = batch_append(batch, &op, section, key, other_key);
+    if (error) {
+        TRACE_ERROR_NUMBER("Failed to add value to batch.", error);
+        return error;
+    }
+
+    TRACE_FLOW_EXIT();
+    return EOK;
+}
+
+/* Delete a value as a part of the batch */
+int ini_config_batch_delete_value(struct ini_cfgbatch *batch,
+                                  const char *section,
+                                  int position,
+                                  const char *key,
+                                  int idx)
+{
+    int error = EOK;
+    struct batch_op op;
+
+    TRACE_FLOW_ENTRY();
+
+    /* Check arguments */
+    if (!batch) {
+        TRACE_ERROR_STRING("Invalid argument","batch");
+        return EINVAL;
+    }
+
+    if (!section) {
+        TRACE_ERROR_STRING("Invalid argument","section");
+        return EINVAL;
+    }
+
+    if (!key) {
+        TRACE_ERROR_STRING("Invalid argument","key");
+        return EINVAL;
+    }
+
+    if (idx < 0) {
+        TRACE_ERROR_STRING("Invalid argument","idx");
+        return EINVAL;
+    }
+
+    memset(&op, 0, sizeof(struct batch_op));
+    op.type = BATCH_OP_DELETE;
+    op.position = position;
+    op.idx = idx;
+
+    error = batch_append(batch, &op, section, key, NULL);
+    if (error) {
+        TRACE_ERROR_NUMBER("Failed to add deletion to batch.", error);
+        return error;
+    }
+
+    TRACE_FLOW_EXIT();
+    return EOK;
+}
+
+/* Update a comment as a part of the batch */
+int ini_config_batch_update_comment(struct ini_cfgbatch *batch,
+                                    const char *section,
+                                    const char *key,
+                                    const char *comments[],
+                                    size_t count_comment,
+                                    int idx)
+{
+    int error = EOK;
+    struct batch_op op;
+
+    TRACE_FLOW_ENTRY();
+
+    /* Check arguments */
+    if (!batch) {
+        TRACE_ERROR_STRING("Invalid argument","batch");
+        return EINVAL;
+    }
+
+    if (!section) {
+        TRACE_ERROR_STRING("Invalid argument","section");
+        return EINVAL;
+    }
+
+    if (!key) {
+        TRACE_ERROR_STRING("Invalid argument","key");
+        return EINVAL;
+    }
+
+    if (idx < 0) {
+        TRACE_ERROR_STRING("Invalid argument","idx");
+        return EINVAL;
+    }
+
+    memset(&op, 0, sizeof(struct batch_op));
+    op.type = BATCH_OP_COMMENT;
+    op.idx = idx;
+
+    if (comments) {
+        error = ini_comment_construct(comments,
+                                      count_comment,
+                                      &(op.ic));
+        if (error) {
+            TRACE_ERROR_NUMBER("Failed to construct comment", error);
+            return error;
+        }
+    }
+
+    error = batch_append(batch, &op, section, key, NULL);
+    if (error) {
+        TRACE_ERROR_NUMBER("Failed to add comment to batch.", error);
+        return error;
+    }
+
+    TRACE_FLOW_EXIT();
+    return EOK;
+}
+
+/* Find the instance of the key in the section.
+ * The first instance comes from the table.
+ */
+static int batch_find_dup(struct collection_item *sec,
+                          struct collection_item *first,
+                          const char *key,
+                          int idx,
+                          int exact,
+                          struct collection_item **item)
+{
+    int error = EOK;
+
+    if (idx == 0) {
+        *item = first;
+        return EOK;
+    }
+
+    error = col_get_dup_item(sec,
+                             NULL,
+                             key,
+                             COL_TYPE_ANY,
+                             idx,
+                             exact,
+                             item);
+    if ((!error) && (!(*item))) error = ENOENT;
+
+    return error;
+}
+
+/* Take the item out of the section and free it */
+static int batch_extract(struct collection_item *sec,
+                         struct ini_item_table *keys,
+                         int position,
+                         const char *key,
+                         int idx)
+{
+    int error = EOK;
+    struct collection_item *item = NULL;
+    struct value_obj *vo = NULL;
+
+    error = col_extract_item(sec,
+                             NULL,
+                             position,
+                             key,
+                             idx,
+                             COL_TYPE_ANY,
+                             &item);
+    if (error) {
+        TRACE_ERROR_NUMBER("Item not found or error", error);
+        return error;
+    }
+
+    ini_item_table_remove(keys, sec, item);
+
+    vo = *((struct value_obj **)(col_get_item_data(item)));
+    value_destroy(vo);
+    col_delete_item(item);
+
     return EOK;
 }
+
+/* Apply adding or modification of the value to the section */
+static int batch_apply_add(struct collection_item *sec,
+                           struct ini_item_table *keys,
+                           struct batch_op *op)
+{
+    int error = EOK;
+    struct collection_item *first = NULL;
+    struct collection_item *item = NULL;
+    struct value_obj *old_vo = NULL;
+    const char *key_ptr;
+    int position;
+
+    TRACE_FLOW_ENTRY();
+
+    /* Same logic as in ini_config_add_str_value() but
+     * the key that is not in the table is known to be
+     * missing without searching the section.
+     */
+    first = ini_item_table_find(keys, op->key);
+
+    switch (op->flags) {
+
+    case INI_VA_NOCHECK:    break;
+
+    case INI_VA_MOD:
+    case INI_VA_MOD_E:      if (!first) return ENOENT;
+                            error = batch_find_dup(sec, first, op->key,
+                                                   op->idx, EXACT(op->flags),
+                                                   &item);
+                            if (error) return error;
+                            break;
+
+    case INI_VA_MODADD:
+    case INI_VA_MODADD_E:   if (!first) break;
+                            /* Index past the last instance
+                             * is an error in the exact mode.
+                             */
+                            error = batch_find_dup(sec, first, op->key,
+                                                   op->idx, EXACT(op->flags),
+                                                   &item);
+                            if (error) return error;
+                            break;
+
+    case INI_VA_DUPERROR:   if (first) return EEXIST;
+                            break;
+
+    case INI_VA_CLEAN:      while (ini_item_table_find(keys, op->key)) {
+                                error = batch_extract(sec, keys,
+                                                      COL_DSP_FIRSTDUP,
+                                                      op->key, 0);
+                                if (error) return error;
+                            }
+                            break;
+
+    default:                return ENOSYS;
+    }
+
+    if (item) {
+        old_vo = *((struct value_obj **)(col_get_item_data(item)));
+        error =  col_modify_binary_item(item,
+                                        NULL,
+                                        &(op->vo),
+                                        sizeof(struct value_obj *));
+        if (error) {
+            TRACE_ERROR_NUMBER("Failed to update item.", error);
+            return error;
+        }
+        value_destroy(old_vo);
+    }
+    else {
+        position = op->position;
+        if (position == COL_DSP_FRONT) {
+            key_ptr = INI_SECTION_KEY;
+            position = COL_DSP_AFTER;
+        }
+        else {
+            key_ptr = op->other_key;
+        }
+
+        /* Duplicates are already handled above */
+        error = col_insert_binary_property_with_ref(sec,
+                                                    NULL,
+                                                    position,
+                                                    key_ptr,
+                                                    op->idx,
+                                                    COL_INSERT_NOCHECK,
+                                                    op->key,
+                                                    &(op->vo),
+                                                    sizeof(struct value_obj *),
+                                                    &item);
+        if (error) {
+            TRACE_ERROR_NUMBER("Failed to insert value.", error);
+            return error;
+        }
+
+        /* Only the first item of the key can be ahead of the others */
+        if ((first) && (position != COL_DSP_END))
+            error = ini_item_table_insert(keys, sec, item);
+        else error = ini_item_table_add(keys, item);
+    }
+
+    /* The section owns the value now */
+    op->vo = NULL;
+
+    TRACE_FLOW_RETURN(error);
+    return error;
+}
+
+/* Apply the comment update to the section */
+static int batch_apply_comment(struct collection_item *sec,
+                               struct ini_item_table *keys,
+                               struct batch_op *op)
+{
+    int error = EOK;
+    struct collection_item *first = NULL;
+    struct collection_item *item = NULL;
+    struct value_obj *vo = NULL;
+
+    TRACE_FLOW_ENTRY();
+
+    first = ini_item_table_find(keys, op->key);
+    if (!first) return ENOENT;
+
+    error = batch_find_dup(sec, first, op->key, op->idx, 1, &item);
+    if (error) return error;
+
+    vo = *((struct value_obj **)(col_get_item_data(item)));
+
+    error = value_put_comment(vo, op->ic);
+    if (error) {
+        TRACE_ERROR_NUMBER("Faile to update comment.", error);
+        return error;
+    }
+
+    /* The value owns the comment now */
+    op->ic = NULL;
+
+    TRACE_FLOW_EXIT();
+    return EOK;
+}
+
+/* Apply the edits of one section to its copy */
+static int batch_apply_section(struct collection_item *sec,
+                               struct ref_array *ops,
+                               struct batch_ref *refs,
+                               uint32_t count)
+{
+    int error = EOK;
+    struct ini_item_table *keys = NULL;
+    struct batch_op *op;
+    uint32_t i;
+
+    TRACE_FLOW_ENTRY();
+
+    /* Keys are looked up once per section */
+    error = ini_item_table_create(sec, COL_TYPE_BINARY, &keys);
+    if (error) {
+        TRACE_ERROR_NUMBER("Failed to create key table", error);
+        return error;
+    }
+
+    for (i = 0; i < count; i++) {
+        op = ref_array_get(ops, refs[i].pos, NULL);
+
+        switch (op->type) {
+        case BATCH_OP_ADD:      error = batch_apply_add(sec, keys, op);
+                                break;
+        case BATCH_OP_DELETE:   error = batch_extract(sec, keys,
+                                                      op->position,
+                                                      op->key,
+                                                      op->idx);
+                                break;
+        case BATCH_OP_COMMENT:  error = batch_apply_comment(sec, keys, op);
+                                break;
+        }
+
+        if (error) {
+            TRACE_ERROR_NUMBER("Failed to apply edit", error);
+            break;
+        }
+    }
+
+    ini_item_table_destroy(keys);
+
+    TRACE_FLOW_RETURN(error);
+    return error;
+}
+
+/* Order edits by section keeping the order of the edits */
+static int batch_ref_cmp(const void *a, const void *b)
+{
+    const struct batch_ref *ra = a;
+    const struct batch_ref *rb = b;
+
+    if (ra->sec_item != rb->sec_item) {
+        return ((uintptr_t)(ra->sec_item) < (uintptr_t)(rb->sec_item)) ?
+               -1 : 1;
+    }
+
+    if (ra->pos != rb->pos) return (ra->pos < rb->pos) ? -1 : 1;
+    return 0;
+}
+
+/* Order sections by their first edit so that
+ * the same batch always fails the same way */
+static int batch_first_cmp(const void *a, const void *b)
+{
+    const struct batch_ref *ra = a;
+    const struct batch_ref *rb = b;
+
+    if (ra->first != rb->first) return (ra->first < rb->first) ? -1 : 1;
+    if (ra->pos != rb->pos) return (ra->pos < rb->pos) ? -1 : 1;
+    return 0;
+}
+
+/* Resolve sections of all edits and group the edits by section */
+static int batch_resolve(struct ini_cfgobj *ini_config,
+                         struct ref_array *ops,
+                         struct batch_ref *refs,
+                         uint32_t count)
+{
+    int error = EOK;
+    struct ini_item_table *sections = NULL;
+    struct batch_op *op;
+    uint32_t start;
+    uint32_t i;
+
+    TRACE_FLOW_ENTRY();
+
+    error = ini_item_table_create(ini_config->cfg,
+                                  COL_TYPE_COLLECTIONREF,
+                                  &sections);
+    if (error) {
+        TRACE_ERROR_NUMBER("Failed to create section table", error);
+        return error;
+    }
+
+    for (i = 0; i < count; i++) {
+        op = ref_array_get(ops, i, NULL);
+        refs[i].sec_item = ini_item_table_find(sections, op->section);
+        refs[i].pos = i;
+        if (!(refs[i].sec_item)) {
+            TRACE_ERROR_STRING("Section not found", op->section);
+            error = ENOENT;
+            break;
+        }
+    }
+
+    ini_item_table_destroy(sections);
+
+    if (error) {
+        TRACE_ERROR_NUMBER("Failed to resolve sections", error);
+        return error;
+    }
+
+    qsort(refs, count, sizeof(struct batch_ref), batch_ref_cmp);
+
+    /* Edits of a section are in order so the first one leads */
+    for (i = 0; i < count; i++) {
+        if ((i == 0) || (refs[i].sec_item != refs[i - 1].sec_item)) start = i;
+        refs[i].first = refs[start].pos;
+    }
+
+    qsort(refs, count, sizeof(struct batch_ref), batch_first_cmp);
+
+    TRACE_FLOW_RETURN(error);
+    return error;
+}
+
+/* Apply all edits of the batch */
+int ini_config_batch_apply(struct ini_cfgobj *ini_config,
+                           struct ini_cfgbatch *batch)
+{
+    int error = EOK;
+    struct batch_ref *refs = NULL;
+    struct batch_section *secs = NULL;
+    struct collection_item *copy = NULL;
+    int reindex_error = EOK;
+    int ret;
+    uint32_t count;
+    uint32_t num_secs = 0;
+    uint32_t start;
+    uint32_t end;
+    uint32_t i;
+
+    TRACE_FLOW_ENTRY();
+
+    /* Check arguments */
+    if (!ini_config) {
+        TRACE_ERROR_STRING("Invalid argument","ini_config");
+        return EINVAL;
+    }
+
+    if (!batch) {
+        TRACE_ERROR_STRING("Invalid argument","batch");
+        return EINVAL;
+    }
+
+    count = ref_array_len(batch->ops);
+    if (count == 0) {
+        TRACE_FLOW_EXIT();
+        return EOK;
+    }
+
+    refs = malloc(count * sizeof(struct batch_ref));
+    secs = malloc(count * sizeof(struct batch_section));
+    if ((!refs) || (!secs)) {
+        TRACE_ERROR_NUMBER("Failed to allocate memory", ENOMEM);
+        error = ENOMEM;
+        goto done;
+    }
+
+    error = batch_resolve(ini_config, batch->ops, refs, count);
+    if (error) goto done;
+
+    /* Each section is changed on its copy so that
+     * the original can be restored if any edit fails.
+     */
+    for (start = 0; start < count; start = end) {
+        end = start + 1;
+        while ((end < count) &&
+               (refs[end].sec_item == refs[start].sec_item)) end++;
+
+        secs[num_secs].slot = (struct collection_item **)
+                              (col_get_item_data(refs[start].sec_item));
+        secs[num_secs].name = col_get_item_property(refs[start].sec_item,
+                                                    NULL);
+
+        error = col_copy_collection_with_cb(&copy,
+                                            *(secs[num_secs].slot),
+                                            NULL,
+                                            COL_COPY_NORMAL,
+                                            ini_copy_cb,
+                                            NULL);
+        if (error) {
+            TRACE_ERROR_NUMBER("Failed to copy section", error);
+            break;
+        }
+
+        secs[num_secs].original = *(secs[num_secs].slot);
+        *(secs[num_secs].slot) = copy;
+        num_secs++;
+
+        error = batch_apply_section(copy, batch->ops,
+                                    refs + start, end - start);
+        if (error) {
+            TRACE_ERROR_NUMBER("Failed to apply edits", error);
+            break;
+        }
+    }
+
+    for (i = 0; i < num_secs; i++) {
+        if (error) {
+            col_destroy_collection_with_cb(*(secs[i].slot),
+                                           ini_cleanup_cb, NULL);
+            *(secs[i].slot) = secs[i].original;
+        }
+        else {
+            col_destroy_collection_with_cb(secs[i].original,
+                                           ini_cleanup_cb, NULL);
+        }
+    }
+
+    /* Each changed section is indexed once */
+    for (i = 0; (!error) && (i < num_secs); i++) {
+        ret = reindex_section(ini_config, secs[i].name);
+        if (ret) {
+            TRACE_ERROR_NUMBER("Failed to reindex section.", ret);
+            if (!reindex_error) reindex_error = ret;
+        }
+    }
+    if (!error) error = reindex_error;
+
+done:
+    /* Values that were not applied are freed with the edits */
+    ref_array_reset(batch->ops);
+    free(refs);
+    free(secs);
+
+    TRACE_FLOW_RETURN(error);
+    return error;
+}
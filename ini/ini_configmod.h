@@ -761,6 +761,146 @@ int ini_config_update_comment(struct ini_cfgobj *ini_config,
                               const char *comments[],
                               size_t count_comment,
                               int idx);
+
+/**
+ * @brief Batch of edits.
+ *
+ * Batch collects additions, modifications and deletions of
+ * the values and applies them to the configuration at once.
+ * Each section is looked up once for the whole batch and
+ * the keys of the section are looked up in a temporary table
+ * instead of searching the section for every edit.
+ * If any edit fails the configuration is left unchanged.
+ */
+struct ini_cfgbatch;
+
+/**
+ * @brief Create a batch of edits.
+ *
+ * @param[out] batch           New empty batch.
+ *
+ * @return 0                   - Success.
+ * @return EINVAL              - Invalid parameter.
+ * @return ENOMEM              - No memory.
+ */
+int ini_config_batch_create(struct ini_cfgbatch **batch);
+
+/**
+ * @brief Destroy the batch.
+ *
+ * Edits that were not applied are discarded.
+ *
+ * @param[in]  batch           Batch to destroy.
+ */
+void ini_config_batch_destroy(struct ini_cfgbatch *batch);
+
+/**
+ * @brief Get number of edits in the batch.
+ *
+ * @param[in]  batch           Batch of edits.
+ *
+ * @return Number of edits that are waiting to be applied.
+ */
+uint32_t ini_config_batch_count(struct ini_cfgbatch *batch);
+
+/**
+ * @brief Add a string value to the batch.
+ *
+ * Function records the same change that
+ * \ref ini_config_add_str_value would make.
+ * The value object is built right away so
+ * invalid arguments are reported by this call.
+ * Errors that depend on the configuration, like
+ * a missing section or EEXIST for INI_VA_DUPERROR,
+ * are reported by \ref ini_config_batch_apply.
+ *
+ * For the arguments see \ref ini_config_add_str_value.
+ *
+ * @return 0                   - Success.
+ * @return EINVAL              - Invalid parameter.
+ * @return ENOSYS              - Flags are not supported.
+ * @return ENOMEM              - No memory.
+ */
+int ini_config_batch_add_str_value(struct ini_cfgbatch *batch,
+                                   const char *section,
+                                   const char *key,
+                                   const char *value,
+                                   const char **comments,
+                                   size_t count_comment,
+                                   int border,
+                                   int position,
+                                   const char *other_key,
+                                   int idx,
+                                   enum INI_VA flags);
+
+/**
+ * @brief Add deletion of a value to the batch.
+ *
+ * Function records the same change that
+ * \ref ini_config_delete_value would make.
+ *
+ * For the arguments see \ref ini_config_delete_value.
+ *
+ * @return 0                   - Success.
+ * @return EINVAL              - Invalid parameter.
+ * @return ENOMEM              - No memory.
+ */
+int ini_config_batch_delete_value(struct ini_cfgbatch *batch,
+                                  const char *section,
+                                  int position,
+                                  const char *key,
+                                  int idx);
+
+/**
+ * @brief Add update of a comment to the batch.
+ *
+ * Function records the same change that
+ * \ref ini_config_update_comment would make.
+ *
+ * For the arguments see \ref ini_config_update_comment.
+ *
+ * @return 0                   - Success.
+ * @return EINVAL              - Invalid parameter.
+ * @return ENOMEM              - No memory.
+ */
+int ini_config_batch_update_comment(struct ini_cfgbatch *batch,
+                                    const char *section,
+                                    const char *key,
+                                    const char *comments[],
+                                    size_t count_comment,
+                                    int idx);
+
+/**
+ * @brief Apply the batch to the configuration.
+ *
+ * Edits of the same section are applied in the order they
+ * were added to the batch. Sections are changed on copies
+ * that replace the originals only when all edits succeed,
+ * so on error the configuration is left as it was.
+ * Sections are processed in the order of their first edit,
+ * so the error returned is the one of the earliest section
+ * that fails.
+ * The batch is empty after the call whether the edits
+ * were applied or not and can be filled again.
+ *
+ * Unlike the single edit functions, a successful call
+ * replaces every value of each section the batch touches.
+ * Value objects and array views obtained for any key of
+ * those sections before the call are no longer valid
+ * and must be looked up again.
+ *
+ * @param[in]  ini_config      Configuration object to modify.
+ * @param[in]  batch           Batch of edits.
+ *
+ * @return 0                   - All edits were applied.
+ * @return EINVAL              - Invalid parameter.
+ * @return ENOENT              - Section or value is not found.
+ * @return EEXIST              - Value exists and INI_VA_DUPERROR is used.
+ * @return ENOMEM              - No memory.
+ * @return Other error returned by the edit that failed.
+ */
+int ini_config_batch_apply(struct ini_cfgobj *ini_config,
+                           struct ini_cfgbatch *batch);
 /**
  * @}
  */
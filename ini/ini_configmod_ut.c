@@ -1123,11 +1123,521 @@ static int dup_test(void)
     return EOK;
 }
 
+/* Check that the lookup returns the expected value */
+static int check_value(struct ini_cfgobj *in_cfg,
+                       const char *section,
+                       const char *key,
+                       int mode,
+                       const char *expected)
+{
+    int error = EOK;
+    struct value_obj *vo = NULL;
+    const char *value = NULL;
+
+    error = ini_get_config_valueobj(section, key, in_cfg, mode, &vo);
+    if (error) {
+        INIOUT(printf("Failed to get value %s:%s %d.\n",
+                      section, key, error));
+        return error;
+    }
+
+    if (vo == NULL) {
+        if (expected == NULL) return EOK;
+        INIOUT(printf("Value %s:%s not found, expected %s.\n",
+                      section, key, expected));
+        return ENOENT;
+    }
+
+    value = ini_get_const_string_config_value(vo, &error);
+    if ((expected == NULL) || (strcmp(value, expected) != 0)) {
+        INIOUT(printf("Value %s:%s is %s, expected %s.\n",
+                      section, key, value,
+                      expected ? expected : "nothing"));
+        return EINVAL;
+    }
+
+    return EOK;
+}
+
+/* Walk the same key with two independent cursors */
+static int check_cursors(struct ini_cfgobj *in_cfg)
+{
+    int error = EOK;
+    struct ini_cursor cur1;
+    struct ini_cursor cur2;
+    struct value_obj *vo1 = NULL;
+    struct value_obj *vo2 = NULL;
+    const char *expected[] = { "value1a", "value1b", "value1c", NULL };
+    int mode = INI_GET_FIRST_VALUE;
+    int i;
+
+    for (i = 0; i < 4; i++) {
+        error = ini_get_config_valueobj_r("one", "key1", in_cfg,
+                                          mode, &cur1, &vo1);
+        if (!error) {
+            /* The second cursor restarts every time */
+            error = ini_get_config_valueobj_r("one", "key1", in_cfg,
+                                              INI_GET_FIRST_VALUE,
+                                              &cur2, &vo2);
+        }
+        if (error) {
+            INIOUT(printf("Failed to get value %d.\n", error));
+            return error;
+        }
+
+        if ((vo2 == NULL) ||
+            (strcmp(ini_get_const_string_config_value(vo2, NULL),
+                    "value1a") != 0)) {
+            INIOUT(printf("Second cursor returned wrong value.\n"));
+            return EINVAL;
+        }
+
+        if (expected[i] == NULL) {
+            if (vo1 == NULL) break;
+            INIOUT(printf("Expected no more values.\n"));
+            return EINVAL;
+        }
+
+        if ((vo1 == NULL) ||
+            (strcmp(ini_get_const_string_config_value(vo1, NULL),
+                    expected[i]) != 0)) {
+            INIOUT(printf("First cursor returned wrong value.\n"));
+            return EINVAL;
+        }
+        mode = INI_GET_NEXT_VALUE;
+    }
+
+    return EOK;
+}
+
+/* Test that lookups follow the modifications */
+static int lookup_test(void)
+{
+    int error = EOK;
+    struct ini_cfgobj *in_cfg = NULL;
+    const char *values[] = { "value1a", "value1b", "value1c" };
+    int i;
+
+    INIOUT(printf("<==== Start ====>\n"));
+
+    error = ini_config_create(&in_cfg);
+    if (error) {
+        INIOUT(printf("Failed to create collection. Error %d.\n", error));
+        return error;
+    }
+
+    error = ini_config_add_section(in_cfg, "one", NULL, 0,
+                                   COL_DSP_END, NULL, 0);
+    for (i = 0; (!error) && (i < 3); i++) {
+        error = ini_config_add_str_value(in_cfg, "one", "key1", values[i],
+                                         NULL, 0, WRAP_SIZE, COL_DSP_END,
+                                         NULL, 0, INI_VA_NOCHECK);
+    }
+    if ((error) ||
+        (error = ini_config_add_str_value(in_cfg, "one", "key2", "value2",
+                                          NULL, 0, WRAP_SIZE, COL_DSP_FRONT,
+                                          NULL, 0, INI_VA_NOCHECK)) ||
+        (error = ini_config_add_section(in_cfg, "two", NULL, 0,
+                                        COL_DSP_END, NULL, 0)) ||
+        (error = ini_config_add_str_value(in_cfg, "two", "key1", "value3",
+                                          NULL, 0, WRAP_SIZE, COL_DSP_END,
+                                          NULL, 0, INI_VA_NOCHECK))) {
+        INIOUT(printf("Failed to build configuration %d.\n", error));
+        ini_config_destroy(in_cfg);
+        return error;
+    }
+
+    /* Walk the duplicates */
+    if ((error = check_value(in_cfg, "one", "key1",
+                             INI_GET_FIRST_VALUE, "value1a")) ||
+        (error = check_value(in_cfg, "one", "key1",
+                             INI_GET_NEXT_VALUE, "value1b")) ||
+        (error = check_value(in_cfg, "one", "key1",
+                             INI_GET_NEXT_VALUE, "value1c")) ||
+        (error = check_value(in_cfg, "one", "key1",
+                             INI_GET_NEXT_VALUE, NULL)) ||
+        (error = check_value(in_cfg, "ONE", "KEY1",
+                             INI_GET_LAST_VALUE, "value1c")) ||
+        (error = check_value(in_cfg, "one", "key1",
+                             INI_GET_NEXT_VALUE, NULL)) ||
+        (error = check_value(in_cfg, "one", "key2",
+                             INI_GET_NEXT_VALUE, "value2")) ||
+        (error = check_value(in_cfg, "two", "key1",
+                             INI_GET_FIRST_VALUE, "value3")) ||
+        (error = check_value(in_cfg, "two", "key2",
+                             INI_GET_FIRST_VALUE, NULL))) {
+        print_configuration(in_cfg, stdout);
+        ini_config_destroy(in_cfg);
+        return error;
+    }
+
+    /* Two searches of the same key must not interfere */
+    if ((error = check_cursors(in_cfg))) {
+        ini_config_destroy(in_cfg);
+        return error;
+    }
+
+    /* Replace, delete and rename */
+    if ((error = ini_config_add_str_value(in_cfg, "one", "key1", "new1",
+                                          NULL, 0, WRAP_SIZE, COL_DSP_END,
+                                          NULL, 0, INI_VA_CLEAN)) ||
+        (error = ini_config_delete_value(in_cfg, "one", COL_DSP_FIRSTDUP,
+                                         "key2", 0)) ||
+        (error = ini_config_rename_section(in_cfg, "two", "three"))) {
+        INIOUT(printf("Failed to modify configuration %d.\n", error));
+        ini_config_destroy(in_cfg);
+        return error;
+    }
+
+    if ((error = check_value(in_cfg, "one", "key1",
+                             INI_GET_FIRST_VALUE, "new1")) ||
+        (error = check_value(in_cfg, "one", "key1",
+                             INI_GET_NEXT_VALUE, NULL)) ||
+        (error = check_value(in_cfg, "one", "key2",
+                             INI_GET_FIRST_VALUE, NULL)) ||
+        (error = check_value(in_cfg, "two", "key1",
+                             INI_GET_FIRST_VALUE, NULL)) ||
+        (error = check_value(in_cfg, "three", "key1",
+                             INI_GET_FIRST_VALUE, "value3"))) {
+        print_configuration(in_cfg, stdout);
+        ini_config_destroy(in_cfg);
+        return error;
+    }
+
+    /* Delete section */
+    if ((error = ini_config_delete_section_by_name(in_cfg, "one")) ||
+        (error = check_value(in_cfg, "one", "key1",
+                             INI_GET_FIRST_VALUE, NULL)) ||
+        (error = check_value(in_cfg, "three", "key1",
+                             INI_GET_FIRST_VALUE, "value3"))) {
+        print_configuration(in_cfg, stdout);
+        ini_config_destroy(in_cfg);
+        return error;
+    }
+
+    ini_config_destroy(in_cfg);
+
+    INIOUT(printf("<==== End ====>\n"));
+
+    return EOK;
+}
+
+/* Edit used by the batch test */
+struct batch_edit {
+    int type;
+    const char *section;
+    const char *key;
+    const char *value;
+    int position;
+    const char *other_key;
+    int idx;
+    enum INI_VA flags;
+};
+
+#define EDIT_ADD 0
+#define EDIT_DELETE 1
+#define EDIT_COMMENT 2
+
+/* Create configuration with two sections */
+static int batch_config(struct ini_cfgobj **in_cfg)
+{
+    int error = EOK;
+    const char *sections[] = { "one", "two", NULL };
+    int i;
+
+    error = ini_config_create(in_cfg);
+    for (i = 0; (!error) && (sections[i]); i++) {
+        error = ini_config_add_section(*in_cfg, sections[i], NULL, 0,
+                                       COL_DSP_END, NULL, 0);
+        if (!error) error = ini_config_add_str_value(*in_cfg, sections[i],
+                                                     "key1", "value1",
+                                                     NULL, 0, WRAP_SIZE,
+                                                     COL_DSP_END, NULL, 0,
+                                                     INI_VA_NOCHECK);
+    }
+
+    if (error) {
+        INIOUT(printf("Failed to build configuration %d.\n", error));
+        ini_config_destroy(*in_cfg);
+        *in_cfg = NULL;
+    }
+
+    return error;
+}
+
+/* Apply edit with the regular functions */
+static int batch_edit_single(struct ini_cfgobj *in_cfg,
+                             struct batch_edit *edit,
+                             const char **comments)
+{
+    switch (edit->type) {
+    case EDIT_ADD:      return ini_config_add_str_value(in_cfg,
+                                                        edit->section,
+                                                        edit->key,
+                                                        edit->value,
+                                                        NULL, 0, WRAP_SIZE,
+                                                        edit->position,
+                                                        edit->other_key,
+                                                        edit->idx,
+                                                        edit->flags);
+    case EDIT_DELETE:   return ini_config_delete_value(in_cfg,
+                                                       edit->section,
+                                                       edit->position,
+                                                       edit->key,
+                                                       edit->idx);
+    default:            return ini_config_update_comment(in_cfg,
+                                                         edit->section,
+                                                         edit->key,
+                                                         comments, 0,
+                                                         edit->idx);
+    }
+}
+
+/* Add edit to the batch */
+static int batch_edit_add(struct ini_cfgbatch *batch,
+                          struct batch_edit *edit,
+                          const char **comments)
+{
+    switch (edit->type) {
+    case EDIT_ADD:      return ini_config_batch_add_str_value(batch,
+                                                              edit->section,
+                                                              edit->key,
+                                                              edit->value,
+                                                              NULL, 0,
+                                                              WRAP_SIZE,
+                                                              edit->position,
+                                                              edit->other_key,
+                                                              edit->idx,
+                                                              edit->flags);
+    case EDIT_DELETE:   return ini_config_batch_delete_value(batch,
+                                                             edit->section,
+                                                             edit->position,
+                                                             edit->key,
+                                                             edit->idx);
+    default:            return ini_config_batch_update_comment(batch,
+                                                               edit->section,
+                                                               edit->key,
+                                                               comments, 0,
+                                                               edit->idx);
+    }
+}
+
+/* Serialize configuration into a new buffer */
+static int batch_serialize(struct ini_cfgobj *in_cfg,
+                           struct simplebuffer **sbobj)
+{
+    int error = EOK;
+
+    error = simplebuffer_alloc(sbobj);
+    if (!error) error = ini_config_serialize(in_cfg, *sbobj);
+    if (error) {
+        INIOUT(printf("Failed to serialize. Error %d.\n", error));
+        simplebuffer_free(*sbobj);
+        *sbobj = NULL;
+    }
+
+    return error;
+}
+
+/* Check that the configurations are saved the same way */
+static int batch_compare(struct ini_cfgobj *cfg1, struct ini_cfgobj *cfg2)
+{
+    int error = EOK;
+    struct simplebuffer *sb1 = NULL;
+    struct simplebuffer *sb2 = NULL;
+
+    error = batch_serialize(cfg1, &sb1);
+    if (!error) error = batch_serialize(cfg2, &sb2);
+    if ((!error) &&
+        ((simplebuffer_get_len(sb1) != simplebuffer_get_len(sb2)) ||
+         (memcmp(simplebuffer_get_buf(sb1), simplebuffer_get_buf(sb2),
+                 simplebuffer_get_len(sb1)) != 0))) {
+        INIOUT(printf("Configurations differ.\n"));
+        print_configuration(cfg1, stdout);
+        print_configuration(cfg2, stdout);
+        error = EINVAL;
+    }
+
+    simplebuffer_free(sb1);
+    simplebuffer_free(sb2);
+    return error;
+}
+
+/* Batch makes the same changes as the regular functions */
+static int batch_test(void)
+{
+    int error = EOK;
+    struct ini_cfgobj *single_cfg = NULL;
+    struct ini_cfgobj *batch_cfg = NULL;
+    struct ini_cfgbatch *batch = NULL;
+    struct value_obj *vo = NULL;
+    const char *comments[] = { "# Batch", NULL };
+    char key[20];
+    char value[20];
+    struct batch_edit bulk;
+    struct batch_edit edits[] = {
+        { EDIT_ADD, "one", "key2", "value2", COL_DSP_END, NULL, 0,
+          INI_VA_DUPERROR },
+        { EDIT_ADD, "two", "key1", "value1b", COL_DSP_END, NULL, 0,
+          INI_VA_NOCHECK },
+        { EDIT_ADD, "one", "key1", "value1b", COL_DSP_FRONT, NULL, 0,
+          INI_VA_NOCHECK },
+        { EDIT_ADD, "one", "key3", "value3", COL_DSP_AFTER, "key2", 0,
+          INI_VA_MODADD },
+        { EDIT_ADD, "two", "key1", "value1c", COL_DSP_END, NULL, 1,
+          INI_VA_MOD_E },
+        { EDIT_COMMENT, "one", "key1", NULL, 0, NULL, 1, 0 },
+        { EDIT_ADD, "one", "key1", "value1c", COL_DSP_END, NULL, 5,
+          INI_VA_MODADD },
+        { EDIT_DELETE, "two", "key1", NULL, COL_DSP_FIRSTDUP, NULL, 0, 0 },
+        { EDIT_ADD, "two", "key2", "value2", COL_DSP_BEFORE, "key1", 0,
+          INI_VA_MODADD_E },
+        { EDIT_ADD, "one", "key2", "value2b", COL_DSP_END, NULL, 0,
+          INI_VA_CLEAN },
+        { EDIT_DELETE, "one", "key1", NULL, COL_DSP_FIRSTDUP, NULL, 0, 0 },
+        { EDIT_ADD, "one", "key1", "value1d", COL_DSP_END, NULL, 0,
+          INI_VA_MOD },
+        { -1, NULL, NULL, NULL, 0, NULL, 0, 0 }
+    };
+    struct batch_edit fail[] = {
+        { EDIT_ADD, "one", "key4", "value4", COL_DSP_END, NULL, 0,
+          INI_VA_NOCHECK },
+        { EDIT_DELETE, "two", "key2", NULL, COL_DSP_FIRSTDUP, NULL, 0, 0 },
+        { EDIT_ADD, "one", "key3", "value3", COL_DSP_END, NULL, 0,
+          INI_VA_DUPERROR },
+        { -1, NULL, NULL, NULL, 0, NULL, 0, 0 }
+    };
+    int i;
+
+    INIOUT(printf("<==== Start ====>\n"));
+
+    if ((error = batch_config(&single_cfg)) ||
+        (error = batch_config(&batch_cfg)) ||
+        (error = ini_config_batch_create(&batch))) {
+        ini_config_destroy(single_cfg);
+        ini_config_destroy(batch_cfg);
+        return error;
+    }
+
+    for (i = 0; (!error) && (edits[i].type >= 0); i++) {
+        error = batch_edit_single(single_cfg, &edits[i], comments);
+        if (!error) error = batch_edit_add(batch, &edits[i], comments);
+        if (error) INIOUT(printf("Edit %d failed %d.\n", i, error));
+    }
+
+    /* Many edits of one section */
+    memset(&bulk, 0, sizeof(struct batch_edit));
+    bulk.section = "two";
+    bulk.key = key;
+    bulk.value = value;
+    for (i = 0; (!error) && (i < 1000); i++) {
+        sprintf(key, "bulk%d", i % 400);
+        sprintf(value, "value%d", i);
+        bulk.type = (i % 7 == 6) ? EDIT_DELETE : EDIT_ADD;
+        bulk.position = (i % 7 == 6) ? COL_DSP_FIRSTDUP : COL_DSP_END;
+        bulk.flags = (i % 3) ? INI_VA_MODADD : INI_VA_NOCHECK;
+        /* The key might be already deleted */
+        if (bulk.type == EDIT_DELETE) {
+            error = ini_get_config_valueobj("two", key, single_cfg,
+                                            INI_GET_FIRST_VALUE, &vo);
+            if ((error) || (!vo)) continue;
+        }
+        error = batch_edit_single(single_cfg, &bulk, comments);
+        if (!error) error = batch_edit_add(batch, &bulk, comments);
+        if (error) INIOUT(printf("Bulk edit %d failed %d.\n", i, error));
+    }
+
+    if ((!error) && (ini_config_batch_count(batch) == 0)) error = EINVAL;
+    if (!error) error = ini_config_batch_apply(batch_cfg, batch);
+    if ((!error) && (ini_config_batch_count(batch) != 0)) error = EINVAL;
+    if (!error) error = batch_compare(single_cfg, batch_cfg);
+
+    /* Lookups see the changes */
+    if ((error) ||
+        (error = check_value(batch_cfg, "one", "key1",
+                             INI_GET_FIRST_VALUE, "value1d")) ||
+        (error = check_value(batch_cfg, "two", "key2",
+                             INI_GET_FIRST_VALUE, "value2")) ||
+        (error = check_value(batch_cfg, "two", "bulk399",
+                             INI_GET_FIRST_VALUE, "value799"))) {
+        INIOUT(printf("Batch test failed %d.\n", error));
+        ini_config_batch_destroy(batch);
+        ini_config_destroy(single_cfg);
+        ini_config_destroy(batch_cfg);
+        return error;
+    }
+
+    /* Failing edit leaves the configuration unchanged */
+    for (i = 0; (!error) && (fail[i].type >= 0); i++) {
+        error = batch_edit_add(batch, &fail[i], comments);
+    }
+    if (!error) {
+        error = ini_config_batch_apply(batch_cfg, batch);
+        if (error == EEXIST) error = EOK;
+        else {
+            INIOUT(printf("Expected EEXIST got %d.\n", error));
+            error = EINVAL;
+        }
+    }
+    if ((!error) && (ini_config_batch_count(batch) != 0)) error = EINVAL;
+    if ((error) ||
+        (error = batch_compare(single_cfg, batch_cfg)) ||
+        (error = check_value(batch_cfg, "one", "key4",
+                             INI_GET_FIRST_VALUE, NULL)) ||
+        (error = check_value(batch_cfg, "two", "key2",
+                             INI_GET_FIRST_VALUE, "value2"))) {
+        INIOUT(printf("Batch rollback failed %d.\n", error));
+    }
+
+    /* Missing section */
+    if ((!error) &&
+        ((error = ini_config_batch_delete_value(batch, "three",
+                                                COL_DSP_FIRSTDUP,
+                                                "key1", 0)) ||
+         (error = (ini_config_batch_apply(batch_cfg, batch) == ENOENT) ?
+                  EOK : EINVAL))) {
+        INIOUT(printf("Missing section was not detected.\n"));
+    }
+
+    /* Error of the section edited first is returned */
+    for (i = 0; (!error) && (i < 2); i++) {
+        error = ini_config_batch_delete_value(batch, i ? "one" : "two",
+                                              COL_DSP_FIRSTDUP,
+                                              "missing", 0);
+        if (!error) error = ini_config_batch_add_str_value(batch,
+                                                           i ? "two" : "one",
+                                                           "key1", "value",
+                                                           NULL, 0,
+                                                           WRAP_SIZE,
+                                                           COL_DSP_END,
+                                                           NULL, 0,
+                                                           INI_VA_DUPERROR);
+        if (!error) {
+            error = ini_config_batch_apply(batch_cfg, batch);
+            if (error == ENOENT) error = EOK;
+            else {
+                INIOUT(printf("Expected ENOENT got %d.\n", error));
+                error = EINVAL;
+            }
+        }
+    }
+
+    ini_config_batch_destroy(batch);
+    ini_config_destroy(single_cfg);
+    ini_config_destroy(batch_cfg);
+
+    INIOUT(printf("<==== End ====>\n"));
+
+    return error;
+}
+
 int main(int argc, char *argv[])
 {
     int error = EOK;
     test_fn tests[] = { basic_test,
                         dup_test,
+                        lookup_test,
+                        batch_test,
                         NULL };
     test_fn t;
     int i = 0;
@@ -28,24 +28,54 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <stdarg.h>
+#include <unistd.h>
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
 /* For error text */
 #include <libintl.h>
 #define _(String) gettext (String)
 #include "trace.h"
 #include "collection.h"
 #include "collection_tools.h"
+#include "ref_array.h"
 #include "ini_configobj.h"
 #include "ini_config_priv.h"
 #include "ini_defines.h"
 #include "ini_valueobj.h"
 #include "ini_configobj.h"
 
+/* Maximal number of threads checking the rules */
+#define INI_RULES_MAX_THREADS 8
+
+/* Number of section changes to grow the merge change list by */
+#define INI_MERGE_CHANGE_INC 10
+
+/* Number of sources to grow the source list by */
+#define INI_SOURCE_INC 4
+
+/* Change of one section made by the in place merge */
+struct merge_change {
+    /* Reference to the section that was replaced
+     * by a copy or NULL if the section was added.
+     */
+    struct collection_item **slot;
+    /* Section before the merge */
+    struct collection_item *original;
+    /* Name of the section */
+    const char *name;
+};
+
 /* Internal structure used during the merge operation */
 struct merge_data {
     struct collection_item *ci;
     uint32_t flags;
     int error;
     int found;
+    /* Changes to undo if merge fails, NULL if not needed */
+    struct ref_array *changes;
+    /* Names of the acceptor items, NULL if not needed */
+    struct ini_item_table *table;
 };
 
 /* Callback */
@@ -76,14 +106,8 @@ void ini_config_clean_state(struct ini_cfgobj *ini_config)
     TRACE_FLOW_ENTRY();
 
     if (ini_config) {
-        if (ini_config->iterator) col_unbind_iterator(ini_config->iterator);
-        ini_config->iterator = NULL;
-        free(ini_config->section);
-        ini_config->section = NULL;
-        free(ini_config->name);
-        ini_config->name = NULL;
-        ini_config->section_len = 0;
-        ini_config->name_len = 0;
+        ini_config->cursor.key = NULL;
+        ini_config->cursor.pos = 0;
     }
 
     TRACE_FLOW_EXIT();
@@ -113,6 +137,13 @@ void ini_config_destroy(struct ini_cfgobj *ini_config)
             col_destroy_collection(ini_config->error_list);
         }
 
+        ini_index_destroy(ini_config->index);
+
+        /* Values are gone, release their memory at once */
+        ini_arena_destroy(ini_config->arena);
+
+        ref_array_destroy(ini_config->sources);
+
         free(ini_config);
     }
 
@@ -141,13 +172,14 @@ int ini_config_create(struct ini_cfgobj **ini_config)
     new_co->cfg = NULL;
     new_co->boundary = INI_WRAP_BOUNDARY;
     new_co->last_comment = NULL;
-    new_co->section = NULL;
-    new_co->name = NULL;
-    new_co->section_len = 0;
-    new_co->name_len = 0;
-    new_co->iterator = NULL;
+    new_co->index = NULL;
+    new_co->cursor.key = NULL;
+    new_co->cursor.pos = 0;
     new_co->error_list = NULL;
     new_co->count = 0;
+    new_co->arena = NULL;
+    new_co->lean = 0;
+    new_co->sources = NULL;
 
     /* Create a collection to hold configuration data */
     error = col_create_collection(&(new_co->cfg),
@@ -169,6 +201,14 @@ int ini_config_create(struct ini_cfgobj **ini_config)
         return error;
     }
 
+    /* Create index of sections and keys */
+    error = ini_index_create(&(new_co->index));
+    if (error) {
+        TRACE_ERROR_NUMBER("Failed to create index", error);
+        ini_config_destroy(new_co);
+        return error;
+    }
+
     *ini_config = new_co;
 
     TRACE_FLOW_EXIT();
@@ -233,9 +273,9 @@ int ini_config_set_wrap(struct ini_cfgobj *ini_config,
 }
 
 /* Configuration copy callback */
-static int ini_copy_cb(struct collection_item *item,
-                       void *ext_data,
-                       int *skip)
+int ini_copy_cb(struct collection_item *item,
+                void *ext_data,
+                int *skip)
 {
     int error = EOK;
     struct value_obj *vo = NULL;
@@ -287,6 +327,102 @@ int ini_flags_have(uint32_t flag, uint32_t flags)
     return 0;
 }
 
+/* Cleanup callback for the source list */
+static void source_cleanup(void *elem,
+                           ref_array_del_enum type,
+                           void *data)
+{
+    TRACE_FLOW_ENTRY();
+    free(((struct ini_source *)elem)->path);
+    TRACE_FLOW_EXIT();
+}
+
+/* Record the source of the configuration */
+int ini_config_add_source(struct ini_cfgobj *ini_config,
+                          const char *path,
+                          const struct stat *stats,
+                          uint64_t hash)
+{
+    int error = EOK;
+    struct ini_source *src;
+    struct ini_source new_src;
+    uint32_t i;
+
+    TRACE_FLOW_ENTRY();
+
+    if (!(ini_config->sources)) {
+        error = ref_array_create(&(ini_config->sources),
+                                 sizeof(struct ini_source),
+                                 INI_SOURCE_INC,
+                                 source_cleanup,
+                                 NULL);
+        if (error) {
+            TRACE_ERROR_NUMBER("Failed to create source list", error);
+            return error;
+        }
+    }
+
+    /* The same file can be read again */
+    for (i = 0; i < ref_array_len(ini_config->sources); i++) {
+        src = ref_array_get(ini_config->sources, i, NULL);
+        if (strcmp(src->path, path) == 0) {
+            src->stats = *stats;
+            src->hash = hash;
+            TRACE_FLOW_EXIT();
+            return EOK;
+        }
+    }
+
+    new_src.path = strdup(path);
+    if (!(new_src.path)) {
+        TRACE_ERROR_NUMBER("Failed to copy path", ENOMEM);
+        return ENOMEM;
+    }
+    new_src.stats = *stats;
+    new_src.hash = hash;
+
+    error = ref_array_append(ini_config->sources, &new_src);
+    if (error) {
+        TRACE_ERROR_NUMBER("Failed to add source", error);
+        free(new_src.path);
+        return error;
+    }
+
+    TRACE_FLOW_EXIT();
+    return EOK;
+}
+
+/* Record all sources of the other configuration */
+int ini_config_add_sources(struct ini_cfgobj *ini_config,
+                           struct ini_cfgobj *other)
+{
+    int error = EOK;
+    struct ini_source *src;
+    uint32_t i;
+
+    TRACE_FLOW_ENTRY();
+
+    if (!(other->sources)) {
+        TRACE_FLOW_EXIT();
+        return EOK;
+    }
+
+    for (i = 0; i < ref_array_len(other->sources); i++) {
+        src = ref_array_get(other->sources, i, NULL);
+        error = ini_config_add_source(ini_config,
+                                      src->path,
+                                      &(src->stats),
+                                      src->hash);
+        if (error) {
+            TRACE_ERROR_NUMBER("Failed to add source", error);
+            return error;
+        }
+    }
+
+    TRACE_FLOW_EXIT();
+    return EOK;
+}
+
 /* Copy configuration */
 int ini_config_copy(struct ini_cfgobj *ini_config,
                     struct ini_cfgobj **ini_new)
@@ -312,13 +448,14 @@ int ini_config_copy(struct ini_cfgobj *ini_config,
     new_co->cfg = NULL;
     new_co->boundary = ini_config->boundary;
     new_co->last_comment = NULL;
-    new_co->section = NULL;
-    new_co->name = NULL;
-    new_co->section_len = 0;
-    new_co->name_len = 0;
-    new_co->iterator = NULL;
+    new_co->index = NULL;
+    new_co->cursor.key = NULL;
+    new_co->cursor.pos = 0;
     new_co->error_list = NULL;
     new_co->count = 0;
+    new_co->arena = NULL;
+    new_co->lean = ini_config->lean;
+    new_co->sources = NULL;
 
     error = col_copy_collection_with_cb(&(new_co->cfg),
                                         ini_config->cfg,
@@ -332,6 +469,20 @@ int ini_config_copy(struct ini_cfgobj *ini_config,
         return error;
     }
 
+    error = ini_index_create(&(new_co->index));
+    if (error) {
+        TRACE_ERROR_NUMBER("Failed to create index", error);
+        ini_config_destroy(new_co);
+        return error;
+    }
+
+    error = ini_index_build(new_co->index, new_co->cfg);
+    if (error) {
+        TRACE_ERROR_NUMBER("Failed to index configuration", error);
+        ini_config_destroy(new_co);
+        return error;
+    }
+
     if (ini_config->last_comment) {
         error = ini_comment_copy(ini_config->last_comment,
                                  &(new_co->last_comment));
@@ -342,6 +493,13 @@ int ini_config_copy(struct ini_cfgobj *ini_config,
         }
     }
 
+    error = ini_config_add_sources(new_co, ini_config);
+    if (error) {
+        TRACE_ERROR_NUMBER("Failed to copy sources", error);
+        ini_config_destroy(new_co);
+        return error;
+    }
+
     *ini_new = new_co;
 
     TRACE_FLOW_EXIT();
@@ -365,10 +523,7 @@ static int merge_section_handler(const char *property,
     struct merge_data *passed_data;
     struct collection_item *acceptor = NULL;
     struct collection_item *item = NULL;
-    unsigned insertmode;
     uint32_t mergemode;
-    int suppress = 0;
-    int doinsert = 0;
 
     TRACE_FLOW_ENTRY();
 
@@ -395,118 +550,83 @@ static int merge_section_handler(const char *property,
     acceptor = passed_data->ci;
     mergemode = passed_data->flags & INI_MV2S_MASK;
 
-    switch (mergemode) {
-    case INI_MV2S_ERROR:     insertmode = COL_INSERT_DUPERROR;
-                             doinsert = 1;
-                             break;
-    case INI_MV2S_PRESERVE:  insertmode = COL_INSERT_DUPERROR;
-                             doinsert = 1;
-                             suppress = 1;
-                             break;
-    case INI_MV2S_ALLOW:     insertmode = COL_INSERT_NOCHECK;
-                             doinsert = 1;
-                             break;
-    case INI_MV2S_OVERWRITE: /* Special handling */
-    case INI_MV2S_DETECT:
-    default:
-                             break;
+    /* Look for the dup unless dups are allowed */
+    if (passed_data->table) {
+        TRACE_INFO_STRING("Looking for:", property);
+        item = ini_item_table_find(passed_data->table, property);
     }
 
-    /* Do not insert but search for dups first */
-    if (!doinsert) {
-        TRACE_INFO_STRING("Overwrite mode. Looking for:",
-                          property);
-
-        error = col_get_item(acceptor,
-                             property,
-                             COL_TYPE_BINARY,
-                             COL_TRAVERSE_DEFAULT,
-                             &item);
+    if (item) {
+        if (mergemode == INI_MV2S_ERROR) {
+            TRACE_ERROR_NUMBER("Failed to add value object to "
+                               "the section in error mode ", EEXIST);
+            value_destroy(new_vo);
+            passed_data->error = EEXIST;
+            *dummy = 1;
+            return EEXIST;
+        }
 
-        if (error) {
-            TRACE_ERROR_NUMBER("Failed searching for dup", error);
+        if (mergemode == INI_MV2S_PRESERVE) {
+            TRACE_INFO_STRING("Preseved exisitng value", property);
             value_destroy(new_vo);
-            return error;
+            TRACE_FLOW_EXIT();
+            return EOK;
         }
 
-        /* Check if there is a dup */
-        if (item) {
-            /* Check if we are in the detect mode */
-            if (mergemode == INI_MV2S_DETECT) {
-                passed_data->error = EEXIST;
-                doinsert = 1;
-                insertmode = COL_INSERT_NOCHECK;
+        if (mergemode == INI_MV2S_OVERWRITE) {
+            /* Dup exists - update it */
+            vo_old = *((struct value_obj **)(col_get_item_data(item)));
+            error = col_modify_binary_item(item,
+                                           NULL,
+                                           &new_vo,
+                                           sizeof(struct value_obj *));
+            if (error) {
+                TRACE_ERROR_NUMBER("Failed updating the value", error);
+                value_destroy(new_vo);
+                return error;
             }
-            else {
-
-                /* We are in the OVERWRITE mode.
-                 * Dup exists - update it.
-                 */
-                vo_old = *((struct value_obj **)(col_get_item_data(item)));
-                error = col_modify_binary_item(item,
-                                               NULL,
-                                               &new_vo,
-                                               sizeof(struct value_obj *));
-                if (error) {
-                    TRACE_ERROR_NUMBER("Failed updating the value", error);
-                    value_destroy(new_vo);
-                    return error;
-                }
 
-                /* If we failed to update it is better to leak then crash,
-                 * so destroy original value only on the successful update.
-                 */
-                value_destroy(vo_old);
-            }
-        }
-        else {
-            /* No dup found so we can insert with no check */
-            doinsert = 1;
-            insertmode = COL_INSERT_NOCHECK;
+            /* If we failed to update it is better to leak then crash,
+             * so destroy original value only on the successful update.
+             */
+            value_destroy(vo_old);
+            TRACE_FLOW_EXIT();
+            return EOK;
         }
+
+        /* Detect mode adds the value and reports the dup */
+        passed_data->error = EEXIST;
     }
 
-    if (doinsert) {
-        /* Add value to collection */
-        error = col_insert_binary_property(acceptor,
-                                           NULL,
-                                           COL_DSP_END,
-                                           NULL,
-                                           0,
-                                           insertmode,
-                                           property,
-                                           &new_vo,
-                                           sizeof(struct value_obj *));
-        if (error) {
-            value_destroy(new_vo);
+    /* Add value to collection */
+    error = col_insert_binary_property_with_ref(acceptor,
+                                                NULL,
+                                                COL_DSP_END,
+                                                NULL,
+                                                0,
+                                                COL_INSERT_NOCHECK,
+                                                property,
+                                                &new_vo,
+                                                sizeof(struct value_obj *),
+                                                &item);
+    if (error) {
+        TRACE_ERROR_NUMBER("Failed to add value object"
+                           " to the section", error);
+        value_destroy(new_vo);
+        return error;
+    }
 
-            if ((suppress) && (error == EEXIST)) {
-                /* We are here is we do not allow dups
-                 * but found one and need to ignore it.
-                 */
-                TRACE_INFO_STRING("Preseved exisitng value",
-                                  property);
-                error = 0;
-            }
-            else {
-                /* Check if this is a critical error or not */
-                if ((mergemode == INI_MV2S_ERROR) && (error == EEXIST)) {
-                    TRACE_ERROR_NUMBER("Failed to add value object to "
-                                       "the section in error mode ", error);
-                    passed_data->error = EEXIST;
-                    *dummy = 1;
-                }
-                else {
-                    TRACE_ERROR_NUMBER("Failed to add value object"
-                                       " to the section", error);
-                    return error;
-                }
-            }
+    /* Next values with the same name are dups */
+    if (passed_data->table) {
+        error = ini_item_table_add(passed_data->table, item);
+        if (error) {
+            TRACE_ERROR_NUMBER("Failed to remember value", error);
+            return error;
         }
     }
 
     TRACE_FLOW_EXIT();
-    return error;
+    return EOK;
 }
 
 
@@ -524,11 +644,26 @@ static int merge_two_sections(struct collection_item *donor,
     data.flags = flags;
     data.error = 0;
     data.found = 0;
+    data.changes = NULL;
+    data.table = NULL;
+
+    /* Keys of the acceptor are hashed so that
+     * looking for dups does not walk the section.
+     */
+    if ((flags & INI_MV2S_MASK) != INI_MV2S_ALLOW) {
+        error = ini_item_table_create(acceptor, COL_TYPE_BINARY,
+                                      &(data.table));
+        if (error) {
+            TRACE_ERROR_NUMBER("Failed to hash keys", error);
+            return error;
+        }
+    }
 
     error = col_traverse_collection(donor,
                                     COL_TRAVERSE_ONELEVEL,
                                     merge_section_handler,
                                     (void *)(&data));
+    ini_item_table_destroy(data.table);
     if (error) {
         TRACE_ERROR_NUMBER("Merge values failed", error);
         return error;
@@ -540,6 +675,123 @@ static int merge_two_sections(struct collection_item *donor,
 
 
 
+/* Record a change made by the in place merge */
+static int merge_add_change(struct ref_array *changes,
+                            struct collection_item **slot,
+                            struct collection_item *original,
+                            const char *name)
+{
+    int error = EOK;
+    struct merge_change change;
+
+    TRACE_FLOW_ENTRY();
+
+    change.slot = slot;
+    change.original = original;
+    change.name = name;
+
+    error = ref_array_append(changes, &change);
+    if (error) {
+        TRACE_ERROR_NUMBER("Failed to record change", error);
+        return error;
+    }
+
+    TRACE_FLOW_EXIT();
+    return EOK;
+}
+
+/* Remove the section that was added last */
+static void merge_remove_last(struct collection_item *cfg)
+{
+    struct collection_item *item = NULL;
+
+    TRACE_FLOW_ENTRY();
+
+    if (col_extract_item(cfg, NULL, COL_DSP_END,
+                         NULL, 0, COL_TYPE_ANY, &item) == EOK) {
+        col_delete_item_with_cb(item, ini_cleanup_cb, NULL);
+    }
+
+    TRACE_FLOW_EXIT();
+}
+
+/* Replace section with its copy and remember the original */
+static int merge_save_section(struct ref_array *changes,
+                              const char *name,
+                              struct collection_item **slot)
+{
+    int error = EOK;
+    struct collection_item *copy = NULL;
+
+    TRACE_FLOW_ENTRY();
+
+    error = col_copy_collection_with_cb(&copy,
+                                        *slot,
+                                        NULL,
+                                        COL_COPY_NORMAL,
+                                        ini_copy_cb,
+                                        NULL);
+    if (error) {
+        TRACE_ERROR_NUMBER("Failed to copy section", error);
+        return error;
+    }
+
+    error = merge_add_change(changes, slot, *slot, name);
+    if (error) {
+        TRACE_ERROR_NUMBER("Failed to save change", error);
+        col_destroy_collection_with_cb(copy, ini_cleanup_cb, NULL);
+        return error;
+    }
+
+    /* The section item now points to the copy */
+    *slot = copy;
+
+    TRACE_FLOW_EXIT();
+    return EOK;
+}
+
+/* Undo all changes made by the in place merge */
+static void merge_rollback(struct collection_item *cfg,
+                           struct ref_array *changes)
+{
+    struct merge_change *change;
+    uint32_t i;
+
+    TRACE_FLOW_ENTRY();
+
+    /* Undo in reverse order */
+    for (i = ref_array_len(changes); i > 0; i--) {
+        change = ref_array_get(changes, i - 1, NULL);
+        if (change->slot) {
+            col_destroy_collection_with_cb(*(change->slot),
+                                           ini_cleanup_cb, NULL);
+            *(change->slot) = change->original;
+        }
+        else merge_remove_last(cfg);
+    }
+
+    TRACE_FLOW_EXIT();
+}
+
+/* Make changes of the in place merge permanent */
+static void merge_commit(struct ref_array *changes)
+{
+    struct merge_change *change;
+    uint32_t i;
+
+    TRACE_FLOW_ENTRY();
+
+    for (i = 0; i < ref_array_len(changes); i++) {
+        change = ref_array_get(changes, i, NULL);
+        if (change->slot) {
+            col_destroy_collection_with_cb(change->original,
+                                           ini_cleanup_cb, NULL);
+        }
+    }
+
+    TRACE_FLOW_EXIT();
+}
+
 /* Callback to process the accepting config */
 static int acceptor_handler(const char *property,
                             int property_len,
@@ -566,6 +818,22 @@ static int acceptor_handler(const char *property,
 
     mergemode = passed_data->flags & INI_MS_MODE_MASK;
 
+    /* In place merge works on a copy of the section
+     * so that the section can be restored.
+     */
+    if ((passed_data->changes) &&
+        (mergemode != INI_MS_ERROR) &&
+        (mergemode != INI_MS_PRESERVE)) {
+        error = merge_save_section(passed_data->changes,
+                                   property,
+                                   (struct collection_item **)(data));
+        if (error) {
+            TRACE_ERROR_NUMBER("Failed to save section", error);
+            return error;
+        }
+        acceptor = *((struct collection_item **)(data));
+    }
+
     if (passed_data->flags & INI_MS_DETECT) {
         TRACE_INFO_STRING("Detect mode", "");
         passed_data->error = EEXIST;
@@ -646,6 +914,8 @@ static int donor_handler(const char *property,
     struct merge_data *passed_data;
     struct merge_data acceptor_data;
     struct collection_item *new_ci = NULL;
+    struct collection_item *item = NULL;
+    int found = 0;
 
     TRACE_FLOW_ENTRY();
 
@@ -666,17 +936,24 @@ static int donor_handler(const char *property,
         acceptor_data.ci = *((struct collection_item **)(data));
         acceptor_data.error = 0;
         acceptor_data.found = 0;
+        acceptor_data.changes = passed_data->changes;
+        acceptor_data.table = NULL;
 
         /* Try to find same section as the current one */
-        error = col_get_item_and_do(passed_data->ci,
-                                    property,
-                                    COL_TYPE_COLLECTIONREF,
-                                    COL_TRAVERSE_ONELEVEL,
-                                    acceptor_handler,
-                                    (void *)(&acceptor_data));
-        if (error) {
-            TRACE_ERROR_NUMBER("Critical error", error);
-            return error;
+        item = ini_item_table_find(passed_data->table, property);
+        if (item) {
+            error = acceptor_handler(property,
+                                     property_len,
+                                     COL_TYPE_COLLECTIONREF,
+                                     col_get_item_data(item),
+                                     col_get_item_length(item),
+                                     (void *)(&acceptor_data),
+                                     &found);
+            /* Duplicates are reported in the acceptor data */
+            if ((error) && (error != EEXIST)) {
+                TRACE_ERROR_NUMBER("Critical error", error);
+                return error;
+            }
         }
 
         /* Was duplicate found ? */
@@ -716,16 +993,40 @@ static int donor_handler(const char *property,
             }
 
             /* ... and embed into the existing collection */
-            error = col_add_collection_to_collection(passed_data->ci,
-                                                     NULL,
-                                                     NULL,
-                                                     new_ci,
-                                                     COL_ADD_MODE_EMBED);
+            error = col_insert_property_with_ref(passed_data->ci,
+                                                 NULL,
+                                                 COL_DSP_END,
+                                                 NULL,
+                                                 0,
+                                                 COL_INSERT_NOCHECK,
+                                                 property,
+                                                 COL_TYPE_COLLECTIONREF,
+                                                 (void *)(&new_ci),
+                                                 sizeof(struct collection_item *),
+                                                 &item);
             if (error) {
                 TRACE_ERROR_NUMBER("Failed to copy collection", error);
                 col_destroy_collection(new_ci);
                 return error;
             }
+
+            /* Same section can come again */
+            error = ini_item_table_add(passed_data->table, item);
+            if (error) {
+                TRACE_ERROR_NUMBER("Failed to remember section", error);
+                return error;
+            }
+
+            /* Remember to remove the section if merge fails */
+            if (passed_data->changes) {
+                error = merge_add_change(passed_data->changes,
+                                         NULL, NULL, property);
+                if (error) {
+                    TRACE_ERROR_NUMBER("Failed to save change", error);
+                    merge_remove_last(passed_data->ci);
+                    return error;
+                }
+            }
         }
     }
 
@@ -737,6 +1038,7 @@ static int merge_comment(struct ini_cfgobj *donor,
                          struct ini_cfgobj *acceptor)
 {
     int error = EOK;
+    struct ini_comment *ic = NULL;
 
     TRACE_FLOW_ENTRY();
 
@@ -744,13 +1046,24 @@ static int merge_comment(struct ini_cfgobj *donor,
 
         if (acceptor->last_comment) {
 
-            error = ini_comment_add(donor->last_comment,
-                                    acceptor->last_comment);
+            /* Merge into a copy so that a failure
+             * leaves the acceptor intact.
+             */
+            error = ini_comment_copy(acceptor->last_comment, &ic);
+            if (error) {
+                TRACE_ERROR_NUMBER("Copy comment failed", error);
+                return error;
+            }
+
+            error = ini_comment_add(donor->last_comment, ic);
             if (error) {
                 TRACE_ERROR_NUMBER("Merge comment failed", error);
+                ini_comment_destroy(ic);
                 return error;
             }
 
+            ini_comment_destroy(acceptor->last_comment);
+            acceptor->last_comment = ic;
         }
         else {
             error = ini_comment_copy(donor->last_comment,
@@ -771,7 +1084,8 @@ static int merge_comment(struct ini_cfgobj *donor,
 /* Internal function to merge two configs */
 static int merge_configs(struct ini_cfgobj *donor,
                          struct ini_cfgobj *acceptor,
-                         uint32_t collision_flags)
+                         uint32_t collision_flags,
+                         struct ref_array *changes)
 {
     int error = EOK;
     struct merge_data data;
@@ -782,6 +1096,17 @@ static int merge_configs(struct ini_cfgobj *donor,
     data.flags = collision_flags;
     data.error = 0;
     data.found = 0;
+    data.changes = changes;
+
+    /* Sections of the acceptor are hashed
+     * for the duration of the merge.
+     */
+    error = ini_item_table_create(acceptor->cfg, COL_TYPE_COLLECTIONREF,
+                                  &(data.table));
+    if (error) {
+        TRACE_ERROR_NUMBER("Failed to hash sections", error);
+        return error;
+    }
 
     /* Loop through the donor collection calling
      * donor_handler callback for every section we find.
@@ -790,6 +1115,7 @@ static int merge_configs(struct ini_cfgobj *donor,
                                     COL_TRAVERSE_ONELEVEL,
                                     donor_handler,
                                     (void *)(&data));
+    ini_item_table_destroy(data.table);
     if (error) {
         TRACE_ERROR_NUMBER("Merge failed", error);
         return error;
@@ -803,15 +1129,6 @@ static int merge_configs(struct ini_cfgobj *donor,
         return data.error;
     }
 
-    /* If boundaries are different re-align the values */
-    if (acceptor->boundary != donor->boundary) {
-        error = ini_config_set_wrap(acceptor, acceptor->boundary);
-        if (error) {
-            TRACE_ERROR_NUMBER("Failed to re-align", error);
-            return error;
-        }
-    }
-
     /* Merge last comment */
     error = merge_comment(donor, acceptor);
     if (error) {
@@ -879,6 +1196,7 @@ int ini_config_merge(struct ini_cfgobj *first,
                      struct ini_cfgobj **result)
 {
     int error = EOK;
+    int error2 = EOK;
     struct ini_cfgobj *new_co = NULL;
 
     TRACE_FLOW_ENTRY();
@@ -916,8 +1234,38 @@ int ini_config_merge(struct ini_cfgobj *first,
         return error;
     }
 
+    /* Comments of the lean configuration are gone */
+    new_co->lean |= second->lean;
+
+    error = ini_config_add_sources(new_co, second);
+    if (error) {
+        TRACE_ERROR_NUMBER("Failed to add sources", error);
+        ini_config_destroy(new_co);
+        return error;
+    }
+
     /* Merge configs */
-    error = merge_configs(second, new_co, collision_flags);
+    error = merge_configs(second, new_co, collision_flags, NULL);
+    if (((error == EOK) || (error == EEXIST)) &&
+        (new_co->boundary != second->boundary)) {
+        /* If boundaries are different re-align the values */
+        error2 = ini_config_set_wrap(new_co, new_co->boundary);
+        if (error2) {
+            TRACE_ERROR_NUMBER("Failed to re-align", error2);
+            ini_config_destroy(new_co);
+            return error2;
+        }
+    }
+    if ((error == EOK) || (error == EEXIST)) {
+        /* Sections and keys were added - refresh the index */
+        error2 = ini_index_build(new_co->index, new_co->cfg);
+        if (error2) {
+            TRACE_ERROR_NUMBER("Failed to index configuration", error2);
+            ini_config_destroy(new_co);
+            return error2;
+        }
+    }
+
     if (error) {
         TRACE_ERROR_NUMBER("Failed to merge configuration", error);
         if ((error == EEXIST) &&
@@ -942,19 +1290,125 @@ int ini_config_merge(struct ini_cfgobj *first,
 
 }
 
-/* How many errors do we have in the list ? */
-unsigned ini_config_error_count(struct ini_cfgobj *cfg_ctx)
+/* Merge second configuration into the first one in place */
+int ini_config_merge_into(struct ini_cfgobj *first,
+                          struct ini_cfgobj *second,
+                          uint32_t collision_flags)
 {
-    unsigned count = 0;
+    int error = EOK;
+    int error2 = EOK;
+    struct ref_array *changes = NULL;
+    struct merge_change *change;
+    uint32_t i;
 
     TRACE_FLOW_ENTRY();
 
-    count = cfg_ctx->count;
-
-    TRACE_FLOW_EXIT();
-    return count;
-
-}
+    /* Check input params */
+    if ((!first) || (!second)) {
+        TRACE_ERROR_NUMBER("Invalid argument", EINVAL);
+        return EINVAL;
+    }
+
+    /* Check collision flags */
+    if (!valid_collision_flags(collision_flags)) {
+        TRACE_ERROR_NUMBER("Invalid flags.", EINVAL);
+        return EINVAL;
+    }
+
+    /* Extra sources only make the cache more cautious
+     * so they are not removed if the merge fails.
+     */
+    error = ini_config_add_sources(first, second);
+    if (error) {
+        TRACE_ERROR_NUMBER("Failed to add sources", error);
+        return error;
+    }
+
+    error = ref_array_create(&changes,
+                             sizeof(struct merge_change),
+                             INI_MERGE_CHANGE_INC,
+                             NULL,
+                             NULL);
+    if (error) {
+        TRACE_ERROR_NUMBER("Failed to create change list", error);
+        return error;
+    }
+
+    /* Only the sections that are touched by the merge are copied.
+     * Everything else is shared with the original configuration.
+     */
+    error = merge_configs(second, first, collision_flags, changes);
+    if (error) {
+        TRACE_ERROR_NUMBER("Failed to merge configuration", error);
+        if (!((error == EEXIST) &&
+              ((ini_flags_have(INI_MS_DETECT, collision_flags) &&
+                ((collision_flags & INI_MV2S_MASK) != INI_MV2S_ERROR)) ||
+               (!ini_flags_have(INI_MS_ERROR, collision_flags) &&
+                ((collision_flags & INI_MV2S_MASK) == INI_MV2S_DETECT))))) {
+            /* Got an error in non detect mode - undo the merge */
+            TRACE_ERROR_NUMBER("Got error in non detect mode", error);
+            merge_rollback(first->cfg, changes);
+            ref_array_destroy(changes);
+            return error;
+        }
+        /* Fall through! */
+    }
+
+    /* Refresh the index for the changed sections
+     * while the old sections are still around.
+     */
+    for (i = 0; i < ref_array_len(changes); i++) {
+        change = ref_array_get(changes, i, NULL);
+        error2 = ini_index_update_section(first->index,
+                                          first->cfg,
+                                          change->name);
+        if (error2) {
+            TRACE_ERROR_NUMBER("Failed to index section", error2);
+            merge_rollback(first->cfg, changes);
+            ref_array_destroy(changes);
+            /* Best effort, the index is empty if this fails */
+            (void)ini_index_build(first->index, first->cfg);
+            return error2;
+        }
+    }
+
+    merge_commit(changes);
+    ref_array_destroy(changes);
+
+    first->lean |= second->lean;
+
+    /* If boundaries are different re-align the values.
+     * Done after the commit so that a failed merge
+     * leaves all the sections as they were.
+     */
+    if (first->boundary != second->boundary) {
+        error2 = ini_config_set_wrap(first, first->boundary);
+        if (error2) {
+            TRACE_ERROR_NUMBER("Failed to re-align", error2);
+            ini_config_clean_state(first);
+            return error2;
+        }
+    }
+
+    ini_config_clean_state(first);
+
+    TRACE_FLOW_EXIT();
+    return error;
+}
+
+/* How many errors do we have in the list ? */
+unsigned ini_config_error_count(struct ini_cfgobj *cfg_ctx)
+{
+    unsigned count = 0;
+
+    TRACE_FLOW_ENTRY();
+
+    count = cfg_ctx->count;
+
+    TRACE_FLOW_EXIT();
+    return count;
+
+}
 
 /* Free error strings */
 void ini_config_free_errors(char **errors)
@@ -1113,427 +1567,458 @@ static int ini_dummy_error(const char *rule_name,
     return ini_errobj_add_msg(errobj, "Error");
 }
 
-static int is_allowed_section(const char *tested_section,
-                              char **allowed_sections,
-                              size_t num_sec,
-                              regex_t *allowed_sections_re,
-                              size_t num_sec_re,
-                              int case_insensitive)
+/* Allowed names and patterns of the
+ * 'ini_allowed_sections' and 'ini_allowed_options' rules
+ * prepared for checking.
+ */
+struct ini_rule_names {
+    struct ini_name_set *names;
+    regex_t *re;
+    size_t num_re;
+};
+
+/* Kinds of the compiled rules */
+enum ini_rule_type {
+    INI_RULE_REPORT,   /* Rule only reports its problems */
+    INI_RULE_FUNC,     /* Rule runs the validator */
+    INI_RULE_SECTIONS, /* Rule checks the allowed sections */
+    INI_RULE_OPTIONS   /* Rule checks the allowed options */
+};
+
+/* Compiled rule */
+struct ini_rule {
+    char *name;
+    enum ini_rule_type type;
+    ini_validator_func *func;
+    struct ini_rule_names *names;
+    /* Messages the rule reports every time it is checked */
+    struct ini_errobj *report;
+};
+
+/* Compiled rules */
+struct ini_cfgrules {
+    /* Copy of the rules passed to the validators */
+    struct ini_cfgobj *rules_obj;
+    size_t count;
+    struct ini_rule *rules;
+};
+
+#ifdef HAVE_PTHREAD
+/* Rules shared by the checking threads */
+struct ini_rules_pool {
+    struct ini_cfgrules *rules;
+    struct ini_cfgobj *config_obj;
+    /* Messages and error of each rule */
+    struct ini_errobj **results;
+    int *errors;
+    size_t next;
+    pthread_mutex_t lock;
+};
+#endif
+
+static void rule_names_free(struct ini_rule_names *data)
 {
-    int ret;
-    int i;
+    size_t i;
 
-    if (case_insensitive) {
-        for (i = 0; i < num_sec; i++) {
-            if (strcasecmp(tested_section, allowed_sections[i]) == 0) {
-                return 1;
-            }
-        }
-    } else { /* case sensitive */
-        for (i = 0; i < num_sec; i++) {
-            if (strcmp(tested_section, allowed_sections[i]) == 0) {
-                return 1;
-            }
-        }
+    if (data == NULL) {
+        return;
     }
 
-    for (i = 0; i < num_sec_re; i++) {
-        ret = regexec(&allowed_sections_re[i], tested_section, 0, NULL, 0);
-        if (ret == 0) {
-            return 1;
+    ini_name_set_destroy(data->names);
+    if (data->re != NULL) {
+        for (i = 0; i < data->num_re; i++) {
+            regfree(&data->re[i]);
         }
+        free(data->re);
     }
-
-    return 0;
+    free(data);
 }
 
-static int ini_allowed_sections(const char *rule_name,
-                                struct ini_cfgobj *rules_obj,
-                                struct ini_cfgobj *config_obj,
-                                struct ini_errobj *errobj,
-                                void **data)
+static int rule_names_create(uint32_t num_names, size_t num_re,
+                             int case_insensitive,
+                             struct ini_rule_names **_data)
 {
-    struct value_obj *vo = NULL;
+    struct ini_rule_names *data;
     int ret;
-    char *regex_str = NULL;
-    char **allowed_sections = NULL;
-    char *insensitive_str;
-    char **cfg_sections = NULL;
-    int num_cfg_sections;
-    char **attributes = NULL;
-    int num_attributes;
-    size_t num_sec = 0;
-    size_t num_sec_re = 0;
-    regex_t *allowed_sections_re = NULL;
-    size_t buf_size;
-    int reg_err;
-    int is_allowed;
-    int case_insensitive = 0;
-    int regcomp_flags = REG_NOSUB;
-    int i;
 
-    /* Get number of 'section' and 'section_re' attributes
-     * in this rule */
-    attributes = ini_get_attribute_list(rules_obj,
-                                        rule_name,
-                                        &num_attributes,
-                                        NULL);
-    if (attributes == NULL) {
-        ret = ENOMEM;
-        goto done;
+    data = calloc(1, sizeof(struct ini_rule_names));
+    if (data == NULL) {
+        return ENOMEM;
+    }
+
+    ret = ini_name_set_create(num_names, case_insensitive, &data->names);
+    if (ret != EOK) {
+        free(data);
+        return ret;
+    }
+
+    data->re = calloc(num_re + 1, sizeof(regex_t));
+    if (data->re == NULL) {
+        rule_names_free(data);
+        return ENOMEM;
     }
 
-    for (i = 0; i < num_attributes; i++) {
-        if (strcmp("section", attributes[i]) == 0) {
-            num_sec++;
+    *_data = data;
+    return EOK;
+}
+
+/* Compile the next regex of the rule.
+ * On failure EINVAL is returned and err_str
+ * is set to the description of the problem. */
+static int rule_names_add_re(struct ini_rule_names *data,
+                             const char *regex_str,
+                             int regcomp_flags,
+                             char **err_str)
+{
+    int reg_err;
+    size_t buf_size;
+
+    reg_err = regcomp(&data->re[data->num_re], regex_str, regcomp_flags);
+    if (reg_err) {
+        buf_size = regerror(reg_err, &data->re[data->num_re], NULL, 0);
+        *err_str = malloc(buf_size);
+        if (*err_str == NULL) {
+            return ENOMEM;
         }
 
-        if (strcmp("section_re", attributes[i]) == 0) {
-            num_sec_re++;
+        regerror(reg_err, &data->re[data->num_re], *err_str, buf_size);
+        return EINVAL;
+    }
+
+    data->num_re++;
+    return EOK;
+}
+
+static int is_allowed_section(const char *tested_section,
+                              const struct ini_rule_names *data)
+{
+    size_t i;
+
+    if (ini_name_set_has(data->names, tested_section)) {
+        return 1;
+    }
+
+    for (i = 0; i < data->num_re; i++) {
+        if (regexec(&data->re[i], tested_section, 0, NULL, 0) == 0) {
+            return 1;
         }
     }
 
-    ini_free_attribute_list(attributes);
+    return 0;
+}
+
+/* Prepare the 'ini_allowed_sections' rule for checking.
+ * If the rule can't be used the problem is reported
+ * to errobj and data is left NULL. */
+static int allowed_sections_load(const char *rule_name,
+                                 struct ini_cfgobj *rules_obj,
+                                 struct ini_errobj *errobj,
+                                 struct ini_rule_names **_data)
+{
+    const struct ini_index_sec *rule_sec;
+    const struct ini_index_key *sec_key;
+    const struct ini_index_key *sec_re_key;
+    struct ini_rule_names *data = NULL;
+    struct value_obj *vo;
+    const char *str;
+    char *err_str = NULL;
+    uint32_t num_sec;
+    uint32_t num_sec_re;
+    int case_insensitive = 0;
+    int regcomp_flags = REG_NOSUB;
+    int ret;
+    uint32_t i;
+
+    *_data = NULL;
+
+    /* All values of 'section' and 'section_re' come from the index */
+    rule_sec = ini_index_find_sec(rules_obj->index, rule_name);
+    sec_key = ini_index_find_key(rule_sec, "section");
+    sec_re_key = ini_index_find_key(rule_sec, "section_re");
+    num_sec = ini_index_key_count(sec_key);
+    num_sec_re = ini_index_key_count(sec_re_key);
 
     if (num_sec == 0 && num_sec_re == 0) {
         /* This rule is empty. */
-        ret = ini_errobj_add_msg(errobj,
-                                 "No allowed sections specified. "
-                                 "Use 'section = default' to allow only "
-                                 "default section");
-        goto done;
-    }
-
-    ret = ini_get_config_valueobj(rule_name,
-                                  "case_insensitive",
-                                  rules_obj,
-                                  INI_GET_NEXT_VALUE,
-                                  &vo);
-    if (ret) {
-        goto done;
+        return ini_errobj_add_msg(errobj,
+                                  "No allowed sections specified. "
+                                  "Use 'section = default' to allow only "
+                                  "default section");
     }
 
+    vo = ini_index_key_value(ini_index_find_key(rule_sec,
+                                                "case_insensitive"), 0);
     if (vo) {
-        insensitive_str = ini_get_string_config_value(vo, &ret);
-        if (ret) {
-            goto done;
-        }
-
-        if (strcasecmp(insensitive_str, "yes") == 0
-            || strcasecmp(insensitive_str, "true") == 0
-            || strcmp(insensitive_str, "1") == 0) {
+        str = ini_get_const_string_config_value(vo, NULL);
+        if (strcasecmp(str, "yes") == 0
+            || strcasecmp(str, "true") == 0
+            || strcmp(str, "1") == 0) {
             case_insensitive = 1;
             regcomp_flags |= REG_ICASE;
         }
-
-        free(insensitive_str);
-    }
-
-    /* Create arrays for section_re regexes and section name
-     * strings. */
-    allowed_sections = calloc(num_sec + 1, sizeof(char *));
-    if (allowed_sections == NULL) {
-        ret = ENOMEM;
-        goto done;
     }
 
-    allowed_sections_re = calloc(num_sec_re + 1, sizeof(regex_t));
-    if (allowed_sections_re == NULL) {
-        ret = ENOMEM;
-        goto done;
+    ret = rule_names_create(num_sec, num_sec_re, case_insensitive, &data);
+    if (ret) {
+        return ret;
     }
 
-    /* Get all allowed section names and store them to
-     * allowed_sections array */
     for (i = 0; i < num_sec; i++) {
-        ret = ini_get_config_valueobj(rule_name,
-                                      "section",
-                                      rules_obj,
-                                      INI_GET_NEXT_VALUE,
-                                      &vo);
-        if (ret) {
-            goto done;
-        }
-
-        allowed_sections[i] = ini_get_string_config_value(vo, &ret);
+        str = ini_get_const_string_config_value(
+                                ini_index_key_value(sec_key, i), NULL);
+        ret = ini_name_set_add(data->names, str);
         if (ret) {
             goto done;
         }
     }
 
-    /* Get all regular section_re regular expresions and
-     * store them to allowed_sections_re array */
     for (i = 0; i < num_sec_re; i++) {
-        ret = ini_get_config_valueobj(rule_name,
-                                      "section_re",
-                                      rules_obj,
-                                      INI_GET_NEXT_VALUE,
-                                      &vo);
-        if (ret) {
-            goto done;
+        str = ini_get_const_string_config_value(
+                                ini_index_key_value(sec_re_key, i), NULL);
+        ret = rule_names_add_re(data, str, regcomp_flags, &err_str);
+        if (ret == EINVAL) {
+            ret = ini_errobj_add_msg(errobj,
+                                     "Validator failed to use regex [%s]:[%s]",
+                                     str, err_str);
+            ret = ret ? ret : EINVAL;
         }
-
-        regex_str = ini_get_string_config_value(vo, &ret);
         if (ret) {
             goto done;
         }
+    }
+
+    *_data = data;
+    data = NULL;
+    ret = EOK;
+done:
+    rule_names_free(data);
+    free(err_str);
+    return ret;
+}
 
-        reg_err = regcomp(&allowed_sections_re[i], regex_str, regcomp_flags);
-        if (reg_err) {
-            char *err_str;
+/* State of the walk over the configuration.
+ * The configuration is walked with col_traverse_collection()
+ * which, unlike the list and iterator functions, does not
+ * touch the collection, so several rules can check
+ * the same configuration at the same time. */
+struct rules_walk {
+    const struct ini_rule_names *data;
+    struct ini_errobj *errobj;
+    const char *section;
+};
 
-            buf_size = regerror(reg_err, &allowed_sections_re[i], NULL, 0);
-            err_str = malloc(buf_size);
-            if (err_str == NULL) {
-                ret = ENOMEM;
-                goto done;
-            }
+/* Check that the section is allowed */
+static int allowed_sections_cb(const char *property,
+                               int property_len,
+                               int type,
+                               void *data,
+                               int length,
+                               void *custom_data,
+                               int *dummy)
+{
+    struct rules_walk *walk = (struct rules_walk *)custom_data;
 
-            regerror(reg_err, &allowed_sections_re[i], err_str, buf_size);
-            ret = ini_errobj_add_msg(errobj,
-                                     "Validator failed to use regex [%s]:[%s]",
-                                     regex_str, err_str);
-            free(err_str);
-            ret = ret ? ret : EINVAL;
-            goto done;
-        }
-        free(regex_str);
-        regex_str = NULL;
+    /* Sections are the references to the subcollections */
+    if (type != COL_TYPE_COLLECTIONREF) {
+        return EOK;
     }
 
-    /* Finally get list of all sections in configuration and
-     * check if they are matched by some string in allowed_sections
-     * or regex in allowed_sections_re */
-    cfg_sections = ini_get_section_list(config_obj, &num_cfg_sections, &ret);
-    if (ret != EOK) {
-        goto done;
+    if (is_allowed_section(property, walk->data)) {
+        return EOK;
     }
 
-    for (i = 0; i < num_cfg_sections; i++) {
-        is_allowed = is_allowed_section(cfg_sections[i],
-                                        allowed_sections,
-                                        num_sec,
-                                        allowed_sections_re,
-                                        num_sec_re,
-                                        case_insensitive);
-        if (!is_allowed) {
-            ret = ini_errobj_add_msg(errobj,
-                                     "Section [%s] is not allowed. "
-                                     "Check for typos.",
-                                     cfg_sections[i]);
-            if (ret) {
-                goto done;
-            }
-        }
-    }
+    return ini_errobj_add_msg(walk->errobj,
+                              "Section [%s] is not allowed. "
+                              "Check for typos.",
+                              property);
+}
 
-    ret = EOK;
-done:
-    if (allowed_sections != NULL) {
-        for (i = 0; allowed_sections[i] != NULL; i++) {
-            free(allowed_sections[i]);
-        }
-        free(allowed_sections);
-    }
-    if (allowed_sections_re != NULL) {
-        for (i = 0; i < num_sec_re; i++) {
-            regfree(&allowed_sections_re[i]);
-        }
-        free(allowed_sections_re);
-    }
-    ini_free_section_list(cfg_sections);
-    free(regex_str);
+/* Check that the configuration has only the allowed sections */
+static int allowed_sections_check(const struct ini_rule_names *data,
+                                  struct ini_cfgobj *config_obj,
+                                  struct ini_errobj *errobj)
+{
+    struct rules_walk walk = { data, errobj, NULL };
 
-    return ret;
+    return col_traverse_collection(config_obj->cfg,
+                                   COL_TRAVERSE_ONELEVEL,
+                                   allowed_sections_cb,
+                                   &walk);
 }
 
-static int check_if_allowed(char *section, char *attr, char **allowed,
-                            int num_allowed, struct ini_errobj *errobj)
+static int ini_allowed_sections(const char *rule_name,
+                                struct ini_cfgobj *rules_obj,
+                                struct ini_cfgobj *config_obj,
+                                struct ini_errobj *errobj,
+                                void **data)
 {
-    int is_allowed = 0;
+    struct ini_rule_names *names = NULL;
     int ret;
-    int i;
-
-    for (i = 0; i < num_allowed; i++) {
-        if (strcmp(attr, allowed[i]) == 0) {
-            is_allowed = 1;
-            break;
-        }
-    }
 
-    if (!is_allowed) {
-        ret = ini_errobj_add_msg(errobj,
-                                 "Attribute '%s' is not allowed in "
-                                 "section '%s'. Check for typos.",
-                                 attr, section);
+    ret = allowed_sections_load(rule_name, rules_obj, errobj, &names);
+    if (names == NULL) {
         return ret;
     }
 
-    return 0;
+    ret = allowed_sections_check(names, config_obj, errobj);
+    rule_names_free(names);
+    return ret;
 }
 
-static int ini_allowed_options(const char *rule_name,
-                               struct ini_cfgobj *rules_obj,
-                               struct ini_cfgobj *config_obj,
-                               struct ini_errobj *errobj,
-                               void **data)
+/* Prepare the 'ini_allowed_options' rule for checking.
+ * If the rule can't be used the problem is reported
+ * to errobj and data is left NULL. */
+static int allowed_options_load(const char *rule_name,
+                                struct ini_cfgobj *rules_obj,
+                                struct ini_errobj *errobj,
+                                struct ini_rule_names **_data)
 {
-    struct value_obj *vo = NULL;
-    int ret;
-    char *section_regex;
-    int num_sections;
-    char **sections = NULL;
-    char **attributes = NULL;
-    int num_attributes;
-    int num_opts = 0;
-    int i;
-    int a;
-    regex_t preg;
-    size_t buf_size;
+    const struct ini_index_sec *rule_sec;
+    const struct ini_index_key *opt_key;
+    struct ini_rule_names *data = NULL;
+    struct value_obj *vo;
+    const char *str;
     char *err_str = NULL;
-    int reg_err;
-    char **allowed = NULL;
+    uint32_t num_opts;
+    int ret;
+    uint32_t i;
 
-    /* Get section regex */
-    ret = ini_get_config_valueobj(rule_name,
-                                  "section_re",
-                                  rules_obj,
-                                  INI_GET_FIRST_VALUE,
-                                  &vo);
-    if (ret != 0) {
-        return ret;
-    }
+    *_data = NULL;
 
-    if (vo == NULL) {
+    /* Get section regex */
+    rule_sec = ini_index_find_sec(rules_obj->index, rule_name);
+    vo = ini_index_key_value(ini_index_find_key(rule_sec, "section_re"), 0);
+    str = vo ? ini_get_const_string_config_value(vo, NULL) : NULL;
+    if (str == NULL || str[0] == '\0') {
         ret = ini_errobj_add_msg(errobj,
                                  "Validator misses 'section_re' parameter");
-        if (ret) {
-            return ret;
-        }
-        return EINVAL;
+        return ret ? ret : EINVAL;
     }
 
-    section_regex = ini_get_string_config_value(vo, NULL);
-    if (section_regex == NULL || section_regex[0] == '\0') {
-        ret = ini_errobj_add_msg(errobj,
-                                 "Validator misses 'section_re' parameter");
-        if (ret) {
-            return ret;
-        }
+    opt_key = ini_index_find_key(rule_sec, "option");
+    num_opts = ini_index_key_count(opt_key);
 
-        free(section_regex);
-        return EINVAL;
+    /* Option names are case sensitive */
+    ret = rule_names_create(num_opts, 1, 0, &data);
+    if (ret) {
+        return ret;
     }
 
-    /* compile the regular expression */
-    reg_err = regcomp(&preg, section_regex, REG_NOSUB);
-    if (reg_err) {
-        buf_size = regerror(reg_err, &preg, NULL, 0);
-        err_str = malloc(buf_size);
-        if (err_str == NULL) {
-            ret = ENOMEM;
-            goto done;
-        }
-
-        regerror(reg_err, &preg, err_str, buf_size);
+    ret = rule_names_add_re(data, str, REG_NOSUB, &err_str);
+    if (ret == EINVAL) {
         ret = ini_errobj_add_msg(errobj,
                                  "Cannot compile regular expression from "
                                  "option 'section_re'. Error: '%s'", err_str);
         ret = ret ? ret : EINVAL;
-        goto done;
-    }
-
-    /* Get all sections from config_obj */
-    sections = ini_get_section_list(config_obj, &num_sections, &ret);
-    if (ret != EOK) {
-        goto done;
     }
-
-    /* Get number of 'option' attributes in this rule
-     * and create an array long enough to store them all */
-    attributes = ini_get_attribute_list(rules_obj,
-                                        rule_name,
-                                        &num_attributes,
-                                        NULL);
-    if (attributes == NULL) {
-        ret = ENOMEM;
+    if (ret) {
         goto done;
     }
 
-    for (i = 0; i < num_attributes; i++) {
-        if (strcmp("option", attributes[i]) == 0) {
-            num_opts++;
+    for (i = 0; i < num_opts; i++) {
+        str = ini_get_const_string_config_value(
+                                ini_index_key_value(opt_key, i), NULL);
+        ret = ini_name_set_add(data->names, str);
+        if (ret) {
+            goto done;
         }
     }
 
-    ini_free_attribute_list(attributes);
-    attributes = NULL;
-
-    allowed = calloc(num_opts + 1, sizeof(char *));
-    if (allowed == NULL) {
-        ret = ENOMEM;
-        goto done;
-    }
+    *_data = data;
+    data = NULL;
+    ret = EOK;
+done:
+    rule_names_free(data);
+    free(err_str);
+    return ret;
+}
 
-    for (i = 0; i < num_opts; i++) {
-        ret = ini_get_config_valueobj(rule_name,
-                                      "option",
-                                      rules_obj,
-                                      INI_GET_NEXT_VALUE,
-                                      &vo);
-        if (ret) {
-            goto done;
-        }
+/* Check that the attribute is allowed */
+static int allowed_options_attr_cb(const char *property,
+                                   int property_len,
+                                   int type,
+                                   void *data,
+                                   int length,
+                                   void *custom_data,
+                                   int *dummy)
+{
+    struct rules_walk *walk = (struct rules_walk *)custom_data;
 
-        allowed[i] = ini_get_string_config_value(vo, &ret);
-        if (ret) {
-            goto done;
-        }
+    /* Values are the binary items, the one that
+     * holds the section comment is not an attribute */
+    if ((type != COL_TYPE_BINARY) ||
+        (strcmp(property, INI_SECTION_KEY) == 0)) {
+        return EOK;
     }
 
-    for (i = 0; i < num_sections; i++) {
-        if (regexec(&preg, sections[i], 0, NULL, 0) == 0) {
-            /* Regex matched section */
-            /* Get options from this section */
-            attributes = ini_get_attribute_list(config_obj,
-                                                sections[i],
-                                                &num_attributes,
-                                                NULL);
-            if (attributes == NULL) {
-                ret = ENOMEM;
-                goto done;
-            }
+    if (ini_name_set_has(walk->data->names, property)) {
+        return EOK;
+    }
 
-            for (a = 0; a < num_attributes; a++) {
-                ret = check_if_allowed(sections[i], attributes[a], allowed,
-                                       num_opts, errobj);
-                if (ret != 0) {
-                    goto done;
-                }
-            }
-            ini_free_attribute_list(attributes);
-            attributes = NULL;
-        }
+    return ini_errobj_add_msg(walk->errobj,
+                              "Attribute '%s' is not allowed in "
+                              "section '%s'. Check for typos.",
+                              property, walk->section);
+}
+
+/* Check the attributes of the section if the rule matches it */
+static int allowed_options_section_cb(const char *property,
+                                      int property_len,
+                                      int type,
+                                      void *data,
+                                      int length,
+                                      void *custom_data,
+                                      int *dummy)
+{
+    struct rules_walk *walk = (struct rules_walk *)custom_data;
+
+    if ((type != COL_TYPE_COLLECTIONREF) ||
+        (regexec(&walk->data->re[0], property, 0, NULL, 0) != 0)) {
+        return EOK;
     }
 
-    ret = 0;
-done:
-    if (allowed != NULL) {
-        for (i = 0; allowed[i] != NULL; i++) {
-            free(allowed[i]);
-        }
-        free(allowed);
+    /* Regex matched section */
+    walk->section = property;
+    return col_traverse_collection(*((struct collection_item **)data),
+                                   COL_TRAVERSE_ONELEVEL,
+                                   allowed_options_attr_cb,
+                                   walk);
+}
+
+/* Check the options in the sections matched by the rule */
+static int allowed_options_check(const struct ini_rule_names *data,
+                                 struct ini_cfgobj *config_obj,
+                                 struct ini_errobj *errobj)
+{
+    struct rules_walk walk = { data, errobj, NULL };
+
+    return col_traverse_collection(config_obj->cfg,
+                                   COL_TRAVERSE_ONELEVEL,
+                                   allowed_options_section_cb,
+                                   &walk);
+}
+
+static int ini_allowed_options(const char *rule_name,
+                               struct ini_cfgobj *rules_obj,
+                               struct ini_cfgobj *config_obj,
+                               struct ini_errobj *errobj,
+                               void **data)
+{
+    struct ini_rule_names *names = NULL;
+    int ret;
+
+    ret = allowed_options_load(rule_name, rules_obj, errobj, &names);
+    if (names == NULL) {
+        return ret;
     }
-    ini_free_section_list(sections);
-    free(section_regex);
-    ini_free_attribute_list(attributes);
-    regfree(&preg);
-    free(err_str);
+
+    ret = allowed_options_check(names, config_obj, errobj);
+    rule_names_free(names);
     return ret;
 }
 
 static ini_validator_func *
-get_validator(char *validator_name,
+get_validator(const char *validator_name,
               struct ini_validator **validators)
 {
     struct ini_validator *ext_validator;
@@ -1568,6 +2053,45 @@ get_validator(char *validator_name,
     return NULL;
 }
 
+/* Report the result of the rule: the error code
+ * if it is not zero and then all messages of the rule. */
+static int rules_report(struct ini_errobj *errobj,
+                        const char *rule_name,
+                        int rule_ret,
+                        struct ini_errobj *localerr)
+{
+    struct ini_errmsg *msg;
+    int ret;
+
+    if (rule_ret != 0) {
+        /* Just report the error and continue normally,
+         * maybe there are some errors in localerr */
+        ret = ini_errobj_add_msg(errobj,
+                                 "Rule '%s' returned error code '%d'",
+                                 rule_name, rule_ret);
+        if (ret != EOK) {
+            return ret;
+        }
+    }
+
+    /* Bad validator could destroy the localerr, check
+     * for NULL */
+    if (localerr == NULL) {
+        return EOK;
+    }
+
+    /* Walk the list directly, the iterator of
+     * localerr is left alone */
+    for (msg = localerr->first_msg; msg != NULL; msg = msg->next) {
+        ret = ini_errobj_add_msg(errobj, "[%s]: %s", rule_name, msg->str);
+        if (ret != EOK) {
+            return ret;
+        }
+    }
+
+    return EOK;
+}
+
 int ini_rules_check(struct ini_cfgobj *rules_obj,
                     struct ini_cfgobj *config_obj,
                     struct ini_validator **extra_validators,
@@ -1640,33 +2164,9 @@ int ini_rules_check(struct ini_cfgobj *rules_obj,
             }
 
             ret = vfunc(sections[i], rules_obj, config_obj, localerr, NULL);
-            if (ret != 0) {
-                /* Just report the error and continue normally,
-                 * maybe there are some errors in localerr */
-                ret = ini_errobj_add_msg(errobj,
-                                         "Rule '%s' returned error code '%d'",
-                                         sections[i], ret);
-                if (ret != EOK) {
-                    goto done;
-                }
-            }
-
-            /* Bad validator could destroy the localerr, check
-             * for NULL */
-            if (localerr == NULL) {
-                continue;
-            }
-
-            ini_errobj_reset(localerr);
-            while (!ini_errobj_no_more_msgs(localerr)) {
-                ret = ini_errobj_add_msg(errobj,
-                                         "[%s]: %s",
-                                         sections[i],
-                                         ini_errobj_get_msg(localerr));
-                if (ret != EOK) {
-                    goto done;
-                }
-                ini_errobj_next(localerr);
+            ret = rules_report(errobj, sections[i], ret, localerr);
+            if (ret != EOK) {
+                goto done;
             }
 
             ini_errobj_destroy(&localerr);
@@ -1687,6 +2187,418 @@ void ini_rules_destroy(struct ini_cfgobj *rules)
     ini_config_destroy(rules);
 }
 
+/* Destroy the compiled rules */
+void ini_rules_destroy_compiled(struct ini_cfgrules *rules)
+{
+    size_t i;
+
+    if (rules == NULL) {
+        return;
+    }
+
+    TRACE_FLOW_ENTRY();
+
+    if (rules->rules != NULL) {
+        for (i = 0; i < rules->count; i++) {
+            free(rules->rules[i].name);
+            rule_names_free(rules->rules[i].names);
+            ini_errobj_destroy(&rules->rules[i].report);
+        }
+        free(rules->rules);
+    }
+
+    ini_config_destroy(rules->rules_obj);
+    free(rules);
+
+    TRACE_FLOW_EXIT();
+}
+
+/* Resolve the validator of the rule and prepare the rule.
+ * Problems of the rule are kept in its report to be
+ * returned by every check exactly as ini_rules_check does. */
+static int compile_rule(struct ini_rule *rule,
+                        struct ini_cfgobj *rules_obj,
+                        struct ini_validator **extra_validators)
+{
+    struct value_obj *vo = NULL;
+    struct ini_cursor cursor;
+    struct ini_errobj *localerr = NULL;
+    const char *vname;
+    int ret;
+
+    rule->type = INI_RULE_REPORT;
+
+    ret = ini_errobj_create(&rule->report);
+    if (ret != EOK) {
+        return ret;
+    }
+
+    ret = ini_get_config_valueobj_r(rule->name, "validator", rules_obj,
+                                    INI_GET_FIRST_VALUE, &cursor, &vo);
+    if (ret != 0) {
+        /* Failed to get value object. This should not
+         * happen. Rule is skipped. */
+        return EOK;
+    }
+
+    if (vo == NULL) {
+        return ini_errobj_add_msg(rule->report,
+                                  "Rule '%s' has no validator.",
+                                  rule->name);
+    }
+
+    vname = ini_get_const_string_config_value(vo, NULL);
+    rule->func = get_validator(vname, extra_validators);
+    if (rule->func == NULL) {
+        return ini_errobj_add_msg(rule->report,
+                                  "Rule '%s' uses unknown "
+                                  "validator '%s'.",
+                                  rule->name, vname);
+    }
+
+    if ((rule->func != ini_allowed_sections) &&
+        (rule->func != ini_allowed_options)) {
+        rule->type = INI_RULE_FUNC;
+        return EOK;
+    }
+
+    ret = ini_errobj_create(&localerr);
+    if (ret != EOK) {
+        return ret;
+    }
+
+    if (rule->func == ini_allowed_sections) {
+        ret = allowed_sections_load(rule->name, rules_obj,
+                                    localerr, &rule->names);
+        rule->type = INI_RULE_SECTIONS;
+    } else {
+        ret = allowed_options_load(rule->name, rules_obj,
+                                   localerr, &rule->names);
+        rule->type = INI_RULE_OPTIONS;
+    }
+
+    if (rule->names == NULL) {
+        rule->type = INI_RULE_REPORT;
+        ret = rules_report(rule->report, rule->name, ret, localerr);
+    }
+
+    ini_errobj_destroy(&localerr);
+    return ret;
+}
+
+/* Compile the rules */
+int ini_rules_compile(struct ini_cfgobj *rules_obj,
+                      struct ini_validator **extra_validators,
+                      struct ini_cfgrules **_rules)
+{
+    struct ini_cfgrules *rules = NULL;
+    char **sections = NULL;
+    int num_sections;
+    int ret;
+    int i;
+
+    if (rules_obj == NULL || _rules == NULL) {
+        return EINVAL;
+    }
+
+    TRACE_FLOW_ENTRY();
+
+    rules = calloc(1, sizeof(struct ini_cfgrules));
+    if (rules == NULL) {
+        return ENOMEM;
+    }
+
+    /* The compiled rules do not depend on the
+     * rules object the caller passed */
+    ret = ini_config_copy(rules_obj, &rules->rules_obj);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    sections = ini_get_section_list(rules->rules_obj, &num_sections, &ret);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    rules->rules = calloc(num_sections + 1, sizeof(struct ini_rule));
+    if (rules->rules == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    /* Only sections that begin with a prefix "rule/"
+     * are rules. */
+    for (i = 0; i < num_sections; i++) {
+        if (strncmp(sections[i], "rule/", sizeof("rule/") - 1)) {
+            continue;
+        }
+
+        rules->rules[rules->count].name = strdup(sections[i]);
+        if (rules->rules[rules->count].name == NULL) {
+            ret = ENOMEM;
+            goto done;
+        }
+
+        rules->count++;
+        ret = compile_rule(&rules->rules[rules->count - 1],
+                           rules->rules_obj, extra_validators);
+        if (ret != EOK) {
+            goto done;
+        }
+    }
+
+    *_rules = rules;
+    rules = NULL;
+    ret = EOK;
+done:
+    ini_free_section_list(sections);
+    ini_rules_destroy_compiled(rules);
+
+    TRACE_FLOW_EXIT();
+    return ret;
+}
+
+/* Check one compiled rule */
+static int check_compiled_rule(struct ini_cfgrules *rules,
+                               struct ini_rule *rule,
+                               struct ini_cfgobj *config_obj,
+                               struct ini_errobj *errobj)
+{
+    struct ini_errobj *localerr = NULL;
+    int ret;
+
+    struct ini_errmsg *msg;
+
+    if (rule->type == INI_RULE_REPORT) {
+        /* The report is only read so the rules can be
+         * checked from several threads */
+        for (msg = rule->report->first_msg; msg != NULL; msg = msg->next) {
+            ret = ini_errobj_add_msg(errobj, "%s", msg->str);
+            if (ret != EOK) {
+                return ret;
+            }
+        }
+        return EOK;
+    }
+
+    /* Do not pass global errobj to validators, they
+     * could corrupt it. Create local one for each
+     * validator. */
+    ret = ini_errobj_create(&localerr);
+    if (ret != EOK) {
+        return ret;
+    }
+
+    switch (rule->type) {
+    case INI_RULE_SECTIONS:
+        ret = allowed_sections_check(rule->names, config_obj, localerr);
+        break;
+    case INI_RULE_OPTIONS:
+        ret = allowed_options_check(rule->names, config_obj, localerr);
+        break;
+    default:
+        ret = rule->func(rule->name, rules->rules_obj,
+                         config_obj, localerr, NULL);
+        break;
+    }
+
+    ret = rules_report(errobj, rule->name, ret, localerr);
+    ini_errobj_destroy(&localerr);
+    return ret;
+}
+
+/* Move all messages of the other errobj to the end of errobj */
+static void errobj_append(struct ini_errobj *errobj,
+                          struct ini_errobj *other)
+{
+    if (other->count == 0) {
+        return;
+    }
+
+    if (errobj->count == 0) {
+        errobj->first_msg = other->first_msg;
+        errobj->cur_msg = other->first_msg;
+    } else {
+        errobj->last_msg->next = other->first_msg;
+    }
+    errobj->last_msg = other->last_msg;
+    errobj->count += other->count;
+
+    other->first_msg = NULL;
+    other->last_msg = NULL;
+    other->cur_msg = NULL;
+    other->count = 0;
+}
+
+#ifdef HAVE_PTHREAD
+/* Checking thread - takes the next unchecked rule until none is left */
+static void *ini_rules_worker(void *data)
+{
+    struct ini_rules_pool *pool = (struct ini_rules_pool *)data;
+    size_t i;
+
+    TRACE_FLOW_ENTRY();
+
+    for (;;) {
+        pthread_mutex_lock(&(pool->lock));
+        i = pool->next;
+        if (i < pool->rules->count) pool->next++;
+        pthread_mutex_unlock(&(pool->lock));
+
+        if (i >= pool->rules->count) break;
+
+        pool->errors[i] = check_compiled_rule(pool->rules,
+                                              &pool->rules->rules[i],
+                                              pool->config_obj,
+                                              pool->results[i]);
+    }
+
+    TRACE_FLOW_EXIT();
+    return NULL;
+}
+#endif
+
+/* Check the rules using a pool of threads.
+ * Every rule collects its messages separately and they are
+ * added to errobj in the order of the rules afterwards,
+ * so the result is the same as if the rules were checked
+ * one by one. Sets checked to zero if the rules should
+ * be checked one by one instead.
+ */
+static int rules_check_parallel(struct ini_cfgrules *rules,
+                                struct ini_cfgobj *config_obj,
+                                struct ini_errobj *errobj,
+                                int *checked)
+{
+#ifdef HAVE_PTHREAD
+    struct ini_rules_pool pool;
+    pthread_t threads[INI_RULES_MAX_THREADS];
+    long cpus;
+    size_t num = 0;
+    size_t started = 0;
+    size_t i;
+    int ret = EOK;
+
+    TRACE_FLOW_ENTRY();
+
+    *checked = 0;
+
+    /* Use one thread less since the caller checks too */
+    cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpus > 1) num = (size_t)(cpus - 1);
+    if (num > INI_RULES_MAX_THREADS) num = INI_RULES_MAX_THREADS;
+    if (num + 1 > rules->count) num = rules->count ? rules->count - 1 : 0;
+    if (num == 0) {
+        TRACE_FLOW_EXIT();
+        return EOK;
+    }
+
+    pool.rules = rules;
+    pool.config_obj = config_obj;
+    pool.next = 0;
+    pool.errors = calloc(rules->count, sizeof(int));
+    pool.results = calloc(rules->count, sizeof(struct ini_errobj *));
+    if ((pool.errors == NULL) || (pool.results == NULL)) {
+        TRACE_ERROR_NUMBER("Failed to allocate results", ENOMEM);
+        ret = ENOMEM;
+        goto done;
+    }
+
+    for (i = 0; i < rules->count; i++) {
+        ret = ini_errobj_create(&pool.results[i]);
+        if (ret != EOK) {
+            goto done;
+        }
+    }
+
+    if (pthread_mutex_init(&(pool.lock), NULL)) {
+        TRACE_ERROR_STRING("Failed to initialize mutex", "");
+        goto done;
+    }
+
+    /* If a thread can't be started the rest do its share */
+    for (started = 0; started < num; started++) {
+        if (pthread_create(&threads[started], NULL,
+                           ini_rules_worker, &pool)) {
+            TRACE_ERROR_NUMBER("Failed to start thread", started);
+            break;
+        }
+    }
+
+    ini_rules_worker(&pool);
+
+    for (i = 0; i < started; i++) pthread_join(threads[i], NULL);
+
+    pthread_mutex_destroy(&(pool.lock));
+
+    /* Stop at the first rule that failed
+     * just like the check one by one does */
+    for (i = 0; i < rules->count; i++) {
+        errobj_append(errobj, pool.results[i]);
+        if (pool.errors[i] != EOK) {
+            ret = pool.errors[i];
+            break;
+        }
+    }
+
+    *checked = 1;
+
+done:
+    if (pool.results != NULL) {
+        for (i = 0; i < rules->count; i++) {
+            ini_errobj_destroy(&pool.results[i]);
+        }
+        free(pool.results);
+    }
+    free(pool.errors);
+
+    TRACE_FLOW_EXIT();
+    return ret;
+#else
+    TRACE_FLOW_ENTRY();
+    TRACE_INFO_STRING("Threads are not supported", "");
+    *checked = 0;
+    TRACE_FLOW_EXIT();
+    return EOK;
+#endif
+}
+
+/* Check configuration using the compiled rules */
+int ini_rules_check_compiled(struct ini_cfgrules *rules,
+                             struct ini_cfgobj *config_obj,
+                             uint32_t flags,
+                             struct ini_errobj *errobj)
+{
+    int checked = 0;
+    int ret;
+    size_t i;
+
+    if (rules == NULL || config_obj == NULL || errobj == NULL) {
+        return EINVAL;
+    }
+
+    TRACE_FLOW_ENTRY();
+
+    if (flags & INI_RULES_PARALLEL) {
+        ret = rules_check_parallel(rules, config_obj, errobj, &checked);
+        if (ret != EOK || checked) {
+            TRACE_FLOW_EXIT();
+            return ret;
+        }
+    }
+
+    for (i = 0; i < rules->count; i++) {
+        ret = check_compiled_rule(rules, &rules->rules[i],
+                                  config_obj, errobj);
+        if (ret != EOK) {
+            return ret;
+        }
+    }
+
+    TRACE_FLOW_EXIT();
+    return EOK;
+}
+
 int ini_errobj_create(struct ini_errobj **_errobj)
 {
     struct ini_errobj *new_errobj = NULL;
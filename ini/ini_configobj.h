@@ -348,6 +348,30 @@ enum ERR_PARSE {
 /** This defaults to MERGE, but can be used with OVERWRITE and PRESERVE **/
 #define INI_MS_DETECT    0x0400
 
+/**
+ * @}
+ */
+
+/**
+ * @defgroup augflags Augmentation flags
+ *
+ * Flags that can be combined with the merge flags
+ * passed to \ref ini_config_augment() to control
+ * how the snippets are processed.
+ *
+ * @{
+ */
+/** @brief Parse snippets concurrently
+ *
+ * Snippets are read and parsed in parallel on a small
+ * pool of threads bounded by the number of processors.
+ * They are still merged one by one in the sorted order
+ * so the result is the same as without the flag.
+ * If the library is built without thread support
+ * the flag is ignored.
+ */
+#define INI_AUG_PARALLEL 0x10000
+
 /**
  * @}
  */
@@ -374,6 +398,26 @@ enum ERR_PARSE {
 #define INI_PARSE_NO_C_COMMENTS    0x0008
 /** @brief Skip lines that are not KVPs */
 #define INI_PARSE_IGNORE_NON_KVP    0x0010
+/**
+ * @brief Allocate values from an arena
+ *
+ * Value objects and their lines are allocated from
+ * large blocks owned by the configuration object and
+ * released all at once when it is destroyed.
+ * Saves time and memory when parsing big files.
+ * Lines of the values modified later are kept on the heap.
+ */
+#define INI_PARSE_ARENA            0x0020
+/**
+ * @brief Keep only the values
+ *
+ * Comments are dropped and the lines of the folded
+ * values are joined without keeping the original layout.
+ * Use it when the configuration is only read.
+ * Configuration parsed in this mode can't be serialized,
+ * saved or cached, such attempts fail with ENOTSUP.
+ */
+#define INI_PARSE_LEAN             0x0040
 
 /**
  * @}
@@ -404,6 +448,21 @@ enum INI_GET {
     INI_GET_LAST_VALUE   /**< Look for the last value in the section */
 };
 
+/** @brief Search state owned by the caller.
+ *
+ * The structure keeps the position of the search
+ * performed by \ref ini_get_config_valueobj_r().
+ * Each thread should use its own cursor.
+ * The members are internal and should not be used
+ * directly. The cursor does not need to be initialized
+ * before the search in \ref INI_GET_FIRST_VALUE or
+ * \ref INI_GET_LAST_VALUE mode.
+ */
+struct ini_cursor {
+    const void *key; /**< Key that is being searched. */
+    uint32_t pos;    /**< Position of the next value of the key. */
+};
+
 /**
  * @}
  */
@@ -462,6 +521,12 @@ enum augmode {
 
 struct ini_cfgobj;
 struct ini_cfgfile;
+struct ini_augment_ctx;
+struct ini_reload;
+struct ini_watch;
+struct ini_cfghandle;
+struct ini_cfgsnapshot;
+struct ini_cfgrules;
 
 /** @brief Structure that holds error number and
  *  line number for the encountered error.
@@ -577,6 +642,56 @@ int ini_config_file_from_mem(void *data_buf,
                              uint32_t data_len,
                              struct ini_cfgfile **file_ctx);
 
+/**
+ * @brief Function that gives the borrowed memory back.
+ *
+ * Called by \ref ini_config_file_destroy for the memory
+ * passed to \ref ini_config_file_from_mem_borrow.
+ */
+typedef void (ini_mem_release_func)(void *data_buf,
+                                    void *release_data);
+
+/**
+ * @brief Create a configuration file object over memory buffer
+ *         without copying it.
+ *
+ * Same as \ref ini_config_file_from_mem but the configuration
+ * is parsed directly from the caller's memory instead of
+ * a private copy of it.
+ * The memory must not be changed or freed until
+ * the file object is destroyed. If the release callback
+ * is provided it is called when the file object
+ * is destroyed so the caller can release the memory
+ * or drop its reference to it.
+ * If the function fails the callback is not called
+ * and the memory still belongs to the caller.
+ *
+ * Only UTF-8 data is read in place. Data in other
+ * encodings is converted into a private buffer
+ * as \ref ini_config_file_from_mem does.
+ * The values of the parsed configuration never
+ * point to the memory so the configuration object
+ * can outlive the file object.
+ *
+ * @param[in]  data_buf         In memory configuration data.
+ *                              Does not need to be NULL terminated.
+ * @param[in]  data_len         Length of memory data.
+ * @param[in]  release          Function to call when the memory
+ *                              is not needed. Can be NULL.
+ * @param[in]  release_data     Data passed to the release function.
+ * @param[out] file_ctx         Configuration file object.
+ *
+ * @return 0 - Success.
+ * @return EINVAL - Invalid parameter.
+ * @return EILSEQ - Data is not valid UTF-8.
+ * @return ENOMEM - No memory.
+ */
+int ini_config_file_from_mem_borrow(void *data_buf,
+                                    uint32_t data_len,
+                                    ini_mem_release_func *release,
+                                    void *release_data,
+                                    struct ini_cfgfile **file_ctx);
+
 /**
  * @brief Close configuration file after parsing
  *
@@ -717,6 +832,10 @@ int ini_config_save(struct ini_cfgfile *file_ctx,
  * from the existing context. The rest of the context will be reinitialized.
  * Configuration will be serialized and saved in the file using encoding
  * specified by BOM type. The BOM prefix will also be added if needed.
+ * The configuration is written into a temporary file in the same
+ * directory that then replaces the target, so if saving fails
+ * the old file is left as it was. If the target is a symbolic link
+ * the file it points to is replaced.
  * After saving the file the function initializes the context and reads the
  * file back. At this moment the file context is ready for the parsing
  * again.
@@ -911,17 +1030,19 @@ int ini_config_access_check(struct ini_cfgfile *file_ctx,
  * - time stamp
  * - device ID
  * - i-node
+ * - size
+ * - hash of the contents that were read
  *
  * Function can be used to check if the file
  * has changed since last time the it was read.
  *
  * <i> Note:</i> If the file was deleted and quickly
  * re-created the kernel seems to restore the same i-node.
- * The stat structure keeps time granularity of seconds.
- * As a result if the file is quickly recreated
- * with the same contents like in the unit test the check
- * would assume that file did not change.
- * This is why the unit test has a one second delay.
+ * Time stamps are compared with nanosecond precision
+ * where the platform provides it and the contents
+ * are compared as well, so a change is detected
+ * even on file systems with coarse time stamps
+ * unless the file is recreated with the same contents.
  *
  * @param[in]  file_ctx1        First configuration file object.
  * @param[in]  file_ctx2        Second configuration file object.
@@ -968,6 +1089,114 @@ int ini_config_parse(struct ini_cfgfile *file_ctx,
                      uint32_t parse_flags,
                      struct ini_cfgobj *ini_config);
 
+/**
+ * @brief Callbacks of the streaming parser
+ *
+ * Any of the callbacks can be NULL.
+ * Strings are owned by the parser and are valid
+ * only until the callback returns. They are
+ * NUL terminated but may contain embedded NULs,
+ * so use the lengths.
+ * A non zero value returned by a callback stops
+ * parsing and is returned by
+ * \ref ini_config_parse_stream().
+ */
+struct ini_parse_cb {
+    /** Section with the given name starts */
+    int (*section)(const char *name,
+                   uint32_t name_len,
+                   uint32_t line,
+                   void *data);
+    /** Key and its value, folded lines are joined */
+    int (*value)(const char *key,
+                 uint32_t key_len,
+                 const char *value,
+                 uint32_t value_len,
+                 uint32_t line,
+                 void *data);
+    /** One comment or empty line */
+    int (*comment)(const char *text,
+                   uint32_t text_len,
+                   uint32_t line,
+                   void *data);
+    /** Parsing error or warning, see \ref errorlevel */
+    int (*error)(uint32_t line,
+                 int error,
+                 int warning,
+                 void *data);
+};
+
+/**
+ * @brief Parse the file without building a configuration object
+ *
+ * Function runs the same parser as \ref ini_config_parse()
+ * but instead of building a configuration object it reports
+ * sections, values and comments to the callbacks in the
+ * order they appear in the file.
+ * The file object holds the whole decoded file so memory
+ * still grows with the size of the file, use
+ * \ref ini_config_parse_stream_file() to parse large files
+ * in constant memory. Duplicate sections and keys are reported
+ * as they are, so there are no collision flags.
+ * Flag \ref INI_PARSE_LEAN suppresses the comment callback,
+ * \ref INI_PARSE_ARENA has no effect.
+ *
+ * @param[in]  file_ctx         Configuration file object.
+ * @param[in]  error_level      Flags that control actions
+ *                              in case of parsing error.
+ *                              See \ref errorlevel.
+ * @param[in]  parse_flags      Flags that control parsing process.
+ *                              See \ref parseflags.
+ * @param[in]  cb               Callbacks.
+ * @param[in]  cb_data          Data passed to the callbacks.
+ *
+ * @return 0 - Success.
+ * @return EINVAL - Invalid parameter.
+ * @return ENOMEM - No memory.
+ * @return EIO - Parsing error.
+ * @return EILSEQ - Parsing warning.
+ * @return Any value returned by a callback.
+ */
+int ini_config_parse_stream(struct ini_cfgfile *file_ctx,
+                            int error_level,
+                            uint32_t parse_flags,
+                            const struct ini_parse_cb *cb,
+                            void *cb_data);
+
+/**
+ * @brief Parse the file by name without reading it into memory
+ *
+ * Function works like \ref ini_config_parse_stream()
+ * but reads the file and converts it to UTF-8 one buffer
+ * at a time, so memory does not depend on the size of the file.
+ * On platforms without fopencookie() the whole file is read
+ * as \ref ini_config_file_open() does.
+ *
+ * @param[in]  filename         Name of the file.
+ * @param[in]  error_level      Flags that control actions
+ *                              in case of parsing error.
+ *                              See \ref errorlevel.
+ * @param[in]  parse_flags      Flags that control parsing process.
+ *                              See \ref parseflags.
+ * @param[in]  cb               Callbacks.
+ * @param[in]  cb_data          Data passed to the callbacks.
+ *
+ * @return 0 - Success.
+ * @return EINVAL - Invalid parameter or a character
+ *                  sequence is cut at the end of the file.
+ * @return ENOMEM - No memory.
+ * @return EIO - Parsing error.
+ * @return EILSEQ - Parsing warning or the file
+ *                  is not valid in its encoding.
+ * @return Any value returned by a callback.
+ * @return Errors returned by fopen().
+ */
+int ini_config_parse_stream_file(const char *filename,
+                                 int error_level,
+                                 uint32_t parse_flags,
+                                 const struct ini_parse_cb *cb,
+                                 void *cb_data);
+
 /**
  * @brief Create a copy of the configuration object
  *
@@ -1015,6 +1244,38 @@ int ini_config_merge(struct ini_cfgobj *first,
                      uint32_t collision_flags,
                      struct ini_cfgobj **result);
 
+/**
+ * @brief Merge configuration object into another one
+ *
+ * Function merges the second configuration object
+ * into the first one without creating a new object.
+ * Only the sections of the first object that
+ * are affected by the merge are copied, so merging
+ * a small object into a large one is cheap.
+ * If the merge fails the first object is left
+ * exactly as it was before the call.
+ * The same collision flags rules apply as for
+ * \ref ini_config_merge "ini_config_merge()".
+ *
+ * @param[in]  first            A base object
+ *                              the other object will
+ *                              be merged into.
+ * @param[in]  second           The object that will
+ *                              be merged to the first one.
+ * @param[in]  collision_flags  Flags that control handling
+ *                              of the duplicate sections or keys.
+ *                              See \ref collisionflags.
+ *
+ * @return 0 - Success.
+ * @return EEXIST - Duplicates found in detect mode.
+ *                  The merge is still performed.
+ * @return EINVAL - Invalid parameter.
+ * @return ENOMEM - No memory.
+ */
+int ini_config_merge_into(struct ini_cfgobj *first,
+                          struct ini_cfgobj *second,
+                          uint32_t collision_flags);
+
 
 /**
  * @brief Augment configuration
@@ -1066,6 +1327,7 @@ int ini_config_merge(struct ini_cfgobj *first,
  *                              a specific section might be treated as
  *                              an error.
  *                              See \ref mergesec.
+ *                              Can be combined with \ref augflags.
  * @param[out] result_cfg       A new configuration object,
  *                              the result of the merge.
  * @param[out] error_list       List of strings that
@@ -1096,6 +1358,428 @@ int ini_config_augment(struct ini_cfgobj *base_cfg,
                        struct ref_array **error_list,
                        struct ref_array **success_list);
 
+/**
+ * @brief Prepare context for repeated augmentation
+ *
+ * Compiles the file name and section patterns once so
+ * that they can be reused by \ref ini_config_augment_ctx()
+ * every time the configuration is reloaded.
+ * The patterns have the same meaning as the patterns
+ * and sections arguments of \ref ini_config_augment().
+ * Patterns that fail to compile are reported in the
+ * error list of every augmentation that uses the context.
+ * The context is not modified by the augmentation.
+ *
+ * @param[in]  patterns         List of regular expressions
+ *                              that the name of a snippet file
+ *                              has to match to be considered
+ *                              for merge.
+ * @param[in]  sections         List of regular expressions
+ *                              that the section names in the snippet
+ *                              should match.
+ * @param[out] ctx              Prepared context.
+ *
+ * @return 0 - Success.
+ * @return EINVAL - Invalid parameter.
+ * @return ENOMEM - No memory.
+ */
+int ini_augment_ctx_create(const char *patterns[],
+                           const char *sections[],
+                           struct ini_augment_ctx **ctx);
+
+/**
+ * @brief Destroy augmentation context
+ *
+ * @param[in] ctx               Context to free.
+ */
+void ini_augment_ctx_destroy(struct ini_augment_ctx *ctx);
+
+/**
+ * @brief Augment configuration using prepared context
+ *
+ * Same as \ref ini_config_augment() but uses patterns
+ * prepared by \ref ini_augment_ctx_create().
+ *
+ * @param[in]  base_cfg         A configuration object
+ *                              that will be augmented.
+ * @param[in]  path             Path to a directory where
+ *                              configuration snippets
+ *                              will be read from.
+ * @param[in]  ctx              Prepared patterns.
+ * @param[in]  check_perm       Pointer to structure that
+ *                              holds criteria for the
+ *                              access check.
+ * @param[in]  error_level      Flags that control actions
+ *                              in case of parsing error in a snippet file.
+ * @param[in]  collision_flags  These flags control how the potential
+ *                              collisions between keys and sections
+ *                              within the snippet file will be handled.
+ *                              See \ref collisionflags.
+ * @param[in]  parse_flags      Flags that control parsing process.
+ *                              See \ref parseflags.
+ * @param[in]  merge_flags      Flags that control handling
+ *                              of the duplicate sections or keys
+ *                              during merging of the snippets.
+ *                              See \ref mergesec and \ref augflags.
+ * @param[out] result_cfg       A new configuration object,
+ *                              the result of the merge.
+ * @param[out] error_list       List of strings that
+ *                              contains all encountered
+ *                              errors. Can be NULL.
+ * @param[out] success_list     List of strings that
+ *                              contains file names of snippets that were
+ *                              successfully merged. Can be NULL.
+ *
+ * @return 0 - Success.
+ * @return EINVAL - Invalid parameter.
+ * @return ENOMEM - No memory.
+ */
+int ini_config_augment_ctx(struct ini_cfgobj *base_cfg,
+                           const char *path,
+                           struct ini_augment_ctx *ctx,
+                           struct access_check *check_perm,
+                           int error_level,
+                           uint32_t collision_flags,
+                           uint32_t parse_flags,
+                           uint32_t merge_flags,
+                           struct ini_cfgobj **result_cfg,
+                           struct ref_array **error_list,
+                           struct ref_array **success_list);
+
+/**
+ * @brief Prepare incremental reload
+ *
+ * Creates the state that \ref ini_config_reload() uses
+ * to remember which files make up the configuration,
+ * their metadata, the hash of their contents and the
+ * result of parsing each of them.
+ *
+ * @param[in]  path             Main configuration file.
+ * @param[in]  snip_dir         Directory with the snippets.
+ *                              Can be NULL if there are none.
+ * @param[in]  ctx              Patterns that snippet names and
+ *                              sections should match.
+ *                              See \ref ini_augment_ctx_create().
+ *                              Can be NULL to accept all.
+ *                              The context must stay around until
+ *                              the reload state is destroyed.
+ * @param[in]  check_perm       Access check for snippets.
+ *                              Can be NULL.
+ * @param[in]  error_level      Flags that control actions
+ *                              in case of parsing error.
+ * @param[in]  collision_flags  Collision flags used for parsing.
+ *                              See \ref collisionflags.
+ * @param[in]  parse_flags      Flags that control parsing process.
+ *                              See \ref parseflags.
+ * @param[in]  merge_flags      Flags that control merging
+ *                              of the snippets.
+ *                              See \ref mergesec.
+ * @param[out] reload           Reload state.
+ *
+ * @return 0 - Success.
+ * @return EINVAL - Invalid parameter.
+ * @return ENOMEM - No memory.
+ */
+int ini_reload_create(const char *path,
+                      const char *snip_dir,
+                      struct ini_augment_ctx *ctx,
+                      struct access_check *check_perm,
+                      int error_level,
+                      uint32_t collision_flags,
+                      uint32_t parse_flags,
+                      uint32_t merge_flags,
+                      struct ini_reload **reload);
+
+/**
+ * @brief Destroy reload state
+ *
+ * @param[in] reload            Reload state to free.
+ */
+void ini_reload_destroy(struct ini_reload *reload);
+
+/**
+ * @brief Reload changed configuration files
+ *
+ * Checks the main configuration file and the snippets
+ * for changes and parses only the files that changed.
+ * A file is considered unchanged if its device, i-node,
+ * size and modification time (with nanoseconds where
+ * available) are the same or if its contents hash
+ * to the same value as before.
+ *
+ * If anything changed the snippets are merged again
+ * and the sections whose keys, values or comments differ are
+ * replaced in the configuration object, new sections
+ * are added at the end and removed sections are deleted.
+ * Values of the sections that did not change stay
+ * where they are so the pointers to them remain valid.
+ *
+ * The first call populates an empty configuration object
+ * and reports all of its sections as changed.
+ *
+ * @param[in]  reload           Reload state.
+ * @param[in]  ini_config       Configuration object to update.
+ * @param[out] changed_sections List of the sections that were
+ *                              added, modified or removed.
+ *                              NULL if nothing changed.
+ *                              Free with \ref ini_free_section_list().
+ * @param[out] error_list       List of strings that
+ *                              contains all encountered
+ *                              errors. Can be NULL.
+ *
+ * @return 0 - Success.
+ * @return EINVAL - Invalid parameter.
+ * @return ENOMEM - No memory.
+ * @return Any error that occurred while opening or
+ *         parsing the main file or updating the
+ *         configuration object, in this case the
+ *         configuration object is not changed.
+ * @return Error of a snippet that was detected as a
+ *         duplicate or ignored, like
+ *         \ref ini_config_augment_ctx() does. This is
+ *         a warning, the configuration object is updated
+ *         and changed_sections is set.
+ */
+int ini_config_reload(struct ini_reload *reload,
+                      struct ini_cfgobj *ini_config,
+                      char ***changed_sections,
+                      struct ref_array **error_list);
+
+/**
+ * @brief Watcher callback
+ *
+ * Called from the watcher thread after the configuration
+ * files changed and were reloaded.
+ *
+ * @param[in] ini_config        New configuration object.
+ *                              The callback takes ownership
+ *                              of it and has to destroy it
+ *                              with \ref ini_config_destroy().
+ *                              NULL if the reload failed.
+ * @param[in] changed_sections  List of the sections that were
+ *                              added, modified or removed.
+ *                              Freed after the callback returns.
+ * @param[in] error_list        Parsing errors, can be NULL.
+ *                              Freed after the callback returns.
+ * @param[in] error             Result of the reload. If the
+ *                              configuration is not NULL it
+ *                              is a warning, see
+ *                              \ref ini_config_reload().
+ * @param[in] data              Data passed to
+ *                              \ref ini_watch_create().
+ */
+typedef void (*ini_watch_fn)(struct ini_cfgobj *ini_config,
+                             char **changed_sections,
+                             struct ref_array *error_list,
+                             int error,
+                             void *data);
+
+/**
+ * @brief Watch configuration files for changes
+ *
+ * Reads the configuration the same way as
+ * \ref ini_config_reload() and then starts a thread
+ * that uses inotify to watch the directory of the
+ * main file and the snippet directory. Replacing the
+ * file by renaming a new one over it is detected too.
+ * The snippet directory can be created, removed or
+ * replaced while the watcher runs.
+ *
+ * Changes are collected until no new event arrives
+ * for the debounce interval, or for at most ten
+ * intervals since the first change if the events keep
+ * coming, then the changed files are
+ * reloaded and, if any section changed, a copy of the new
+ * configuration is passed to the callback. The copy is
+ * never modified by the watcher so it can be published
+ * to other threads as is.
+ * A file that is written in place can be read before
+ * the writer is done, so a reload that fails is tried
+ * once more after the debounce interval and the error is
+ * passed to the callback only if the files read the same.
+ *
+ * The first arguments are the same as
+ * for \ref ini_reload_create().
+ *
+ * @param[in]  file_ctx         Main configuration file.
+ * @param[in]  snip_dir         Directory with the snippets.
+ *                              Can be NULL if there are none.
+ * @param[in]  ctx              Patterns for snippets and sections.
+ *                              Can be NULL.
+ * @param[in]  check_perm       Access check for snippets.
+ *                              Can be NULL.
+ * @param[in]  error_level      Flags that control actions
+ *                              in case of parsing error.
+ * @param[in]  collision_flags  Collision flags used for parsing.
+ * @param[in]  parse_flags      Flags that control parsing process.
+ * @param[in]  merge_flags      Flags that control merging
+ *                              of the snippets.
+ * @param[in]  debounce_ms      Quiet period in milliseconds.
+ * @param[in]  cb               Callback that receives
+ *                              the new configuration.
+ * @param[in]  cb_data          Data passed to the callback.
+ * @param[out] watch            Watcher.
+ *
+ * @return 0 - Success.
+ * @return EINVAL - Invalid parameter.
+ * @return ENOMEM - No memory.
+ * @return ENOSYS - Watching is not supported on this platform.
+ * @return Any error that occurred while reading
+ *         the configuration or setting up the watches.
+ */
+int ini_watch_create(struct ini_cfgfile *file_ctx,
+                     const char *snip_dir,
+                     struct ini_augment_ctx *ctx,
+                     struct access_check *check_perm,
+                     int error_level,
+                     uint32_t collision_flags,
+                     uint32_t parse_flags,
+                     uint32_t merge_flags,
+                     unsigned debounce_ms,
+                     ini_watch_fn cb,
+                     void *cb_data,
+                     struct ini_watch **watch);
+
+/**
+ * @brief Stop watching
+ *
+ * Stops the watcher thread and frees the watcher.
+ * The callback is not called after this function returns.
+ *
+ * @param[in] watch             Watcher to destroy.
+ */
+void ini_watch_destroy(struct ini_watch *watch);
+
+/**
+ * @brief Create a configuration handle
+ *
+ * A handle lets one thread publish new versions of
+ * the configuration while other threads keep reading
+ * the version they acquired. An old version is destroyed
+ * when the last reader releases it, so values taken from
+ * a snapshot stay valid until the snapshot is released.
+ *
+ * Objects published through the handle must not be
+ * modified afterwards.
+ *
+ * @param[in]  ini_config       Initial configuration.
+ *                              The handle takes ownership
+ *                              of it on success.
+ * @param[out] handle           New handle.
+ *
+ * @return 0 - Success.
+ * @return EINVAL - Invalid parameter.
+ * @return ENOMEM - No memory.
+ */
+int ini_config_handle_create(struct ini_cfgobj *ini_config,
+                             struct ini_cfghandle **handle);
+
+/**
+ * @brief Destroy the configuration handle
+ *
+ * Snapshots that are still acquired stay valid
+ * and are destroyed when they are released.
+ *
+ * @param[in] handle            Handle to destroy.
+ */
+void ini_config_handle_destroy(struct ini_cfghandle *handle);
+
+/**
+ * @brief Publish a new configuration
+ *
+ * Makes the configuration the current one and
+ * increments the version of the handle.
+ * Can be called from the \ref ini_watch_fn callback.
+ *
+ * The handle takes ownership of the configuration and
+ * destroys it when the last snapshot of it is released,
+ * so the caller must not use or publish it again.
+ * Publishing the current configuration is detected,
+ * publishing one that an older snapshot still holds
+ * is not and leads to a double free.
+ *
+ * @param[in] handle            Handle.
+ * @param[in] ini_config        New configuration.
+ *                              The handle takes ownership
+ *                              of it on success.
+ *
+ * @return 0 - Success.
+ * @return EINVAL - Invalid parameter or the configuration
+ *                  is the current one.
+ * @return ENOMEM - No memory.
+ */
+int ini_config_handle_publish(struct ini_cfghandle *handle,
+                              struct ini_cfgobj *ini_config);
+
+/**
+ * @brief Get the current version
+ *
+ * @param[in] handle            Handle.
+ *
+ * @return Version of the current configuration,
+ *         it starts with 1 and grows with every publish.
+ */
+uint64_t ini_config_handle_version(struct ini_cfghandle *handle);
+
+/**
+ * @brief Acquire the current configuration
+ *
+ * @param[in]  handle           Handle.
+ * @param[out] snapshot         Current snapshot.
+ *                              Release with
+ *                              \ref ini_config_snapshot_release().
+ *
+ * @return 0 - Success.
+ * @return EINVAL - Invalid parameter.
+ */
+int ini_config_snapshot_acquire(struct ini_cfghandle *handle,
+                                struct ini_cfgsnapshot **snapshot);
+
+/**
+ * @brief Make sure the snapshot is the current one
+ *
+ * Meant for the threads that keep their snapshot
+ * between requests. If nothing was published since
+ * the snapshot was acquired the function only reads
+ * the version of the handle. Otherwise it releases
+ * the snapshot and acquires the current one.
+ *
+ * @param[in]     handle        Handle.
+ * @param[in,out] snapshot      Snapshot to refresh.
+ *                              Can point to NULL.
+ *
+ * @return 0 - Success.
+ * @return EINVAL - Invalid parameter.
+ */
+int ini_config_snapshot_refresh(struct ini_cfghandle *handle,
+                                struct ini_cfgsnapshot **snapshot);
+
+/**
+ * @brief Release the snapshot
+ *
+ * @param[in] snapshot          Snapshot to release.
+ */
+void ini_config_snapshot_release(struct ini_cfgsnapshot *snapshot);
+
+/**
+ * @brief Get the configuration of the snapshot
+ *
+ * @param[in] snapshot          Snapshot.
+ *
+ * @return Configuration object. It must not be modified
+ *         and is valid until the snapshot is released.
+ */
+struct ini_cfgobj *ini_config_snapshot_get(struct ini_cfgsnapshot *snapshot);
+
+/**
+ * @brief Get the version of the snapshot
+ *
+ * @param[in] snapshot          Snapshot.
+ *
+ * @return Version of the snapshot.
+ */
+uint64_t ini_config_snapshot_version(struct ini_cfgsnapshot *snapshot);
+
 /**
  * @brief Set the folding boundary
  *
@@ -1125,10 +1809,80 @@ int ini_config_set_wrap(struct ini_cfgobj *ini_config,
  * @return 0 - Success.
  * @return EINVAL - Invalid parameter.
  * @return ENOMEM - No memory.
+ * @return ENOTSUP - Configuration was parsed with
+ *                   \ref INI_PARSE_LEAN.
  */
 int ini_config_serialize(struct ini_cfgobj *ini_config,
                          struct simplebuffer *sbobj);
 
+/**
+ * @brief Save configuration object into a cache file
+ *
+ * Stores the configuration object in a compact binary
+ * file that can be loaded with \ref ini_config_cache_load()
+ * much faster than the configuration files can be parsed.
+ * Together with the configuration the function records
+ * every file and directory the configuration was read from:
+ * the files parsed into it, the snippet files and the
+ * snippet directory of \ref ini_config_augment() and
+ * \ref ini_config_reload(), and the sources of the
+ * configurations merged into it.
+ * Device, inode, size, modification time with nanoseconds
+ * and the hash of the contents are taken when the source
+ * is read, so changes made between parsing and saving
+ * are detected when the cache is loaded.
+ * Configuration that was not read from files is saved
+ * without any sources and the cache never becomes stale.
+ *
+ * Comments are saved but the parsing errors are not.
+ * The cache file is written under a temporary name
+ * and then renamed so readers never see a partial file.
+ * The file is not portable between architectures.
+ *
+ * @param[in]  ini_config       Configuration object.
+ * @param[in]  cache_file       Path of the cache file.
+ *
+ * @return 0 - Success.
+ * @return EINVAL - Invalid parameter.
+ * @return ENOMEM - No memory.
+ * @return ENOTSUP - Configuration was parsed with
+ *                   \ref INI_PARSE_LEAN.
+ * @return Any error returned by file operations.
+ */
+int ini_config_cache_save(struct ini_cfgobj *ini_config,
+                          const char *cache_file);
+
+/**
+ * @brief Load configuration object from a cache file
+ *
+ * Maps the cache file created by \ref ini_config_cache_save()
+ * and builds the configuration object from it.
+ * Before that the function checks that none of the recorded
+ * sources changed. A file whose modification time changed
+ * is read again and is still accepted if its contents
+ * are the same. If the function fails the caller should
+ * parse the configuration files as usual and save
+ * a new cache.
+ *
+ * The lines of the values are not copied, they are used
+ * in place and the file stays mapped until the configuration
+ * object is destroyed. Replace the cache file only with
+ * \ref ini_config_cache_save() or another rename, truncating
+ * it in place breaks the loaded configurations.
+ *
+ * @param[in]  cache_file       Path of the cache file.
+ * @param[out] ini_config       New configuration object.
+ *
+ * @return 0 - Success.
+ * @return EINVAL - Invalid parameter.
+ * @return ENOENT - There is no cache file.
+ * @return ESTALE - Some of the sources changed.
+ * @return EIO - Cache file is damaged or has wrong format.
+ * @return ENOMEM - No memory.
+ */
+int ini_config_cache_load(const char *cache_file,
+                          struct ini_cfgobj **ini_config);
+
 
 /* Functions that add, modify or delete sections and values in
  * the configuration object can be found in section \ref ini_mod.
@@ -1268,6 +2022,43 @@ int ini_get_config_valueobj(const char *section,
                             int mode,
                             struct value_obj **vo);
 
+/**
+ * @brief Retrieve a value object using caller provided search state.
+ *
+ * Same as \ref ini_get_config_valueobj() but the state
+ * of the search is kept in the cursor provided by the caller
+ * and not inside the configuration object.
+ * The function does not modify the configuration object
+ * so several threads can search the same configuration
+ * at the same time without locking as long as no thread
+ * modifies it.
+ *
+ * To get all values of the key start the search
+ * with \ref INI_GET_FIRST_VALUE mode and then continue it
+ * with \ref INI_GET_NEXT_VALUE mode passing the same cursor.
+ *
+ * @param[in]  section          Section name.
+ *                              If NULL assumed default.
+ * @param[in]  name             Attribute name to find.
+ * @param[in]  ini_config       Configuration object to search.
+ * @param[in]  mode             See \ref searchmode "search mode"
+ *                              section for more info.
+ * @param[in,out] cursor        Search state.
+ * @param[out] vo               Value object.
+ *                              Will be set to NULL if
+ *                              element with the given name
+ *                              is not found.
+ * @return 0 - Success.
+ * @return EINVAL - Invalid parameter.
+ *
+ */
+int ini_get_config_valueobj_r(const char *section,
+                              const char *name,
+                              struct ini_cfgobj *ini_config,
+                              int mode,
+                              struct ini_cursor *cursor,
+                              struct value_obj **vo);
+
 
 
 /**
@@ -2037,6 +2828,124 @@ double *ini_get_double_config_array(struct value_obj *vo,
                                     int *size,
                                     int *error);
 
+/**
+ * @brief Get the value as an array of strings without copying it.
+ *
+ * The function splits the value the same way as
+ * \ref ini_get_string_config_array() does but the
+ * array is kept in the value object and is reused
+ * by the next calls with the same separators.
+ * Nothing is allocated once the array is cached,
+ * so the function is suitable for the values
+ * that are read over and over again.
+ *
+ * The array belongs to the value object. It must not be
+ * modified or freed. It stays valid until the value is
+ * modified or the configuration object is destroyed.
+ * The array is always NULL terminated.
+ *
+ * @param[in]  vo               Value object to interpret.
+ *                              It must be retrieved using
+ *                              \ref ini_get_config_valueobj().
+ * @param[in]  sep              String consisting of separator
+ *                              symbols. If NULL, comma is assumed.
+ * @param[out] size             Variable that optionally receives
+ *                              the size of the array.
+ * @param[out] error            Variable will get the value
+ *                              of the error code if
+ *                              error happened.
+ *                              Can be NULL. In this case
+ *                              function does not set
+ *                              the code.
+ *                              Codes:
+ *                              - 0 - Success.
+ *                              - EINVAL - Argument is invalid.
+ *                              - ENOMEM - No memory.
+ *
+ * @return Array of strings.
+ * In case of failure the function returns NULL.
+ */
+const char * const *ini_get_string_config_array_view(struct value_obj *vo,
+                                                     const char *sep,
+                                                     int *size,
+                                                     int *error);
+
+/**
+ * @brief Get the value as an array of long values without copying it.
+ *
+ * The function converts the value the same way as
+ * \ref ini_get_long_config_array() does but the
+ * array is kept in the value object and is reused
+ * by the next calls. The conversion error is
+ * remembered as well.
+ *
+ * The array belongs to the value object. It must not be
+ * modified or freed. It stays valid until the value is
+ * modified or the configuration object is destroyed.
+ *
+ * @param[in]  vo               Value object to interpret.
+ *                              It must be retrieved using
+ *                              \ref ini_get_config_valueobj().
+ * @param[out] size             Variable that receives
+ *                              the size of the array.
+ * @param[out] error            Variable will get the value
+ *                              of the error code if
+ *                              error happened.
+ *                              Can be NULL. In this case
+ *                              function does not set
+ *                              the code.
+ *                              Codes:
+ *                              - 0 - Success.
+ *                              - EINVAL - Argument is invalid.
+ *                              - EIO - Conversion failed.
+ *                              - ERANGE - Value is out of range.
+ *                              - ENOMEM - No memory.
+ *
+ * @return Array of long values.
+ * In case of failure the function returns NULL.
+ */
+const long *ini_get_long_config_array_view(struct value_obj *vo,
+                                           int *size,
+                                           int *error);
+
+/**
+ * @brief Get the value as an array of floating point
+ * values without copying it.
+ *
+ * The function converts the value the same way as
+ * \ref ini_get_double_config_array() does but the
+ * array is kept in the value object and is reused
+ * by the next calls. The decimal point of the locale
+ * that is in effect during the first call is used.
+ *
+ * The array belongs to the value object. It must not be
+ * modified or freed. It stays valid until the value is
+ * modified or the configuration object is destroyed.
+ *
+ * @param[in]  vo               Value object to interpret.
+ *                              It must be retrieved using
+ *                              \ref ini_get_config_valueobj().
+ * @param[out] size             Variable that receives
+ *                              the size of the array.
+ * @param[out] error            Variable will get the value
+ *                              of the error code if
+ *                              error happened.
+ *                              Can be NULL. In this case
+ *                              function does not set
+ *                              the code.
+ *                              Codes:
+ *                              - 0 - Success.
+ *                              - EINVAL - Argument is invalid.
+ *                              - EIO - Conversion failed.
+ *                              - ENOMEM - No memory.
+ *
+ * @return Array of floating point values.
+ * In case of failure the function returns NULL.
+ */
+const double *ini_get_double_config_array_view(struct value_obj *vo,
+                                               int *size,
+                                               int *error);
+
 /**
  * @brief Free array of string values.
  *
@@ -2246,6 +3155,172 @@ int ini_rules_check(struct ini_cfgobj *rules_obj,
  */
 void ini_rules_destroy(struct ini_cfgobj *ini_config);
 
+/**
+ * @brief Compile the rules
+ *
+ * This function prepares the rules previously loaded by
+ * \ref ini_rules_read_from_file so that they can be
+ * used to check many configurations.
+ * The validators are resolved once, the regular
+ * expressions of the built-in validators are compiled
+ * once and the allowed names are put into hash tables.
+ * The compiled rules keep their own copy of the rules
+ * so the rules object can be destroyed afterwards.
+ *
+ * Problems of the rules themselves, like an unknown
+ * validator or an invalid regular expression, do not
+ * fail the compilation. They are reported by every
+ * \ref ini_rules_check_compiled call with the same messages
+ * \ref ini_rules_check would produce.
+ *
+ * The compiled rules are not modified by the checks.
+ * Several threads can check configurations using
+ * the same compiled rules as long as the external
+ * validators allow it.
+ *
+ * @param[in] rules_obj            config object representing the rules
+ * @param[in] extra_validators     NULL terminated array of external
+ *                                 validators. Can be NULL if no external
+ *                                 validators are used. The array
+ *                                 is not used after the call but the
+ *                                 validator functions must stay valid
+ *                                 while the compiled rules are used.
+ * @param[out] rules               compiled rules. Free with
+ *                                 \ref ini_rules_destroy_compiled.
+ *
+ * @return Zero on success. Non zero value on error.
+ */
+int ini_rules_compile(struct ini_cfgobj *rules_obj,
+                      struct ini_validator **extra_validators,
+                      struct ini_cfgrules **rules);
+
+/**
+ * @brief Check the rules concurrently
+ *
+ * The rules are checked in parallel on a small pool
+ * of threads bounded by the number of processors.
+ * The configuration must not be modified during the check.
+ * The messages of every rule are collected separately
+ * and added to the errobj in the order of the rules
+ * so the result is the same as without the flag.
+ * External validators are called from several threads
+ * at the same time so they must be thread safe, for example
+ * they should search the configuration and the rules using
+ * \ref ini_get_config_valueobj_r() and not
+ * \ref ini_get_config_valueobj().
+ * If the library is built without thread support
+ * the flag is ignored.
+ */
+#define INI_RULES_PARALLEL 0x0001
+
+/**
+ * @brief Check configuration file using compiled rules
+ *
+ * Same as \ref ini_rules_check but uses the rules
+ * prepared by \ref ini_rules_compile.
+ *
+ * @param[in] rules                compiled rules
+ * @param[in] config_obj           config object representing the
+ *                                 configuration
+ * @param[in] flags                Zero or \ref INI_RULES_PARALLEL.
+ * @param[in] errobj               errobj to store generated errors
+ *                                 from validators.
+ *
+ * @return Zero on success. Non zero value on error.
+ */
+int ini_rules_check_compiled(struct ini_cfgrules *rules,
+                             struct ini_cfgobj *config_obj,
+                             uint32_t flags,
+                             struct ini_errobj *errobj);
+
+/**
+ * @brief Free the compiled rules
+ *
+ * @param[in] rules                compiled rules
+ */
+void ini_rules_destroy_compiled(struct ini_cfgrules *rules);
+
+/** @brief Types of the fields that can be filled
+ * by \ref ini_config_bind.
+ */
+enum ini_bind_type {
+    INI_BIND_INT,          /**< int */
+    INI_BIND_UNSIGNED,     /**< unsigned */
+    INI_BIND_LONG,         /**< long */
+    INI_BIND_ULONG,        /**< unsigned long */
+    INI_BIND_INT32,        /**< int32_t */
+    INI_BIND_UINT32,       /**< uint32_t */
+    INI_BIND_INT64,        /**< int64_t */
+    INI_BIND_UINT64,       /**< uint64_t */
+    INI_BIND_DOUBLE,       /**< double */
+    INI_BIND_BOOL,         /**< unsigned char */
+    INI_BIND_STRING,       /**< char *, allocated, free with free() */
+    INI_BIND_CONST_STRING  /**< const char *, points into
+                            * the configuration object */
+};
+
+/** @brief Description of one option that should
+ * be stored into a field of the caller's structure.
+ *
+ * The array of descriptions is terminated by
+ * an entry with NULL name.
+ * Entries for the same section should be kept
+ * together, the section is looked up only once
+ * for a group of entries.
+ */
+struct ini_binding {
+    const char *section;     /**< Section name.
+                              * If NULL assumed default. */
+    const char *name;        /**< Option name. */
+    enum ini_bind_type type; /**< Type of the field. */
+    size_t offset;           /**< Offset of the field
+                              * in the structure, use offsetof(). */
+    const char *def;         /**< Default value as string.
+                              * Converted the same way as the value
+                              * from the configuration.
+                              * If NULL the field is not changed
+                              * when option is missing. */
+};
+
+/**
+ * @brief Fill the structure with values of the options
+ *
+ * The function looks up every option described in the bindings
+ * array, converts its first value to the type of the field
+ * and stores it in the structure. If the option is missing
+ * the default is used. If the option can't be converted
+ * the default is used, the error is reported into errobj
+ * and the function returns EIO after processing all options.
+ *
+ * String fields of type \ref INI_BIND_STRING are allocated
+ * and should be freed by the caller. Old contents of the
+ * fields are overwritten without being freed.
+ *
+ * The function does not modify the configuration object
+ * and can be called from several threads.
+ *
+ * @param[in] ini_config       Configuration object.
+ * @param[in] bindings         Array of option descriptions
+ *                             terminated by an entry with
+ *                             NULL name.
+ * @param[in] strict           Fail the conversion if
+ *                             there are more characters
+ *                             after the number.
+ * @param[out] data            Structure to fill.
+ * @param[in] errobj           Container for conversion errors.
+ *                             Can be NULL.
+ *
+ * @return 0 - Success.
+ * @return EINVAL - Invalid parameter.
+ * @return EIO - Some values could not be converted.
+ * @return ENOMEM - No memory.
+ */
+int ini_config_bind(struct ini_cfgobj *ini_config,
+                    const struct ini_binding *bindings,
+                    int strict,
+                    void *data,
+                    struct ini_errobj *errobj);
+
 /**
  * @}
  */
@@ -28,6 +28,7 @@
 #include <stdlib.h>
 #include <iconv.h>
 #include <dirent.h>
+#include <limits.h>
 #include "trace.h"
 #include "ini_defines.h"
 #include "ini_configobj.h"
@@ -35,6 +36,8 @@
 #include "path_utils.h"
 
 #define ICONV_BUFFER    5000
+/* Portion of the configuration that is written at once */
+#define INI_SAVE_BUFFER 65536
 
 #define BOM4_SIZE 4
 #define BOM3_SIZE 3
@@ -71,6 +74,9 @@ void ini_config_file_destroy(struct ini_cfgfile *file_ctx)
         free(file_ctx->filename);
         simplebuffer_free(file_ctx->file_data);
         if(file_ctx->file) fclose(file_ctx->file);
+        /* Memory is given back after the stream over it is closed */
+        if (file_ctx->release) file_ctx->release(file_ctx->borrowed_buf,
+                                                 file_ctx->release_data);
         free(file_ctx);
     }
 
@@ -231,6 +237,155 @@ static int initialize_conv(unsigned char *read_buf,
     return error;
 }
 
+/* Check that the buffer is valid UTF-8.
+ * Returns EILSEQ for an invalid sequence and
+ * EINVAL for a sequence cut at the end of the buffer
+ * the same way iconv() does.
+ */
+static int validate_utf8(const unsigned char *buf, size_t len)
+{
+    size_t i = 0;
+    size_t need;
+    uint64_t chunk;
+    unsigned char c;
+
+    while (i < len) {
+        /* Skip ASCII eight bytes at a time */
+        while (i + sizeof(uint64_t) <= len) {
+            memcpy(&chunk, buf + i, sizeof(uint64_t));
+            if (chunk & 0x8080808080808080ULL) break;
+            i += sizeof(uint64_t);
+        }
+        if (i >= len) break;
+
+        c = buf[i];
+        if (c < 0x80) {
+            i++;
+            continue;
+        }
+
+        if ((c >= 0xC2) && (c <= 0xDF)) need = 1;
+        else if ((c >= 0xE0) && (c <= 0xEF)) need = 2;
+        else if ((c >= 0xF0) && (c <= 0xF4)) need = 3;
+        else return EILSEQ;
+
+        if (i + need >= len) {
+            /* Check what we have before reporting the cut */
+            for (i++; i < len; i++) {
+                if ((buf[i] & 0xC0) != 0x80) return EILSEQ;
+            }
+            return EINVAL;
+        }
+
+        /* Overlong forms, surrogates and values above U+10FFFF */
+        if (((c == 0xE0) && (buf[i + 1] < 0xA0)) ||
+            ((c == 0xED) && (buf[i + 1] > 0x9F)) ||
+            ((c == 0xF0) && (buf[i + 1] < 0x90)) ||
+            ((c == 0xF4) && (buf[i + 1] > 0x8F))) return EILSEQ;
+
+        for (i++; need; need--, i++) {
+            if ((buf[i] & 0xC0) != 0x80) return EILSEQ;
+        }
+    }
+
+    return EOK;
+}
+
+/* Data of the file, borrowed or read */
+static void *file_data_buf(struct ini_cfgfile *file_ctx)
+{
+    if (file_ctx->borrowed) return file_ctx->borrowed;
+    return simplebuffer_get_vbuf(file_ctx->file_data);
+}
+
+/* Length of the data of the file */
+static uint32_t file_data_len(struct ini_cfgfile *file_ctx)
+{
+    if (file_ctx->borrowed) return file_ctx->borrowed_len;
+    return simplebuffer_get_len(file_ctx->file_data);
+}
+
+/* Open the stream over the data that was read */
+static int common_file_open_data(struct ini_cfgfile *file_ctx)
+{
+    int error = EOK;
+
+    TRACE_FLOW_ENTRY();
+
+    TRACE_INFO_NUMBER("File len", file_data_len(file_ctx));
+    errno = 0;
+    file_ctx->file = fmemopen(file_data_buf(file_ctx),
+                              file_data_len(file_ctx),
+                              "r");
+    if (!(file_ctx->file)) {
+        error = errno;
+        TRACE_ERROR_NUMBER("Failed to open file", error);
+        return error;
+    }
+
+    TRACE_FLOW_EXIT();
+    return EOK;
+}
+
+/* UTF-8 needs no conversion, just read and validate it */
+static int common_file_utf8(FILE *file,
+                            struct ini_cfgfile *file_ctx,
+                            uint32_t size,
+                            char *read_buf,
+                            size_t read_cnt,
+                            size_t bom_shift)
+{
+    int error = EOK;
+    size_t total_read = read_cnt;
+
+    TRACE_FLOW_ENTRY();
+
+    /* Allocate the whole buffer at once */
+    error = simplebuffer_grow(file_ctx->file_data, size, size + 1);
+    if (error) {
+        TRACE_ERROR_NUMBER("Failed to allocate buffer", error);
+        return error;
+    }
+
+    error = simplebuffer_add_raw(file_ctx->file_data,
+                                 read_buf + bom_shift,
+                                 read_cnt - bom_shift,
+                                 ICONV_BUFFER);
+
+    while ((!error) && (total_read < size)) {
+        read_cnt = 0;
+        error = read_chunk(file,
+                           size - total_read,
+                           ICONV_BUFFER,
+                           read_buf,
+                           &read_cnt);
+        if ((error) || (read_cnt == 0)) break;
+
+        error = simplebuffer_add_raw(file_ctx->file_data,
+                                     read_buf,
+                                     read_cnt,
+                                     ICONV_BUFFER);
+        total_read += read_cnt;
+    }
+
+    if (error) {
+        TRACE_ERROR_NUMBER("Failed to read file", error);
+        return error;
+    }
+
+    error = validate_utf8(simplebuffer_get_buf(file_ctx->file_data),
+                          simplebuffer_get_len(file_ctx->file_data));
+    if (error) {
+        TRACE_ERROR_NUMBER("Invalid UTF-8", error);
+        return error;
+    }
+
+    error = common_file_open_data(file_ctx);
+
+    TRACE_FLOW_EXIT();
+    return error;
+}
+
 /* Internal conversion part */
 static int common_file_convert(FILE *file,
                                struct ini_cfgfile *file_ctx,
@@ -272,6 +427,21 @@ static int common_file_convert(FILE *file,
         to_convert = read_cnt + in_buffer;
         in_buffer = 0;
 
+        /* Only UTF-16 and UTF-32 files need the converter */
+        if (!initialized) {
+            ind = check_bom(INDEX_UTF8NOBOM,
+                            (unsigned char *)read_buf,
+                            read_cnt,
+                            &bom_shift);
+            if ((ind == INDEX_UTF8) || (ind == INDEX_UTF8NOBOM)) {
+                file_ctx->bom = ind;
+                error = common_file_utf8(file, file_ctx, size,
+                                         read_buf, read_cnt, bom_shift);
+                TRACE_FLOW_EXIT();
+                return error;
+            }
+        }
+
         /* Do initialization if needed */
         error = initialize_conv((unsigned char *)read_buf,
                                 read_cnt,
@@ -368,26 +538,28 @@ static int common_file_convert(FILE *file,
     iconv_close(conv);
 
     /* Open file */
-    TRACE_INFO_STRING("File data",
-                      (char *)simplebuffer_get_vbuf(file_ctx->file_data));
-    TRACE_INFO_NUMBER("File len",
-                      simplebuffer_get_len(file_ctx->file_data));
     TRACE_INFO_NUMBER("Size", size);
-    errno = 0;
-    file_ctx->file = fmemopen(simplebuffer_get_vbuf(file_ctx->file_data),
-                              simplebuffer_get_len(file_ctx->file_data),
-                              "r");
-    if (!(file_ctx->file)) {
-        error = errno;
-        TRACE_ERROR_NUMBER("Failed to open file", error);
-        return error;
-    }
+    error = common_file_open_data(file_ctx);
 
     TRACE_FLOW_EXIT();
-    return EOK;
+    return error;
 }
 
 
+/* Add data to the content hash (64-bit FNV-1a) */
+uint64_t ini_hash_data(uint64_t hash, const void *data, size_t len)
+{
+    const unsigned char *ptr = data;
+    size_t i;
+
+    for (i = 0; i < len; i++) {
+        hash ^= ptr[i];
+        hash *= 0x100000001b3ULL;
+    }
+
+    return hash;
+}
+
 /* Internal common initialization part */
 static int common_file_init(struct ini_cfgfile *file_ctx,
                             void *data_buf,
@@ -406,6 +578,9 @@ static int common_file_init(struct ini_cfgfile *file_ctx,
 
     if (data_buf) {
 
+        /* Memory has no stats */
+        memset(&(file_ctx->file_stats), 0, sizeof(struct stat));
+
         if(data_len) {
             internal_data = data_buf;
             internal_len = data_len;
@@ -483,12 +658,18 @@ static int common_file_init(struct ini_cfgfile *file_ctx,
 
     fclose(file);
 
-    /* Collect stats */
+    /* Remember what was read to detect changes */
+    file_ctx->content_hash = ini_hash_data(INI_HASH_INIT,
+                                           file_data_buf(file_ctx),
+                                           file_data_len(file_ctx));
+
+    /* Stats are always kept to record the source
+     * of the configuration but reported only if asked.
+     */
     if (file_ctx->metadata_flags & INI_META_STATS) {
         file_ctx->stats_read = 1;
     }
     else {
-        memset(&(file_ctx->file_stats), 0, sizeof(struct stat));
         file_ctx->stats_read = 0;
     }
 
@@ -496,6 +677,58 @@ static int common_file_init(struct ini_cfgfile *file_ctx,
     return EOK;
 }
 
+/* Initialization that reads UTF-8 data in place */
+static int borrow_file_init(struct ini_cfgfile *file_ctx,
+                            unsigned char *data_buf,
+                            uint32_t data_len)
+{
+    int error = EOK;
+    size_t bom_shift = 0;
+    enum index_utf_t ind;
+
+    TRACE_FLOW_ENTRY();
+
+    ind = check_bom(INDEX_UTF8NOBOM, data_buf, data_len, &bom_shift);
+
+    /* Other encodings need conversion and an empty
+     * buffer can't be opened so they are copied.
+     */
+    if (((ind != INDEX_UTF8) && (ind != INDEX_UTF8NOBOM)) ||
+        (data_len == bom_shift)) {
+        TRACE_INFO_NUMBER("Data has to be copied, encoding", ind);
+        error = common_file_init(file_ctx, data_buf, data_len);
+        TRACE_FLOW_EXIT();
+        return error;
+    }
+
+    error = validate_utf8(data_buf + bom_shift, data_len - bom_shift);
+    if (error) {
+        TRACE_ERROR_NUMBER("Invalid UTF-8", error);
+        return error;
+    }
+
+    file_ctx->bom = ind;
+    file_ctx->borrowed = data_buf + bom_shift;
+    file_ctx->borrowed_len = data_len - (uint32_t)bom_shift;
+
+    error = common_file_open_data(file_ctx);
+    if (error) {
+        TRACE_ERROR_NUMBER("Failed to open data", error);
+        file_ctx->borrowed = NULL;
+        return error;
+    }
+
+    file_ctx->content_hash = ini_hash_data(INI_HASH_INIT,
+                                           file_ctx->borrowed,
+                                           file_ctx->borrowed_len);
+
+    memset(&(file_ctx->file_stats), 0, sizeof(struct stat));
+    file_ctx->stats_read = 0;
+
+    TRACE_FLOW_EXIT();
+    return EOK;
+}
+
 /* Create a file object for parsing a config file */
 int ini_config_file_open(const char *filename,
                          uint32_t metadata_flags,
@@ -521,6 +754,8 @@ int ini_config_file_open(const char *filename,
     new_ctx->filename = NULL;
     new_ctx->file = NULL;
     new_ctx->file_data = NULL;
+    new_ctx->borrowed = NULL;
+    new_ctx->release = NULL;
     new_ctx->bom = INDEX_UTF8NOBOM;
 
     error = simplebuffer_alloc(&(new_ctx->file_data));
@@ -565,10 +800,12 @@ int ini_config_file_open(const char *filename,
     return error;
 }
 
-/* Create a file object from a memory buffer */
-int ini_config_file_from_mem(void *data_buf,
-                             uint32_t data_len,
-                             struct ini_cfgfile **file_ctx)
+/* Create a file object from a memory buffer
+ * either copying or borrowing the memory */
+static int file_from_mem(void *data_buf,
+                         uint32_t data_len,
+                         int borrow,
+                         struct ini_cfgfile **file_ctx)
 {
     int error = EOK;
     struct ini_cfgfile *new_ctx = NULL;
@@ -590,6 +827,8 @@ int ini_config_file_from_mem(void *data_buf,
     new_ctx->filename = NULL;
     new_ctx->file = NULL;
     new_ctx->file_data = NULL;
+    new_ctx->borrowed = NULL;
+    new_ctx->release = NULL;
     new_ctx->metadata_flags = 0;
     new_ctx->bom = INDEX_UTF8NOBOM;
 
@@ -609,7 +848,8 @@ int ini_config_file_from_mem(void *data_buf,
     }
 
     /* Do common init */
-    error = common_file_init(new_ctx, data_buf, data_len);
+    if (borrow) error = borrow_file_init(new_ctx, data_buf, data_len);
+    else error = common_file_init(new_ctx, data_buf, data_len);
     if(error) {
         TRACE_ERROR_NUMBER("Failed to do common init", error);
         ini_config_file_destroy(new_ctx);
@@ -621,6 +861,40 @@ int ini_config_file_from_mem(void *data_buf,
     return error;
 }
 
+/* Create a file object from a memory buffer */
+int ini_config_file_from_mem(void *data_buf,
+                             uint32_t data_len,
+                             struct ini_cfgfile **file_ctx)
+{
+    return file_from_mem(data_buf, data_len, 0, file_ctx);
+}
+
+/* Create a file object over a memory buffer */
+int ini_config_file_from_mem_borrow(void *data_buf,
+                                    uint32_t data_len,
+                                    ini_mem_release_func *release,
+                                    void *release_data,
+                                    struct ini_cfgfile **file_ctx)
+{
+    int error = EOK;
+
+    TRACE_FLOW_ENTRY();
+
+    error = file_from_mem(data_buf, data_len, 1, file_ctx);
+    if (error) {
+        TRACE_ERROR_NUMBER("Failed to create file object", error);
+        return error;
+    }
+
+    /* From now on the file object releases the memory */
+    (*file_ctx)->borrowed_buf = data_buf;
+    (*file_ctx)->release = release;
+    (*file_ctx)->release_data = release_data;
+
+    TRACE_FLOW_EXIT();
+    return EOK;
+}
+
 
 
 /* Create a file object from existing one */
@@ -647,6 +921,8 @@ int ini_config_file_reopen(struct ini_cfgfile *file_ctx_in,
     new_ctx->file = NULL;
     new_ctx->file_data = NULL;
     new_ctx->filename = NULL;
+    new_ctx->borrowed = NULL;
+    new_ctx->release = NULL;
 
     error = simplebuffer_alloc(&(new_ctx->file_data));
     if (error) {
@@ -684,6 +960,197 @@ int ini_config_file_reopen(struct ini_cfgfile *file_ctx_in,
     return error;
 }
 
+#ifdef HAVE_FOPENCOOKIE
+
+/* Converts the file to UTF-8 as the parser reads it
+ * so only one buffer of the file is in memory at a time */
+struct ini_decoder {
+    /* Raw file */
+    FILE *raw;
+    /* Decoded stream read by the parser */
+    FILE *file;
+    iconv_t conv;
+    char in[ICONV_BUFFER];
+    size_t in_len;
+    int eof;
+    /* First error, reported on close */
+    int error;
+};
+
+static ssize_t decoder_read(void *cookie, char *buf, size_t size)
+{
+    struct ini_decoder *decoder = (struct ini_decoder *)cookie;
+    char *src;
+    char *dest = buf;
+    size_t room = size;
+    size_t res;
+    size_t read_cnt;
+
+    TRACE_FLOW_ENTRY();
+
+    while ((room == size) && (!(decoder->error))) {
+
+        if (decoder->in_len) {
+            src = decoder->in;
+            errno = 0;
+            res = iconv(decoder->conv, &src, &(decoder->in_len),
+                        &dest, &room);
+            if ((res == (size_t) -1) &&
+                (errno != E2BIG) && (errno != EINVAL)) {
+                TRACE_ERROR_NUMBER("Failed to convert", errno);
+                decoder->error = errno;
+                break;
+            }
+            memmove(decoder->in, src, decoder->in_len);
+            /* Give out what was converted */
+            if (room != size) break;
+        }
+
+        if (decoder->eof) {
+            /* Sequence is cut at the end of the file */
+            if (decoder->in_len) decoder->error = EINVAL;
+            break;
+        }
+
+        read_cnt = fread(decoder->in + decoder->in_len, 1,
+                         ICONV_BUFFER - decoder->in_len, decoder->raw);
+        if (read_cnt == 0) {
+            if (ferror(decoder->raw)) {
+                TRACE_ERROR_NUMBER("Failed to read data from file", EIO);
+                decoder->error = EIO;
+                break;
+            }
+            decoder->eof = 1;
+        }
+        decoder->in_len += read_cnt;
+    }
+
+    if ((room == size) && (decoder->error)) {
+        errno = decoder->error;
+        return -1;
+    }
+
+    TRACE_FLOW_EXIT();
+    return size - room;
+}
+
+/* The decoder is freed by ini_decoder_close() */
+static int decoder_close(void *cookie)
+{
+    return 0;
+}
+
+/* Open the file for decoding as it is read */
+int ini_decoder_open(const char *filename,
+                     struct ini_decoder **decoder_out,
+                     FILE **file)
+{
+    int error = EOK;
+    struct ini_decoder *decoder = NULL;
+    enum index_utf_t ind;
+    size_t bom_shift = 0;
+    cookie_io_functions_t io = { decoder_read, NULL, NULL, decoder_close };
+
+    TRACE_FLOW_ENTRY();
+
+    if ((!filename) || (!decoder_out) || (!file)) {
+        TRACE_ERROR_NUMBER("Invalid parameter.", EINVAL);
+        return EINVAL;
+    }
+
+    decoder = calloc(1, sizeof(struct ini_decoder));
+    if (!decoder) {
+        TRACE_ERROR_NUMBER("Failed to allocate decoder.", ENOMEM);
+        return ENOMEM;
+    }
+    decoder->conv = (iconv_t) -1;
+
+    errno = 0;
+    decoder->raw = fopen(filename, "r");
+    if (!(decoder->raw)) {
+        error = errno;
+        TRACE_ERROR_NUMBER("Failed to open file", error);
+        ini_decoder_close(decoder);
+        return error;
+    }
+
+    decoder->in_len = fread(decoder->in, 1, ICONV_BUFFER, decoder->raw);
+    if (decoder->in_len < ICONV_BUFFER) {
+        if (ferror(decoder->raw)) {
+            TRACE_ERROR_NUMBER("Failed to read data from file", EIO);
+            ini_decoder_close(decoder);
+            return EIO;
+        }
+        decoder->eof = 1;
+    }
+
+    ind = check_bom(INDEX_UTF8NOBOM,
+                    (unsigned char *)decoder->in,
+                    decoder->in_len,
+                    &bom_shift);
+    decoder->in_len -= bom_shift;
+    memmove(decoder->in, decoder->in + bom_shift, decoder->in_len);
+
+    errno = 0;
+    decoder->conv = iconv_open(encodings[INDEX_UTF8], encodings[ind]);
+    if (decoder->conv == (iconv_t) -1) {
+        error = errno;
+        TRACE_ERROR_NUMBER("Failed to create converter", error);
+        ini_decoder_close(decoder);
+        return error;
+    }
+
+    errno = 0;
+    decoder->file = fopencookie(decoder, "r", io);
+    if (!(decoder->file)) {
+        error = errno;
+        TRACE_ERROR_NUMBER("Failed to open decoded stream", error);
+        ini_decoder_close(decoder);
+        return error;
+    }
+
+    *decoder_out = decoder;
+    *file = decoder->file;
+
+    TRACE_FLOW_EXIT();
+    return EOK;
+}
+
+/* Close the decoder and return the first decoding error */
+int ini_decoder_close(struct ini_decoder *decoder)
+{
+    int error;
+
+    TRACE_FLOW_ENTRY();
+
+    if (!decoder) return EOK;
+
+    if (decoder->file) fclose(decoder->file);
+    if (decoder->raw) fclose(decoder->raw);
+    if (decoder->conv != (iconv_t) -1) iconv_close(decoder->conv);
+    error = decoder->error;
+    free(decoder);
+
+    TRACE_FLOW_EXIT();
+    return error;
+}
+
+#else
+
+int ini_decoder_open(const char *filename,
+                     struct ini_decoder **decoder_out,
+                     FILE **file)
+{
+    return ENOSYS;
+}
+
+int ini_decoder_close(struct ini_decoder *decoder)
+{
+    return EOK;
+}
+
+#endif
+
 /* Function to construct file name */
 static int create_file_name(const char *dir,
                             const char *tpl,
@@ -870,6 +1337,70 @@ static int open_new_file(const char *filename,
 
 }
 
+/* Create temporary file next to the target and set proper permissions */
+static int open_temp_file(const char *filename,
+                          uid_t uid,
+                          gid_t gid,
+                          mode_t mode,
+                          char **tmp_name,
+                          int *fd_ptr)
+{
+    int error = EOK;
+    int ret = 0;
+    int fd;
+    size_t len;
+    char *name;
+
+    TRACE_FLOW_ENTRY();
+
+    len = strlen(filename);
+    name = malloc(len + sizeof(".XXXXXX"));
+    if (!name) {
+        TRACE_ERROR_NUMBER("Failed to allocate name.", ENOMEM);
+        return ENOMEM;
+    }
+    memcpy(name, filename, len);
+    memcpy(name + len, ".XXXXXX", sizeof(".XXXXXX"));
+
+    errno = 0;
+    fd = mkstemp(name);
+    if (fd == -1) {
+        error = errno;
+        free(name);
+        TRACE_ERROR_NUMBER("Failed to create file.", error);
+        return error;
+    }
+
+    errno = 0;
+    ret = fchmod(fd, mode);
+    if (ret == -1) {
+        error = errno;
+        TRACE_ERROR_NUMBER("Failed to chmod file.", error);
+    }
+
+    if (!error) {
+        errno = 0;
+        ret = fchown(fd, uid, gid);
+        if (ret == -1) {
+            error = errno;
+            TRACE_ERROR_NUMBER("Failed to chown file.", error);
+        }
+    }
+
+    if (error) {
+        close(fd);
+        unlink(name);
+        free(name);
+        return error;
+    }
+
+    *tmp_name = name;
+    *fd_ptr = fd;
+
+    TRACE_FLOW_EXIT();
+    return EOK;
+}
+
 /* Function to do the encoding */
 static int do_encoding(struct ini_cfgfile *file_ctx,
                        struct simplebuffer *sb)
@@ -891,8 +1422,8 @@ static int do_encoding(struct ini_cfgfile *file_ctx,
         return error;
     }
 
-    src = (char *)simplebuffer_get_vbuf(file_ctx->file_data);
-    to_convert = (size_t)simplebuffer_get_len(file_ctx->file_data);
+    src = (char *)file_data_buf(file_ctx);
+    to_convert = (size_t)file_data_len(file_ctx);
 
     do {
         /* There is only one loop since everything is already read.
@@ -1026,20 +1557,17 @@ static int write_bom(int fd,
     return EOK;
 }
 
-/* Function to write to file */
-static int write_to_file(struct ini_cfgfile *file_ctx,
-                         const char *filename,
-                         struct access_check *overwrite,
-                         int check)
+/* Create the file with the right permissions and ownership */
+static int open_for_write(struct ini_cfgfile *file_ctx,
+                          const char *filename,
+                          struct access_check *overwrite,
+                          int check,
+                          int *fd)
 {
     int error = EOK;
     uid_t uid = 0;
     gid_t gid = 0;
     mode_t mode = 0;
-    int fd = -1;
-    uint32_t left = 0;
-    struct simplebuffer *sb = NULL;
-    struct simplebuffer *sb_ptr = NULL;
 
     TRACE_FLOW_ENTRY();
 
@@ -1060,12 +1588,254 @@ static int write_to_file(struct ini_cfgfile *file_ctx,
                           gid,
                           mode,
                           check,
-                          &fd);
+                          fd);
     if (error) {
         TRACE_ERROR_NUMBER("Failed to open new file.", error);
         return error;
     }
 
+    TRACE_FLOW_EXIT();
+    return EOK;
+}
+
+/* Create the temporary file that will replace the target */
+static int open_temp_for_write(struct ini_cfgfile *file_ctx,
+                               const char *filename,
+                               struct access_check *overwrite,
+                               char **tmp_name,
+                               int *fd)
+{
+    int error = EOK;
+    uid_t uid = 0;
+    gid_t gid = 0;
+    mode_t mode = 0;
+
+    TRACE_FLOW_ENTRY();
+
+    error = determine_permissions(file_ctx,
+                                  overwrite,
+                                  &uid,
+                                  &gid,
+                                  &mode);
+    if (error) {
+        TRACE_ERROR_NUMBER("Failed to determine permissions.", error);
+        return error;
+    }
+
+    error = open_temp_file(filename, uid, gid, mode, tmp_name, fd);
+    if (error) {
+        TRACE_ERROR_NUMBER("Failed to open temporary file.", error);
+        return error;
+    }
+
+    TRACE_FLOW_EXIT();
+    return EOK;
+}
+
+/* Write the whole buffer */
+static int write_all(int fd, const char *buf, size_t len)
+{
+    ssize_t ret;
+    int error = EOK;
+
+    while (len > 0) {
+        errno = 0;
+        ret = write(fd, buf, len);
+        if (ret == -1) {
+            error = errno;
+            if (error == EINTR) continue;
+            TRACE_ERROR_NUMBER("Failed to write data", error);
+            return error;
+        }
+        buf += ret;
+        len -= ret;
+    }
+
+    return EOK;
+}
+
+/* Where the configuration is being saved */
+struct save_stream {
+    int fd;
+    /* Converter if the file is not in UTF-8 */
+    iconv_t encoder;
+};
+
+/* Encode and write a portion of the serialized configuration */
+static int save_stream_sink(void *buf,
+                            uint32_t len,
+                            void *data)
+{
+    int error = EOK;
+    struct save_stream *ss = (struct save_stream *)data;
+    char result_buf[ICONV_BUFFER];
+    char *src, *dest;
+    size_t to_convert = 0;
+    size_t room_left = 0;
+    size_t conv_res = 0;
+
+    TRACE_FLOW_ENTRY();
+
+    if (ss->encoder == (iconv_t) -1) {
+        error = write_all(ss->fd, buf, len);
+        TRACE_FLOW_RETURN(error);
+        return error;
+    }
+
+    /* Portions always end between the values
+     * so there are no partial sequences.
+     */
+    src = buf;
+    to_convert = len;
+
+    do {
+        dest = result_buf;
+        room_left = ICONV_BUFFER;
+
+        errno = 0;
+        conv_res = iconv(ss->encoder, &src, &to_convert, &dest, &room_left);
+        if ((conv_res == (size_t) -1) && (errno != E2BIG)) {
+            error = errno;
+            TRACE_ERROR_NUMBER("Failed to encode", error);
+            if ((error != EILSEQ) && (error != EINVAL)) error = ENOTSUP;
+            return error;
+        }
+
+        error = write_all(ss->fd, result_buf, ICONV_BUFFER - room_left);
+        if (error) {
+            TRACE_ERROR_NUMBER("Failed to write encoded data", error);
+            return error;
+        }
+    }
+    while (conv_res == (size_t) -1);
+
+    TRACE_FLOW_EXIT();
+    return EOK;
+}
+
+/* Serialize the configuration directly into the file.
+ * It is written under a temporary name and renamed
+ * over the target only when everything is written,
+ * so the old file stays as it was if anything fails.
+ */
+static int write_config_to_file(struct ini_cfgfile *file_ctx,
+                                const char *filename,
+                                struct access_check *overwrite,
+                                struct ini_cfgobj *ini_config)
+{
+    int error = EOK;
+    struct save_stream ss;
+    char target[PATH_MAX + 1];
+    char *tmp_name = NULL;
+
+    TRACE_FLOW_ENTRY();
+
+    /* Replace the file the link points to, not the link */
+    if (!realpath(filename, target)) {
+        if (strlen(filename) > PATH_MAX) {
+            TRACE_ERROR_NUMBER("Path is too long.", ENAMETOOLONG);
+            return ENAMETOOLONG;
+        }
+        strcpy(target, filename);
+    }
+
+    ss.fd = -1;
+    ss.encoder = (iconv_t) -1;
+
+    if ((file_ctx->bom != INDEX_UTF8NOBOM) &&
+        (file_ctx->bom != INDEX_UTF8)) {
+        errno = 0;
+        ss.encoder = iconv_open(encodings[file_ctx->bom],
+                                encodings[INDEX_UTF8NOBOM]);
+        if (ss.encoder == (iconv_t) -1) {
+            error = errno;
+            TRACE_ERROR_NUMBER("Failed to create converter", error);
+            return error;
+        }
+    }
+
+    error = open_temp_for_write(file_ctx, target, overwrite,
+                                &tmp_name, &(ss.fd));
+    if (error) {
+        TRACE_ERROR_NUMBER("Failed to open new file.", error);
+        if (ss.encoder != (iconv_t) -1) iconv_close(ss.encoder);
+        return error;
+    }
+
+    if (file_ctx->bom != INDEX_UTF8NOBOM) {
+        error = write_bom(ss.fd, file_ctx->bom);
+        if (error) {
+            TRACE_ERROR_NUMBER("Failed to save bom", error);
+        }
+    }
+
+    if (!error) {
+        error = ini_config_serialize_to(ini_config, INI_SAVE_BUFFER,
+                                        save_stream_sink, &ss);
+        if (error) {
+            TRACE_ERROR_NUMBER("Failed to save configuration", error);
+        }
+    }
+
+    if (ss.encoder != (iconv_t) -1) iconv_close(ss.encoder);
+
+    errno = 0;
+    if ((close(ss.fd) == -1) && (!error)) {
+        error = errno;
+        TRACE_ERROR_NUMBER("Failed to close file", error);
+    }
+
+    if (!error) {
+        errno = 0;
+        if (rename(tmp_name, target) == -1) {
+            error = errno;
+            TRACE_ERROR_NUMBER("Failed to replace file", error);
+        }
+    }
+
+    if (error) unlink(tmp_name);
+    free(tmp_name);
+
+    TRACE_FLOW_RETURN(error);
+    return error;
+}
+
+/* Function to write to file */
+static int write_to_file(struct ini_cfgfile *file_ctx,
+                         const char *filename,
+                         struct access_check *overwrite,
+                         int check)
+{
+    int error = EOK;
+    int fd = -1;
+    uint32_t left = 0;
+    struct simplebuffer *sb = NULL;
+    struct simplebuffer *sb_ptr = NULL;
+
+    TRACE_FLOW_ENTRY();
+
+    error = open_for_write(file_ctx, filename, overwrite, check, &fd);
+    if (error) {
+        TRACE_ERROR_NUMBER("Failed to open new file.", error);
+        return error;
+    }
+
+    /* Borrowed data is only UTF-8 and
+     * it is written through a temporary copy */
+    if (file_ctx->borrowed) {
+        error = simplebuffer_alloc(&sb);
+        if (!error) error = simplebuffer_add_raw(sb,
+                                                 file_ctx->borrowed,
+                                                 file_ctx->borrowed_len,
+                                                 file_ctx->borrowed_len);
+        if (error) {
+            TRACE_ERROR_NUMBER("Failed to copy borrowed data", error);
+            simplebuffer_free(sb); /* Checks for NULL */
+            close(fd);
+            return error;
+        }
+    }
+
     /* Write to file */
     if (file_ctx->bom != INDEX_UTF8NOBOM) {
 
@@ -1090,7 +1860,7 @@ static int write_to_file(struct ini_cfgfile *file_ctx,
             sb_ptr = sb;
 
         }
-        else sb_ptr = file_ctx->file_data;
+        else sb_ptr = sb ? sb : file_ctx->file_data;
 
         /* Write bom into file */
         error = write_bom(fd, file_ctx->bom);
@@ -1102,7 +1872,7 @@ static int write_to_file(struct ini_cfgfile *file_ctx,
         }
 
     }
-    else sb_ptr = file_ctx->file_data;
+    else sb_ptr = sb ? sb : file_ctx->file_data;
 
     left = simplebuffer_get_len(sb_ptr);
     do {
@@ -1354,27 +2124,20 @@ int ini_config_save_as(struct ini_cfgfile *file_ctx,
         return EINVAL;
     }
 
-    error = simplebuffer_alloc(&sbobj);
-    if (error) {
-        TRACE_ERROR_NUMBER("Failed to allocate buffer.", error);
-        return error;
+    if (!ini_config) {
+        TRACE_ERROR_NUMBER("Invalid argument", EINVAL);
+        return EINVAL;
     }
 
-    error = ini_config_serialize(ini_config, sbobj);
-    if (error) {
-        TRACE_ERROR_NUMBER("Failed to serialize.", error);
-        simplebuffer_free(sbobj);
-        return error;
+    /* Fail before the file is touched */
+    if (ini_config->lean) {
+        TRACE_ERROR_NUMBER("Configuration was parsed in lean mode", ENOTSUP);
+        return ENOTSUP;
     }
 
     /* Close the internal file handle we control */
     ini_config_file_close(file_ctx);
 
-    /* Free old buffer and assign a new one */
-    simplebuffer_free(file_ctx->file_data);
-    file_ctx->file_data = sbobj;
-    sbobj = NULL;
-
     if (filename) {
         /* Clean existing file name */
         free(file_ctx->filename);
@@ -1398,14 +2161,7 @@ int ini_config_save_as(struct ini_cfgfile *file_ctx,
         }
     }
 
-    /* Write the buffer we have to the file */
-    error = write_to_file(file_ctx, file_ctx->filename, new_access, 0);
-    if (error) {
-        TRACE_ERROR_NUMBER("Failed to write file.", error);
-        return error;
-    }
-
-    /* Free again to truncate and prepare for re-read */
+    /* Old data is not needed any more, the file will be re-read */
     simplebuffer_free(file_ctx->file_data);
     file_ctx->file_data = NULL;
 
@@ -1417,6 +2173,16 @@ int ini_config_save_as(struct ini_cfgfile *file_ctx,
 
     file_ctx->file_data = sbobj;
 
+    /* Configuration is written as it is serialized
+     * so it is never kept in memory as a whole.
+     */
+    error = write_config_to_file(file_ctx, file_ctx->filename,
+                                 new_access, ini_config);
+    if (error) {
+        TRACE_ERROR_NUMBER("Failed to write file.", error);
+        return error;
+    }
+
     /* Reopen and re-read */
     error = common_file_init(file_ctx, NULL, 0);
     if(error) {
@@ -1591,9 +2357,11 @@ int ini_config_access_check(struct ini_cfgfile *file_ctx,
 }
 
 /* Determines if two file contexts are different by comparing:
- * - time stamp
+ * - time stamp with nanoseconds
  * - device ID
  * - i-node
+ * - size
+ * - hash of the contents
  */
 int ini_config_changed(struct ini_cfgfile *file_ctx1,
                        struct ini_cfgfile *file_ctx2,
@@ -1616,15 +2384,16 @@ int ini_config_changed(struct ini_cfgfile *file_ctx1,
 
     *changed = 0;
 
-    /* Unfortunately the time is not granular enough
-     * to detect the change if run during the unit test.
-     * In future when a more granular version of stat
-     * is available we should switch to it and update
-     * the unit test.
+    /* The contents are compared too since even nanosecond
+     * time stamps are only as precise as the file system.
      */
-
     if((file_ctx1->file_stats.st_mtime !=
         file_ctx2->file_stats.st_mtime) ||
+       (INI_MTIME_NSEC(&(file_ctx1->file_stats)) !=
+        INI_MTIME_NSEC(&(file_ctx2->file_stats))) ||
+       (file_ctx1->file_stats.st_size !=
+        file_ctx2->file_stats.st_size) ||
+       (file_ctx1->content_hash != file_ctx2->content_hash) ||
        (file_ctx1->file_stats.st_dev !=
         file_ctx2->file_stats.st_dev) ||
        (file_ctx1->file_stats.st_ino !=
@@ -32,6 +32,7 @@
 #include "collection_tools.h"
 #include "ini_defines.h"
 #include "ini_configobj.h"
+#include "ini_config_priv.h"
 
 /*
  * Internal contants to indicate how
@@ -40,25 +41,49 @@
 #define EXCLUDE_EMPTY   0
 #define INCLUDE_EMPTY   1
 
-/* Maximum number of separators supported. Do not make it less than 3. */
-#define MAX_SEP_LEN     3
+/* Strings are followed by the pointers to them */
+#define ARRAY_ALIGN(len) (((len) + sizeof(void *) - 1) & ~(sizeof(void *) - 1))
 
-/* Arrays of stings */
-static char **get_str_cfg_array(struct value_obj *vo,
-                                int include,
-                                const char *sep,
-                                int *size,
-                                int *error)
+/* Allocate array that will be cached in the value */
+static struct value_array *alloc_array(enum value_array_type type,
+                                       const char *sep,
+                                       size_t size)
+{
+    struct value_array *array;
+
+    array = malloc(sizeof(struct value_array) + size);
+    if (array == NULL) {
+        TRACE_ERROR_NUMBER("Failed to allocate memory.", ENOMEM);
+        return NULL;
+    }
+
+    array->next = NULL;
+    array->type = type;
+    if (sep) strcpy(array->sep, sep);
+    else array->sep[0] = '\0';
+    array->error = EOK;
+    array->size = 0;
+    array->len = 0;
+    array->items = NULL;
+
+    return array;
+}
+
+/* Split the value into strings */
+static struct value_array *split_str_array(struct value_obj *vo,
+                                           int include,
+                                           const char *locsep)
 {
+    struct value_array *array = NULL;
+    struct value_array *new_array = NULL;
     char *copy = NULL;
     char *dest = NULL;
-    char locsep[MAX_SEP_LEN + 1];
     uint32_t lensep;
     const char *buff;
     uint32_t count = 0;
     uint32_t len = 0;
     uint32_t resume_len;
-    char **array;
+    char **items;
     const char *start;
     char *start_array;
     uint32_t i, j;
@@ -66,41 +91,24 @@ static char **get_str_cfg_array(struct value_obj *vo,
 
     TRACE_FLOW_ENTRY();
 
-    /* Do we have the vo ? */
-    if (vo == NULL) {
-        TRACE_ERROR_NUMBER("Invalid argument.", EINVAL);
-        if (error) *error = EINVAL;
-        return NULL;
-    }
-
-    /* Get value and length - no error checking as we checked it above
-     * and there is no other reson the function could to fail.
+    /* Get value and length - no error checking as
+     * there is no reson the function could to fail.
      */
     value_get_concatenated(vo, &buff);
     value_get_concatenated_len(vo, &dlen);
 
-    /* Handle the separators */
-    if (sep == NULL) {
-        locsep[0] = ',';
-        locsep[1] = '\0';
-        lensep = 2;
-    }
-    else {
-        strncpy(locsep, sep, MAX_SEP_LEN);
-        locsep[MAX_SEP_LEN] = '\0';
-        lensep = strlen(locsep) + 1;
-    }
+    /* Terminating zero is also a separator */
+    lensep = strlen(locsep) + 1;
 
     /* Allocate memory for the copy of the string */
     TRACE_INFO_NUMBER("Length to allocate is :", dlen);
-    /* Always reserve one more byte 
+    /* Always reserve one more byte
      * for the case when the string consist of delimeters */
-    copy = malloc(dlen + 1);
-    if (copy == NULL) {
-        TRACE_ERROR_NUMBER("Failed to allocate memory.", ENOMEM);
-        if (error) *error = ENOMEM;
-        return NULL;
-    }
+    array = alloc_array(include ? VALUE_ARRAY_RAW_STRING : VALUE_ARRAY_STRING,
+                        locsep, dlen + 1);
+    if (array == NULL) return NULL;
+
+    copy = (char *)array->data;
 
     /* Suppress warning */
     start = buff;
@@ -169,107 +177,65 @@ static char **get_str_cfg_array(struct value_obj *vo,
     }
 
     /* Now we know how many items are there in the list */
-    array = malloc((count + 1) * sizeof(char *));
-    if (array == NULL) {
-        free(copy);
+    new_array = realloc(array, sizeof(struct value_array) +
+                               ARRAY_ALIGN(dlen + 1) +
+                               (count + 1) * sizeof(char *));
+    if (new_array == NULL) {
+        free(array);
         TRACE_ERROR_NUMBER("Failed to allocate memory.", ENOMEM);
-        if (error) *error = ENOMEM;
         return NULL;
     }
+    array = new_array;
+    copy = (char *)array->data;
+    items = (char **)(copy + ARRAY_ALIGN(dlen + 1));
 
     /* Loop again to fill in the pointers */
     start_array = copy;
     for (i = 0; i < count; i++) {
         TRACE_INFO_STRING("Token :", start_array);
         TRACE_INFO_NUMBER("Item :", i);
-        array[i] = start_array;
+        items[i] = start_array;
         /* Move to next item */
         while(*start_array) start_array++;
         start_array++;
     }
-    array[count] = NULL;
+    items[count] = NULL;
 
-    if (error) *error = EOK;
-    if (size) *size = count;
-    /* If count is 0 the copy needs to be freed */
-    if (count == 0) free(copy);
+    array->items = items;
+    array->size = count;
+    array->len = dlen + 1;
 
     TRACE_FLOW_EXIT();
     return array;
 }
 
-/* Get array of strings from item eliminating empty tokens */
-char **ini_get_string_config_array(struct value_obj *vo,
-                                   const char *sep, int *size, int *error)
-{
-    TRACE_FLOW_ENTRY();
-    return get_str_cfg_array(vo, EXCLUDE_EMPTY, sep, size, error);
-}
-/* Get array of strings from item preserving empty tokens */
-char **ini_get_raw_string_config_array(struct value_obj *vo,
-                                       const char *sep, int *size, int *error)
-{
-    TRACE_FLOW_ENTRY();
-    return get_str_cfg_array(vo, INCLUDE_EMPTY, sep, size, error);
-}
-
-/* Special function to free string config array */
-void ini_free_string_config_array(char **str_config)
-{
-    TRACE_FLOW_ENTRY();
-
-    if (str_config != NULL) {
-        if (*str_config != NULL) free(*str_config);
-        free(str_config);
-    }
-
-    TRACE_FLOW_EXIT();
-}
-
-/* Get an array of long values.
- * NOTE: For now I leave just one function that returns numeric arrays.
- * In future if we need other numeric types we can change it to do strtoll
- * internally and wrap it for backward compatibility.
- */
-long *ini_get_long_config_array(struct value_obj *vo, int *size, int *error)
+/* Convert the value into long values */
+static struct value_array *split_long_array(struct value_obj *vo)
 {
     const char *str;
     char *endptr;
     long val = 0;
-    long *array;
+    long *items;
+    struct value_array *array;
+    struct value_array *new_array;
     uint32_t count = 0;
     int err;
     uint32_t dlen;
 
     TRACE_FLOW_ENTRY();
 
-    /* Do we have the vo ? */
-    if (vo == NULL) {
-        TRACE_ERROR_NUMBER("Invalid value object argument.", EINVAL);
-        if (error) *error = EINVAL;
-        return NULL;
-    }
-
-    /* Do we have the size ? */
-    if (size == NULL) {
-        TRACE_ERROR_NUMBER("Invalid size argument.", EINVAL);
-        if (error) *error = EINVAL;
-        return NULL;
-    }
-
-    /* Get value and length - no error checking as we checked it above
-     * and there is no other reson the function could to fail.
+    /* Get value and length - no error checking as
+     * there is no reson the function could to fail.
      */
     value_get_concatenated(vo, &str);
     value_get_concatenated_len(vo, &dlen);
 
     /* Assume that we have maximum number of different numbers */
-    array = (long *)malloc(sizeof(long) * dlen/2);
-    if (array == NULL) {
-        TRACE_ERROR_NUMBER("Failed to allocate memory.", ENOMEM);
-        if (error) *error = ENOMEM;
-        return NULL;
-    }
+    array = alloc_array(VALUE_ARRAY_LONG, NULL,
+                        sizeof(long) * (dlen / 2 + 1));
+    if (array == NULL) return NULL;
+
+    items = (long *)array->data;
 
     /* Now parse the string */
     while (*str) {
@@ -280,20 +246,18 @@ long *ini_get_long_config_array(struct value_obj *vo, int *size, int *error)
 
         if (err) {
             TRACE_ERROR_NUMBER("Conversion failed", err);
-            free(array);
-            if (error) *error = err;
-            return NULL;
+            array->error = err;
+            return array;
         }
 
         if (endptr == str) {
             TRACE_ERROR_NUMBER("Nothing processed", EIO);
-            free(array);
-            if (error) *error = EIO;
-            return NULL;
+            array->error = EIO;
+            return array;
         }
 
         /* Save value */
-        array[count] = val;
+        items[count] = val;
         count++;
         /* Are we done? */
         if (*endptr == 0) break;
@@ -303,55 +267,46 @@ long *ini_get_long_config_array(struct value_obj *vo, int *size, int *error)
         }
     }
 
-    *size = count;
-    if (error) *error = EOK;
+    /* Release the part that was not used */
+    new_array = realloc(array, sizeof(struct value_array) +
+                               sizeof(long) * count);
+    if (new_array) array = new_array;
+
+    array->items = array->data;
+    array->size = count;
+    array->len = sizeof(long) * count;
 
     TRACE_FLOW_EXIT();
     return array;
-
 }
 
-/* Get an array of double values */
-double *ini_get_double_config_array(struct value_obj *vo, int *size, int *error)
+/* Convert the value into double values */
+static struct value_array *split_double_array(struct value_obj *vo)
 {
     const char *str;
     char *endptr;
     double val = 0;
-    double *array;
+    double *items;
+    struct value_array *array;
+    struct value_array *new_array;
     int count = 0;
     struct lconv *loc;
     uint32_t dlen;
 
     TRACE_FLOW_ENTRY();
 
-    /* Do we have the vo ? */
-    if (vo == NULL) {
-        TRACE_ERROR_NUMBER("Invalid value object argument.", EINVAL);
-        if (error) *error = EINVAL;
-        return NULL;
-    }
-
-    /* Do we have the size ? */
-    if (size == NULL) {
-        TRACE_ERROR_NUMBER("Invalid size argument.", EINVAL);
-        if (error) *error = EINVAL;
-        return NULL;
-    }
-
-    /* Get value and length - no error checking as we checked it above
-     * and there is no other reson the function could to fail.
+    /* Get value and length - no error checking as
+     * there is no reson the function could to fail.
      */
     value_get_concatenated(vo, &str);
     value_get_concatenated_len(vo, &dlen);
 
-
     /* Assume that we have maximum number of different numbers */
-    array = (double *)malloc(sizeof(double) * dlen/2);
-    if (array == NULL) {
-        TRACE_ERROR_NUMBER("Failed to allocate memory.", ENOMEM);
-        if (error) *error = ENOMEM;
-        return NULL;
-    }
+    array = alloc_array(VALUE_ARRAY_DOUBLE, NULL,
+                        sizeof(double) * (dlen / 2 + 1));
+    if (array == NULL) return NULL;
+
+    items = (double *)array->data;
 
     /* Get locale information so that we can check for decimal point character.
      * Based on the man pages it is unclear if this is an allocated memory or not.
@@ -369,12 +324,11 @@ double *ini_get_double_config_array(struct value_obj *vo, int *size, int *error)
             ((errno != 0) && (val == 0)) ||
             (endptr == str)) {
             TRACE_ERROR_NUMBER("Conversion failed", EIO);
-            free(array);
-            if (error) *error = EIO;
-            return NULL;
+            array->error = EIO;
+            return array;
         }
         /* Save value */
-        array[count] = val;
+        items[count] = val;
         count++;
         /* Are we done? */
         if (*endptr == 0) break;
@@ -387,12 +341,304 @@ double *ini_get_double_config_array(struct value_obj *vo, int *size, int *error)
         }
     }
 
-    *size = count;
+    /* Release the part that was not used */
+    new_array = realloc(array, sizeof(struct value_array) +
+                               sizeof(double) * count);
+    if (new_array) array = new_array;
+
+    array->items = array->data;
+    array->size = count;
+    array->len = sizeof(double) * count;
+
+    TRACE_FLOW_EXIT();
+    return array;
+}
+
+/* Get the array cached in the value
+ * converting the value if it is not there yet.
+ */
+static struct value_array *get_array(struct value_obj *vo,
+                                     enum value_array_type type,
+                                     const char *sep,
+                                     int *error)
+{
+    struct value_array *array;
+    char locsep[VALUE_ARRAY_SEP_LEN + 1];
+
+    TRACE_FLOW_ENTRY();
+
+    /* Handle the separators */
+    if (sep == NULL) {
+        locsep[0] = ',';
+        locsep[1] = '\0';
+    }
+    else {
+        strncpy(locsep, sep, VALUE_ARRAY_SEP_LEN);
+        locsep[VALUE_ARRAY_SEP_LEN] = '\0';
+    }
+
+    array = value_get_array(vo, type, locsep);
+    if (array == NULL) {
+        switch (type) {
+        case VALUE_ARRAY_STRING:
+            array = split_str_array(vo, EXCLUDE_EMPTY, locsep);
+            break;
+        case VALUE_ARRAY_RAW_STRING:
+            array = split_str_array(vo, INCLUDE_EMPTY, locsep);
+            break;
+        case VALUE_ARRAY_LONG:
+            array = split_long_array(vo);
+            break;
+        case VALUE_ARRAY_DOUBLE:
+            array = split_double_array(vo);
+            break;
+        }
+
+        if (array == NULL) {
+            if (error) *error = ENOMEM;
+            return NULL;
+        }
+
+        value_add_array(vo, array);
+    }
+
+    if (array->error) {
+        TRACE_ERROR_NUMBER("Conversion failed", array->error);
+        if (error) *error = array->error;
+        return NULL;
+    }
+
     if (error) *error = EOK;
 
     TRACE_FLOW_EXIT();
     return array;
+}
+
+/* Arrays of stings */
+static char **get_str_cfg_array(struct value_obj *vo,
+                                int include,
+                                const char *sep,
+                                int *size,
+                                int *error)
+{
+    struct value_array *cached;
+    char * const *items;
+    char *copy = NULL;
+    char **array;
+    int i;
+
+    TRACE_FLOW_ENTRY();
+
+    /* Do we have the vo ? */
+    if (vo == NULL) {
+        TRACE_ERROR_NUMBER("Invalid argument.", EINVAL);
+        if (error) *error = EINVAL;
+        return NULL;
+    }
+
+    cached = get_array(vo,
+                       include ? VALUE_ARRAY_RAW_STRING : VALUE_ARRAY_STRING,
+                       sep, error);
+    if (cached == NULL) return NULL;
+
+    /* The caller gets its own copy of the cached array */
+    array = malloc((cached->size + 1) * sizeof(char *));
+    if (array == NULL) {
+        TRACE_ERROR_NUMBER("Failed to allocate memory.", ENOMEM);
+        if (error) *error = ENOMEM;
+        return NULL;
+    }
+
+    /* If count is 0 the strings are not needed */
+    if (cached->size) {
+        copy = malloc(cached->len);
+        if (copy == NULL) {
+            free(array);
+            TRACE_ERROR_NUMBER("Failed to allocate memory.", ENOMEM);
+            if (error) *error = ENOMEM;
+            return NULL;
+        }
+        memcpy(copy, cached->data, cached->len);
+    }
+
+    items = cached->items;
+    for (i = 0; i < cached->size; i++) {
+        array[i] = copy + (items[i] - (const char *)cached->data);
+    }
+    array[cached->size] = NULL;
+
+    if (size) *size = cached->size;
+
+    TRACE_FLOW_EXIT();
+    return array;
+}
 
+/* Get array of strings from item eliminating empty tokens */
+char **ini_get_string_config_array(struct value_obj *vo,
+                                   const char *sep, int *size, int *error)
+{
+    TRACE_FLOW_ENTRY();
+    return get_str_cfg_array(vo, EXCLUDE_EMPTY, sep, size, error);
+}
+/* Get array of strings from item preserving empty tokens */
+char **ini_get_raw_string_config_array(struct value_obj *vo,
+                                       const char *sep, int *size, int *error)
+{
+    TRACE_FLOW_ENTRY();
+    return get_str_cfg_array(vo, INCLUDE_EMPTY, sep, size, error);
+}
+
+/* Get array of strings owned by the value */
+const char * const *ini_get_string_config_array_view(struct value_obj *vo,
+                                                     const char *sep,
+                                                     int *size,
+                                                     int *error)
+{
+    struct value_array *cached;
+
+    TRACE_FLOW_ENTRY();
+
+    /* Do we have the vo ? */
+    if (vo == NULL) {
+        TRACE_ERROR_NUMBER("Invalid argument.", EINVAL);
+        if (error) *error = EINVAL;
+        return NULL;
+    }
+
+    cached = get_array(vo, VALUE_ARRAY_STRING, sep, error);
+    if (cached == NULL) return NULL;
+
+    if (size) *size = cached->size;
+
+    TRACE_FLOW_EXIT();
+    return cached->items;
+}
+
+/* Special function to free string config array */
+void ini_free_string_config_array(char **str_config)
+{
+    TRACE_FLOW_ENTRY();
+
+    if (str_config != NULL) {
+        if (*str_config != NULL) free(*str_config);
+        free(str_config);
+    }
+
+    TRACE_FLOW_EXIT();
+}
+
+/* Get numeric array cached in the value */
+static struct value_array *get_num_array(struct value_obj *vo,
+                                         enum value_array_type type,
+                                         int *size,
+                                         int *error)
+{
+    struct value_array *cached;
+
+    TRACE_FLOW_ENTRY();
+
+    /* Do we have the vo ? */
+    if (vo == NULL) {
+        TRACE_ERROR_NUMBER("Invalid value object argument.", EINVAL);
+        if (error) *error = EINVAL;
+        return NULL;
+    }
+
+    /* Do we have the size ? */
+    if (size == NULL) {
+        TRACE_ERROR_NUMBER("Invalid size argument.", EINVAL);
+        if (error) *error = EINVAL;
+        return NULL;
+    }
+
+    cached = get_array(vo, type, NULL, error);
+    if (cached == NULL) return NULL;
+
+    *size = cached->size;
+
+    TRACE_FLOW_EXIT();
+    return cached;
+}
+
+/* Copy numeric array for the caller */
+static void *copy_num_array(struct value_array *cached, int *error)
+{
+    void *array;
+
+    /* Empty array is still a valid allocation */
+    array = malloc(cached->len ? cached->len : sizeof(double));
+    if (array == NULL) {
+        TRACE_ERROR_NUMBER("Failed to allocate memory.", ENOMEM);
+        if (error) *error = ENOMEM;
+        return NULL;
+    }
+
+    memcpy(array, cached->items, cached->len);
+    return array;
+}
+
+/* Get an array of long values.
+ * NOTE: For now I leave just one function that returns numeric arrays.
+ * In future if we need other numeric types we can change it to do strtoll
+ * internally and wrap it for backward compatibility.
+ */
+long *ini_get_long_config_array(struct value_obj *vo, int *size, int *error)
+{
+    struct value_array *cached;
+
+    TRACE_FLOW_ENTRY();
+
+    cached = get_num_array(vo, VALUE_ARRAY_LONG, size, error);
+    if (cached == NULL) return NULL;
+
+    TRACE_FLOW_EXIT();
+    return copy_num_array(cached, error);
+}
+
+/* Get an array of double values */
+double *ini_get_double_config_array(struct value_obj *vo, int *size, int *error)
+{
+    struct value_array *cached;
+
+    TRACE_FLOW_ENTRY();
+
+    cached = get_num_array(vo, VALUE_ARRAY_DOUBLE, size, error);
+    if (cached == NULL) return NULL;
+
+    TRACE_FLOW_EXIT();
+    return copy_num_array(cached, error);
+}
+
+/* Get an array of long values owned by the value */
+const long *ini_get_long_config_array_view(struct value_obj *vo,
+                                           int *size,
+                                           int *error)
+{
+    struct value_array *cached;
+
+    TRACE_FLOW_ENTRY();
+
+    cached = get_num_array(vo, VALUE_ARRAY_LONG, size, error);
+    if (cached == NULL) return NULL;
+
+    TRACE_FLOW_EXIT();
+    return cached->items;
+}
+
+/* Get an array of double values owned by the value */
+const double *ini_get_double_config_array_view(struct value_obj *vo,
+                                               int *size,
+                                               int *error)
+{
+    struct value_array *cached;
+
+    TRACE_FLOW_ENTRY();
+
+    cached = get_num_array(vo, VALUE_ARRAY_DOUBLE, size, error);
+    if (cached == NULL) return NULL;
+
+    TRACE_FLOW_EXIT();
+    return cached->items;
 }
 
 /* Special function to free long config array */
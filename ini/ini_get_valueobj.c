@@ -37,73 +37,18 @@
 /* Macro co convert to HEX value */
 #define HEXVAL(c) (isdigit(c) ? (c - '0') : (tolower(c) - 'a') + 10)
 
-static int is_same_section(struct ini_cfgobj *ini_config,
-                           const char *section)
+/* Function to get value object using caller provided search state */
+int ini_get_config_valueobj_r(const char *section,
+                              const char *name,
+                              struct ini_cfgobj *ini_config,
+                              int mode,
+                              struct ini_cursor *cursor,
+                              struct value_obj **vo)
 {
-    int len = 0;
-
-    TRACE_FLOW_ENTRY();
-
-    /* If section is not defined it is different */
-    if (ini_config->section == NULL) {
-        TRACE_FLOW_RETURN(0);
-        return 0;
-    }
-
-    len = strlen(section);
-
-    /* If values are same this is the same section */
-    if ((strncasecmp(ini_config->section, section, ini_config->section_len) == 0) &&
-        (ini_config->section_len == len)) {
-        TRACE_FLOW_RETURN(1);
-        return 1;
-    }
-
-    /* Otherwise the values are different */
-    TRACE_FLOW_RETURN(0);
-    return 0;
-}
-
-static int is_same_name(struct ini_cfgobj *ini_config,
-                        const char *name,
-                        int name_len)
-{
-    TRACE_FLOW_ENTRY();
-
-    /* If name is not defined it is different */
-    if (ini_config->name == NULL) {
-        TRACE_FLOW_RETURN(0);
-        return 0;
-    }
-
-    /* If values are same this is the same value */
-    if ((strncasecmp(ini_config->name, name, ini_config->name_len) == 0) &&
-        (ini_config->name_len == name_len)) {
-        TRACE_FLOW_RETURN(1);
-        return 1;
-    }
-
-    /* Otherwise the values are different */
-    TRACE_FLOW_RETURN(0);
-    return 0;
-}
-
-
-/* Function to get value object from the configuration handle */
-int ini_get_config_valueobj(const char *section,
-                            const char *name,
-                            struct ini_cfgobj *ini_config,
-                            int mode,
-                            struct value_obj **vo)
-{
-    int error = EOK;
-    struct collection_item *section_handle = NULL;
-    struct collection_item *item = NULL;
-    struct collection_item *last_found = NULL;
+    const struct ini_index_key *key = NULL;
     const char *to_find;
     char default_section[] = INI_DEFAULT_SECTION;
-    uint64_t hash = 0;
-    int len = 0, name_len = 0;
+    uint32_t count = 0;
 
     TRACE_FLOW_ENTRY();
 
@@ -120,6 +65,11 @@ int ini_get_config_valueobj(const char *section,
         return EINVAL;
     }
 
+    if (cursor == NULL) {
+        TRACE_ERROR_NUMBER("Invalid argument cursor.", EINVAL);
+        return EINVAL;
+    }
+
     if ((mode < INI_GET_FIRST_VALUE) ||
         (mode > INI_GET_LAST_VALUE)) {
         TRACE_ERROR_NUMBER("Invalid argument mode:", mode);
@@ -139,118 +89,74 @@ int ini_get_config_valueobj(const char *section,
     TRACE_INFO_STRING("Getting Name:", name);
     TRACE_INFO_STRING("In Section:", to_find);
 
-    /* Make sure we start over if this is the first value */
-    if (mode == INI_GET_FIRST_VALUE) ini_config_clean_state(ini_config);
-
-    /* Are we looking in the same section ? */
-    if (!is_same_section(ini_config, to_find)) {
-
-        /* This is a different section */
-        ini_config_clean_state(ini_config);
-
-        /* Get Subcollection */
-        error = col_get_collection_reference(ini_config->cfg, &section_handle, to_find);
-        /* Check error */
-        if (error && (error != ENOENT)) {
-            TRACE_ERROR_NUMBER("Failed to get section", error);
-            return error;
-        }
+    /* The index gives us all values of the key in one step.
+     * The index is not modified here so any number of
+     * threads can search the same configuration.
+     */
+    key = ini_index_find(ini_config->index, to_find, name);
+    if (key == NULL) {
+        /* We have not found the value - return success */
+        cursor->key = NULL;
+        cursor->pos = 0;
+        TRACE_FLOW_EXIT();
+        return EOK;
+    }
+
+    /* Continue from the saved position only if we
+     * are asked for the next value of the same key,
+     * otherwise start over.
+     */
+    if ((mode != INI_GET_NEXT_VALUE) ||
+        (cursor->key != (const void *)key)) {
+        cursor->key = key;
+        cursor->pos = 0;
+    }
 
-        /* Did we find a section */
-        if ((error == ENOENT) || (section_handle == NULL)) {
-            /* We have not found section - return success */
-                TRACE_FLOW_EXIT();
-            return EOK;
-        }
+    count = ini_index_key_count(key);
 
-        /* Create an iterator */
-        error = col_bind_iterator(&(ini_config->iterator),
-                                  section_handle,
-                                  COL_TRAVERSE_ONELEVEL);
-        /* Make sure we free the section we found */
-        col_destroy_collection(section_handle);
-        /* Check error */
-        if (error) {
-            TRACE_ERROR_NUMBER("Failed to bind to section", error);
-            return error;
-        }
+    if (mode == INI_GET_LAST_VALUE) cursor->pos = count - 1;
 
-        /* Save section */
-        ini_config->section_len = strlen(to_find);
-        ini_config->section = strndup(to_find, ini_config->section_len);
-        /* Check error */
-        if (ini_config->section == NULL) {
-            TRACE_ERROR_NUMBER("Failed to save section name ", ENOMEM);
-            ini_config_clean_state(ini_config);
-            return ENOMEM;
-        }
+    if (cursor->pos >= count) {
+        /* There is nothing left to look for */
+        cursor->key = NULL;
+        cursor->pos = 0;
+        TRACE_FLOW_EXIT();
+        return EOK;
     }
 
-    hash = col_make_hash(name, 0, &name_len);
-
-    /* Check if this is the same name */
-    if (!is_same_name(ini_config, name, name_len)) {
-        TRACE_INFO_STRING("Saved name:", ini_config->name);
-        TRACE_INFO_STRING("Passed name:", name);
-        TRACE_INFO_NUMBER("Length of the saved name", ini_config->name_len);
-        TRACE_INFO_NUMBER("Length of the passed name", name_len);
-        col_rewind_iterator(ini_config->iterator);
-        free(ini_config->name);
-        ini_config->name = NULL;
-        ini_config->name_len = 0;
-    }
+    TRACE_INFO_STRING("Item is found", name);
+    *vo = ini_index_key_value(key, cursor->pos);
+    cursor->pos++;
 
-    /* Iterate through the section */
-    do {
+    TRACE_FLOW_EXIT();
+    return EOK;
+}
 
-        /* Loop through a collection */
-        error = col_iterate_collection(ini_config->iterator, &item);
-        if (error) {
-            TRACE_ERROR_NUMBER("Failed to iterate", error);
-            ini_config_clean_state(ini_config);
-            return error;
-        }
+/* Function to get value object from the configuration handle */
+int ini_get_config_valueobj(const char *section,
+                            const char *name,
+                            struct ini_cfgobj *ini_config,
+                            int mode,
+                            struct value_obj **vo)
+{
+    int error = EOK;
 
-        /* Are we done ? */
-        if (item == NULL) {
-            /* We looped to the end and found last value */
-            if ((mode == INI_GET_LAST_VALUE) && (last_found)) {
-                item = last_found;
-                break;
-            }
-            /* There is nothing left to look for */
-            ini_config_clean_state(ini_config);
-            TRACE_FLOW_EXIT();
-            return EOK;
-        }
+    TRACE_FLOW_ENTRY();
 
-        if ((hash == col_get_item_hash(item)) &&
-            (col_get_item_type(item) == COL_TYPE_BINARY) &&
-            (strncasecmp(col_get_item_property(item, &len), name, name_len) == 0) &&
-            (len == name_len)) {
-                TRACE_INFO_STRING("Item is found", name);
-                last_found = item;
-                if (mode == INI_GET_LAST_VALUE) continue;
-                break;
-        }
-    }
-    while(1);
-
-    if (!is_same_name(ini_config, name, name_len)) {
-        /* Save name */
-        ini_config->name_len = name_len;
-        ini_config->name = strndup(name, name_len);
-        /* Check error */
-        if (ini_config->name == NULL) {
-            TRACE_ERROR_NUMBER("Failed to save key name ", ENOMEM);
-            ini_config_clean_state(ini_config);
-            return ENOMEM;
-        }
+    if (ini_config == NULL) {
+        TRACE_ERROR_NUMBER("Invalid argument ini_config.", EINVAL);
+        return EINVAL;
     }
 
-    *vo = *((struct value_obj **)(col_get_item_data(item)));
+    /* Use the search state stored in the configuration object */
+    error = ini_get_config_valueobj_r(section,
+                                      name,
+                                      ini_config,
+                                      mode,
+                                      &(ini_config->cursor),
+                                      vo);
 
-    TRACE_FLOW_EXIT();
+    TRACE_FLOW_NUMBER("ini_get_config_valueobj returning", error);
     return error;
 }
 
@@ -260,10 +166,9 @@ static long long ini_get_llong_config_value(struct value_obj *vo,
                                             long long def,
                                             int *error)
 {
-    int err;
     const char *str;
     char *endptr;
-    long long val = 0;
+    struct value_cache cache;
 
     TRACE_FLOW_ENTRY();
 
@@ -276,32 +181,40 @@ static long long ini_get_llong_config_value(struct value_obj *vo,
 
     if (error) *error = EOK;
 
-    /* Get value - no error checking as we checked it above
-     * and there is no other reson the function could fail.
-     */
-    value_get_concatenated(vo, &str);
+    /* Parse the value only if it was not parsed before */
+    if (value_get_cache(vo, VALUE_CACHE_LLONG, &cache) != EOK) {
+        /* Get value - no error checking as we checked it above
+         * and there is no other reson the function could fail.
+         */
+        value_get_concatenated(vo, &str);
+
+        /* Try to parse the value */
+        errno = 0;
+        cache.val.llval = strtoll(str, &endptr, 10);
+        cache.error = errno;
+        if ((cache.error == 0) && (endptr == str)) cache.error = EIO;
+        cache.partial = (*endptr != '\0');
 
-    /* Try to parse the value */
-    errno = 0;
-    val = strtoll(str, &endptr, 10);
-    err = errno;
+        value_set_cache(vo, VALUE_CACHE_LLONG, &cache);
+    }
 
     /* Check for various possible errors */
-    if (err != 0) {
-        TRACE_ERROR_NUMBER("Conversion failed", err);
-        if (error) *error = err;
+    if (cache.error != 0) {
+        TRACE_ERROR_NUMBER("Conversion failed", cache.error);
+        if (error) *error = cache.error;
         return def;
     }
 
     /* Other error cases */
-    if ((endptr == str) || (strict && (*endptr != '\0'))) {
+    if (strict && cache.partial) {
         TRACE_ERROR_NUMBER("More characters or nothing processed", EIO);
         if (error) *error = EIO;
         return def;
     }
 
-    TRACE_FLOW_NUMBER("ini_get_llong_config_value returning", (long)val);
-    return val;
+    TRACE_FLOW_NUMBER("ini_get_llong_config_value returning",
+                      (long)cache.val.llval);
+    return cache.val.llval;
 }
 
 /* Get unsigned long long value from config value object */
@@ -310,10 +223,9 @@ static unsigned long long ini_get_ullong_config_value(struct value_obj *vo,
                                                       unsigned long long def,
                                                       int *error)
 {
-    int err;
     const char *str;
     char *endptr;
-    unsigned long long val = 0;
+    struct value_cache cache;
 
     TRACE_FLOW_ENTRY();
 
@@ -326,31 +238,39 @@ static unsigned long long ini_get_ullong_config_value(struct value_obj *vo,
 
     if (error) *error = EOK;
 
-    /* Get value - no error checking as we checked it above
-     * and there is no other reson the function could fail.
-     */
-    value_get_concatenated(vo, &str);
+    /* Parse the value only if it was not parsed before */
+    if (value_get_cache(vo, VALUE_CACHE_ULLONG, &cache) != EOK) {
+        /* Get value - no error checking as we checked it above
+         * and there is no other reson the function could fail.
+         */
+        value_get_concatenated(vo, &str);
 
-    errno = 0;
-    val = strtoull(str, &endptr, 10);
-    err = errno;
+        errno = 0;
+        cache.val.ullval = strtoull(str, &endptr, 10);
+        cache.error = errno;
+        if ((cache.error == 0) && (endptr == str)) cache.error = EIO;
+        cache.partial = (*endptr != '\0');
+
+        value_set_cache(vo, VALUE_CACHE_ULLONG, &cache);
+    }
 
     /* Check for various possible errors */
-    if (err != 0) {
-        TRACE_ERROR_NUMBER("Conversion failed", err);
-        if (error) *error = err;
+    if (cache.error != 0) {
+        TRACE_ERROR_NUMBER("Conversion failed", cache.error);
+        if (error) *error = cache.error;
         return def;
     }
 
     /* Other error cases */
-    if ((endptr == str) || (strict && (*endptr != '\0'))) {
+    if (strict && cache.partial) {
         TRACE_ERROR_NUMBER("More characters or nothing processed", EIO);
         if (error) *error = EIO;
         return def;
     }
 
-    TRACE_FLOW_NUMBER("ini_get_ullong_config_value returning", val);
-    return val;
+    TRACE_FLOW_NUMBER("ini_get_ullong_config_value returning",
+                      cache.val.ullval);
+    return cache.val.ullval;
 }
 
 
@@ -576,6 +496,7 @@ double ini_get_double_config_value(struct value_obj *vo,
     const char *str;
     char *endptr;
     double val = 0;
+    struct value_cache cache;
 
     TRACE_FLOW_ENTRY();
 
@@ -588,24 +509,35 @@ double ini_get_double_config_value(struct value_obj *vo,
 
     if (error) *error = EOK;
 
-    /* Get value - no error checking as we checked it above
-     * and there is no other reason the function could fail.
-     */
-    value_get_concatenated(vo, &str);
+    /* Parse the value only if it was not parsed before */
+    if (value_get_cache(vo, VALUE_CACHE_DOUBLE, &cache) != EOK) {
+        /* Get value - no error checking as we checked it above
+         * and there is no other reason the function could fail.
+         */
+        value_get_concatenated(vo, &str);
 
-    errno = 0;
-    val = strtod(str, &endptr);
+        errno = 0;
+        cache.val.dval = strtod(str, &endptr);
 
-    /* Check for various possible errors */
-    if ((errno == ERANGE) ||
-        ((errno != 0) && (val == 0)) ||
-        (endptr == str)) {
+        /* Check for various possible errors */
+        if ((errno == ERANGE) ||
+            ((errno != 0) && (cache.val.dval == 0)) ||
+            (endptr == str)) cache.error = EIO;
+        else cache.error = EOK;
+        cache.partial = (*endptr != '\0');
+
+        value_set_cache(vo, VALUE_CACHE_DOUBLE, &cache);
+    }
+
+    if (cache.error) {
         TRACE_ERROR_NUMBER("Conversion failed", EIO);
         if (error) *error = EIO;
         return def;
     }
 
-    if (strict && (*endptr != '\0')) {
+    val = cache.val.dval;
+
+    if (strict && cache.partial) {
         TRACE_ERROR_NUMBER("More characters than expected", EIO);
         if (error) *error = EIO;
         val = def;
@@ -621,6 +553,7 @@ unsigned char ini_get_bool_config_value(struct value_obj *vo,
 {
     const char *str;
     uint32_t len = 0;
+    struct value_cache cache;
 
     TRACE_FLOW_ENTRY();
 
@@ -633,27 +566,38 @@ unsigned char ini_get_bool_config_value(struct value_obj *vo,
 
     if (error) *error = EOK;
 
-    /* Get value - no error checking as we checked it above
-     * and there is no other reson the function could fail.
-     */
-    value_get_concatenated(vo, &str);
-    value_get_concatenated_len(vo, &len);
+    /* Parse the value only if it was not parsed before */
+    if (value_get_cache(vo, VALUE_CACHE_BOOL, &cache) != EOK) {
+        /* Get value - no error checking as we checked it above
+         * and there is no other reson the function could fail.
+         */
+        value_get_concatenated(vo, &str);
+        value_get_concatenated_len(vo, &len);
+
+        /* Try to parse the value */
+        cache.error = EOK;
+        cache.partial = 0;
+        if ((strncasecmp(str, "true", len) == 0) ||
+            (strncasecmp(str, "yes", len) == 0)) {
+            cache.val.bval = '\1';
+        }
+        else if ((strncasecmp(str, "false", len) == 0) ||
+                 (strncasecmp(str, "no", len) == 0)) {
+            cache.val.bval = '\0';
+        }
+        else cache.error = EIO;
 
-    /* Try to parse the value */
-    if ((strncasecmp(str, "true", len) == 0) ||
-        (strncasecmp(str, "yes", len) == 0)) {
-        TRACE_FLOW_STRING("Returning", "true");
-        return '\1';
+        value_set_cache(vo, VALUE_CACHE_BOOL, &cache);
     }
-    else if ((strncasecmp(str, "false", len) == 0) ||
-             (strncasecmp(str, "no", len) == 0)) {
-        TRACE_FLOW_STRING("Returning", "false");
-        return '\0';
+
+    if (cache.error) {
+        TRACE_ERROR_STRING("Returning", "error");
+        if (error) *error = EIO;
+        return def;
     }
 
-    TRACE_ERROR_STRING("Returning", "error");
-    if (error) *error = EIO;
-    return def;
+    TRACE_FLOW_STRING("Returning", cache.val.bval ? "true" : "false");
+    return cache.val.bval;
 }
 
 /* Return a string out of the value */
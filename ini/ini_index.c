@@ -0,0 +1,1179 @@
+/*
+    INI LIBRARY
+
+    Index over the sections and keys of the configuration object.
+
+    Copyright (C) Dmitri Pal <dpal@redhat.com> 2026
+
+    INI Library is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    INI Library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with INI Library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "config.h"
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+#include "trace.h"
+#include "collection.h"
+#include "ini_defines.h"
+#include "ini_valueobj.h"
+#include "ini_config_priv.h"
+#include "ini_index.h"
+
+/* Minimal number of slots in a table */
+#define INI_INDEX_MIN_SLOTS 8
+
+/* All values of one key in a section.
+ * Slot is empty if first is NULL.
+ */
+struct ini_index_key {
+    struct collection_item *first;
+    struct collection_item **items;
+    uint32_t count;
+};
+
+/* One section */
+struct ini_index_sec {
+    uint64_t hash;
+    /* Hash of all keys and values */
+    uint64_t content_hash;
+    /* Reference item in the top collection */
+    struct collection_item *ref;
+    /* Key table */
+    uint32_t size;
+    struct ini_index_key *keys;
+    /* Items of all keys grouped by key */
+    struct collection_item **items;
+};
+
+/* Table of sections */
+struct ini_index {
+    uint32_t size;
+    uint32_t count;
+    struct ini_index_sec **slots;
+};
+
+/* Items of one collection level */
+struct ini_item_table {
+    int type;
+    uint32_t size;
+    uint32_t count;
+    struct collection_item **slots;
+    /* Number of items with the name of the slot */
+    uint32_t *dups;
+};
+
+/* Name in the name set, slot is empty if name is NULL */
+struct ini_name_entry {
+    uint64_t hash;
+    int len;
+    char *name;
+};
+
+/* Set of names */
+struct ini_name_set {
+    int case_insensitive;
+    uint32_t size;
+    uint32_t count;
+    struct ini_name_entry *slots;
+};
+
+/* Get the table size for the number of entries */
+static uint32_t index_table_size(uint32_t count)
+{
+    uint32_t size = INI_INDEX_MIN_SLOTS;
+
+    /* Keep the table at most half full */
+    while (size < count * 2) size *= 2;
+
+    return size;
+}
+
+/* Check if the item has the given name */
+static int index_item_match(struct collection_item *item,
+                            uint64_t hash,
+                            const char *name,
+                            int name_len)
+{
+    const char *property;
+    int len = 0;
+
+    if (col_get_item_hash(item) != hash) return 0;
+
+    property = col_get_item_property(item, &len);
+
+    return ((len == name_len) &&
+            (strncasecmp(property, name, name_len) == 0));
+}
+
+/* Find the slot for the key in the section.
+ * Returns the slot with the key or an empty slot
+ * where the key should be inserted.
+ */
+static struct ini_index_key *index_key_slot(struct ini_index_key *keys,
+                                            uint32_t size,
+                                            uint64_t hash,
+                                            const char *name,
+                                            int name_len)
+{
+    uint32_t i;
+
+    i = (uint32_t)(hash & (size - 1));
+    while ((keys[i].first) &&
+           (!index_item_match(keys[i].first, hash, name, name_len))) {
+        i = (i + 1) & (size - 1);
+    }
+
+    return &keys[i];
+}
+
+/* Find the slot for the section.
+ * Returns the index of the slot with the section or
+ * of an empty slot where the section should be inserted.
+ */
+static uint32_t index_sec_slot(struct ini_index *index,
+                               uint64_t hash,
+                               const char *name,
+                               int name_len)
+{
+    uint32_t i;
+
+    i = (uint32_t)(hash & (index->size - 1));
+    while ((index->slots[i]) &&
+           (!index_item_match(index->slots[i]->ref, hash, name, name_len))) {
+        i = (i + 1) & (index->size - 1);
+    }
+
+    return i;
+}
+
+/* Free section entry */
+static void index_sec_destroy(struct ini_index_sec *isec)
+{
+    TRACE_FLOW_ENTRY();
+
+    if (isec) {
+        free(isec->keys);
+        free(isec->items);
+        free(isec);
+    }
+
+    TRACE_FLOW_EXIT();
+}
+
+/* Add the comment lines of the value to the hash */
+static uint64_t index_hash_comment(uint64_t hash, struct value_obj *vo)
+{
+    struct ini_comment *ic;
+    uint32_t num = 0;
+    uint32_t len = 0;
+    uint32_t i;
+    char *line;
+
+    ic = value_get_comment(vo);
+    if (ic) ini_comment_get_numlines(ic, &num);
+
+    /* Count keeps a comment line apart from the next key */
+    hash = ini_hash_data(hash, &num, sizeof(num));
+    for (i = 0; i < num; i++) {
+        if (ini_comment_get_line(ic, i, &line, &len) == EOK)
+            hash = ini_hash_data(hash, line, len);
+    }
+
+    return hash;
+}
+
+/* Build key table for the section */
+static int index_sec_fill(struct ini_index_sec *isec)
+{
+    int error = EOK;
+    struct collection_item *sec = NULL;
+    struct collection_iterator *iterator = NULL;
+    struct collection_item *item = NULL;
+    struct ini_index_key *keys = NULL;
+    struct ini_index_key *key = NULL;
+    struct collection_item **items = NULL;
+    struct value_obj *vo = NULL;
+    const char *name;
+    const char *value;
+    int name_len = 0;
+    uint32_t value_len = 0;
+    uint64_t content_hash = INI_HASH_INIT;
+    unsigned count = 0;
+    uint32_t size;
+    uint32_t offset = 0;
+    uint32_t i;
+    int pass;
+
+    TRACE_FLOW_ENTRY();
+
+    sec = *((struct collection_item **)(col_get_item_data(isec->ref)));
+
+    error = col_get_collection_count(sec, &count);
+    if (error) {
+        TRACE_ERROR_NUMBER("Failed to get section size", error);
+        return error;
+    }
+
+    size = index_table_size(count);
+
+    keys = calloc(size, sizeof(struct ini_index_key));
+    if (!keys) {
+        TRACE_ERROR_NUMBER("Failed to allocate key table", ENOMEM);
+        return ENOMEM;
+    }
+
+    /* Count includes the header so there is always room */
+    items = malloc(count * sizeof(struct collection_item *));
+    if (!items) {
+        TRACE_ERROR_NUMBER("Failed to allocate item table", ENOMEM);
+        free(keys);
+        return ENOMEM;
+    }
+
+    error = col_bind_iterator(&iterator, sec, COL_TRAVERSE_ONELEVEL);
+    if (error) {
+        TRACE_ERROR_NUMBER("Failed to bind to section", error);
+        free(keys);
+        free(items);
+        return error;
+    }
+
+    /* First pass counts values of every key,
+     * second pass puts items in place
+     * preserving the order of the duplicates.
+     */
+    for (pass = 0; pass < 2; pass++) {
+        for (;;) {
+            error = col_iterate_collection(iterator, &item);
+            if (error) {
+                TRACE_ERROR_NUMBER("Failed to iterate", error);
+                col_unbind_iterator(iterator);
+                free(keys);
+                free(items);
+                return error;
+            }
+
+            if (item == NULL) break;
+
+            if (col_get_item_type(item) != COL_TYPE_BINARY) continue;
+
+            name = col_get_item_property(item, &name_len);
+            key = index_key_slot(keys, size,
+                                 col_get_item_hash(item),
+                                 name, name_len);
+            if (pass == 0) {
+                if (!(key->first)) key->first = item;
+
+                /* Hash keys, values and comments to detect changes */
+                vo = *((struct value_obj **)(col_get_item_data(item)));
+                value_get_concatenated(vo, &value);
+                value_get_concatenated_len(vo, &value_len);
+                content_hash = ini_hash_data(content_hash, name, name_len + 1);
+                content_hash = ini_hash_data(content_hash, value, value_len + 1);
+                content_hash = index_hash_comment(content_hash, vo);
+            }
+            else key->items[key->count] = item;
+
+            key->count++;
+        }
+
+        if (pass == 0) {
+            /* Lay out the item groups */
+            for (i = 0; i < size; i++) {
+                if (keys[i].first) {
+                    keys[i].items = items + offset;
+                    offset += keys[i].count;
+                    keys[i].count = 0;
+                }
+            }
+            col_rewind_iterator(iterator);
+        }
+    }
+
+    col_unbind_iterator(iterator);
+
+    free(isec->keys);
+    free(isec->items);
+    isec->keys = keys;
+    isec->items = items;
+    isec->size = size;
+    isec->content_hash = content_hash;
+
+    TRACE_FLOW_EXIT();
+    return EOK;
+}
+
+/* Resize the section table if needed */
+static int index_grow(struct ini_index *index, uint32_t count)
+{
+    struct ini_index_sec **slots = NULL;
+    struct ini_index_sec *isec = NULL;
+    uint32_t old_size;
+    uint32_t size;
+    uint32_t i;
+    uint32_t j;
+
+    TRACE_FLOW_ENTRY();
+
+    size = index_table_size(count);
+    if (size <= index->size) {
+        TRACE_FLOW_EXIT();
+        return EOK;
+    }
+
+    slots = calloc(size, sizeof(struct ini_index_sec *));
+    if (!slots) {
+        TRACE_ERROR_NUMBER("Failed to allocate section table", ENOMEM);
+        return ENOMEM;
+    }
+
+    old_size = index->size;
+    for (i = 0; i < old_size; i++) {
+        isec = index->slots[i];
+        if (!isec) continue;
+        j = (uint32_t)(isec->hash & (size - 1));
+        while (slots[j]) j = (j + 1) & (size - 1);
+        slots[j] = isec;
+    }
+
+    free(index->slots);
+    index->slots = slots;
+    index->size = size;
+
+    TRACE_FLOW_EXIT();
+    return EOK;
+}
+
+/* Remove the section at the given slot */
+static void index_remove_slot(struct ini_index *index, uint32_t i)
+{
+    uint32_t j;
+    uint32_t home;
+
+    TRACE_FLOW_ENTRY();
+
+    index_sec_destroy(index->slots[i]);
+    index->slots[i] = NULL;
+    index->count--;
+
+    /* Move back the entries that were displaced
+     * by the removed one so the probing chains stay intact.
+     */
+    j = i;
+    for (;;) {
+        j = (j + 1) & (index->size - 1);
+        if (!(index->slots[j])) break;
+
+        home = (uint32_t)(index->slots[j]->hash & (index->size - 1));
+        if (((j > i) && ((home <= i) || (home > j))) ||
+            ((j < i) && ((home <= i) && (home > j)))) {
+            index->slots[i] = index->slots[j];
+            index->slots[j] = NULL;
+            i = j;
+        }
+    }
+
+    TRACE_FLOW_EXIT();
+}
+
+/* Add section to the index or refresh it */
+static int index_add_section(struct ini_index *index,
+                             struct collection_item *ref)
+{
+    int error = EOK;
+    struct ini_index_sec *isec = NULL;
+    const char *name;
+    int name_len = 0;
+    uint64_t hash;
+    uint32_t i;
+
+    TRACE_FLOW_ENTRY();
+
+    error = index_grow(index, index->count + 1);
+    if (error) {
+        TRACE_ERROR_NUMBER("Failed to grow index", error);
+        return error;
+    }
+
+    name = col_get_item_property(ref, &name_len);
+    hash = col_get_item_hash(ref);
+
+    i = index_sec_slot(index, hash, name, name_len);
+    isec = index->slots[i];
+    if (isec) {
+        /* Section with the same name is already indexed.
+         * Refresh it only if this is the same section,
+         * otherwise the first section wins as it does
+         * in the collection search.
+         */
+        if (isec->ref != ref) {
+            TRACE_FLOW_EXIT();
+            return EOK;
+        }
+    }
+    else {
+        isec = calloc(1, sizeof(struct ini_index_sec));
+        if (!isec) {
+            TRACE_ERROR_NUMBER("Failed to allocate section", ENOMEM);
+            return ENOMEM;
+        }
+        isec->hash = hash;
+        isec->ref = ref;
+    }
+
+    error = index_sec_fill(isec);
+    if (error) {
+        TRACE_ERROR_NUMBER("Failed to index section", error);
+        if (index->slots[i]) index_remove_slot(index, i);
+        else index_sec_destroy(isec);
+        return error;
+    }
+
+    if (!(index->slots[i])) {
+        index->slots[i] = isec;
+        index->count++;
+    }
+
+    TRACE_FLOW_EXIT();
+    return EOK;
+}
+
+/* Drop all sections */
+static void index_clear(struct ini_index *index)
+{
+    uint32_t i;
+
+    TRACE_FLOW_ENTRY();
+
+    for (i = 0; i < index->size; i++) {
+        index_sec_destroy(index->slots[i]);
+        index->slots[i] = NULL;
+    }
+    index->count = 0;
+
+    TRACE_FLOW_EXIT();
+}
+
+/* Create an empty index */
+int ini_index_create(struct ini_index **index)
+{
+    struct ini_index *new_index = NULL;
+
+    TRACE_FLOW_ENTRY();
+
+    if (!index) {
+        TRACE_ERROR_NUMBER("Invalid argument", EINVAL);
+        return EINVAL;
+    }
+
+    new_index = malloc(sizeof(struct ini_index));
+    if (!new_index) {
+        TRACE_ERROR_NUMBER("Failed to allocate memory", ENOMEM);
+        return ENOMEM;
+    }
+
+    new_index->size = INI_INDEX_MIN_SLOTS;
+    new_index->count = 0;
+    new_index->slots = calloc(new_index->size,
+                              sizeof(struct ini_index_sec *));
+    if (!(new_index->slots)) {
+        TRACE_ERROR_NUMBER("Failed to allocate memory", ENOMEM);
+        free(new_index);
+        return ENOMEM;
+    }
+
+    *index = new_index;
+
+    TRACE_FLOW_EXIT();
+    return EOK;
+}
+
+/* Destroy index */
+void ini_index_destroy(struct ini_index *index)
+{
+    TRACE_FLOW_ENTRY();
+
+    if (index) {
+        index_clear(index);
+        free(index->slots);
+        free(index);
+    }
+
+    TRACE_FLOW_EXIT();
+}
+
+/* Rebuild the whole index */
+int ini_index_build(struct ini_index *index,
+                    struct collection_item *cfg)
+{
+    int error = EOK;
+    struct collection_iterator *iterator = NULL;
+    struct collection_item *item = NULL;
+    unsigned count = 0;
+
+    TRACE_FLOW_ENTRY();
+
+    if ((!index) || (!cfg)) {
+        TRACE_ERROR_NUMBER("Invalid argument", EINVAL);
+        return EINVAL;
+    }
+
+    index_clear(index);
+
+    error = col_get_collection_count(cfg, &count);
+    if (error) {
+        TRACE_ERROR_NUMBER("Failed to get collection size", error);
+        return error;
+    }
+
+    error = index_grow(index, count);
+    if (error) {
+        TRACE_ERROR_NUMBER("Failed to grow index", error);
+        return error;
+    }
+
+    error = col_bind_iterator(&iterator, cfg, COL_TRAVERSE_ONELEVEL);
+    if (error) {
+        TRACE_ERROR_NUMBER("Failed to bind iterator", error);
+        return error;
+    }
+
+    for (;;) {
+        error = col_iterate_collection(iterator, &item);
+        if (error) {
+            TRACE_ERROR_NUMBER("Failed to iterate", error);
+            break;
+        }
+
+        if (item == NULL) break;
+
+        if (col_get_item_type(item) != COL_TYPE_COLLECTIONREF) continue;
+
+        error = index_add_section(index, item);
+        if (error) {
+            TRACE_ERROR_NUMBER("Failed to index section", error);
+            break;
+        }
+    }
+
+    col_unbind_iterator(iterator);
+
+    if (error) index_clear(index);
+
+    TRACE_FLOW_EXIT();
+    return error;
+}
+
+/* Reindex one section */
+int ini_index_update_section(struct ini_index *index,
+                             struct collection_item *cfg,
+                             const char *section)
+{
+    int error = EOK;
+    struct collection_item *item = NULL;
+
+    TRACE_FLOW_ENTRY();
+
+    if ((!index) || (!cfg) || (!section)) {
+        TRACE_ERROR_NUMBER("Invalid argument", EINVAL);
+        return EINVAL;
+    }
+
+    error = col_get_item(cfg,
+                         section,
+                         COL_TYPE_COLLECTIONREF,
+                         COL_TRAVERSE_ONELEVEL,
+                         &item);
+    if (error) {
+        TRACE_ERROR_NUMBER("Search for section failed.", error);
+        return error;
+    }
+
+    /* Drop the old entry if the section is gone or
+     * the name now belongs to a different section.
+     */
+    if ((!item) ||
+        (ini_index_find_section(index, section) !=
+         *((struct collection_item **)col_get_item_data(item)))) {
+        ini_index_remove_section(index, section);
+    }
+
+    if (!item) {
+        TRACE_FLOW_EXIT();
+        return EOK;
+    }
+
+    error = index_add_section(index, item);
+    if (error) {
+        TRACE_ERROR_NUMBER("Failed to index section", error);
+        return error;
+    }
+
+    TRACE_FLOW_EXIT();
+    return EOK;
+}
+
+/* Remove section from the index */
+void ini_index_remove_section(struct ini_index *index,
+                              const char *section)
+{
+    uint64_t hash;
+    int name_len = 0;
+    uint32_t i;
+
+    TRACE_FLOW_ENTRY();
+
+    if ((index) && (section)) {
+        hash = col_make_hash(section, 0, &name_len);
+        i = index_sec_slot(index, hash, section, name_len);
+        if (index->slots[i]) index_remove_slot(index, i);
+    }
+
+    TRACE_FLOW_EXIT();
+}
+
+/* Find section collection */
+struct collection_item *ini_index_find_section(struct ini_index *index,
+                                               const char *section)
+{
+    struct ini_index_sec *isec = NULL;
+    uint64_t hash;
+    int name_len = 0;
+
+    TRACE_FLOW_ENTRY();
+
+    if ((!index) || (!section)) {
+        TRACE_FLOW_EXIT();
+        return NULL;
+    }
+
+    hash = col_make_hash(section, 0, &name_len);
+    isec = index->slots[index_sec_slot(index, hash, section, name_len)];
+    if (!isec) {
+        TRACE_FLOW_EXIT();
+        return NULL;
+    }
+
+    TRACE_FLOW_EXIT();
+    return *((struct collection_item **)(col_get_item_data(isec->ref)));
+}
+
+/* Find section entry */
+const struct ini_index_sec *ini_index_find_sec(struct ini_index *index,
+                                               const char *section)
+{
+    struct ini_index_sec *isec = NULL;
+    uint64_t hash;
+    int name_len = 0;
+
+    TRACE_FLOW_ENTRY();
+
+    if ((!index) || (!section)) {
+        TRACE_FLOW_EXIT();
+        return NULL;
+    }
+
+    hash = col_make_hash(section, 0, &name_len);
+    isec = index->slots[index_sec_slot(index, hash, section, name_len)];
+    if (!isec) {
+        TRACE_INFO_STRING("Section not found:", section);
+    }
+
+    TRACE_FLOW_EXIT();
+    return isec;
+}
+
+/* Find key in the section entry */
+const struct ini_index_key *ini_index_find_key(const struct ini_index_sec *isec,
+                                               const char *name)
+{
+    struct ini_index_key *key = NULL;
+    uint64_t hash;
+    int name_len = 0;
+
+    TRACE_FLOW_ENTRY();
+
+    if ((!isec) || (!name)) {
+        TRACE_FLOW_EXIT();
+        return NULL;
+    }
+
+    hash = col_make_hash(name, 0, &name_len);
+    key = index_key_slot(isec->keys, isec->size, hash, name, name_len);
+    if (!(key->first)) {
+        TRACE_INFO_STRING("Key not found:", name);
+        TRACE_FLOW_EXIT();
+        return NULL;
+    }
+
+    TRACE_FLOW_EXIT();
+    return key;
+}
+
+/* Find key in the section */
+const struct ini_index_key *ini_index_find(struct ini_index *index,
+                                           const char *section,
+                                           const char *name)
+{
+    const struct ini_index_key *key = NULL;
+
+    TRACE_FLOW_ENTRY();
+
+    key = ini_index_find_key(ini_index_find_sec(index, section), name);
+
+    TRACE_FLOW_EXIT();
+    return key;
+}
+
+/* Number of values */
+uint32_t ini_index_key_count(const struct ini_index_key *key)
+{
+    if (!key) return 0;
+    return key->count;
+}
+
+/* Get value object by position */
+struct value_obj *ini_index_key_value(const struct ini_index_key *key,
+                                      uint32_t pos)
+{
+    if ((!key) || (pos >= key->count)) return NULL;
+
+    return *((struct value_obj **)(col_get_item_data(key->items[pos])));
+}
+
+/* Hash of the keys and values of the section */
+uint64_t ini_index_sec_content_hash(const struct ini_index_sec *isec)
+{
+    if (!isec) return 0;
+    return isec->content_hash;
+}
+
+/* Find the slot for the item name in the item table */
+static uint32_t item_table_slot(struct ini_item_table *table,
+                                uint64_t hash,
+                                const char *name,
+                                int name_len)
+{
+    uint32_t i;
+
+    i = (uint32_t)(hash & (table->size - 1));
+    while ((table->slots[i]) &&
+           (!index_item_match(table->slots[i], hash, name, name_len))) {
+        i = (i + 1) & (table->size - 1);
+    }
+
+    return i;
+}
+
+/* Resize the item table if needed */
+static int item_table_grow(struct ini_item_table *table, uint32_t count)
+{
+    struct collection_item **slots = NULL;
+    uint32_t *dups = NULL;
+    uint32_t size;
+    uint32_t i;
+    uint32_t j;
+
+    size = index_table_size(count);
+    if (size <= table->size) return EOK;
+
+    slots = calloc(size, sizeof(struct collection_item *));
+    dups = calloc(size, sizeof(uint32_t));
+    if ((!slots) || (!dups)) {
+        TRACE_ERROR_NUMBER("Failed to allocate item table", ENOMEM);
+        free(slots);
+        free(dups);
+        return ENOMEM;
+    }
+
+    for (i = 0; i < table->size; i++) {
+        if (!(table->slots[i])) continue;
+        j = (uint32_t)(col_get_item_hash(table->slots[i]) & (size - 1));
+        while (slots[j]) j = (j + 1) & (size - 1);
+        slots[j] = table->slots[i];
+        dups[j] = table->dups[i];
+    }
+
+    free(table->slots);
+    free(table->dups);
+    table->slots = slots;
+    table->dups = dups;
+    table->size = size;
+
+    return EOK;
+}
+
+/* Create table of the items of one collection level */
+int ini_item_table_create(struct collection_item *col,
+                          int type,
+                          struct ini_item_table **table)
+{
+    int error = EOK;
+    struct ini_item_table *new_table = NULL;
+    struct collection_iterator *iterator = NULL;
+    struct collection_item *item = NULL;
+    unsigned count = 0;
+
+    TRACE_FLOW_ENTRY();
+
+    if ((!col) || (!table)) {
+        TRACE_ERROR_NUMBER("Invalid argument", EINVAL);
+        return EINVAL;
+    }
+
+    error = col_get_collection_count(col, &count);
+    if (error) {
+        TRACE_ERROR_NUMBER("Failed to get collection size", error);
+        return error;
+    }
+
+    new_table = malloc(sizeof(struct ini_item_table));
+    if (!new_table) {
+        TRACE_ERROR_NUMBER("Failed to allocate memory", ENOMEM);
+        return ENOMEM;
+    }
+
+    new_table->type = type;
+    new_table->count = 0;
+    new_table->size = index_table_size(count);
+    new_table->slots = calloc(new_table->size,
+                              sizeof(struct collection_item *));
+    new_table->dups = calloc(new_table->size, sizeof(uint32_t));
+    if ((!(new_table->slots)) || (!(new_table->dups))) {
+        TRACE_ERROR_NUMBER("Failed to allocate memory", ENOMEM);
+        ini_item_table_destroy(new_table);
+        return ENOMEM;
+    }
+
+    error = col_bind_iterator(&iterator, col, COL_TRAVERSE_ONELEVEL);
+    if (error) {
+        TRACE_ERROR_NUMBER("Failed to bind iterator", error);
+        ini_item_table_destroy(new_table);
+        return error;
+    }
+
+    for (;;) {
+        error = col_iterate_collection(iterator, &item);
+        if (error) {
+            TRACE_ERROR_NUMBER("Failed to iterate", error);
+            break;
+        }
+
+        if (item == NULL) break;
+
+        error = ini_item_table_add(new_table, item);
+        if (error) {
+            TRACE_ERROR_NUMBER("Failed to add item", error);
+            break;
+        }
+    }
+
+    col_unbind_iterator(iterator);
+
+    if (error) {
+        ini_item_table_destroy(new_table);
+        return error;
+    }
+
+    *table = new_table;
+
+    TRACE_FLOW_EXIT();
+    return EOK;
+}
+
+/* Destroy item table */
+void ini_item_table_destroy(struct ini_item_table *table)
+{
+    TRACE_FLOW_ENTRY();
+
+    if (table) {
+        free(table->slots);
+        free(table->dups);
+        free(table);
+    }
+
+    TRACE_FLOW_EXIT();
+}
+
+/* Add item to the table */
+int ini_item_table_add(struct ini_item_table *table,
+                       struct collection_item *item)
+{
+    int error = EOK;
+    const char *name;
+    int name_len = 0;
+    uint32_t i;
+
+    if (col_get_item_type(item) != table->type) return EOK;
+
+    error = item_table_grow(table, table->count + 1);
+    if (error) {
+        TRACE_ERROR_NUMBER("Failed to grow item table", error);
+        return error;
+    }
+
+    name = col_get_item_property(item, &name_len);
+    i = item_table_slot(table, col_get_item_hash(item), name, name_len);
+
+    /* The first item with the name is the one
+     * the collection search would find.
+     */
+    if (!(table->slots[i])) {
+        table->slots[i] = item;
+        table->count++;
+    }
+    table->dups[i]++;
+
+    return EOK;
+}
+
+/* Find the first item with the name in the collection again */
+static void item_table_refresh(struct ini_item_table *table,
+                               struct collection_item *col,
+                               uint32_t i)
+{
+    struct collection_item *item = NULL;
+    const char *name;
+
+    name = col_get_item_property(table->slots[i], NULL);
+    if ((col_get_item(col, name, table->type,
+                      COL_TRAVERSE_ONELEVEL, &item) == EOK) && (item)) {
+        table->slots[i] = item;
+    }
+}
+
+/* Add the item that was inserted at any position */
+int ini_item_table_insert(struct ini_item_table *table,
+                          struct collection_item *col,
+                          struct collection_item *item)
+{
+    int error = EOK;
+    const char *name;
+    int name_len = 0;
+    uint32_t i;
+
+    error = ini_item_table_add(table, item);
+    if ((error) || (col_get_item_type(item) != table->type)) return error;
+
+    name = col_get_item_property(item, &name_len);
+    i = item_table_slot(table, col_get_item_hash(item), name, name_len);
+
+    /* The new item might be ahead of the one in the table */
+    if (table->slots[i] != item) item_table_refresh(table, col, i);
+
+    return EOK;
+}
+
+/* Remove the item that was taken out of the collection */
+void ini_item_table_remove(struct ini_item_table *table,
+                           struct collection_item *col,
+                           struct collection_item *item)
+{
+    const char *name;
+    int name_len = 0;
+    uint32_t i;
+    uint32_t j;
+    uint32_t k;
+
+    if (col_get_item_type(item) != table->type) return;
+
+    name = col_get_item_property(item, &name_len);
+    i = item_table_slot(table, col_get_item_hash(item), name, name_len);
+    if (!(table->slots[i])) return;
+
+    table->dups[i]--;
+    if (table->dups[i]) {
+        /* Another item with the name becomes the first one */
+        if (table->slots[i] == item) item_table_refresh(table, col, i);
+        return;
+    }
+
+    table->slots[i] = NULL;
+    table->count--;
+
+    /* Move back the items that would not be found
+     * past the empty slot.
+     */
+    j = i;
+    for (;;) {
+        j = (j + 1) & (table->size - 1);
+        if (!(table->slots[j])) break;
+        k = (uint32_t)(col_get_item_hash(table->slots[j]) &
+                       (table->size - 1));
+        if ((i <= j) ? ((k <= i) || (k > j)) : ((k <= i) && (k > j))) {
+            table->slots[i] = table->slots[j];
+            table->dups[i] = table->dups[j];
+            table->slots[j] = NULL;
+            table->dups[j] = 0;
+            i = j;
+        }
+    }
+}
+
+/* Find item by name */
+struct collection_item *ini_item_table_find(struct ini_item_table *table,
+                                            const char *name)
+{
+    uint64_t hash;
+    int name_len = 0;
+
+    hash = col_make_hash(name, 0, &name_len);
+
+    return table->slots[item_table_slot(table, hash, name, name_len)];
+}
+
+/* Find the slot for the name in the name set.
+ * Returns the slot with the name or an empty slot
+ * where the name should be inserted.
+ */
+static struct ini_name_entry *name_set_slot(struct ini_name_entry *slots,
+                                            uint32_t size,
+                                            int case_insensitive,
+                                            uint64_t hash,
+                                            const char *name,
+                                            int len)
+{
+    uint32_t i;
+
+    /* Most of the mismatches are caught by the hash
+     * and the length without touching the strings */
+    i = (uint32_t)(hash & (size - 1));
+    while (slots[i].name) {
+        if ((slots[i].hash == hash) && (slots[i].len == len) &&
+            ((case_insensitive ? strncasecmp(slots[i].name, name, len) :
+                                 memcmp(slots[i].name, name, len)) == 0)) break;
+        i = (i + 1) & (size - 1);
+    }
+
+    return &slots[i];
+}
+
+/* Create name set */
+int ini_name_set_create(uint32_t count,
+                        int case_insensitive,
+                        struct ini_name_set **set)
+{
+    struct ini_name_set *new_set = NULL;
+
+    TRACE_FLOW_ENTRY();
+
+    if (!set) {
+        TRACE_ERROR_NUMBER("Invalid argument", EINVAL);
+        return EINVAL;
+    }
+
+    new_set = malloc(sizeof(struct ini_name_set));
+    if (!new_set) {
+        TRACE_ERROR_NUMBER("Failed to allocate memory", ENOMEM);
+        return ENOMEM;
+    }
+
+    new_set->case_insensitive = case_insensitive;
+    new_set->count = 0;
+    new_set->size = index_table_size(count);
+    new_set->slots = calloc(new_set->size, sizeof(struct ini_name_entry));
+    if (!(new_set->slots)) {
+        TRACE_ERROR_NUMBER("Failed to allocate memory", ENOMEM);
+        free(new_set);
+        return ENOMEM;
+    }
+
+    *set = new_set;
+
+    TRACE_FLOW_EXIT();
+    return EOK;
+}
+
+/* Destroy name set */
+void ini_name_set_destroy(struct ini_name_set *set)
+{
+    uint32_t i;
+
+    TRACE_FLOW_ENTRY();
+
+    if (set) {
+        for (i = 0; i < set->size; i++) free(set->slots[i].name);
+        free(set->slots);
+        free(set);
+    }
+
+    TRACE_FLOW_EXIT();
+}
+
+/* Add name to the set */
+int ini_name_set_add(struct ini_name_set *set, const char *name)
+{
+    struct ini_name_entry *slots = NULL;
+    struct ini_name_entry *entry = NULL;
+    uint64_t hash;
+    int len = 0;
+    uint32_t size;
+    uint32_t i;
+
+    if ((!set) || (!name)) {
+        TRACE_ERROR_NUMBER("Invalid argument", EINVAL);
+        return EINVAL;
+    }
+
+    size = index_table_size(set->count + 1);
+    if (size > set->size) {
+        slots = calloc(size, sizeof(struct ini_name_entry));
+        if (!slots) {
+            TRACE_ERROR_NUMBER("Failed to allocate name set", ENOMEM);
+            return ENOMEM;
+        }
+
+        for (i = 0; i < set->size; i++) {
+            if (!(set->slots[i].name)) continue;
+            *name_set_slot(slots, size, set->case_insensitive,
+                           set->slots[i].hash,
+                           set->slots[i].name,
+                           set->slots[i].len) = set->slots[i];
+        }
+
+        free(set->slots);
+        set->slots = slots;
+        set->size = size;
+    }
+
+    /* The hash ignores case so it works for both kinds of sets */
+    hash = col_make_hash(name, 0, &len);
+    entry = name_set_slot(set->slots, set->size,
+                          set->case_insensitive, hash, name, len);
+    if (entry->name) return EOK;
+
+    entry->name = strndup(name, len);
+    if (!(entry->name)) {
+        TRACE_ERROR_NUMBER("Failed to copy name", ENOMEM);
+        return ENOMEM;
+    }
+    entry->hash = hash;
+    entry->len = len;
+    set->count++;
+
+    return EOK;
+}
+
+/* Check if the name is in the set */
+int ini_name_set_has(const struct ini_name_set *set, const char *name)
+{
+    uint64_t hash;
+    int len = 0;
+
+    if ((!set) || (!name)) return 0;
+
+    hash = col_make_hash(name, 0, &len);
+    return (name_set_slot(set->slots, set->size, set->case_insensitive,
+                          hash, name, len)->name != NULL);
+}
@@ -0,0 +1,174 @@
+/*
+    INI LIBRARY
+
+    Header for the internal index over sections and keys.
+
+    Copyright (C) Dmitri Pal <dpal@redhat.com> 2026
+
+    INI Library is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    INI Library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with INI Library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef INI_INDEX_H
+#define INI_INDEX_H
+
+#include <stdint.h>
+#include "collection.h"
+#include "ini_valueobj.h"
+
+/* The index maps the section name and the key name
+ * to the items of the configuration collection.
+ * The index keeps pointers to the collection items
+ * (not to the value objects) so values can be replaced
+ * in place without touching the index.
+ * Any operation that adds, removes or renames items
+ * must refresh the affected section.
+ * The index is never modified by the lookup functions
+ * so it is safe to read it from several threads.
+ */
+struct ini_index;
+
+/* Entry that describes one section */
+struct ini_index_sec;
+
+/* Entry that describes all values of one key in a section */
+struct ini_index_key;
+
+/* Create an empty index */
+int ini_index_create(struct ini_index **index);
+
+/* Destroy index */
+void ini_index_destroy(struct ini_index *index);
+
+/* Rebuild the whole index from the configuration collection */
+int ini_index_build(struct ini_index *index,
+                    struct collection_item *cfg);
+
+/* Reindex one section after its content changed or it was added.
+ * If the section is not in the collection any more
+ * it is removed from the index.
+ */
+int ini_index_update_section(struct ini_index *index,
+                             struct collection_item *cfg,
+                             const char *section);
+
+/* Remove section from the index.
+ * Must be called while the section item still exists.
+ */
+void ini_index_remove_section(struct ini_index *index,
+                              const char *section);
+
+/* Find section collection by name */
+struct collection_item *ini_index_find_section(struct ini_index *index,
+                                               const char *section);
+
+/* Find the entry for the section.
+ * Returns NULL if there is no such section.
+ */
+const struct ini_index_sec *ini_index_find_sec(struct ini_index *index,
+                                               const char *section);
+
+/* Hash of the keys and values of the section.
+ * Sections with the same keys and values
+ * in the same order have the same hash.
+ */
+uint64_t ini_index_sec_content_hash(const struct ini_index_sec *isec);
+
+/* Find the entry for the key in the section entry.
+ * Returns NULL if there is no such key or section is NULL.
+ */
+const struct ini_index_key *ini_index_find_key(const struct ini_index_sec *isec,
+                                               const char *name);
+
+/* Find the entry for the key in the section.
+ * Returns NULL if there is no such key.
+ */
+const struct ini_index_key *ini_index_find(struct ini_index *index,
+                                           const char *section,
+                                           const char *name);
+
+/* Number of values the key has in the section */
+uint32_t ini_index_key_count(const struct ini_index_key *key);
+
+/* Get value object by its position among the values of the key */
+struct value_obj *ini_index_key_value(const struct ini_index_key *key,
+                                      uint32_t pos);
+
+/* Table that maps the names to the items of one
+ * level of a collection. Unlike the index it is meant
+ * to be used while the collection is being changed:
+ * the caller adds the items it inserts and
+ * destroys the table when it is done.
+ * Only items of the given type are put into the table.
+ */
+struct ini_item_table;
+
+/* Create the table over the items of the collection */
+int ini_item_table_create(struct collection_item *col,
+                          int type,
+                          struct ini_item_table **table);
+
+/* Destroy the table */
+void ini_item_table_destroy(struct ini_item_table *table);
+
+/* Add the item that was inserted into the collection.
+ * If there is an item with the same name already
+ * the table keeps the old one.
+ */
+int ini_item_table_add(struct ini_item_table *table,
+                       struct collection_item *item);
+
+/* Add the item that was inserted into the collection
+ * at any position. If it was inserted before the item
+ * with the same name that is in the table the table
+ * switches to the new item.
+ */
+int ini_item_table_insert(struct ini_item_table *table,
+                          struct collection_item *col,
+                          struct collection_item *item);
+
+/* Remove the item that was taken out of the collection.
+ * If the collection still has items with the same name
+ * the first of them takes its place in the table.
+ */
+void ini_item_table_remove(struct ini_item_table *table,
+                           struct collection_item *col,
+                           struct collection_item *item);
+
+/* Find the first item with the name, NULL if there is none */
+struct collection_item *ini_item_table_find(struct ini_item_table *table,
+                                            const char *name);
+
+/* Set of names that is built once and
+ * then only searched, possibly by several threads.
+ * The set keeps its own copies of the names.
+ */
+struct ini_name_set;
+
+/* Create the set that is expected to hold count names.
+ * Names are compared ignoring case if case_insensitive is set.
+ */
+int ini_name_set_create(uint32_t count,
+                        int case_insensitive,
+                        struct ini_name_set **set);
+
+/* Destroy the set */
+void ini_name_set_destroy(struct ini_name_set *set);
+
+/* Add name to the set, duplicates are ignored */
+int ini_name_set_add(struct ini_name_set *set, const char *name);
+
+/* Check if the name is in the set */
+int ini_name_set_has(const struct ini_name_set *set, const char *name);
+
+#endif
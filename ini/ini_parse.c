@@ -78,6 +78,18 @@ struct parser_obj {
     /* Merge error */
     uint32_t merge_error;
     int ret;
+    /* Arena for the values, NULL if not used */
+    struct ini_arena *arena;
+    /* First line of the value being read.
+     * Arrays are created only if the value continues.
+     */
+    char *line;
+    uint32_t line_len;
+    uint32_t line_size;
+    int line_pending;
+    /* Callbacks of the streaming parser, NULL if building a tree */
+    const struct ini_parse_cb *cb;
+    void *cb_data;
 };
 
 typedef int (*action_fn)(struct parser_obj *);
@@ -91,6 +103,102 @@ typedef int (*action_fn)(struct parser_obj *);
 #define PARSE_ERROR     3 /* Handle error */
 #define PARSE_DONE      4 /* We are done */
 
+/* Copy a part of the line into the value */
+static char *parser_dup(struct parser_obj *po, const char *str, uint32_t len)
+{
+    char *dupval;
+
+    if (po->arena) return ini_arena_strndup(po->arena, str, len);
+
+    dupval = malloc(len + 1);
+    if (dupval) {
+        memcpy(dupval, str, len);
+        dupval[len] = '\0';
+    }
+    return dupval;
+}
+
+/* Free the copy if it was not added to the value */
+static void parser_free_dup(struct parser_obj *po, char *dupval)
+{
+    if (!(po->arena)) free(dupval);
+}
+
+/* Create arrays for the lines of the new value */
+static int parser_create_arrays(struct parser_obj *po)
+{
+    if (po->arena) return value_create_arena_arrays(&(po->raw_lines),
+                                                    &(po->raw_lengths));
+    return value_create_arrays(&(po->raw_lines), &(po->raw_lengths));
+}
+
+/* Add to the line of the value */
+static int parser_add_line(struct parser_obj *po, const char *str,
+                           uint32_t len, uint32_t offset)
+{
+    char *line;
+
+    /* The buffer is reused for all values */
+    if (offset + len + 1 > po->line_size) {
+        line = realloc(po->line, offset + len + 1);
+        if (!line) {
+            TRACE_ERROR_NUMBER("Failed to allocate line", ENOMEM);
+            return ENOMEM;
+        }
+        po->line = line;
+        po->line_size = offset + len + 1;
+    }
+
+    memcpy(po->line + offset, str, len);
+    po->line[offset + len] = '\0';
+    po->line_len = offset + len;
+    po->line_pending = 1;
+    return EOK;
+}
+
+/* Remember the first line of the value */
+static int parser_set_line(struct parser_obj *po, const char *str, uint32_t len)
+{
+    return parser_add_line(po, str, len, 0);
+}
+
+/* Value has more than one line, move the first one to the arrays */
+static int parser_spill_line(struct parser_obj *po)
+{
+    int error = EOK;
+    char *dupval;
+
+    TRACE_FLOW_ENTRY();
+
+    dupval = parser_dup(po, po->line, po->line_len);
+    if (!dupval) {
+        TRACE_ERROR_NUMBER("Failed to dup value", ENOMEM);
+        return ENOMEM;
+    }
+
+    error = parser_create_arrays(po);
+    if (error) {
+        TRACE_ERROR_NUMBER("Failed to create arrays", error);
+        parser_free_dup(po, dupval);
+        return error;
+    }
+
+    error = value_add_to_arrays(dupval,
+                                po->line_len,
+                                po->raw_lines,
+                                po->raw_lengths);
+    if (error) {
+        TRACE_ERROR_NUMBER("Failed to add value to arrays", error);
+        parser_free_dup(po, dupval);
+        return error;
+    }
+
+    po->line_pending = 0;
+
+    TRACE_FLOW_EXIT();
+    return EOK;
+}
+
 /* Declarations of the reusble functions: */
 static int complete_value_processing(struct parser_obj *po);
 static int save_error(struct collection_item *el,
@@ -174,6 +282,7 @@ static void parser_destroy(struct parser_obj *po)
                              po->raw_lengths);
         if (po->last_read) free(po->last_read);
         if (po->key) free(po->key);
+        free(po->line);
         col_destroy_collection_with_cb(po->top, ini_cleanup_cb, NULL);
         free(po);
     }
@@ -181,46 +290,19 @@ static void parser_destroy(struct parser_obj *po)
     TRACE_FLOW_EXIT();
 }
 
-/* Create parse object
- *
- * It assumes that the ini collection
- * has been precreated.
- */
-static int parser_create(struct ini_cfgobj *co,
-                         FILE *file,
-                         const char *config_filename,
-                         int error_level,
-                         uint32_t collision_flags,
-                         uint32_t parse_flags,
-                         struct parser_obj **po)
+/* Allocate parser object and schedule the first read */
+static int parser_alloc(FILE *file,
+                        const char *config_filename,
+                        int error_level,
+                        uint32_t collision_flags,
+                        uint32_t parse_flags,
+                        struct parser_obj **po)
 {
     int error = EOK;
     struct parser_obj *new_po = NULL;
-    unsigned count = 0;
 
     TRACE_FLOW_ENTRY();
 
-    /* Make sure that all the parts are initialized */
-    if ((!po) ||
-        (!co) ||
-        (!(co->cfg)) ||
-        (!file) ||
-        (!config_filename)) {
-        TRACE_ERROR_NUMBER("Invalid argument", EINVAL);
-        return EINVAL;
-    }
-
-    error = col_get_collection_count(co->cfg, &count);
-    if (error) {
-        TRACE_ERROR_NUMBER("Failed to check object size", error);
-        return error;
-    }
-
-    if (count != 1) {
-        TRACE_ERROR_NUMBER("Configuration is not empty", EINVAL);
-        return EINVAL;
-    }
-
     new_po = malloc(sizeof(struct parser_obj));
     if (!new_po) {
         TRACE_ERROR_NUMBER("No memory", ENOMEM);
@@ -229,13 +311,13 @@ static int parser_create(struct ini_cfgobj *co,
 
     /* Save external data */
     new_po->file = file;
-    new_po->el = co->error_list;
+    new_po->el = NULL;
     new_po->filename = config_filename;
     new_po->error_level = error_level;
     new_po->collision_flags = collision_flags;
     new_po->parse_flags = parse_flags;
-    new_po->boundary = co->boundary;
-    new_po->co = co;
+    new_po->boundary = INI_WRAP_BOUNDARY;
+    new_po->co = NULL;
 
     /* Initialize internal varibles */
     new_po->sec = NULL;
@@ -257,18 +339,15 @@ static int parser_create(struct ini_cfgobj *co,
     new_po->merge_vo = NULL;
     new_po->merge_error = 0;
     new_po->top = NULL;
+    new_po->arena = NULL;
+    new_po->line = NULL;
+    new_po->line_len = 0;
+    new_po->line_size = 0;
+    new_po->line_pending = 0;
+    new_po->cb = NULL;
+    new_po->cb_data = NULL;
     new_po->queue = NULL;
 
-    /* Create top collection */
-    error = col_create_collection(&(new_po->top),
-                                  INI_CONFIG_NAME,
-                                  COL_CLASS_INI_CONFIG);
-    if (error) {
-        TRACE_ERROR_NUMBER("Failed to create top collection", error);
-        parser_destroy(new_po);
-        return error;
-    }
-
     /* Create a queue */
     error = col_create_queue(&(new_po->queue));
     if (error) {
@@ -292,6 +371,85 @@ static int parser_create(struct ini_cfgobj *co,
     return error;
 }
 
+/* Create parse object
+ *
+ * It assumes that the ini collection
+ * has been precreated.
+ */
+static int parser_create(struct ini_cfgobj *co,
+                         FILE *file,
+                         const char *config_filename,
+                         int error_level,
+                         uint32_t collision_flags,
+                         uint32_t parse_flags,
+                         struct parser_obj **po)
+{
+    int error = EOK;
+    struct parser_obj *new_po = NULL;
+    unsigned count = 0;
+
+    TRACE_FLOW_ENTRY();
+
+    /* Make sure that all the parts are initialized */
+    if ((!po) ||
+        (!co) ||
+        (!(co->cfg)) ||
+        (!file) ||
+        (!config_filename)) {
+        TRACE_ERROR_NUMBER("Invalid argument", EINVAL);
+        return EINVAL;
+    }
+
+    error = col_get_collection_count(co->cfg, &count);
+    if (error) {
+        TRACE_ERROR_NUMBER("Failed to check object size", error);
+        return error;
+    }
+
+    if (count != 1) {
+        TRACE_ERROR_NUMBER("Configuration is not empty", EINVAL);
+        return EINVAL;
+    }
+
+    /* Arena belongs to the configuration object */
+    if ((parse_flags & INI_PARSE_ARENA) && (!(co->arena))) {
+        error = ini_arena_create(&(co->arena));
+        if (error) {
+            TRACE_ERROR_NUMBER("Failed to create arena", error);
+            return error;
+        }
+    }
+
+    error = parser_alloc(file, config_filename, error_level,
+                         collision_flags, parse_flags, &new_po);
+    if (error) {
+        TRACE_ERROR_NUMBER("Failed to create parser", error);
+        return error;
+    }
+
+    new_po->el = co->error_list;
+    new_po->boundary = co->boundary;
+    new_po->co = co;
+    new_po->arena = (parse_flags & INI_PARSE_ARENA) ? co->arena : NULL;
+    /* Configuration without comments can't be saved */
+    if (parse_flags & INI_PARSE_LEAN) co->lean = 1;
+
+    /* Create top collection */
+    error = col_create_collection(&(new_po->top),
+                                  INI_CONFIG_NAME,
+                                  COL_CLASS_INI_CONFIG);
+    if (error) {
+        TRACE_ERROR_NUMBER("Failed to create top collection", error);
+        parser_destroy(new_po);
+        return error;
+    }
+
+    *po = new_po;
+
+    TRACE_FLOW_EXIT();
+    return error;
+}
+
 /* Function to read next line from the file */
 static int parser_read(struct parser_obj *po)
 {
@@ -668,6 +826,34 @@ static int parser_save_section(struct parser_obj *po)
 
 }
 
+/* Pass the value to the streaming callback */
+static int parser_emit_value(struct parser_obj *po)
+{
+    int error = EOK;
+    uint32_t len;
+
+    TRACE_FLOW_ENTRY();
+
+    /* Same trimming as for the value object */
+    len = po->line_len;
+    while ((len) && (isspace(po->line[len - 1]))) len--;
+    po->line[len] = '\0';
+
+    if (po->cb->value) error = po->cb->value(po->key,
+                                             po->key_len,
+                                             po->line,
+                                             len,
+                                             po->keylinenum,
+                                             po->cb_data);
+    po->line_pending = 0;
+    free(po->key);
+    po->key = NULL;
+    po->key_len = 0;
+
+    TRACE_FLOW_RETURN(error);
+    return error;
+}
+
 /* Complete value processing */
 static int complete_value_processing(struct parser_obj *po)
 {
@@ -685,6 +871,8 @@ static int complete_value_processing(struct parser_obj *po)
 
     TRACE_FLOW_ENTRY();
 
+    if (po->cb) return parser_emit_value(po);
+
     if (po->merge_sec) {
         TRACE_INFO_STRING("Processing value in merge mode", "");
         section = po->merge_sec;
@@ -719,20 +907,39 @@ static int complete_value_processing(struct parser_obj *po)
     }
     else {
         /* Construct value object from what we have */
-        error = value_create_from_refarray(po->raw_lines,
-                                           po->raw_lengths,
-                                           po->keylinenum,
-                                           INI_VALUE_READ,
-                                           po->key_len,
-                                           po->boundary,
-                                           po->ic,
-                                           &vo);
+        if (po->line_pending) error = value_create_from_line(po->arena,
+                                                             po->line,
+                                                             po->line_len,
+                                                             po->keylinenum,
+                                                             INI_VALUE_READ,
+                                                             po->key_len,
+                                                             po->boundary,
+                                                             po->ic,
+                                                             &vo);
+        else if (po->arena) error = value_create_in_arena(po->arena,
+                                                     po->raw_lines,
+                                                     po->raw_lengths,
+                                                     po->keylinenum,
+                                                     INI_VALUE_READ,
+                                                     po->key_len,
+                                                     po->boundary,
+                                                     po->ic,
+                                                     &vo);
+        else error = value_create_from_refarray(po->raw_lines,
+                                                po->raw_lengths,
+                                                po->keylinenum,
+                                                INI_VALUE_READ,
+                                                po->key_len,
+                                                po->boundary,
+                                                po->ic,
+                                                &vo);
 
         if (error) {
             TRACE_ERROR_NUMBER("Failed to create value object", error);
             return error;
         }
         /* Forget about the arrays. They are now owned by the value object */
+        po->line_pending = 0;
         po->ic = NULL;
         po->raw_lines = NULL;
         po->raw_lengths = NULL;
@@ -898,6 +1105,29 @@ static int handle_comment(struct parser_obj *po, uint32_t *action)
         }
     }
 
+    if ((po->cb) &&
+        (po->cb->comment) &&
+        (!(po->parse_flags & INI_PARSE_LEAN))) {
+        error = po->cb->comment(po->last_read,
+                                po->last_read_len,
+                                po->linenum,
+                                po->cb_data);
+        if (error) {
+            TRACE_ERROR_NUMBER("Comment callback failed", error);
+            return error;
+        }
+    }
+
+    if ((po->cb) || (po->parse_flags & INI_PARSE_LEAN)) {
+        /* Comments are not kept */
+        free(po->last_read);
+        po->last_read = NULL;
+        po->last_read_len = 0;
+        *action = PARSE_READ;
+        TRACE_FLOW_EXIT();
+        return EOK;
+    }
+
     if (!(po->ic)) {
         /* Create a new comment */
         error = ini_comment_create(&(po->ic));
@@ -934,7 +1164,6 @@ static int handle_kvp(struct parser_obj *po, uint32_t *action)
     int error = EOK;
     char *eq = NULL;
     uint32_t len = 0;
-    char *dupval = NULL;
     char *str;
     uint32_t full_len;
 
@@ -1042,36 +1271,10 @@ static int handle_kvp(struct parser_obj *po, uint32_t *action)
     TRACE_INFO_STRING("VALUE:", eq);
     TRACE_INFO_NUMBER("LENGTH:", len);
 
-    /* Dup the part of the value */
-    dupval = malloc(len + 1);
-    if (!dupval) {
-        TRACE_ERROR_NUMBER("Failed to dup value", ENOMEM);
-        TRACE_FLOW_EXIT();
-        return ENOMEM;
-    }
-
-    memcpy(dupval, eq, len);
-    *(dupval + len) = '\0';
-
-    /* Create new arrays */
-    error = value_create_arrays(&(po->raw_lines),
-                                &(po->raw_lengths));
-    if (error) {
-        TRACE_ERROR_NUMBER("Failed to create arrays", error);
-        free(dupval);
-        TRACE_FLOW_EXIT();
-        return error;
-    }
-
-    /* Save a duplicated part in the value */
-    error = value_add_to_arrays(dupval,
-                                len,
-                                po->raw_lines,
-                                po->raw_lengths);
-
+    /* Save the part of the value */
+    error = parser_set_line(po, eq, len);
     if (error) {
-        TRACE_ERROR_NUMBER("Failed to add value to arrays", error);
-        free(dupval);
+        TRACE_ERROR_NUMBER("Failed to save value", error);
         TRACE_FLOW_EXIT();
         return error;
     }
@@ -1095,6 +1298,7 @@ static int handle_space(struct parser_obj *po, uint32_t *action)
 {
     int error = EOK;
     int space_err = 0;
+    char *dupval = NULL;
 
     TRACE_FLOW_ENTRY();
 
@@ -1126,14 +1330,44 @@ static int handle_space(struct parser_obj *po, uint32_t *action)
     }
 
     /* Do we have current value object? */
-    if (po->key) {
+    if ((po->key) && ((po->cb) || (po->parse_flags & INI_PARSE_LEAN))) {
+        /* Only the unfolded value is kept */
+        error = parser_add_line(po, po->last_read, po->last_read_len,
+                                po->line_len);
+        if (error) {
+            TRACE_ERROR_NUMBER("Failed to add line to value", error);
+            return error;
+        }
+        free(po->last_read);
+        po->last_read = NULL;
+        po->last_read_len = 0;
+        *action = PARSE_READ;
+    }
+    else if (po->key) {
         /* This is a new line in a folded value */
+        if (po->line_pending) {
+            error = parser_spill_line(po);
+            if (error) {
+                TRACE_ERROR_NUMBER("Failed to save first line", error);
+                return error;
+            }
+        }
+        if (po->arena) {
+            dupval = parser_dup(po, po->last_read, po->last_read_len);
+            if (!dupval) {
+                TRACE_ERROR_NUMBER("Failed to dup line", ENOMEM);
+                return ENOMEM;
+            }
+            free(po->last_read);
+            po->last_read = dupval;
+        }
         error = value_add_to_arrays(po->last_read,
                                     po->last_read_len,
                                     po->raw_lines,
                                     po->raw_lengths);
         if (error) {
             TRACE_ERROR_NUMBER("Failed to add line to value", error);
+            if (po->arena) po->last_read = NULL;
             return error;
         }
         /* Do not free the line, it is now an element of the array */
@@ -1172,7 +1406,6 @@ static int handle_section(struct parser_obj *po, uint32_t *action)
     int error = EOK;
     char *start;
     char *end;
-    char *dupval;
     uint32_t len;
 
     TRACE_FLOW_ENTRY();
@@ -1223,6 +1456,25 @@ static int handle_section(struct parser_obj *po, uint32_t *action)
         }
     }
 
+    if (po->cb) {
+        /* Terminate the name inside the line */
+        *(end + 1) = '\0';
+        if (po->cb->section) error = po->cb->section(start,
+                                                     len,
+                                                     po->linenum,
+                                                     po->cb_data);
+        if (error) {
+            TRACE_ERROR_NUMBER("Section callback failed", error);
+            return error;
+        }
+        free(po->last_read);
+        po->last_read = NULL;
+        po->last_read_len = 0;
+        *action = PARSE_READ;
+        TRACE_FLOW_EXIT();
+        return EOK;
+    }
+
     /* Save section if we have one*/
     error = parser_save_section(po);
     if (error) {
@@ -1230,48 +1482,25 @@ static int handle_section(struct parser_obj *po, uint32_t *action)
         return error;
     }
 
-    /* Dup the name */
-    dupval = malloc(len + 1);
-    if (!dupval) {
-        TRACE_ERROR_NUMBER("Failed to dup section name", ENOMEM);
-        return ENOMEM;
+    /* Save the name, it is also the value of the special key */
+    error = parser_set_line(po, start, len);
+    if (error) {
+        TRACE_ERROR_NUMBER("Failed to save section name", error);
+        return error;
     }
 
-    memcpy(dupval, start, len);
-    dupval[len] = '\0';
-
     /* Create a new section */
     error = col_create_collection(&po->sec,
-                                  dupval,
+                                  po->line,
                                   COL_CLASS_INI_SECTION);
     if (error) {
         TRACE_ERROR_NUMBER("Failed to create a section", error);
-        free(dupval);
         return error;
     }
 
     /* But if there is just a comment then create a special key */
     po->key_len = sizeof(INI_SECTION_KEY) - 1;
     po->key = strndup(INI_SECTION_KEY, sizeof(INI_SECTION_KEY));
-    /* Create new arrays */
-    error = value_create_arrays(&(po->raw_lines),
-                                &(po->raw_lengths));
-    if (error) {
-        TRACE_ERROR_NUMBER("Failed to create arrays", error);
-        free(dupval);
-        return error;
-    }
-
-    /* Save a duplicated part in the value */
-    error = value_add_to_arrays(dupval,
-                                len,
-                                po->raw_lines,
-                                po->raw_lengths);
-    if (error) {
-        TRACE_ERROR_NUMBER("Failed to add value to the arrays", error);
-        free(dupval);
-        return error;
-    }
 
     /* Save the line number of the last found key */
     po->seclinenum = po->linenum;
@@ -1517,10 +1746,18 @@ static int parser_error(struct parser_obj *po)
     if (po->last_error & INI_WARNING) err_str = WARNING_TXT;
     else err_str = ERROR_TXT;
 
-    error = save_error(po->el,
-                       po->linenum,
-                       po->last_error & ~INI_WARNING,
-                       err_str);
+    if (po->cb) {
+        /* Errors are not collected in the streaming mode */
+        if (po->cb->error) error = po->cb->error(po->linenum,
+                                                 po->last_error & ~INI_WARNING,
+                                                 po->last_error & INI_WARNING
+                                                 ? 1 : 0,
+                                                 po->cb_data);
+    }
+    else error = save_error(po->el,
+                            po->linenum,
+                            po->last_error & ~INI_WARNING,
+                            err_str);
     if (error) {
         TRACE_ERROR_NUMBER("Failed to add error to error list",
                             error);
@@ -1675,6 +1912,7 @@ int ini_config_parse(struct ini_cfgfile *file_ctx,
                      struct ini_cfgobj *ini_config)
 {
     int error = EOK;
+    int error2 = EOK;
     struct parser_obj *po = NULL;
     uint32_t fl1, fl2, fl3;
 
@@ -1750,6 +1988,144 @@ int ini_config_parse(struct ini_cfgfile *file_ctx,
 
     parser_destroy(po);
 
+    /* Index the sections and keys we just read */
+    ini_config_clean_state(ini_config);
+    error2 = ini_index_build(ini_config->index, ini_config->cfg);
+    if (error2) {
+        TRACE_ERROR_NUMBER("Failed to index configuration", error2);
+        return error2;
+    }
+
+    /* Remember what was read for the cache */
+    if ((file_ctx->filename) && (*(file_ctx->filename) != '\0')) {
+        error2 = ini_config_add_source(ini_config,
+                                       file_ctx->filename,
+                                       &(file_ctx->file_stats),
+                                       file_ctx->content_hash);
+        if (error2) {
+            TRACE_ERROR_NUMBER("Failed to record source", error2);
+            return error2;
+        }
+    }
+
+    TRACE_FLOW_EXIT();
+    return error;
+}
+
+/* Run the parser on the stream with the callbacks */
+static int parse_stream_run(FILE *file,
+                            const char *filename,
+                            int error_level,
+                            uint32_t parse_flags,
+                            const struct ini_parse_cb *cb,
+                            void *cb_data)
+{
+    int error = EOK;
+    struct parser_obj *po = NULL;
+
+    TRACE_FLOW_ENTRY();
+
+    if ((error_level != INI_STOP_ON_ANY) &&
+        (error_level != INI_STOP_ON_NONE) &&
+        (error_level != INI_STOP_ON_ERROR)) {
+        TRACE_ERROR_NUMBER("Invalid argument", EINVAL);
+        return EINVAL;
+    }
+
+    error = parser_alloc(file,
+                         filename,
+                         error_level,
+                         0,
+                         parse_flags & ~INI_PARSE_ARENA,
+                         &po);
+    if (error) {
+        TRACE_ERROR_NUMBER("Failed to create parser", error);
+        return error;
+    }
+
+    po->cb = cb;
+    po->cb_data = cb_data;
+
+    error = parser_run(po);
+    parser_destroy(po);
+
+    TRACE_FLOW_EXIT();
+    return error;
+}
+
+/* Parse the file and pass what was found to the callbacks */
+int ini_config_parse_stream(struct ini_cfgfile *file_ctx,
+                            int error_level,
+                            uint32_t parse_flags,
+                            const struct ini_parse_cb *cb,
+                            void *cb_data)
+{
+    int error = EOK;
+
+    TRACE_FLOW_ENTRY();
+
+    if ((!file_ctx) || (!(file_ctx->file)) ||
+        (!(file_ctx->filename)) || (!cb)) {
+        TRACE_ERROR_NUMBER("Invalid argument", EINVAL);
+        return EINVAL;
+    }
+
+    error = parse_stream_run(file_ctx->file, file_ctx->filename,
+                             error_level, parse_flags, cb, cb_data);
+
+    TRACE_FLOW_EXIT();
+    return error;
+}
+
+/* Parse the file decoding it as it is read */
+int ini_config_parse_stream_file(const char *filename,
+                                 int error_level,
+                                 uint32_t parse_flags,
+                                 const struct ini_parse_cb *cb,
+                                 void *cb_data)
+{
+    int error = EOK;
+    int error2 = EOK;
+    struct ini_decoder *decoder = NULL;
+    struct ini_cfgfile *file_ctx = NULL;
+    FILE *file = NULL;
+
+    TRACE_FLOW_ENTRY();
+
+    if ((!filename) || (!cb)) {
+        TRACE_ERROR_NUMBER("Invalid argument", EINVAL);
+        return EINVAL;
+    }
+
+    error = ini_decoder_open(filename, &decoder, &file);
+    if (error == ENOSYS) {
+        /* Platform can't stream so read the whole file */
+        error = ini_config_file_open(filename, 0, &file_ctx);
+        if (error) {
+            TRACE_ERROR_NUMBER("Failed to open file", error);
+            return error;
+        }
+        error = ini_config_parse_stream(file_ctx, error_level,
+                                        parse_flags, cb, cb_data);
+        ini_config_file_destroy(file_ctx);
+        TRACE_FLOW_EXIT();
+        return error;
+    }
+    if (error) {
+        TRACE_ERROR_NUMBER("Failed to open file", error);
+        return error;
+    }
+
+    error = parse_stream_run(file, filename,
+                             error_level, parse_flags, cb, cb_data);
+
+    /* Decoding error is the reason the parser failed to read */
+    error2 = ini_decoder_close(decoder);
+    if (error2) {
+        TRACE_ERROR_NUMBER("Failed to decode file", error2);
+        return error2;
+    }
+
     TRACE_FLOW_EXIT();
     return error;
 }
@@ -25,8 +25,14 @@
 #include <errno.h>
 #include <stdlib.h>
 #include <limits.h>
+#include <stddef.h>
 #include <sys/stat.h>
 #include <sys/wait.h>
+#include <time.h>
+#include <fcntl.h>
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
 #include "ini_defines.h"
 #include "ini_configobj.h"
 #include "ini_config_priv.h"
@@ -37,6 +43,8 @@
 #include "collection_tools.h"
 
 int verbose = 0;
+/* Run the timing tests at full size */
+int perf = 0;
 char *confdir = NULL;
 
 #define NUM_TESTS 14
@@ -3157,6 +3165,1800 @@ static int comment_test(void)
     return EOK;
 }
 
+/* Parse configuration from the string */
+static int parse_mem(const char *text, struct ini_cfgobj **ini_config)
+{
+    int error = EOK;
+    struct ini_cfgfile *file_ctx = NULL;
+
+    error = ini_config_file_from_mem((void *)text, strlen(text), &file_ctx);
+    if (error) {
+        printf("Failed to open from memory. Error %d.\n", error);
+        return error;
+    }
+
+    error = ini_config_create(ini_config);
+    if (error) {
+        printf("Failed to create object. Error %d.\n", error);
+        ini_config_file_destroy(file_ctx);
+        return error;
+    }
+
+    error = ini_config_parse(file_ctx, INI_STOP_ON_ANY, 0, 0, *ini_config);
+    ini_config_file_destroy(file_ctx);
+    if (error) {
+        printf("Failed to parse configuration. Error %d.\n", error);
+        ini_config_destroy(*ini_config);
+        *ini_config = NULL;
+        return error;
+    }
+
+    return EOK;
+}
+
+struct bind_data {
+    int timeout;
+    unsigned retries;
+    double ratio;
+    unsigned char enabled;
+    char *name;
+    const char *mode;
+    int64_t size;
+    int broken;
+};
+
+static int bind_test(void)
+{
+    int error = EOK;
+    struct ini_cfgobj *ini_config = NULL;
+    struct ini_errobj *errobj = NULL;
+    struct bind_data data;
+    const char *text = "[main]\n"
+                       "timeout = 30\n"
+                       "timeout = 40\n"
+                       "enabled = yes\n"
+                       "name = server\n"
+                       "broken = 12abc\n"
+                       "[limits]\n"
+                       "size = 123456789012\n";
+    struct ini_binding bindings[] = {
+        { "main", "timeout", INI_BIND_INT,
+          offsetof(struct bind_data, timeout), "10" },
+        { "main", "retries", INI_BIND_UNSIGNED,
+          offsetof(struct bind_data, retries), "3" },
+        { "main", "enabled", INI_BIND_BOOL,
+          offsetof(struct bind_data, enabled), "no" },
+        { "main", "name", INI_BIND_STRING,
+          offsetof(struct bind_data, name), NULL },
+        { "main", "mode", INI_BIND_CONST_STRING,
+          offsetof(struct bind_data, mode), "fast" },
+        { "main", "broken", INI_BIND_INT,
+          offsetof(struct bind_data, broken), "7" },
+        { "limits", "size", INI_BIND_INT64,
+          offsetof(struct bind_data, size), NULL },
+        { "limits", "ratio", INI_BIND_DOUBLE,
+          offsetof(struct bind_data, ratio), "0.5" },
+        { NULL, NULL, 0, 0, NULL }
+    };
+
+    INIOUT(printf("<==== Bind test ====>\n"));
+
+    error = parse_mem(text, &ini_config);
+    if (error) return error;
+
+    error = ini_errobj_create(&errobj);
+    if (error) {
+        printf("Failed to create error object. Error %d.\n", error);
+        ini_config_destroy(ini_config);
+        return error;
+    }
+
+    memset(&data, 0, sizeof(data));
+    error = ini_config_bind(ini_config, bindings, 1, &data, errobj);
+    ini_config_destroy(ini_config);
+
+    /* Only the broken value should fail */
+    if ((error != EIO) || (ini_errobj_count(errobj) != 1)) {
+        printf("Expected one conversion error, got %d.\n", error);
+        free(data.name);
+        ini_errobj_destroy(&errobj);
+        return EINVAL;
+    }
+    INIOUT(printf("%s\n", ini_errobj_get_msg(errobj)));
+    ini_errobj_destroy(&errobj);
+
+    /* Duplicate value overwrites the first one by default */
+    if ((data.timeout != 40) ||
+        (data.retries != 3) ||
+        (data.enabled != 1) ||
+        (data.name == NULL) ||
+        (strcmp(data.name, "server") != 0) ||
+        (strcmp(data.mode, "fast") != 0) ||
+        (data.broken != 7) ||
+        (data.size != 123456789012LL) ||
+        (data.ratio != 0.5)) {
+        printf("Bound values do not match.\n");
+        free(data.name);
+        return EINVAL;
+    }
+
+    free(data.name);
+
+    INIOUT(printf("<==== Bind test end ====>\n"));
+    return EOK;
+}
+
+/* Parse configuration from the file */
+static int parse_file(const char *name, struct ini_cfgobj **ini_config)
+{
+    int error = EOK;
+    struct ini_cfgfile *file_ctx = NULL;
+
+    error = ini_config_file_open(name, 0, &file_ctx);
+    if (error) {
+        printf("Failed to open file %s. Error %d.\n", name, error);
+        return error;
+    }
+
+    error = ini_config_create(ini_config);
+    if (error) {
+        printf("Failed to create object. Error %d.\n", error);
+        ini_config_file_destroy(file_ctx);
+        return error;
+    }
+
+    error = ini_config_parse(file_ctx, INI_STOP_ON_ANY, 0, 0, *ini_config);
+    ini_config_file_destroy(file_ctx);
+    if (error) {
+        printf("Failed to parse configuration. Error %d.\n", error);
+        ini_config_destroy(*ini_config);
+        *ini_config = NULL;
+        return error;
+    }
+
+    return EOK;
+}
+
+/* Serialize configuration and compare the result */
+static int compare_configs(struct ini_cfgobj *cfg1, struct ini_cfgobj *cfg2)
+{
+    int error = EOK;
+    struct simplebuffer *sb1 = NULL;
+    struct simplebuffer *sb2 = NULL;
+
+    if ((error = simplebuffer_alloc(&sb1)) ||
+        (error = simplebuffer_alloc(&sb2)) ||
+        (error = ini_config_serialize(cfg1, sb1)) ||
+        (error = ini_config_serialize(cfg2, sb2))) {
+        printf("Failed to serialize configuration. Error %d.\n", error);
+        simplebuffer_free(sb1);
+        simplebuffer_free(sb2);
+        return error;
+    }
+
+    if ((simplebuffer_get_len(sb1) != simplebuffer_get_len(sb2)) ||
+        (memcmp(simplebuffer_get_buf(sb1), simplebuffer_get_buf(sb2),
+                simplebuffer_get_len(sb1)) != 0)) {
+        printf("Configurations do not match.\n");
+        INIOUT(printf("%s\n---\n%s\n", simplebuffer_get_buf(sb1),
+                      simplebuffer_get_buf(sb2)));
+        error = EINVAL;
+    }
+
+    simplebuffer_free(sb1);
+    simplebuffer_free(sb2);
+    return error;
+}
+
+/* Set modification time of the file */
+static int set_mtime(const char *path, time_t sec, long nsec)
+{
+    struct timespec times[2];
+
+    times[0].tv_sec = sec;
+    times[0].tv_nsec = nsec;
+    times[1].tv_sec = sec;
+    times[1].tv_nsec = nsec;
+
+    if (utimensat(AT_FDCWD, path, times, 0) == -1) {
+        printf("Failed to set time of %s. Error %d.\n", path, errno);
+        return errno;
+    }
+
+    return EOK;
+}
+
+/* Write text into the file */
+static int write_text(const char *path, const char *mode, const char *text)
+{
+    FILE *ff = NULL;
+
+    ff = fopen(path, mode);
+    if (!ff) {
+        printf("Failed to open file %s.\n", path);
+        return EIO;
+    }
+    fprintf(ff, "%s", text);
+    fclose(ff);
+
+    return EOK;
+}
+
+/* Write the file, parse it, append the change and save the cache */
+static int cache_prepare(const char *path,
+                         const char *cache_file,
+                         const char *text,
+                         const char *change,
+                         struct stat *stats)
+{
+    int error = EOK;
+    struct ini_cfgobj *ini_config = NULL;
+
+    error = write_text(path, "w", text);
+    if (error) return error;
+
+    error = parse_file(path, &ini_config);
+    if (error) return error;
+
+    if (change) {
+        error = write_text(path, "a", change);
+        if (error) {
+            ini_config_destroy(ini_config);
+            return error;
+        }
+    }
+
+    error = ini_config_cache_save(ini_config, cache_file);
+    ini_config_destroy(ini_config);
+    if (error) {
+        printf("Failed to save cache. Error %d.\n", error);
+        return error;
+    }
+
+    if ((stats) && (stat(path, stats) == -1)) {
+        printf("Failed to get stats. Error %d.\n", errno);
+        return errno;
+    }
+
+    return EOK;
+}
+
+/* Check what loading the cache returns */
+static int cache_expect(const char *cache_file, int expected)
+{
+    int error = EOK;
+    struct ini_cfgobj *cached = NULL;
+
+    error = ini_config_cache_load(cache_file, &cached);
+    if (!error) ini_config_destroy(cached);
+    if (error != expected) {
+        printf("Expected %d from the cache got %d.\n", expected, error);
+        return EINVAL;
+    }
+
+    return EOK;
+}
+
+static int cache_test(void)
+{
+    int error = EOK;
+    struct ini_cfgobj *ini_config = NULL;
+    struct ini_cfgobj *cached = NULL;
+    struct ini_cfgobj *recached = NULL;
+    char infile[PATH_MAX];
+    char *srcdir = NULL;
+    const char *cache_file = "./cache_test.cache";
+    const char *changed_file = "./cache_test.conf";
+    struct stat stats;
+
+    INIOUT(printf("<==== Cache test ====>\n"));
+
+    srcdir = getenv("srcdir");
+    snprintf(infile, PATH_MAX, "%s/ini/ini.d/real.conf",
+             (srcdir == NULL) ? "." : srcdir);
+
+    error = parse_file(infile, &ini_config);
+    if (error) return error;
+
+    error = ini_config_cache_save(ini_config, cache_file);
+    if (error) {
+        printf("Failed to save cache. Error %d.\n", error);
+        ini_config_destroy(ini_config);
+        return error;
+    }
+
+    error = ini_config_cache_load(cache_file, &cached);
+    if (error) {
+        printf("Failed to load cache. Error %d.\n", error);
+        ini_config_destroy(ini_config);
+        return error;
+    }
+
+    /* Loaded configuration knows its sources too */
+    error = ini_config_cache_save(cached, cache_file);
+    ini_config_destroy(cached);
+    if (error) {
+        printf("Failed to save cache again. Error %d.\n", error);
+        ini_config_destroy(ini_config);
+        return error;
+    }
+
+    error = ini_config_cache_load(cache_file, &cached);
+    if (error) {
+        printf("Failed to load cache again. Error %d.\n", error);
+        ini_config_destroy(ini_config);
+        return error;
+    }
+
+    /* Values are still there after the copy is gone */
+    error = ini_config_copy(cached, &recached);
+    if (!error) error = compare_configs(ini_config, cached);
+    ini_config_destroy(cached);
+    if (!error) error = compare_configs(ini_config, recached);
+    ini_config_destroy(ini_config);
+    ini_config_destroy(recached);
+    if (error) return error;
+
+    /* Comment at the end of the file is kept */
+    cached = NULL;
+    error = cache_prepare(changed_file, cache_file,
+                          "[s]\nk = v\n# trailing comment\n", NULL, NULL);
+    if (!error) error = parse_file(changed_file, &ini_config);
+    if (!error) {
+        error = ini_config_cache_load(cache_file, &cached);
+        if (!error) error = compare_configs(ini_config, cached);
+        ini_config_destroy(ini_config);
+        ini_config_destroy(cached);
+    }
+    if (error) {
+        printf("Trailing comment was not cached.\n");
+        return error;
+    }
+
+    /* Cache must not be used after the source changes */
+    error = cache_prepare(changed_file, cache_file,
+                          "[one]\nkey = value\n", NULL, NULL);
+    if (!error) error = write_text(changed_file, "a", "other = value\n");
+    if (!error) error = cache_expect(cache_file, ESTALE);
+    if (error) return error;
+
+    /* Even if it changed before the cache was saved */
+    error = cache_prepare(changed_file, cache_file,
+                          "[one]\nkey = value\n", "other = value\n", NULL);
+    if (!error) error = cache_expect(cache_file, ESTALE);
+    if (error) {
+        printf("Change made before saving was not detected.\n");
+        return error;
+    }
+
+    /* Touching the file does not make the cache stale */
+    error = cache_prepare(changed_file, cache_file,
+                          "[one]\nkey = value\n", NULL, &stats);
+    if (!error) error = set_mtime(changed_file, stats.st_mtime + 10, 0);
+    if (!error) error = cache_expect(cache_file, EOK);
+    if (error) {
+        printf("Touched file made the cache stale.\n");
+        return error;
+    }
+
+#ifdef HAVE_STRUCT_STAT_ST_MTIM
+    /* Rewrite of the same size in the same second */
+    error = cache_prepare(changed_file, cache_file,
+                          "[one]\nkey = value\n", NULL, &stats);
+    if (!error) error = write_text(changed_file, "r+", "[two]");
+    if (!error) error = set_mtime(changed_file, stats.st_mtime,
+                                  (stats.st_mtim.tv_nsec + 1) % 1000000000);
+    if (!error) error = cache_expect(cache_file, ESTALE);
+    if (error) {
+        printf("Rewrite in the same second was not detected.\n");
+        return error;
+    }
+#endif
+
+    INIOUT(printf("<==== Cache test end ====>\n"));
+    return EOK;
+}
+
+static int merge_into_test(void)
+{
+    int error = EOK;
+    struct ini_cfgobj *base = NULL;
+    struct ini_cfgobj *snip = NULL;
+    struct ini_cfgobj *expected = NULL;
+    struct ini_cfgobj *saved = NULL;
+    struct value_obj *vo = NULL;
+    const char *base_text = "[one]\nkey1 = a\nkey2 = b\n"
+                            "[two]\nkey1 = c\n#last\n";
+    const char *snip_text = "[new]\nkey = d\n"
+                            "[one]\nkey2 = e\nkey3 = f\n";
+    uint32_t flags = INI_MS_MERGE | INI_MV2S_OVERWRITE;
+
+    INIOUT(printf("<==== Merge into test ====>\n"));
+
+    if ((error = parse_mem(base_text, &base)) ||
+        (error = parse_mem(snip_text, &snip))) {
+        ini_config_destroy(base);
+        return error;
+    }
+
+    /* Result must be the same as with the copying merge */
+    error = ini_config_merge(base, snip, flags, &expected);
+    if (error) {
+        printf("Failed to merge. Error %d.\n", error);
+        goto done;
+    }
+
+    error = ini_config_merge_into(base, snip, flags);
+    if (error) {
+        printf("Failed to merge in place. Error %d.\n", error);
+        goto done;
+    }
+
+    error = compare_configs(base, expected);
+    if (error) goto done;
+
+    error = ini_get_config_valueobj("one", "key3", base,
+                                    INI_GET_FIRST_VALUE, &vo);
+    if ((error) || (!vo)) {
+        printf("Merged value is not found.\n");
+        error = EINVAL;
+        goto done;
+    }
+
+    /* Failed merge must leave the configuration unchanged */
+    error = ini_config_copy(base, &saved);
+    if (error) {
+        printf("Failed to copy. Error %d.\n", error);
+        goto done;
+    }
+
+    ini_config_destroy(snip);
+    snip = NULL;
+    error = parse_mem("[added]\nkey = g\n[two]\nkey2 = h\nkey1 = i\n",
+                      &snip);
+    if (error) goto done;
+
+    error = ini_config_merge_into(base, snip,
+                                  INI_MS_MERGE | INI_MV2S_ERROR);
+    if (error != EEXIST) {
+        printf("Expected EEXIST got %d.\n", error);
+        error = EINVAL;
+        goto done;
+    }
+
+    error = compare_configs(base, saved);
+    if (error) goto done;
+
+    vo = NULL;
+    error = ini_get_config_valueobj("added", "key", base,
+                                    INI_GET_FIRST_VALUE, &vo);
+    if ((error) || (vo)) {
+        printf("Rolled back section is still found.\n");
+        error = EINVAL;
+        goto done;
+    }
+
+    INIOUT(printf("<==== Merge into test end ====>\n"));
+
+done:
+    ini_config_destroy(base);
+    ini_config_destroy(snip);
+    ini_config_destroy(expected);
+    ini_config_destroy(saved);
+    return error;
+}
+
+/* Build configuration for the merge benchmark.
+ * Shifted configuration has half of the sections
+ * and half of the keys in common with the other one.
+ */
+static int merge_bench_config(int sections, int keys, int shift,
+                              struct ini_cfgobj **ini_config)
+{
+    int error = EOK;
+    struct simplebuffer *sb = NULL;
+    char line[100];
+    int i, j;
+
+    error = simplebuffer_alloc(&sb);
+    if (error) return error;
+
+    for (i = 0; (!error) && (i < sections); i++) {
+        snprintf(line, sizeof(line), "[section%d]\n",
+                 i + shift * sections / 2);
+        error = simplebuffer_add_str(sb, line, strlen(line), 100);
+        for (j = 0; (!error) && (j < keys); j++) {
+            snprintf(line, sizeof(line), "key%d = value %d\n",
+                     j + shift * keys / 2, shift);
+            error = simplebuffer_add_str(sb, line, strlen(line), 100);
+        }
+    }
+
+    if (!error) error = parse_mem((const char *)simplebuffer_get_buf(sb),
+                                  ini_config);
+    simplebuffer_free(sb);
+    return error;
+}
+
+/* Merge big configurations in all modes */
+static int merge_bench_test(void)
+{
+    int error = EOK;
+    struct ini_cfgobj *first = NULL;
+    struct ini_cfgobj *second = NULL;
+    struct ini_cfgobj *result = NULL;
+    char **list = NULL;
+    char name[100];
+    int size = 0;
+    clock_t start;
+    int i, j, k;
+    /* Many small sections and few big ones,
+     * 1000 keys each or 10000 keys with -p */
+    int shapes[2][2] = { { 100, 10 }, { 10, 100 } };
+    uint32_t msflags[] = { INI_MS_MERGE,
+                           INI_MS_OVERWRITE,
+                           INI_MS_ERROR,
+                           INI_MS_PRESERVE,
+                           INI_MS_MERGE | INI_MS_DETECT };
+    uint32_t mvflags[] = { INI_MV2S_OVERWRITE,
+                           INI_MV2S_ERROR,
+                           INI_MV2S_PRESERVE,
+                           INI_MV2S_ALLOW,
+                           INI_MV2S_DETECT };
+
+    INIOUT(printf("<==== Merge benchmark ====>\n"));
+
+    if (perf) {
+        shapes[0][0] *= 10;
+        shapes[1][1] *= 10;
+    }
+
+    for (k = 0; k < 2; k++) {
+        /* Second configuration overlaps with the first one */
+        error = merge_bench_config(shapes[k][0], shapes[k][1], 0, &first);
+        if (!error) error = merge_bench_config(shapes[k][0], shapes[k][1],
+                                               1, &second);
+        if (error) {
+            printf("Failed to create configurations. Error %d.\n", error);
+            ini_config_destroy(first);
+            return error;
+        }
+
+        for (i = 0; i < 5; i++) {
+            for (j = 0; j < 5; j++) {
+                start = clock();
+                error = ini_config_merge(first, second,
+                                         msflags[i] | mvflags[j], &result);
+                INIOUT(printf("%d sections, flags 0x%04X: %.3fs (%d)\n",
+                              shapes[k][0], msflags[i] | mvflags[j],
+                              (double)(clock() - start) / CLOCKS_PER_SEC,
+                              error));
+                if ((error) && (error != EEXIST)) {
+                    printf("Failed to merge. Error %d.\n", error);
+                    ini_config_destroy(first);
+                    ini_config_destroy(second);
+                    return error;
+                }
+                error = EOK;
+
+                /* Overlapping sections get the keys of both */
+                if ((msflags[i] == INI_MS_MERGE) &&
+                    (mvflags[j] == INI_MV2S_OVERWRITE)) {
+                    list = ini_get_section_list(result, &size, &error);
+                    ini_free_section_list(list);
+                    if ((error) || (size != shapes[k][0] * 3 / 2)) {
+                        printf("Expected %d sections got %d.\n",
+                               shapes[k][0] * 3 / 2, size);
+                        error = EINVAL;
+                    }
+                    snprintf(name, sizeof(name), "section%d",
+                                 shapes[k][0] - 1);
+                    list = ini_get_attribute_list(result, name, &size,
+                                                  &error);
+                    ini_free_attribute_list(list);
+                    if ((!error) && (size != shapes[k][1] * 3 / 2)) {
+                        printf("Expected %d keys got %d.\n",
+                               shapes[k][1] * 3 / 2, size);
+                        error = EINVAL;
+                    }
+                }
+
+                ini_config_destroy(result);
+                result = NULL;
+                if (error) {
+                    ini_config_destroy(first);
+                    ini_config_destroy(second);
+                    return error;
+                }
+            }
+        }
+
+        ini_config_destroy(first);
+        ini_config_destroy(second);
+        first = NULL;
+        second = NULL;
+    }
+
+    INIOUT(printf("<==== Merge benchmark end ====>\n"));
+    return EOK;
+}
+
+/* Parse file with the given parse flags */
+static int parse_file_flags(const char *name, uint32_t parse_flags,
+                            struct ini_cfgobj **ini_config)
+{
+    int error = EOK;
+    struct ini_cfgfile *file_ctx = NULL;
+
+    error = ini_config_file_open(name, 0, &file_ctx);
+    if (error) {
+        printf("Failed to open file %s. Error %d.\n", name, error);
+        return error;
+    }
+
+    error = ini_config_create(ini_config);
+    if (!error) {
+        error = ini_config_parse(file_ctx, INI_STOP_ON_NONE,
+                                 INI_MV1S_ALLOW, parse_flags, *ini_config);
+        if (error) {
+            printf("Failed to parse %s. Error %d.\n", name, error);
+            ini_config_destroy(*ini_config);
+            *ini_config = NULL;
+        }
+    }
+
+    ini_config_file_destroy(file_ctx);
+    return error;
+}
+
+/* Run the check of a parse mode for every sample file */
+static int sample_files_test(int (*file_test)(const char *name),
+                             const char *mode)
+{
+    int error = EOK;
+    char infile[PATH_MAX];
+    char *srcdir = NULL;
+    int i;
+    const char *files[] = { "real",
+                            "mysssd",
+                            "ipa",
+                            "smerge",
+                            "symbols",
+                            NULL };
+
+    srcdir = getenv("srcdir");
+
+    for (i = 0; files[i]; i++) {
+        snprintf(infile, PATH_MAX, "%s/ini/ini.d/%s.conf",
+                 (srcdir == NULL) ? "." : srcdir, files[i]);
+        error = file_test(infile);
+        if (error) {
+            printf("%s test failed for %s. Error %d.\n",
+                   mode, files[i], error);
+            return error;
+        }
+    }
+
+    return EOK;
+}
+
+/* Time parsing of a big commented configuration
+ * with and without the parse flag, runs only with -p.
+ */
+static int parse_bench(uint32_t parse_flags, const char *mode)
+{
+    int error = EOK;
+    char line[PATH_MAX];
+    struct simplebuffer *sb = NULL;
+    struct ini_cfgobj *cfg = NULL;
+    struct ini_cfgfile *file_ctx = NULL;
+    uint32_t flags[] = { 0, parse_flags };
+    clock_t start;
+    int i;
+
+    if (!perf) return EOK;
+
+    error = simplebuffer_alloc(&sb);
+    if (error) return error;
+
+    for (i = 0; (!error) && (i < 50000); i++) {
+        if (i % 100 == 0) snprintf(line, PATH_MAX,
+                                   "# Section %d\n[section%d]\n", i, i);
+        else line[0] = '\0';
+        error = simplebuffer_add_str(sb, line, strlen(line), 100);
+        if (error) break;
+        snprintf(line, PATH_MAX,
+                 "\n# Key number %d\n# that is described here\n"
+                 "key%d = value number %d\n"
+                 "  continued on the next line\n", i, i, i);
+        error = simplebuffer_add_str(sb, line, strlen(line), 100);
+    }
+
+    for (i = 0; (!error) && (i < 2); i++) {
+        start = clock();
+        error = ini_config_file_from_mem(simplebuffer_get_vbuf(sb),
+                                         simplebuffer_get_len(sb),
+                                         &file_ctx);
+        if (error) break;
+        error = ini_config_create(&cfg);
+        if (!error) error = ini_config_parse(file_ctx, INI_STOP_ON_ANY,
+                                             INI_MS_MERGE, flags[i], cfg);
+        ini_config_destroy(cfg);
+        ini_config_file_destroy(file_ctx);
+        cfg = NULL;
+        INIOUT(printf("Parse and destroy %s: %.3fs\n",
+                      i ? mode : "by default",
+                      (double)(clock() - start) / CLOCKS_PER_SEC));
+    }
+
+    simplebuffer_free(sb);
+    if (error) {
+        printf("Failed to parse big configuration. Error %d.\n", error);
+        return error;
+    }
+
+    return EOK;
+}
+
+/* Parse the same file with and without arena and modify it */
+static int arena_file_test(const char *name)
+{
+    int error = EOK;
+    struct ini_cfgobj *heap_cfg = NULL;
+    struct ini_cfgobj *arena_cfg = NULL;
+    struct ini_cfgobj *cfg = NULL;
+    struct value_obj *vo = NULL;
+    char **sections = NULL;
+    char **keys = NULL;
+    int size = 0;
+    int i;
+
+    if ((error = parse_file_flags(name, 0, &heap_cfg)) ||
+        (error = parse_file_flags(name, INI_PARSE_ARENA, &arena_cfg)) ||
+        (error = compare_configs(heap_cfg, arena_cfg))) goto done;
+
+    /* Refolding moves lines out of the arena */
+    if ((error = ini_config_set_wrap(heap_cfg, 20)) ||
+        (error = ini_config_set_wrap(arena_cfg, 20)) ||
+        (error = compare_configs(heap_cfg, arena_cfg))) goto done;
+
+    sections = ini_get_section_list(arena_cfg, &size, &error);
+    if ((error) || (size == 0)) goto done;
+
+    keys = ini_get_attribute_list(arena_cfg, sections[0], &size, &error);
+    if ((error) || (size == 0)) goto done;
+
+    for (i = 0; i < 2; i++) {
+        cfg = i ? arena_cfg : heap_cfg;
+        error = ini_get_config_valueobj(sections[0], keys[0], cfg,
+                                        INI_GET_FIRST_VALUE, &vo);
+        if ((error) || (!vo)) {
+            printf("Value is not found.\n");
+            error = ENOENT;
+            goto done;
+        }
+        error = value_update(vo, "updated value that is long enough "
+                             "to be folded", 46, INI_VALUE_CREATED, 20);
+        if (error) {
+            printf("Failed to update value. Error %d.\n", error);
+            goto done;
+        }
+    }
+
+    error = compare_configs(heap_cfg, arena_cfg);
+
+done:
+    ini_free_attribute_list(keys);
+    ini_free_section_list(sections);
+    ini_config_destroy(heap_cfg);
+    ini_config_destroy(arena_cfg);
+    return error;
+}
+
+static int arena_test(void)
+{
+    int error = EOK;
+
+    INIOUT(printf("<==== Arena test ====>\n"));
+
+    error = sample_files_test(arena_file_test, "Arena");
+    if (!error) error = parse_bench(INI_PARSE_ARENA, "with arena");
+    if (error) return error;
+
+    INIOUT(printf("<==== Arena test end ====>\n"));
+    return EOK;
+}
+
+/* Values parsed in lean mode must be the same */
+static int lean_file_test(const char *name)
+{
+    int error = EOK;
+    struct ini_cfgobj *full_cfg = NULL;
+    struct ini_cfgobj *lean_cfg = NULL;
+    struct ini_cfgobj *copy_cfg = NULL;
+    struct value_obj *vo = NULL;
+    struct simplebuffer *sb = NULL;
+    char **sections = NULL;
+    char **keys = NULL;
+    const char *str1;
+    const char *str2;
+    int num_sec = 0;
+    int num_keys = 0;
+    int i, j;
+
+    if ((error = parse_file_flags(name, 0, &full_cfg)) ||
+        (error = parse_file_flags(name, INI_PARSE_LEAN, &lean_cfg))) goto done;
+
+    sections = ini_get_section_list(full_cfg, &num_sec, &error);
+    if (error) goto done;
+
+    for (i = 0; i < num_sec; i++) {
+        keys = ini_get_attribute_list(full_cfg, sections[i],
+                                      &num_keys, &error);
+        if (error) goto done;
+
+        for (j = 0; j < num_keys; j++) {
+            error = ini_get_config_valueobj(sections[i], keys[j], full_cfg,
+                                            INI_GET_FIRST_VALUE, &vo);
+            if ((!error) && (vo)) error = value_get_concatenated(vo, &str1);
+            if (error) goto done;
+            error = ini_get_config_valueobj(sections[i], keys[j], lean_cfg,
+                                            INI_GET_FIRST_VALUE, &vo);
+            if ((!error) && (!vo)) error = ENOENT;
+            if (!error) error = value_get_concatenated(vo, &str2);
+            if (error) {
+                printf("Key %s is missing. Error %d.\n", keys[j], error);
+                goto done;
+            }
+            if (strcmp(str1, str2) != 0) {
+                printf("Values differ [%s] [%s].\n", str1, str2);
+                error = EINVAL;
+                goto done;
+            }
+        }
+
+        ini_free_attribute_list(keys);
+        keys = NULL;
+    }
+
+    /* Lean configuration and its copies can't be saved */
+    error = simplebuffer_alloc(&sb);
+    if (!error) error = ini_config_copy(lean_cfg, &copy_cfg);
+    if (error) goto done;
+
+    if ((ini_config_serialize(lean_cfg, sb) != ENOTSUP) ||
+        (ini_config_serialize(copy_cfg, sb) != ENOTSUP)) {
+        printf("Lean configuration was serialized.\n");
+        error = EINVAL;
+    }
+
+done:
+    simplebuffer_free(sb);
+    ini_free_attribute_list(keys);
+    ini_free_section_list(sections);
+    ini_config_destroy(full_cfg);
+    ini_config_destroy(lean_cfg);
+    ini_config_destroy(copy_cfg);
+    return error;
+}
+
+static int lean_test(void)
+{
+    int error = EOK;
+
+    INIOUT(printf("<==== Lean test ====>\n"));
+
+    error = sample_files_test(lean_file_test, "Lean");
+    if (!error) error = parse_bench(INI_PARSE_LEAN, "lean");
+    if (error) return error;
+
+    INIOUT(printf("<==== Lean test end ====>\n"));
+    return EOK;
+}
+
+/* Single line values are kept compact in memory */
+static int inline_test(void)
+{
+    int error = EOK;
+    struct ini_cfgobj *ini_config = NULL;
+    struct ini_cfgobj *ini_copy = NULL;
+    struct value_obj *vo = NULL;
+    struct simplebuffer *sbobj = NULL;
+    const char *text = "# Comment\n"
+                       "key1 = value  \n"
+                       "[section]\n"
+                       "key2 = first\n"
+                       "  second\n"
+                       "key3 =\n";
+    const char *expected = "# Comment\n"
+                           "key1 = value\n"
+                           "[section]\n"
+                           "key2 = first\n"
+                           "  second\n"
+                           "key3 = \n";
+    const char *expected_copy = "# Comment\n"
+                                "key1 = value\n"
+                                "[section]\n"
+                                "key2 = first  second\n"
+                                "key3 = \n";
+    const char *values[] = { "value", "first  second", "" };
+    const char *sections[] = { INI_DEFAULT_SECTION, "section", "section" };
+    const char *keys[] = { "key1", "key2", "key3" };
+    const char *str;
+    int i;
+
+    INIOUT(printf("<==== Inline test ====>\n"));
+
+    error = parse_mem(text, &ini_config);
+    if (error) return error;
+
+    for (i = 0; i < 3; i++) {
+        error = ini_get_config_valueobj(sections[i], keys[i], ini_config,
+                                        INI_GET_FIRST_VALUE, &vo);
+        if ((!error) && (!vo)) error = ENOENT;
+        if (!error) error = value_get_concatenated(vo, &str);
+        if (error) {
+            printf("Failed to get %s. Error %d.\n", keys[i], error);
+            ini_config_destroy(ini_config);
+            return error;
+        }
+        if (strcmp(str, values[i]) != 0) {
+            printf("Expected [%s] got [%s].\n", values[i], str);
+            ini_config_destroy(ini_config);
+            return EINVAL;
+        }
+    }
+
+    error = simplebuffer_alloc(&sbobj);
+    if (!error) error = ini_config_serialize(ini_config, sbobj);
+    if (error) {
+        printf("Failed to serialize. Error %d.\n", error);
+        simplebuffer_free(sbobj);
+        ini_config_destroy(ini_config);
+        return error;
+    }
+
+    INIOUT(printf("%s", simplebuffer_get_buf(sbobj)));
+
+    if (strcmp((const char *)simplebuffer_get_buf(sbobj), expected) != 0) {
+        printf("Unexpected serialization:\n%s\n",
+               simplebuffer_get_buf(sbobj));
+        simplebuffer_free(sbobj);
+        ini_config_destroy(ini_config);
+        return EINVAL;
+    }
+    simplebuffer_free(sbobj);
+
+    /* Copy folds the values again */
+    error = ini_config_copy(ini_config, &ini_copy);
+    ini_config_destroy(ini_config);
+    if (error) {
+        printf("Failed to copy. Error %d.\n", error);
+        return error;
+    }
+
+    error = simplebuffer_alloc(&sbobj);
+    if (!error) error = ini_config_serialize(ini_copy, sbobj);
+    if ((!error) &&
+        (strcmp((const char *)simplebuffer_get_buf(sbobj),
+                expected_copy) != 0)) {
+        printf("Unexpected serialization of copy:\n%s\n",
+               simplebuffer_get_buf(sbobj));
+        error = EINVAL;
+    }
+
+    simplebuffer_free(sbobj);
+    ini_config_destroy(ini_copy);
+    return error;
+}
+
+/* Collects what the streaming parser reports */
+struct stream_data {
+    struct simplebuffer *sb;
+    int values;
+    int errors;
+    int stop_at;
+};
+
+static int stream_section(const char *name, uint32_t name_len,
+                          uint32_t line, void *data)
+{
+    struct stream_data *sd = (struct stream_data *)data;
+    char buf[PATH_MAX];
+
+    snprintf(buf, PATH_MAX, "%u:[%s]\n", line, name);
+    return simplebuffer_add_str(sd->sb, buf, strlen(buf), 100);
+}
+
+static int stream_value(const char *key, uint32_t key_len,
+                        const char *value, uint32_t value_len,
+                        uint32_t line, void *data)
+{
+    struct stream_data *sd = (struct stream_data *)data;
+    char buf[PATH_MAX];
+
+    sd->values++;
+    if (sd->values == sd->stop_at) return ECANCELED;
+
+    snprintf(buf, PATH_MAX, "%u:%s=%s(%u)\n", line, key, value, value_len);
+    return simplebuffer_add_str(sd->sb, buf, strlen(buf), 100);
+}
+
+static int stream_comment(const char *text, uint32_t text_len,
+                          uint32_t line, void *data)
+{
+    struct stream_data *sd = (struct stream_data *)data;
+    char buf[PATH_MAX];
+
+    snprintf(buf, PATH_MAX, "%u:#%s\n", line, text);
+    return simplebuffer_add_str(sd->sb, buf, strlen(buf), 100);
+}
+
+static int stream_error(uint32_t line, int error, int warning, void *data)
+{
+    struct stream_data *sd = (struct stream_data *)data;
+    char buf[PATH_MAX];
+
+    sd->errors++;
+    snprintf(buf, PATH_MAX, "%u:%s %d\n", line,
+             warning ? "warning" : "error", error);
+    return simplebuffer_add_str(sd->sb, buf, strlen(buf), 100);
+}
+
+static int stream_mem(const char *text, int error_level,
+                      uint32_t parse_flags, struct stream_data *sd)
+{
+    int error = EOK;
+    struct ini_cfgfile *file_ctx = NULL;
+    struct ini_parse_cb cb = { stream_section,
+                               stream_value,
+                               stream_comment,
+                               stream_error };
+
+    error = ini_config_file_from_mem((void *)text, strlen(text), &file_ctx);
+    if (error) {
+        printf("Failed to open from memory. Error %d.\n", error);
+        return error;
+    }
+
+    error = ini_config_parse_stream(file_ctx, error_level,
+                                    parse_flags, &cb, sd);
+    ini_config_file_destroy(file_ctx);
+
+    INIOUT(printf("%s", simplebuffer_get_buf(sd->sb)));
+    return error;
+}
+
+static int stream_test(void)
+{
+    int error = EOK;
+    struct stream_data sd;
+    const char *text = "# Comment\n"
+                       "key0 = top  \n"
+                       "[ section ]\n"
+                       "key1 = first\n"
+                       "  second\n"
+                       "\n"
+                       "[section]\n"
+                       "key1 = again\n";
+    const char *expected = "1:## Comment\n"
+                           "2:key0=top(3)\n"
+                           "3:[section]\n"
+                           "4:key1=first  second(13)\n"
+                           "6:#\n"
+                           "7:[section]\n"
+                           "8:key1=again(5)\n";
+    const char *lean = "2:key0=top(3)\n"
+                       "3:[section]\n"
+                       "4:key1=first  second(13)\n"
+                       "7:[section]\n"
+                       "8:key1=again(5)\n";
+    const char *bad = "key1 = a\n"
+                      "no equal sign\n"
+                      "key2 = b\n";
+    /* Value is complete only when the next one starts */
+    const char *bad_expected = "2:error 5\n"
+                               "1:key1=a(1)\n"
+                               "3:key2=b(1)\n";
+    const char *results[] = { expected, lean, bad_expected };
+    int i;
+
+    INIOUT(printf("<==== Stream test ====>\n"));
+
+    for (i = 0; i < 4; i++) {
+        memset(&sd, 0, sizeof(sd));
+        error = simplebuffer_alloc(&(sd.sb));
+        if (error) return error;
+
+        switch (i) {
+        case 0:
+            error = stream_mem(text, INI_STOP_ON_ANY, 0, &sd);
+            break;
+        case 1:
+            error = stream_mem(text, INI_STOP_ON_ANY, INI_PARSE_LEAN, &sd);
+            break;
+        case 2:
+            /* Parsing continues after the error */
+            error = stream_mem(bad, INI_STOP_ON_NONE, 0, &sd);
+            if ((error == EIO) && (sd.errors == 1)) error = EOK;
+            break;
+        default:
+            /* Callback stops parsing */
+            sd.stop_at = 2;
+            error = stream_mem(text, INI_STOP_ON_ANY, 0, &sd);
+            if ((error == ECANCELED) && (sd.values == 2)) error = EOK;
+            else error = EINVAL;
+        }
+
+        if ((!error) && (i < 3) &&
+            (strcmp((const char *)simplebuffer_get_buf(sd.sb),
+                    results[i]) != 0)) {
+            printf("Unexpected events in pass %d:\n%s", i,
+                   simplebuffer_get_buf(sd.sb));
+            error = EINVAL;
+        }
+
+        simplebuffer_free(sd.sb);
+        if (error) {
+            printf("Stream test failed in pass %d. Error %d.\n", i, error);
+            return error;
+        }
+    }
+
+    INIOUT(printf("<==== Stream test end ====>\n"));
+    return EOK;
+}
+
+/* Parse the file by name and by file object and compare the events */
+static int stream_compare(const char *path)
+{
+    int error = EOK;
+    struct stream_data sd[2];
+    struct ini_cfgfile *file_ctx = NULL;
+    struct ini_parse_cb cb = { stream_section,
+                               stream_value,
+                               stream_comment,
+                               stream_error };
+    int i;
+
+    memset(sd, 0, sizeof(sd));
+    for (i = 0; i < 2; i++) {
+        error = simplebuffer_alloc(&(sd[i].sb));
+        if (error) goto done;
+    }
+
+    error = ini_config_parse_stream_file(path, INI_STOP_ON_ANY, 0, &cb, &sd[0]);
+    if (error) {
+        printf("Failed to stream file %s. Error %d.\n", path, error);
+        goto done;
+    }
+
+    error = ini_config_file_open(path, 0, &file_ctx);
+    if (error) {
+        printf("Failed to open file %s. Error %d.\n", path, error);
+        goto done;
+    }
+    error = ini_config_parse_stream(file_ctx, INI_STOP_ON_ANY, 0, &cb, &sd[1]);
+    ini_config_file_destroy(file_ctx);
+    if (error) {
+        printf("Failed to stream file object %s. Error %d.\n", path, error);
+        goto done;
+    }
+
+    if ((simplebuffer_get_len(sd[0].sb) == 0) ||
+        (strcmp((const char *)simplebuffer_get_buf(sd[0].sb),
+                (const char *)simplebuffer_get_buf(sd[1].sb)) != 0)) {
+        printf("Events differ for file %s:\n%s", path,
+               simplebuffer_get_buf(sd[0].sb));
+        error = EINVAL;
+    }
+
+done:
+    for (i = 0; i < 2; i++) simplebuffer_free(sd[i].sb);
+    return error;
+}
+
+static int stream_file_test(void)
+{
+    int error = EOK;
+    char path[PATH_MAX];
+    char *srcdir = NULL;
+    char *builddir = NULL;
+    struct stream_data sd;
+    struct ini_parse_cb cb = { stream_section,
+                               stream_value,
+                               stream_comment,
+                               stream_error };
+    const char *files[] = { "real8.conf",
+                            "real16be.conf",
+                            "real16le.conf",
+                            "real32be.conf",
+                            "real32le.conf",
+                            NULL };
+    struct {
+        const char *text;
+        int error;
+    } bad[] = { { "key = a\nkey = \xC3\x28\n", EILSEQ },
+                { "key = a\nkey = \xE2\x82", EINVAL },
+                { NULL, 0 } };
+    int i;
+
+    INIOUT(printf("<==== Stream file test ====>\n"));
+
+    srcdir = getenv("srcdir");
+    builddir = getenv("builddir");
+
+    /* Files in all encodings, UTF-32 ones span several buffers */
+    for (i = 0; files[i]; i++) {
+        snprintf(path, PATH_MAX, "%s/ini/ini.d/%s",
+                 (srcdir == NULL) ? "." : srcdir, files[i]);
+        error = stream_compare(path);
+        if (error) return error;
+    }
+
+    snprintf(path, PATH_MAX, "%s/stream.conf",
+             (builddir == NULL) ? "." : builddir);
+
+    for (i = 0; bad[i].text; i++) {
+        error = write_text(path, "w", bad[i].text);
+        if (error) return error;
+
+        memset(&sd, 0, sizeof(sd));
+        error = simplebuffer_alloc(&(sd.sb));
+        if (error) return error;
+        error = ini_config_parse_stream_file(path, INI_STOP_ON_ANY, 0,
+                                             &cb, &sd);
+        simplebuffer_free(sd.sb);
+        if (error != bad[i].error) {
+            printf("Expected error %d for case %d got %d.\n",
+                   bad[i].error, i, error);
+            return EINVAL;
+        }
+    }
+
+    error = ini_config_parse_stream_file(path, INI_STOP_ON_ANY, 0,
+                                         NULL, NULL);
+    if (error != EINVAL) {
+        printf("Expected EINVAL without callbacks got %d.\n", error);
+        return EINVAL;
+    }
+
+    unlink(path);
+
+    INIOUT(printf("<==== Stream file test end ====>\n"));
+    return EOK;
+}
+
+/* UTF-8 files are validated without conversion */
+static int utf8_test(void)
+{
+    int error = EOK;
+    struct ini_cfgfile *file_ctx = NULL;
+    struct ini_cfgobj *ini_config = NULL;
+    struct value_obj *vo = NULL;
+    const char *str = NULL;
+    char bom_text[] = "\xEF\xBB\xBFkey = \xC3\xA9t\xC3\xA9 \xE2\x82\xAC "
+                      "\xF0\x9F\x98\x80 long enough ascii text\n";
+    struct {
+        char text[32];
+        int error;
+    } bad[] = { { "key = \xC3\x28\n", EILSEQ },
+                { "key = \xC0\xAF\n", EILSEQ },
+                { "key = \xED\xA0\x80\n", EILSEQ },
+                { "key = \xF4\x90\x80\x80\n", EILSEQ },
+                { "key = \xE2\x82", EINVAL },
+                { "", 0 } };
+    int i;
+
+    INIOUT(printf("<==== UTF-8 test ====>\n"));
+
+    for (i = 0; bad[i].error; i++) {
+        error = ini_config_file_from_mem(bad[i].text, strlen(bad[i].text),
+                                         &file_ctx);
+        if (error != bad[i].error) {
+            printf("Expected error %d for case %d got %d.\n",
+                   bad[i].error, i, error);
+            ini_config_file_destroy(file_ctx);
+            return EINVAL;
+        }
+    }
+
+    /* BOM is skipped and multibyte characters are kept */
+    error = ini_config_file_from_mem(bom_text, strlen(bom_text), &file_ctx);
+    if (error) {
+        printf("Failed to open from memory. Error %d.\n", error);
+        return error;
+    }
+
+    error = ini_config_create(&ini_config);
+    if (!error) error = ini_config_parse(file_ctx, INI_STOP_ON_ANY,
+                                         0, 0, ini_config);
+    ini_config_file_destroy(file_ctx);
+    if (!error) error = ini_get_config_valueobj(INI_DEFAULT_SECTION, "key",
+                                                ini_config,
+                                                INI_GET_FIRST_VALUE, &vo);
+    if ((!error) && (!vo)) error = ENOENT;
+    if (!error) error = value_get_concatenated(vo, &str);
+    if (error) {
+        printf("Failed to read the value. Error %d.\n", error);
+        ini_config_destroy(ini_config);
+        return error;
+    }
+
+    /* Value follows the BOM and "key = " and ends before the new line */
+    if ((strlen(str) != strlen(bom_text) - 10) ||
+        (strncmp(str, bom_text + 9, strlen(str)) != 0)) {
+        printf("Unexpected value [%s].\n", str);
+        error = EINVAL;
+    }
+
+    ini_config_destroy(ini_config);
+    return error;
+}
+
+/* Counts calls of the release function */
+static void borrow_release(void *data_buf, void *release_data)
+{
+    free(data_buf);
+    (*(int *)release_data)++;
+}
+
+/* Borrowed buffer is parsed in place and released with the file object */
+static int borrow_mem_test(void)
+{
+    int error = EOK;
+    struct ini_cfgfile *file_ctx = NULL;
+    struct ini_cfgobj *ini_config = NULL;
+    struct value_obj *vo = NULL;
+    const char *str = NULL;
+    const char text[] = "\xEF\xBB\xBF[section]\nkey = \xC3\xA9t\xC3\xA9\n"
+                        "other = value\n";
+    const char bad[] = "key = \xC3\x28\n";
+    char *buf;
+    int released = 0;
+
+    INIOUT(printf("<==== Borrow memory test ====>\n"));
+
+    /* Invalid data is not released */
+    buf = malloc(sizeof(bad) - 1);
+    if (!buf) return ENOMEM;
+    memcpy(buf, bad, sizeof(bad) - 1);
+    error = ini_config_file_from_mem_borrow(buf, sizeof(bad) - 1,
+                                            borrow_release, &released,
+                                            &file_ctx);
+    if ((error != EILSEQ) || (released != 0)) {
+        printf("Expected EILSEQ without release got %d, %d.\n",
+               error, released);
+        free(buf);
+        return EINVAL;
+    }
+    free(buf);
+
+    /* Buffer is not terminated */
+    buf = malloc(sizeof(text) - 1);
+    if (!buf) return ENOMEM;
+    memcpy(buf, text, sizeof(text) - 1);
+    error = ini_config_file_from_mem_borrow(buf, sizeof(text) - 1,
+                                            borrow_release, &released,
+                                            &file_ctx);
+    if (error) {
+        printf("Failed to borrow memory. Error %d.\n", error);
+        free(buf);
+        return error;
+    }
+
+    error = ini_config_create(&ini_config);
+    if (!error) error = ini_config_parse(file_ctx, INI_STOP_ON_ANY,
+                                         0, 0, ini_config);
+    ini_config_file_destroy(file_ctx);
+    if (released != 1) {
+        printf("Expected one release got %d.\n", released);
+        ini_config_destroy(ini_config);
+        return EINVAL;
+    }
+
+    /* Values outlive the buffer */
+    if (!error) error = ini_get_config_valueobj("section", "key",
+                                                ini_config,
+                                                INI_GET_FIRST_VALUE, &vo);
+    if ((!error) && (!vo)) error = ENOENT;
+    if (!error) error = value_get_concatenated(vo, &str);
+    if ((!error) && (strcmp(str, "\xC3\xA9t\xC3\xA9") != 0)) {
+        printf("Unexpected value [%s].\n", str);
+        error = EINVAL;
+    }
+    if (!error) error = ini_get_config_valueobj("section", "other",
+                                                ini_config,
+                                                INI_GET_FIRST_VALUE, &vo);
+    if ((!error) && (!vo)) error = ENOENT;
+    if (!error) error = value_get_concatenated(vo, &str);
+    if ((!error) && (strcmp(str, "value") != 0)) {
+        printf("Unexpected value [%s].\n", str);
+        error = EINVAL;
+    }
+
+    ini_config_destroy(ini_config);
+    return error;
+}
+
+/* Get value of the key in the main section */
+static struct value_obj *array_value(struct ini_cfgobj *cfg, const char *key)
+{
+    struct value_obj *vo = NULL;
+
+    if ((ini_get_config_valueobj("main", key, cfg,
+                                 INI_GET_FIRST_VALUE, &vo)) || (!vo)) {
+        printf("Failed to find key %s.\n", key);
+        return NULL;
+    }
+
+    return vo;
+}
+
+/* Arrays are split once and then returned from the value */
+static int array_view_test(void)
+{
+    int error = EOK;
+    struct ini_cfgobj *cfg = NULL;
+    struct value_obj *vo = NULL;
+    const char * const *view = NULL;
+    const char * const *view2 = NULL;
+    const long *lview = NULL;
+    const double *dview = NULL;
+    char **strarray = NULL;
+    long *larray = NULL;
+    int size = 0;
+    int i;
+    clock_t start;
+    const char *text = "[main]\n"
+                       "servers = alpha, beta ,, gamma;delta\n"
+                       "ports = 7\n"
+                       "numbers = 10, -20, 30\n"
+                       "ratios = 0.5 1.5\n"
+                       "bad = x1\n";
+
+    INIOUT(printf("<==== Array view test ====>\n"));
+
+    error = parse_mem(text, &cfg);
+    if (error) return error;
+
+    vo = array_value(cfg, "servers");
+    if (!vo) {
+        ini_config_destroy(cfg);
+        return ENOENT;
+    }
+
+    /* The same array is returned for the same separators */
+    view = ini_get_string_config_array_view(vo, NULL, &size, &error);
+    view2 = ini_get_string_config_array_view(vo, ",", NULL, &error);
+    if ((error) || (!view) || (view != view2) || (size != 3) ||
+        (strcmp(view[0], "alpha") != 0) ||
+        (strcmp(view[1], "beta") != 0) ||
+        (strcmp(view[2], "gamma;delta") != 0) ||
+        (view[3] != NULL)) {
+        printf("Unexpected array of strings. Error %d.\n", error);
+        ini_config_destroy(cfg);
+        return error ? error : EINVAL;
+    }
+
+    view2 = ini_get_string_config_array_view(vo, ",;", &size, &error);
+    if ((error) || (view2 == view) || (size != 4) ||
+        (strcmp(view2[3], "delta") != 0)) {
+        printf("Unexpected array for other separators. Error %d.\n", error);
+        ini_config_destroy(cfg);
+        return error ? error : EINVAL;
+    }
+
+    /* Allocated copies are not affected by the cached arrays */
+    strarray = ini_get_raw_string_config_array(vo, NULL, &size, &error);
+    if ((error) || (size != 4) || (strarray[2][0] != '\0') ||
+        (strcmp(strarray[3], "gamma;delta") != 0) ||
+        (strarray[4] != NULL)) {
+        printf("Unexpected raw array of strings. Error %d.\n", error);
+        ini_free_string_config_array(strarray);
+        ini_config_destroy(cfg);
+        return error ? error : EINVAL;
+    }
+    ini_free_string_config_array(strarray);
+
+    /* Single number used to be at the edge of the buffer */
+    vo = array_value(cfg, "ports");
+    if (vo) larray = ini_get_long_config_array(vo, &size, &error);
+    if ((!larray) || (error) || (size != 1) || (larray[0] != 7)) {
+        printf("Unexpected array of one long. Error %d.\n", error);
+        ini_free_long_config_array(larray);
+        ini_config_destroy(cfg);
+        return error ? error : EINVAL;
+    }
+    ini_free_long_config_array(larray);
+
+    vo = array_value(cfg, "numbers");
+    if (vo) lview = ini_get_long_config_array_view(vo, &size, &error);
+    if ((!lview) || (error) || (size != 3) ||
+        (lview[0] != 10) || (lview[1] != -20) || (lview[2] != 30) ||
+        (lview != ini_get_long_config_array_view(vo, &size, &error))) {
+        printf("Unexpected array of longs. Error %d.\n", error);
+        ini_config_destroy(cfg);
+        return error ? error : EINVAL;
+    }
+
+    vo = array_value(cfg, "ratios");
+    if (vo) dview = ini_get_double_config_array_view(vo, &size, &error);
+    if ((!dview) || (error) || (size != 2) ||
+        (dview[0] != 0.5) || (dview[1] != 1.5)) {
+        printf("Unexpected array of doubles. Error %d.\n", error);
+        ini_config_destroy(cfg);
+        return error ? error : EINVAL;
+    }
+
+    /* Conversion error is returned every time */
+    vo = array_value(cfg, "bad");
+    for (i = 0; (vo) && (i < 2); i++) {
+        lview = ini_get_long_config_array_view(vo, &size, &error);
+        if ((lview) || (error != EIO)) {
+            printf("Expected EIO got %d.\n", error);
+            ini_config_destroy(cfg);
+            return EINVAL;
+        }
+    }
+
+    /* Compare with the arrays that are allocated every time */
+    vo = array_value(cfg, "servers");
+    start = clock();
+    for (i = 0; (vo) && (i < 100000); i++) {
+        strarray = ini_get_string_config_array(vo, ",:", &size, &error);
+        ini_free_string_config_array(strarray);
+    }
+    INIOUT(printf("Allocated arrays: %.3fs\n",
+                  (double)(clock() - start) / CLOCKS_PER_SEC));
+    start = clock();
+    for (i = 0; (vo) && (i < 100000); i++) {
+        view = ini_get_string_config_array_view(vo, ",:", &size, &error);
+    }
+    INIOUT(printf("Array views: %.3fs\n",
+                  (double)(clock() - start) / CLOCKS_PER_SEC));
+
+    ini_config_destroy(cfg);
+
+    INIOUT(printf("<==== Array view test end ====>\n"));
+    return EOK;
+}
+
+/* Configuration whose value matches the version */
+static int version_config(int version, struct ini_cfgobj **cfg)
+{
+    char buf[100];
+
+    snprintf(buf, sizeof(buf), "[one]\nkey = %d\n", version);
+    return parse_mem(buf, cfg);
+}
+
+/* Check that the snapshot is consistent */
+static int check_snapshot(struct ini_cfgsnapshot *snapshot)
+{
+    int error = EOK;
+    struct value_obj *vo = NULL;
+    struct ini_cursor cursor;
+    int value;
+
+    /* Readers share the configuration so the search
+     * state must be their own */
+    error = ini_get_config_valueobj_r("one", "key",
+                                      ini_config_snapshot_get(snapshot),
+                                      INI_GET_FIRST_VALUE, &cursor, &vo);
+    if ((error) || (!vo)) return ENOENT;
+
+    value = ini_get_int_config_value(vo, 1, 0, &error);
+    if ((error) ||
+        ((uint64_t)value != ini_config_snapshot_version(snapshot))) {
+        printf("Snapshot %d has value %d.\n",
+               (int)ini_config_snapshot_version(snapshot), value);
+        return EINVAL;
+    }
+    return EOK;
+}
+
+#define SNAPSHOT_VERSIONS 200
+#define SNAPSHOT_READS 5000
+
+#ifdef HAVE_PTHREAD
+/* Reader thread */
+static void *snapshot_reader(void *data)
+{
+    struct ini_cfghandle *handle = (struct ini_cfghandle *)data;
+    struct ini_cfgsnapshot *snapshot = NULL;
+    uint64_t last = 0;
+    intptr_t error = EOK;
+    int i;
+
+    for (i = 0; i < SNAPSHOT_READS; i++) {
+        error = ini_config_snapshot_refresh(handle, &snapshot);
+        if (error) break;
+        if (ini_config_snapshot_version(snapshot) < last) {
+            printf("Version went back.\n");
+            error = EINVAL;
+            break;
+        }
+        last = ini_config_snapshot_version(snapshot);
+        error = check_snapshot(snapshot);
+        if (error) break;
+    }
+
+    ini_config_snapshot_release(snapshot);
+    return (void *)error;
+}
+#endif
+
+static int snapshot_test(void)
+{
+    int error = EOK;
+    struct ini_cfgobj *cfg = NULL;
+    struct ini_cfghandle *handle = NULL;
+    struct ini_cfgsnapshot *old = NULL;
+    struct ini_cfgsnapshot *snapshot = NULL;
+    int i;
+#ifdef HAVE_PTHREAD
+    pthread_t readers[2];
+    void *ret;
+    int j;
+#endif
+
+    INIOUT(printf("<==== Snapshot test ====>\n"));
+
+    error = version_config(1, &cfg);
+    if (error) return error;
+
+    error = ini_config_handle_create(cfg, &handle);
+    if (error) {
+        printf("Failed to create handle. Error %d.\n", error);
+        ini_config_destroy(cfg);
+        return error;
+    }
+
+    /* Old snapshot survives the publish */
+    if ((error = ini_config_snapshot_acquire(handle, &old)) ||
+        (error = version_config(2, &cfg))) goto done;
+
+    error = ini_config_handle_publish(handle, cfg);
+    if (error) {
+        ini_config_destroy(cfg);
+        goto done;
+    }
+
+    if ((ini_config_handle_version(handle) != 2) ||
+        (ini_config_snapshot_version(old) != 1)) {
+        printf("Unexpected versions.\n");
+        error = EINVAL;
+        goto done;
+    }
+
+    snapshot = old;
+    if ((error = check_snapshot(old)) ||
+        (error = ini_config_snapshot_acquire(handle, &old)) ||
+        (error = ini_config_snapshot_refresh(handle, &snapshot)) ||
+        (error = check_snapshot(snapshot))) goto done;
+
+    if (snapshot != old) {
+        printf("Refresh did not return the current snapshot.\n");
+        error = EINVAL;
+        goto done;
+    }
+
+    /* Current configuration can't be published again */
+    error = ini_config_handle_publish(handle, ini_config_snapshot_get(old));
+    if ((error != EINVAL) || (ini_config_handle_version(handle) != 2)) {
+        printf("Publishing the current configuration was not rejected.\n");
+        error = EINVAL;
+        goto done;
+    }
+    error = EOK;
+
+#ifdef HAVE_PTHREAD
+    for (i = 0; i < 2; i++) {
+        error = pthread_create(&readers[i], NULL, snapshot_reader, handle);
+        if (error) break;
+    }
+
+    for (j = 3; (!error) && (j <= SNAPSHOT_VERSIONS); j++) {
+        error = version_config(j, &cfg);
+        if (error) break;
+        error = ini_config_handle_publish(handle, cfg);
+        if (error) ini_config_destroy(cfg);
+    }
+
+    while (i-- > 0) {
+        pthread_join(readers[i], &ret);
+        if ((!error) && (ret)) error = (int)(intptr_t)ret;
+    }
+    if (error) {
+        printf("Concurrent access failed. Error %d.\n", error);
+        goto done;
+    }
+#else
+    (void)i;
+#endif
+
+    INIOUT(printf("<==== Snapshot test end ====>\n"));
+
+done:
+    ini_config_snapshot_release(old);
+    ini_config_snapshot_release(snapshot);
+    ini_config_handle_destroy(handle);
+    return error;
+}
+
+/* Configurations compared by the fold thread */
+struct fold_data {
+    struct ini_cfgobj *folded;
+    struct ini_cfgobj *copy;
+};
+
+#ifdef HAVE_PTHREAD
+/* Serialize the shared copy */
+static void *fold_reader(void *data)
+{
+    struct fold_data *fd = (struct fold_data *)data;
+
+    return (void *)(intptr_t)compare_configs(fd->folded, fd->copy);
+}
+#endif
+
+/* Copied values are folded when they are saved,
+ * possibly by several threads at the same time.
+ */
+static int shared_fold_test(void)
+{
+    int error = EOK;
+    struct ini_cfgobj *orig = NULL;
+    struct fold_data fd = { NULL, NULL };
+    const char text[] = "[one]\nkey = this value is long enough to be folded "
+                        "into several lines when the configuration is saved "
+                        "back with the default boundary of eighty\n"
+                        "other = short\n";
+#ifdef HAVE_PTHREAD
+    pthread_t readers[2];
+    void *ret;
+    int i;
+#endif
+
+    INIOUT(printf("<==== Shared fold test ====>\n"));
+
+    error = parse_mem(text, &orig);
+    if (error) return error;
+
+    /* The first copy is folded before the threads start */
+    error = ini_config_copy(orig, &(fd.folded));
+    if (!error) error = ini_config_copy(orig, &(fd.copy));
+    if (!error) error = compare_configs(fd.folded, fd.folded);
+    ini_config_destroy(orig);
+    if (error) {
+        printf("Failed to copy configuration. Error %d.\n", error);
+        ini_config_destroy(fd.folded);
+        ini_config_destroy(fd.copy);
+        return error;
+    }
+
+#ifdef HAVE_PTHREAD
+    for (i = 0; i < 2; i++) {
+        error = pthread_create(&readers[i], NULL, fold_reader, &fd);
+        if (error) break;
+    }
+
+    while (i-- > 0) {
+        pthread_join(readers[i], &ret);
+        if ((!error) && (ret)) error = (int)(intptr_t)ret;
+    }
+#endif
+
+    if (!error) error = compare_configs(fd.folded, fd.copy);
+
+    ini_config_destroy(fd.copy);
+    ini_config_destroy(fd.folded);
+
+    INIOUT(printf("<==== Shared fold test end ====>\n"));
+    return error;
+}
+
 static void create_boms(void)
 {
     FILE *f;
@@ -3195,16 +4997,35 @@ int main(int argc, char *argv[])
                         space_test,
                         trim_test,
                         comment_test,
+                        bind_test,
+                        cache_test,
+                        merge_into_test,
+                        merge_bench_test,
+                        snapshot_test,
+                        shared_fold_test,
+                        arena_test,
+                        inline_test,
+                        lean_test,
+                        stream_test,
+                        stream_file_test,
+                        utf8_test,
+                        borrow_mem_test,
+                        array_view_test,
                         NULL };
     test_fn t;
     int i = 0;
     char *var;
 
-    if ((argc > 1) && (strcmp(argv[1], "-v") == 0)) verbose = 1;
-    else {
-        var = getenv("COMMON_TEST_VERBOSE");
-        if (var) verbose = 1;
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-v") == 0) verbose = 1;
+        else if (strcmp(argv[i], "-p") == 0) perf = 1;
     }
+    var = getenv("COMMON_TEST_VERBOSE");
+    if (var) verbose = 1;
+    var = getenv("COMMON_TEST_PERF");
+    if (var) perf = 1;
+
+    i = 0;
 
     /* Create boms in case we want to create more test files */
     create_boms();
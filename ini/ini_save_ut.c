@@ -29,6 +29,8 @@
 #define TRACE_HOME
 #include "trace.h"
 #include "ini_configobj.h"
+#include "ini_defines.h"
+#include "ini_configmod.h"
 #include "ini_config_priv.h"
 #include "collection_tools.h"
 #include "path_utils.h"
@@ -230,10 +232,185 @@ static int basic_test(void)
 }
 
 
+/* Parse the file and serialize the configuration */
+static int read_serialized(const char *name, uint32_t parse_flags,
+                           struct ini_cfgfile **file_ctx,
+                           struct ini_cfgobj **ini_config,
+                           struct simplebuffer **sb)
+{
+    int error = EOK;
+
+    error = ini_config_file_open(name, INI_META_STATS, file_ctx);
+    if (error) {
+        printf("Failed to open file %s. Error %d.\n", name, error);
+        return error;
+    }
+
+    error = ini_config_create(ini_config);
+    if (!error) error = ini_config_parse(*file_ctx, INI_STOP_ON_ANY, 0,
+                                         parse_flags, *ini_config);
+    if ((!error) && (sb)) {
+        error = simplebuffer_alloc(sb);
+        if (!error) error = ini_config_serialize(*ini_config, *sb);
+    }
+
+    if (error) {
+        printf("Failed to read %s. Error %d.\n", name, error);
+        ini_config_file_destroy(*file_ctx);
+        ini_config_destroy(*ini_config);
+        *file_ctx = NULL;
+        *ini_config = NULL;
+    }
+
+    return error;
+}
+
+/* Big configuration is saved in portions */
+static int big_save_test(void)
+{
+    int error = EOK;
+    char srcname[PATH_MAX];
+    char resname[PATH_MAX];
+    char line[PATH_MAX];
+    char *builddir = NULL;
+    struct simplebuffer *sb = NULL;
+    struct simplebuffer *sb2 = NULL;
+    struct ini_cfgfile *file_ctx = NULL;
+    struct ini_cfgfile *file_ctx2 = NULL;
+    struct ini_cfgobj *ini_config = NULL;
+    struct ini_cfgobj *ini_config2 = NULL;
+    FILE *ff = NULL;
+    int i;
+
+    INIOUT(printf("<==== Start of big save test ====>\n"));
+
+    builddir = getenv("builddir");
+    snprintf(srcname, PATH_MAX, "%s/test_big.conf",
+             (builddir == NULL) ? "." : builddir);
+    snprintf(resname, PATH_MAX, "%s/test_big16.conf",
+             (builddir == NULL) ? "." : builddir);
+
+    error = simplebuffer_alloc(&sb);
+    for (i = 0; (!error) && (i < 20000); i++) {
+        if (i % 100 == 0) snprintf(line, PATH_MAX,
+                                   "# Section %d\n[section%d]\n", i, i);
+        else snprintf(line, PATH_MAX,
+                      "key%d = value number %d with some text in it\n",
+                      i, i);
+        error = simplebuffer_add_str(sb, line, strlen(line), 1000);
+    }
+    if (error) {
+        printf("Failed to build configuration. Error %d.\n", error);
+        simplebuffer_free(sb);
+        return error;
+    }
+
+    ff = fopen(srcname, "w");
+    if ((!ff) ||
+        (fwrite(simplebuffer_get_buf(sb), simplebuffer_get_len(sb),
+                1, ff) != 1)) {
+        printf("Failed to write %s.\n", srcname);
+        if (ff) fclose(ff);
+        simplebuffer_free(sb);
+        return EIO;
+    }
+    fclose(ff);
+    simplebuffer_free(sb);
+    sb = NULL;
+
+    /* Lean configuration can't be saved */
+    error = read_serialized(srcname, INI_PARSE_LEAN,
+                            &file_ctx, &ini_config, NULL);
+    if (error) return error;
+    error = ini_config_save_as(file_ctx, resname, NULL, ini_config);
+    ini_config_file_destroy(file_ctx);
+    ini_config_destroy(ini_config);
+    if (error != ENOTSUP) {
+        printf("Expected ENOTSUP got %d.\n", error);
+        return EINVAL;
+    }
+
+    /* Save in UTF-16 and read back */
+    error = read_serialized(srcname, 0, &file_ctx, &ini_config, &sb);
+    if (error) return error;
+
+    error = ini_config_set_bom(file_ctx, INDEX_UTF16LE);
+    if (!error) error = ini_config_save_as(file_ctx, resname,
+                                           NULL, ini_config);
+    ini_config_file_destroy(file_ctx);
+    ini_config_destroy(ini_config);
+    if (error) {
+        printf("Failed to save %s. Error %d.\n", resname, error);
+        simplebuffer_free(sb);
+        return error;
+    }
+
+    error = read_serialized(resname, 0, &file_ctx2, &ini_config2, &sb2);
+    if (error) {
+        simplebuffer_free(sb);
+        return error;
+    }
+
+    if ((ini_config_get_bom(file_ctx2) != INDEX_UTF16LE) ||
+        (simplebuffer_get_len(sb) != simplebuffer_get_len(sb2)) ||
+        (memcmp(simplebuffer_get_buf(sb), simplebuffer_get_buf(sb2),
+                simplebuffer_get_len(sb)) != 0)) {
+        printf("Saved configuration does not match.\n");
+        error = EINVAL;
+    }
+
+    /* Value that can't be encoded stops the save
+     * after a part of the file was written */
+    if (!error) error = ini_config_add_str_value(ini_config2,
+                                                 "section19900",
+                                                 "bad",
+                                                 "\xff\xfe",
+                                                 NULL, 0,
+                                                 INI_WRAP_BOUNDARY,
+                                                 COL_DSP_END,
+                                                 NULL, 0,
+                                                 INI_VA_NOCHECK);
+    if (!error) {
+        error = ini_config_save(file_ctx2, NULL, ini_config2);
+        if (error != EILSEQ) {
+            printf("Expected EILSEQ got %d.\n", error);
+            error = EINVAL;
+        }
+        else error = EOK;
+    }
+    simplebuffer_free(sb2);
+    sb2 = NULL;
+    ini_config_file_destroy(file_ctx2);
+    ini_config_destroy(ini_config2);
+    file_ctx2 = NULL;
+    ini_config2 = NULL;
+
+    /* Old file is still there */
+    if (!error) error = read_serialized(resname, 0, &file_ctx2,
+                                        &ini_config2, &sb2);
+    if ((!error) &&
+        ((simplebuffer_get_len(sb) != simplebuffer_get_len(sb2)) ||
+         (memcmp(simplebuffer_get_buf(sb), simplebuffer_get_buf(sb2),
+                 simplebuffer_get_len(sb)) != 0))) {
+        printf("Failed save changed the file.\n");
+        error = EINVAL;
+    }
+
+    simplebuffer_free(sb);
+    simplebuffer_free(sb2);
+    ini_config_file_destroy(file_ctx2);
+    ini_config_destroy(ini_config2);
+
+    INIOUT(printf("<==== END ====>\n"));
+    return error;
+}
+
+
 int main(int argc, char *argv[])
 {
     int error = EOK;
     test_fn tests[] = { basic_test,
+                        big_save_test,
                         NULL };
     test_fn t;
     int i = 0;
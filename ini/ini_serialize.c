@@ -32,6 +32,42 @@
 #include "ini_config_priv.h"
 #include "trace.h"
 
+/* Serialization state */
+struct serialize_data {
+    struct simplebuffer *sbobj;
+    /* Pass the data to the sink after this many bytes */
+    uint32_t limit;
+    /* NULL if everything is collected in the buffer */
+    ini_serialize_sink sink;
+    void *sink_data;
+};
+
+/* Pass what was serialized so far to the sink */
+static int serialize_flush(struct serialize_data *sd)
+{
+    int error = EOK;
+
+    TRACE_FLOW_ENTRY();
+
+    if (simplebuffer_get_len(sd->sbobj) == 0) return EOK;
+
+    error = sd->sink(simplebuffer_get_vbuf(sd->sbobj),
+                     simplebuffer_get_len(sd->sbobj),
+                     sd->sink_data);
+    if (error) {
+        TRACE_ERROR_NUMBER("Sink failed", error);
+        return error;
+    }
+
+    /* Start over with an empty buffer */
+    simplebuffer_free(sd->sbobj);
+    sd->sbobj = NULL;
+    error = simplebuffer_alloc(&(sd->sbobj));
+
+    TRACE_FLOW_RETURN(error);
+    return error;
+}
+
 /* Callback */
 static int ini_serialize_cb(const char *property,
                             int property_len,
@@ -42,29 +78,37 @@ static int ini_serialize_cb(const char *property,
                             int *stop)
 {
     int error = EOK;
-    struct simplebuffer *sbobj;
+    struct serialize_data *sd;
     struct value_obj *vo;
 
     TRACE_FLOW_ENTRY();
 
     /* Banary items are the values */
     if(type == COL_TYPE_BINARY) {
-        sbobj = (struct simplebuffer *)custom_data;
+        sd = (struct serialize_data *)custom_data;
         vo = *((struct value_obj **)(data));
-        error = value_serialize(vo, property, sbobj);
+        error = value_serialize(vo, property, sd->sbobj);
         if (error) {
             TRACE_ERROR_NUMBER("Failed to serizlize value", error);
             *stop = 1;
         }
+        else if ((sd->sink) &&
+                 (simplebuffer_get_len(sd->sbobj) >= sd->limit)) {
+            error = serialize_flush(sd);
+            if (error) {
+                TRACE_ERROR_NUMBER("Failed to flush", error);
+                *stop = 1;
+            }
+        }
     }
 
     TRACE_FLOW_EXIT();
     return error;
 }
 
-/* Traverse the collection and build the serialization object */
-int ini_config_serialize(struct ini_cfgobj *ini_config,
-                         struct simplebuffer *sbobj)
+/* Traverse the collection and serialize it */
+static int serialize_config(struct ini_cfgobj *ini_config,
+                            struct serialize_data *sd)
 {
     int error = EOK;
     TRACE_FLOW_ENTRY();
@@ -74,11 +118,17 @@ int ini_config_serialize(struct ini_cfgobj *ini_config,
         return EINVAL;
     }
 
+    /* Output would lose the comments */
+    if (ini_config->lean) {
+        TRACE_ERROR_NUMBER("Configuration was parsed in lean mode", ENOTSUP);
+        return ENOTSUP;
+    }
+
     if (ini_config->cfg) {
         error = col_traverse_collection(ini_config->cfg,
                                         COL_TRAVERSE_DEFAULT,
                                         ini_serialize_cb,
-                                        (void *)sbobj);
+                                        (void *)sd);
         if (error) {
             TRACE_ERROR_NUMBER("Failed to serialize collection", error);
             return error;
@@ -86,7 +136,7 @@ int ini_config_serialize(struct ini_cfgobj *ini_config,
     }
 
     if (ini_config->last_comment) {
-        error = ini_comment_serialize(ini_config->last_comment, sbobj);
+        error = ini_comment_serialize(ini_config->last_comment, sd->sbobj);
         if (error) {
             TRACE_ERROR_NUMBER("Failed serialize comment", error);
             return error;
@@ -96,3 +146,53 @@ int ini_config_serialize(struct ini_cfgobj *ini_config,
     TRACE_FLOW_EXIT();
     return error;
 }
+
+/* Traverse the collection and build the serialization object */
+int ini_config_serialize(struct ini_cfgobj *ini_config,
+                         struct simplebuffer *sbobj)
+{
+    struct serialize_data sd;
+
+    sd.sbobj = sbobj;
+    sd.limit = 0;
+    sd.sink = NULL;
+    sd.sink_data = NULL;
+
+    return serialize_config(ini_config, &sd);
+}
+
+/* Serialize and pass the data to the sink in portions */
+int ini_config_serialize_to(struct ini_cfgobj *ini_config,
+                            uint32_t limit,
+                            ini_serialize_sink sink,
+                            void *sink_data)
+{
+    int error = EOK;
+    struct serialize_data sd;
+
+    TRACE_FLOW_ENTRY();
+
+    if (!sink) {
+        TRACE_ERROR_NUMBER("Invalid argument", EINVAL);
+        return EINVAL;
+    }
+
+    sd.sbobj = NULL;
+    sd.limit = limit;
+    sd.sink = sink;
+    sd.sink_data = sink_data;
+
+    error = simplebuffer_alloc(&(sd.sbobj));
+    if (error) {
+        TRACE_ERROR_NUMBER("Failed to allocate buffer", error);
+        return error;
+    }
+
+    error = serialize_config(ini_config, &sd);
+    if (!error) error = serialize_flush(&sd);
+
+    simplebuffer_free(sd.sbobj);
+
+    TRACE_FLOW_RETURN(error);
+    return error;
+}
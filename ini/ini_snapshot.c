@@ -0,0 +1,337 @@
+/*
+    INI LIBRARY
+
+    Versioned handle that publishes configuration
+    snapshots to the reader threads.
+
+    Copyright (C) Dmitri Pal <dpal@redhat.com> 2026
+
+    INI Library is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    INI Library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with INI Library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "config.h"
+#include <errno.h>
+#include <stdlib.h>
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
+#include "trace.h"
+#include "ini_defines.h"
+#include "ini_configobj.h"
+
+/* One published version of the configuration */
+struct ini_cfgsnapshot {
+    struct ini_cfgobj *cfg;
+    uint64_t version;
+    /* The handle holds one reference while
+     * the snapshot is the current one.
+     */
+    uint32_t refcount;
+};
+
+/* Handle that always points to the latest snapshot */
+struct ini_cfghandle {
+    struct ini_cfgsnapshot *current;
+    uint64_t version;
+#ifdef HAVE_PTHREAD
+    /* Protects loading the current pointer
+     * together with taking the reference.
+     */
+    pthread_mutex_t lock;
+#endif
+};
+
+#ifdef HAVE_PTHREAD
+#define HANDLE_LOCK(handle) pthread_mutex_lock(&((handle)->lock))
+#define HANDLE_UNLOCK(handle) pthread_mutex_unlock(&((handle)->lock))
+#else
+#define HANDLE_LOCK(handle)
+#define HANDLE_UNLOCK(handle)
+#endif
+
+#if defined(HAVE_PTHREAD) && !defined(HAVE_ATOMIC_BUILTINS)
+/* Reference counts are updated under a lock
+ * if the compiler does not have atomic operations.
+ */
+static pthread_mutex_t ref_lock = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+/* Take a reference */
+static void snapshot_ref(struct ini_cfgsnapshot *snapshot)
+{
+#ifdef HAVE_ATOMIC_BUILTINS
+    __atomic_add_fetch(&(snapshot->refcount), 1, __ATOMIC_RELAXED);
+#elif defined(HAVE_PTHREAD)
+    pthread_mutex_lock(&ref_lock);
+    snapshot->refcount++;
+    pthread_mutex_unlock(&ref_lock);
+#else
+    snapshot->refcount++;
+#endif
+}
+
+/* Drop a reference and free the snapshot with the last one */
+static void snapshot_unref(struct ini_cfgsnapshot *snapshot)
+{
+    uint32_t count;
+
+    TRACE_FLOW_ENTRY();
+
+#ifdef HAVE_ATOMIC_BUILTINS
+    count = __atomic_sub_fetch(&(snapshot->refcount), 1, __ATOMIC_ACQ_REL);
+#elif defined(HAVE_PTHREAD)
+    pthread_mutex_lock(&ref_lock);
+    count = --(snapshot->refcount);
+    pthread_mutex_unlock(&ref_lock);
+#else
+    count = --(snapshot->refcount);
+#endif
+
+    if (count == 0) {
+        TRACE_INFO_NUMBER("Retiring snapshot", snapshot->version);
+        ini_config_destroy(snapshot->cfg);
+        free(snapshot);
+    }
+
+    TRACE_FLOW_EXIT();
+}
+
+/* Read the version of the handle */
+static uint64_t handle_version(struct ini_cfghandle *handle)
+{
+    uint64_t version;
+
+#ifdef HAVE_ATOMIC_BUILTINS
+    version = __atomic_load_n(&(handle->version), __ATOMIC_ACQUIRE);
+#else
+    HANDLE_LOCK(handle);
+    version = handle->version;
+    HANDLE_UNLOCK(handle);
+#endif
+
+    return version;
+}
+
+/* Wrap the configuration into a new snapshot */
+static int snapshot_create(struct ini_cfgobj *ini_config,
+                           uint64_t version,
+                           struct ini_cfgsnapshot **snapshot)
+{
+    struct ini_cfgsnapshot *new_snapshot;
+
+    new_snapshot = malloc(sizeof(struct ini_cfgsnapshot));
+    if (!new_snapshot) {
+        TRACE_ERROR_NUMBER("Failed to allocate snapshot", ENOMEM);
+        return ENOMEM;
+    }
+
+    new_snapshot->cfg = ini_config;
+    new_snapshot->version = version;
+    new_snapshot->refcount = 1;
+
+    *snapshot = new_snapshot;
+    return EOK;
+}
+
+/* Create a handle */
+int ini_config_handle_create(struct ini_cfgobj *ini_config,
+                             struct ini_cfghandle **handle)
+{
+    int error = EOK;
+    struct ini_cfghandle *new_handle = NULL;
+
+    TRACE_FLOW_ENTRY();
+
+    if ((!ini_config) || (!handle)) {
+        TRACE_ERROR_NUMBER("Invalid argument", EINVAL);
+        return EINVAL;
+    }
+
+    new_handle = malloc(sizeof(struct ini_cfghandle));
+    if (!new_handle) {
+        TRACE_ERROR_NUMBER("Failed to allocate handle", ENOMEM);
+        return ENOMEM;
+    }
+
+    new_handle->version = 1;
+    error = snapshot_create(ini_config, new_handle->version,
+                            &(new_handle->current));
+    if (error) {
+        free(new_handle);
+        return error;
+    }
+
+#ifdef HAVE_PTHREAD
+    error = pthread_mutex_init(&(new_handle->lock), NULL);
+    if (error) {
+        TRACE_ERROR_NUMBER("Failed to initialize lock", error);
+        free(new_handle->current);
+        free(new_handle);
+        return error;
+    }
+#endif
+
+    *handle = new_handle;
+
+    TRACE_FLOW_EXIT();
+    return EOK;
+}
+
+/* Destroy the handle */
+void ini_config_handle_destroy(struct ini_cfghandle *handle)
+{
+    TRACE_FLOW_ENTRY();
+
+    if (handle) {
+        /* Snapshots still held by readers stay valid */
+        snapshot_unref(handle->current);
+#ifdef HAVE_PTHREAD
+        pthread_mutex_destroy(&(handle->lock));
+#endif
+        free(handle);
+    }
+
+    TRACE_FLOW_EXIT();
+}
+
+/* Replace the current configuration */
+int ini_config_handle_publish(struct ini_cfghandle *handle,
+                              struct ini_cfgobj *ini_config)
+{
+    int error = EOK;
+    struct ini_cfgsnapshot *snapshot = NULL;
+    struct ini_cfgsnapshot *old = NULL;
+
+    TRACE_FLOW_ENTRY();
+
+    if ((!handle) || (!ini_config)) {
+        TRACE_ERROR_NUMBER("Invalid argument", EINVAL);
+        return EINVAL;
+    }
+
+    /* Version is assigned under the lock */
+    error = snapshot_create(ini_config, 0, &snapshot);
+    if (error) return error;
+
+    HANDLE_LOCK(handle);
+    old = handle->current;
+    /* Publishing it again would free it twice */
+    if (old->cfg == ini_config) {
+        HANDLE_UNLOCK(handle);
+        TRACE_ERROR_STRING("Invalid argument", "Already published");
+        free(snapshot);
+        return EINVAL;
+    }
+    snapshot->version = handle->version + 1;
+    handle->current = snapshot;
+#ifdef HAVE_ATOMIC_BUILTINS
+    __atomic_store_n(&(handle->version), snapshot->version,
+                     __ATOMIC_RELEASE);
+#else
+    handle->version = snapshot->version;
+#endif
+    HANDLE_UNLOCK(handle);
+
+    /* Freed here or by the last reader */
+    snapshot_unref(old);
+
+    TRACE_FLOW_EXIT();
+    return EOK;
+}
+
+/* Get the version of the current configuration */
+uint64_t ini_config_handle_version(struct ini_cfghandle *handle)
+{
+    if (!handle) return 0;
+    return handle_version(handle);
+}
+
+/* Get the current snapshot */
+int ini_config_snapshot_acquire(struct ini_cfghandle *handle,
+                                struct ini_cfgsnapshot **snapshot)
+{
+    struct ini_cfgsnapshot *current;
+
+    TRACE_FLOW_ENTRY();
+
+    if ((!handle) || (!snapshot)) {
+        TRACE_ERROR_NUMBER("Invalid argument", EINVAL);
+        return EINVAL;
+    }
+
+    HANDLE_LOCK(handle);
+    current = handle->current;
+    snapshot_ref(current);
+    HANDLE_UNLOCK(handle);
+
+    *snapshot = current;
+
+    TRACE_FLOW_EXIT();
+    return EOK;
+}
+
+/* Switch to the current snapshot if a newer one was published */
+int ini_config_snapshot_refresh(struct ini_cfghandle *handle,
+                                struct ini_cfgsnapshot **snapshot)
+{
+    int error = EOK;
+    struct ini_cfgsnapshot *old;
+
+    TRACE_FLOW_ENTRY();
+
+    if ((!handle) || (!snapshot)) {
+        TRACE_ERROR_NUMBER("Invalid argument", EINVAL);
+        return EINVAL;
+    }
+
+    old = *snapshot;
+
+    /* The common case does not touch any shared state but the version */
+    if ((old) && (old->version == handle_version(handle))) {
+        TRACE_FLOW_EXIT();
+        return EOK;
+    }
+
+    error = ini_config_snapshot_acquire(handle, snapshot);
+    if (error) return error;
+
+    if (old) snapshot_unref(old);
+
+    TRACE_FLOW_EXIT();
+    return EOK;
+}
+
+/* Release the snapshot */
+void ini_config_snapshot_release(struct ini_cfgsnapshot *snapshot)
+{
+    TRACE_FLOW_ENTRY();
+
+    if (snapshot) snapshot_unref(snapshot);
+
+    TRACE_FLOW_EXIT();
+}
+
+/* Get the configuration of the snapshot */
+struct ini_cfgobj *ini_config_snapshot_get(struct ini_cfgsnapshot *snapshot)
+{
+    if (!snapshot) return NULL;
+    return snapshot->cfg;
+}
+
+/* Get the version of the snapshot */
+uint64_t ini_config_snapshot_version(struct ini_cfgsnapshot *snapshot)
+{
+    if (!snapshot) return 0;
+    return snapshot->version;
+}
@@ -413,6 +413,217 @@ START_TEST(test_custom_error)
 }
 END_TEST
 
+START_TEST(test_ini_rules_compile)
+{
+    struct ini_cfgobj *rules_obj;
+    struct ini_cfgobj *cfg_obj;
+    struct ini_cfgrules *rules;
+    struct ini_errobj *errobj;
+    struct ini_errobj *errobj_compiled;
+    int ret;
+    int i;
+    size_t num_err;
+    const char *errmsg;
+    const char *errmsg_compiled;
+    struct ini_validator *error[] = {
+        &(struct ini_validator){ "custom_error", custom_error, NULL },
+        NULL
+    };
+
+    /* Rules of every kind, some of them broken */
+    char input_rules[] =
+        "[rule/custom_error]\n"
+        "validator = custom_error\n"
+        "[rule/no_validator]\n"
+        "option = foo\n"
+        "[rule/unknown]\n"
+        "validator = nonexistent\n"
+        "[rule/section_list]\n"
+        "validator = ini_allowed_sections\n"
+        "section = foo\n"
+        "section_re = ^bar[0-9]$\n"
+        "case_insensitive = yes\n"
+        "[rule/wrong_regex]\n"
+        "validator = ini_allowed_sections\n"
+        "section_re = ^foo\\(*$\n"
+        "[rule/options_for_foo]\n"
+        "validator = ini_allowed_options\n"
+        "section_re = ^bar[0-9]$\n"
+        "option = bar\n"
+        "option = baz\n";
+
+    /* Option names are case sensitive, section names are not */
+    char input_cfg[] =
+        "[FOO]\n"
+        "bar = 0\n"
+        "[bar1]\n"
+        "Baz = 0\n"
+        "abz = 0\n"
+        "[bar12]\n"
+        "abz = 0\n";
+
+    create_rules_from_str(input_rules, &rules_obj);
+    cfg_obj = get_ini_config_from_str(input_cfg, sizeof(input_cfg));
+
+    ret = ini_rules_compile(rules_obj, error, &rules);
+    fail_unless(ret == 0, "ini_rules_compile() failed: %s", strerror(ret));
+
+    ret = ini_errobj_create(&errobj);
+    fail_unless(ret == 0, "ini_errobj_create() failed: %s", strerror(ret));
+
+    ret = ini_rules_check(rules_obj, cfg_obj, error, errobj);
+    fail_unless(ret == 0, "ini_rules_check() failed: %s", strerror(ret));
+
+    /* Compiled rules do not need the rules object */
+    ini_rules_destroy(rules_obj);
+
+    num_err = ini_errobj_count(errobj);
+    fail_unless(num_err == 8, "Expected 8 errors, got %zu", num_err);
+
+    /* The same rules can be used many times
+     * and they produce the same messages
+     * whether they are checked in parallel or not */
+    for (i = 0; i < 4; i++) {
+        ret = ini_errobj_create(&errobj_compiled);
+        fail_unless(ret == 0, "ini_errobj_create() failed: %s",
+                    strerror(ret));
+
+        ret = ini_rules_check_compiled(rules, cfg_obj,
+                                       i % 2 ? INI_RULES_PARALLEL : 0,
+                                       errobj_compiled);
+        fail_unless(ret == 0, "ini_rules_check_compiled() failed: %s",
+                    strerror(ret));
+
+        num_err = ini_errobj_count(errobj_compiled);
+        fail_unless(num_err == ini_errobj_count(errobj),
+                    "Expected %zu errors, got %zu",
+                    ini_errobj_count(errobj), num_err);
+
+        ini_errobj_reset(errobj);
+        while (!ini_errobj_no_more_msgs(errobj)) {
+            errmsg = ini_errobj_get_msg(errobj);
+            errmsg_compiled = ini_errobj_get_msg(errobj_compiled);
+            ret = strcmp(errmsg, errmsg_compiled);
+            fail_unless(ret == 0, "Expected msg: [%s], got: [%s]",
+                        errmsg, errmsg_compiled);
+            ini_errobj_next(errobj);
+            ini_errobj_next(errobj_compiled);
+        }
+
+        ini_errobj_destroy(&errobj_compiled);
+    }
+
+    ini_errobj_destroy(&errobj);
+    ini_config_destroy(cfg_obj);
+    ini_rules_destroy_compiled(rules);
+}
+END_TEST
+
+START_TEST(test_ini_rules_parallel)
+{
+    struct ini_cfgobj *rules_obj;
+    struct ini_cfgobj *cfg_obj;
+    struct ini_cfgrules *rules;
+    struct ini_errobj *errobj;
+    struct ini_errobj *errobj_parallel;
+    int ret;
+    int i;
+    int k;
+    size_t len;
+    size_t num_err;
+    const char *errmsg;
+    const char *errmsg_parallel;
+    char input_rules[8192];
+    char input_cfg[16384];
+    struct ini_validator *error[] = {
+        &(struct ini_validator){ "custom_error", custom_error, NULL },
+        NULL
+    };
+
+    /* Every rule allows one option in its own group of sections */
+    len = 0;
+    for (i = 0; i < 20; i++) {
+        len += snprintf(input_rules + len, sizeof(input_rules) - len,
+                        "[rule/options%02d]\n"
+                        "validator = ini_allowed_options\n"
+                        "section_re = ^s%d_\n"
+                        "option = key%d\n",
+                        i, i, i);
+    }
+    len += snprintf(input_rules + len, sizeof(input_rules) - len,
+                    "[rule/custom_error]\n"
+                    "validator = custom_error\n"
+                    "[rule/section_list]\n"
+                    "validator = ini_allowed_sections\n"
+                    "section_re = ^s1_\n");
+    fail_unless(len < sizeof(input_rules));
+
+    /* Every other section has an option that is not allowed */
+    len = 0;
+    for (i = 0; i < 20; i++) {
+        for (k = 0; k < 5; k++) {
+            len += snprintf(input_cfg + len, sizeof(input_cfg) - len,
+                            "[s%d_%d]\n"
+                            "key%d = 0\n"
+                            "%s%d = 0\n",
+                            i, k, i, k % 2 ? "bad" : "key", i);
+        }
+    }
+    fail_unless(len < sizeof(input_cfg));
+
+    create_rules_from_str(input_rules, &rules_obj);
+    cfg_obj = get_ini_config_from_str(input_cfg, len);
+
+    ret = ini_rules_compile(rules_obj, error, &rules);
+    fail_unless(ret == 0, "ini_rules_compile() failed: %s", strerror(ret));
+    ini_rules_destroy(rules_obj);
+
+    ret = ini_errobj_create(&errobj);
+    fail_unless(ret == 0, "ini_errobj_create() failed: %s", strerror(ret));
+
+    ret = ini_rules_check_compiled(rules, cfg_obj, 0, errobj);
+    fail_unless(ret == 0, "ini_rules_check_compiled() failed: %s",
+                strerror(ret));
+
+    /* 40 options, 1 custom error and 95 sections */
+    num_err = ini_errobj_count(errobj);
+    fail_unless(num_err == 136, "Expected 136 errors, got %zu", num_err);
+
+    for (i = 0; i < 10; i++) {
+        ret = ini_errobj_create(&errobj_parallel);
+        fail_unless(ret == 0, "ini_errobj_create() failed: %s",
+                    strerror(ret));
+
+        ret = ini_rules_check_compiled(rules, cfg_obj, INI_RULES_PARALLEL,
+                                       errobj_parallel);
+        fail_unless(ret == 0, "ini_rules_check_compiled() failed: %s",
+                    strerror(ret));
+
+        /* Messages are in the order of the rules */
+        num_err = ini_errobj_count(errobj_parallel);
+        fail_unless(num_err == 136, "Expected 136 errors, got %zu",
+                    num_err);
+
+        ini_errobj_reset(errobj);
+        while (!ini_errobj_no_more_msgs(errobj)) {
+            errmsg = ini_errobj_get_msg(errobj);
+            errmsg_parallel = ini_errobj_get_msg(errobj_parallel);
+            ret = strcmp(errmsg, errmsg_parallel);
+            fail_unless(ret == 0, "Expected msg: [%s], got: [%s]",
+                        errmsg, errmsg_parallel);
+            ini_errobj_next(errobj);
+            ini_errobj_next(errobj_parallel);
+        }
+
+        ini_errobj_destroy(&errobj_parallel);
+    }
+
+    ini_errobj_destroy(&errobj);
+    ini_config_destroy(cfg_obj);
+    ini_rules_destroy_compiled(rules);
+}
+END_TEST
+
 START_TEST(test_ini_allowed_options_ok)
 {
     struct ini_cfgobj *rules_obj;
@@ -678,6 +889,92 @@ START_TEST(test_ini_allowed_options_typos)
 }
 END_TEST
 
+START_TEST(test_ini_allowed_options_large)
+{
+    struct ini_cfgobj *rules_obj;
+    struct ini_cfgobj *cfg_obj;
+    struct ini_cfgrules *rules;
+    struct ini_errobj *errobj;
+    int ret;
+    int i;
+    size_t len;
+    size_t num_err;
+    const char *errmsg;
+    char *input_rules;
+    char *input_cfg;
+
+    input_rules = malloc(32768);
+    fail_if(input_rules == NULL, "malloc() failed");
+    input_cfg = malloc(32768);
+    fail_if(input_cfg == NULL, "malloc() failed");
+
+    /* 600 options are allowed for foo section */
+    len = snprintf(input_rules, 32768,
+                   "[rule/options_for_foo]\n"
+                   "validator = ini_allowed_options\n"
+                   "section_re = ^foo$\n");
+    for (i = 0; i < 600; i++) {
+        len += snprintf(input_rules + len, 32768 - len,
+                        "option = opt%d\n", i);
+    }
+    fail_unless(len < 32768);
+
+    /* Use all of them and make 200 typos,
+     * option names are case sensitive */
+    len = snprintf(input_cfg, 32768, "[foo]\n");
+    for (i = 0; i < 600; i++) {
+        len += snprintf(input_cfg + len, 32768 - len, "opt%d = 0\n", i);
+    }
+    for (i = 0; i < 100; i++) {
+        len += snprintf(input_cfg + len, 32768 - len,
+                        "Opt%d = 0\n"
+                        "opt%dx = 0\n", i, i);
+    }
+    fail_unless(len < 32768);
+
+    create_rules_from_str(input_rules, &rules_obj);
+    cfg_obj = get_ini_config_from_str(input_cfg, len);
+
+    ret = ini_errobj_create(&errobj);
+    fail_unless(ret == 0, "ini_errobj_create() failed: %s", strerror(ret));
+
+    ret = ini_rules_check(rules_obj, cfg_obj, NULL, errobj);
+    fail_unless(ret == 0, "ini_rules_check() failed: %s", strerror(ret));
+
+    num_err = ini_errobj_count(errobj);
+    fail_unless(num_err == 200, "Expected 200 errors, got %zu", num_err);
+
+    errmsg = ini_errobj_get_msg(errobj);
+    ret = strcmp(errmsg,
+                 "[rule/options_for_foo]: Attribute 'Opt0' is not allowed "
+                 "in section 'foo'. Check for typos.");
+    fail_unless(ret == 0, "Got msg: [%s]", errmsg);
+
+    ini_errobj_destroy(&errobj);
+
+    /* Compiled rules find the same typos */
+    ret = ini_rules_compile(rules_obj, NULL, &rules);
+    fail_unless(ret == 0, "ini_rules_compile() failed: %s", strerror(ret));
+
+    ret = ini_errobj_create(&errobj);
+    fail_unless(ret == 0, "ini_errobj_create() failed: %s", strerror(ret));
+
+    ret = ini_rules_check_compiled(rules, cfg_obj, 0, errobj);
+    fail_unless(ret == 0, "ini_rules_check_compiled() failed: %s",
+                strerror(ret));
+
+    num_err = ini_errobj_count(errobj);
+    fail_unless(num_err == 200, "Expected 200 errors, got %zu", num_err);
+
+    ini_errobj_destroy(&errobj);
+    ini_rules_destroy_compiled(rules);
+    ini_config_destroy(cfg_obj);
+    ini_rules_destroy(rules_obj);
+    free(input_rules);
+    free(input_cfg);
+}
+END_TEST
+
 START_TEST(test_ini_allowed_sections_str_ok)
 {
     struct ini_cfgobj *rules_obj;
@@ -1070,12 +1367,15 @@ static Suite *ini_validators_utils_suite(void)
     tcase_add_test(tc_infrastructure, test_unknown_validator);
     tcase_add_test(tc_infrastructure, test_custom_noerror);
     tcase_add_test(tc_infrastructure, test_custom_error);
+    tcase_add_test(tc_infrastructure, test_ini_rules_compile);
+    tcase_add_test(tc_infrastructure, test_ini_rules_parallel);
 
     TCase *tc_allowed_options = tcase_create("ini_allowed_options");
     tcase_add_test(tc_allowed_options, test_ini_allowed_options_ok);
     tcase_add_test(tc_allowed_options, test_ini_allowed_options_no_section);
     tcase_add_test(tc_allowed_options, test_ini_allowed_options_wrong_regex);
     tcase_add_test(tc_allowed_options, test_ini_allowed_options_typos);
+    tcase_add_test(tc_allowed_options, test_ini_allowed_options_large);
 
     TCase *tc_allowed_sections = tcase_create("ini_allowed_sections");
     tcase_add_test(tc_allowed_sections, test_ini_allowed_sections_str_ok);
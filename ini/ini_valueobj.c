@@ -24,11 +24,15 @@
 #include <stdio.h>
 #include <string.h>
 #include <ctype.h>
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
 #include "simplebuffer.h"
 #include "ref_array.h"
 #include "ini_comment.h"
 #include "ini_defines.h"
 #include "ini_valueobj.h"
+#include "ini_config_priv.h"
 #include "trace.h"
 
 struct value_obj {
@@ -40,8 +44,61 @@ struct value_obj {
     uint32_t keylen;
     uint32_t boundary;
     struct ini_comment *ic;
+    /* Cached conversion result */
+    struct value_cache cache;
+    /* Type of the cached result, 0 if none */
+    uint32_t cache_state;
+    /* Cached array interpretations */
+    struct value_array *arrays;
+    /* How the value is stored */
+    uint32_t flags;
+    /* The raw lines do not match the value yet */
+    uint32_t fold_pending;
+    /* Length of the inline value */
+    uint32_t inline_len;
+    /* Single line value is kept right here
+     * instead of the arrays and the buffer.
+     */
+    char inline_val[];
 };
 
+/* The value object itself is in the arena */
+#define VALUE_ARENA_OBJ     0x0001
+/* The raw lines are in the arena */
+#define VALUE_ARENA_LINES   0x0002
+/* The value is stored inline */
+#define VALUE_INLINE        0x0004
+
+/* Unfolded value and its length */
+#define VALUE_STR(vo) (((vo)->flags & VALUE_INLINE) ? \
+                       (vo)->inline_val : \
+                       (const char *)simplebuffer_get_buf((vo)->unfolded))
+#define VALUE_LEN(vo) (((vo)->flags & VALUE_INLINE) ? \
+                       (vo)->inline_len : \
+                       simplebuffer_get_len((vo)->unfolded))
+
+/* The cache is being filled by some thread */
+#define INI_CACHE_BUSY  0x80000000
+
+#if defined(HAVE_PTHREAD) && !defined(HAVE_ATOMIC_BUILTINS)
+/* Arrays are added under a lock
+ * if the compiler does not have atomic operations.
+ */
+static pthread_mutex_t array_lock = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+#ifdef HAVE_PTHREAD
+/* Values of a shared configuration can be folded by
+ * several reader threads, only one of them does it.
+ */
+static pthread_mutex_t fold_lock = PTHREAD_MUTEX_INITIALIZER;
+#define FOLD_LOCK() pthread_mutex_lock(&fold_lock)
+#define FOLD_UNLOCK() pthread_mutex_unlock(&fold_lock)
+#else
+#define FOLD_LOCK()
+#define FOLD_UNLOCK()
+#endif
+
 /* The length of " =" which is 3 */
 #define INI_FOLDING_OVERHEAD 3
 
@@ -366,8 +423,11 @@ static int trim_last(struct value_obj *vo)
     return error;
 }
 
-/* Create value from a referenced array */
-int value_create_from_refarray(struct ref_array *raw_lines,
+/* Create value from a referenced array
+ * using arena if it is provided.
+ */
+static int value_create_common(struct ini_arena *arena,
+                               struct ref_array *raw_lines,
                                struct ref_array *raw_lengths,
                                uint32_t line,
                                uint32_t origin,
@@ -386,7 +446,8 @@ int value_create_from_refarray(struct ref_array *raw_lines,
         return EINVAL;
     }
 
-    new_vo = malloc(sizeof(struct value_obj));
+    if (arena) new_vo = ini_arena_alloc(arena, sizeof(struct value_obj));
+    else new_vo = malloc(sizeof(struct value_obj));
     if (!new_vo) {
         TRACE_ERROR_NUMBER("No memory", ENOMEM);
         return ENOMEM;
@@ -406,6 +467,10 @@ int value_create_from_refarray(struct ref_array *raw_lines,
     new_vo->keylen = key_len;
     new_vo->boundary = boundary;
     new_vo->ic = ic;
+    new_vo->cache_state = 0;
+    new_vo->arrays = NULL;
+    new_vo->flags = arena ? VALUE_ARENA_OBJ | VALUE_ARENA_LINES : 0;
+    new_vo->fold_pending = 0;
 
     /* Last line might have spaces at the end, trim them */
     error = trim_last(new_vo);
@@ -433,6 +498,91 @@ int value_create_from_refarray(struct ref_array *raw_lines,
     return error;
 }
 
+/* Create value from a referenced array */
+int value_create_from_refarray(struct ref_array *raw_lines,
+                               struct ref_array *raw_lengths,
+                               uint32_t line,
+                               uint32_t origin,
+                               uint32_t key_len,
+                               uint32_t boundary,
+                               struct ini_comment *ic,
+                               struct value_obj **vo)
+{
+    return value_create_common(NULL, raw_lines, raw_lengths, line,
+                               origin, key_len, boundary, ic, vo);
+}
+
+/* Create value in the arena */
+int value_create_in_arena(struct ini_arena *arena,
+                          struct ref_array *raw_lines,
+                          struct ref_array *raw_lengths,
+                          uint32_t line,
+                          uint32_t origin,
+                          uint32_t key_len,
+                          uint32_t boundary,
+                          struct ini_comment *ic,
+                          struct value_obj **vo)
+{
+    if (!arena) return EINVAL;
+    return value_create_common(arena, raw_lines, raw_lengths, line,
+                               origin, key_len, boundary, ic, vo);
+}
+
+/* Create value from a single line */
+int value_create_from_line(struct ini_arena *arena,
+                           const char *strvalue,
+                           uint32_t length,
+                           uint32_t line,
+                           uint32_t origin,
+                           uint32_t key_len,
+                           uint32_t boundary,
+                           struct ini_comment *ic,
+                           struct value_obj **vo)
+{
+    struct value_obj *new_vo = NULL;
+    size_t size;
+
+    TRACE_FLOW_ENTRY();
+
+    if ((!strvalue) || (!vo)) {
+        TRACE_ERROR_NUMBER("Invalid argument", EINVAL);
+        return EINVAL;
+    }
+
+    /* Trailing spaces are not a part of the value */
+    while ((length) && (isspace(strvalue[length - 1]))) length--;
+
+    size = sizeof(struct value_obj) + length + 1;
+    if (arena) new_vo = ini_arena_alloc(arena, size);
+    else new_vo = malloc(size);
+    if (!new_vo) {
+        TRACE_ERROR_NUMBER("No memory", ENOMEM);
+        return ENOMEM;
+    }
+
+    new_vo->raw_lines = NULL;
+    new_vo->raw_lengths = NULL;
+    new_vo->unfolded = NULL;
+    new_vo->origin = origin;
+    new_vo->line = line;
+    new_vo->keylen = key_len;
+    new_vo->boundary = boundary;
+    new_vo->ic = ic;
+    new_vo->cache_state = 0;
+    new_vo->arrays = NULL;
+    new_vo->flags = arena ? VALUE_ARENA_OBJ | VALUE_INLINE : VALUE_INLINE;
+    new_vo->fold_pending = 0;
+    new_vo->inline_len = length;
+    memcpy(new_vo->inline_val, strvalue, length);
+    new_vo->inline_val[length] = '\0';
+
+    TRACE_INFO_STRING("Inline value:", new_vo->inline_val);
+    *vo = new_vo;
+
+    TRACE_FLOW_EXIT();
+    return EOK;
+}
+
 /* Cleanup callback for lines array */
 void value_lines_cleanup_cb(void *elem,
                             ref_array_del_enum type,
@@ -452,8 +602,9 @@ void value_lines_cleanup_cb(void *elem,
 }
 
 /* Create a pair of arrays */
-int value_create_arrays(struct ref_array **raw_lines,
-                        struct ref_array **raw_lengths)
+static int value_create_arrays_cb(struct ref_array **raw_lines,
+                                  struct ref_array **raw_lengths,
+                                  ref_array_fn cleanup_cb)
 {
     int error = EOK;
     struct ref_array *new_lines = NULL;
@@ -464,7 +615,7 @@ int value_create_arrays(struct ref_array **raw_lines,
     error = ref_array_create(&new_lines,
                              sizeof(char *),
                              INI_ARRAY_GROW,
-                             value_lines_cleanup_cb,
+                             cleanup_cb,
                              NULL);
     if (error) {
         TRACE_ERROR_NUMBER("Failed to create lines array", error);
@@ -491,6 +642,132 @@ int value_create_arrays(struct ref_array **raw_lines,
     return EOK;
 }
 
+/* Create a pair of arrays */
+int value_create_arrays(struct ref_array **raw_lines,
+                        struct ref_array **raw_lengths)
+{
+    return value_create_arrays_cb(raw_lines, raw_lengths,
+                                  value_lines_cleanup_cb);
+}
+
+/* Create a pair of arrays for the lines in the arena */
+int value_create_arena_arrays(struct ref_array **raw_lines,
+                              struct ref_array **raw_lengths)
+{
+    return value_create_arrays_cb(raw_lines, raw_lengths, NULL);
+}
+
+/* Lines are about to be replaced by the ones
+ * allocated on the heap, so the arrays have to free them.
+ * Inline value gets the arrays and the buffer it did not have.
+ */
+static int value_own_lines(struct value_obj *vo)
+{
+    int error = EOK;
+    struct ref_array *raw_lines = NULL;
+    struct ref_array *raw_lengths = NULL;
+    struct simplebuffer *unfolded = NULL;
+
+    if (!(vo->flags & (VALUE_ARENA_LINES | VALUE_INLINE))) return EOK;
+
+    TRACE_FLOW_ENTRY();
+
+    if (vo->flags & VALUE_INLINE) {
+        error = simplebuffer_alloc(&unfolded);
+        if (!error) error = simplebuffer_add_raw(unfolded,
+                                                 vo->inline_val,
+                                                 vo->inline_len,
+                                                 INI_VALUE_BLOCK);
+        if (error) {
+            TRACE_ERROR_NUMBER("Failed to create buffer", error);
+            simplebuffer_free(unfolded);
+            return error;
+        }
+    }
+
+    error = value_create_arrays(&raw_lines, &raw_lengths);
+    if (error) {
+        TRACE_ERROR_NUMBER("Failed to create arrays", error);
+        simplebuffer_free(unfolded);
+        return error;
+    }
+
+    if (vo->flags & VALUE_INLINE) {
+        /* Folding fills the arrays later */
+        vo->unfolded = unfolded;
+        vo->flags &= ~VALUE_INLINE;
+    }
+
+    value_destroy_arrays(vo->raw_lines, vo->raw_lengths);
+    vo->raw_lines = raw_lines;
+    vo->raw_lengths = raw_lengths;
+    vo->flags &= ~VALUE_ARENA_LINES;
+
+    TRACE_FLOW_EXIT();
+    return EOK;
+}
+
+/* Fold the value if it changed since it was folded last time.
+ * Most of the values that are created or updated by the caller
+ * are never saved so folding is done only when the raw lines
+ * are actually needed. Copies of the values can end up in
+ * a configuration that is read by several threads at once
+ * so folding is done under a lock.
+ */
+static int value_fold_lines(struct value_obj *vo)
+{
+    int error = EOK;
+
+#ifdef HAVE_ATOMIC_BUILTINS
+    if (!__atomic_load_n(&(vo->fold_pending), __ATOMIC_ACQUIRE)) return EOK;
+#elif !defined(HAVE_PTHREAD)
+    if (!(vo->fold_pending)) return EOK;
+#endif
+
+    TRACE_FLOW_ENTRY();
+
+    FOLD_LOCK();
+
+    /* Another thread might have folded it already */
+    if (!(vo->fold_pending)) {
+        FOLD_UNLOCK();
+        TRACE_FLOW_EXIT();
+        return EOK;
+    }
+
+    if (!vo->raw_lines) {
+        error = value_create_arrays(&(vo->raw_lines),
+                                    &(vo->raw_lengths));
+        if (error) {
+            TRACE_ERROR_NUMBER("Failed to create arrays", error);
+            FOLD_UNLOCK();
+            return error;
+        }
+    }
+
+    error = value_fold(vo->unfolded,
+                       vo->keylen,
+                       vo->boundary,
+                       vo->raw_lines,
+                       vo->raw_lengths);
+    if (error) {
+        TRACE_ERROR_NUMBER("Failed to fold", error);
+        FOLD_UNLOCK();
+        return error;
+    }
+
+#ifdef HAVE_ATOMIC_BUILTINS
+    __atomic_store_n(&(vo->fold_pending), 0, __ATOMIC_RELEASE);
+#else
+    vo->fold_pending = 0;
+#endif
+
+    FOLD_UNLOCK();
+
+    TRACE_FLOW_EXIT();
+    return EOK;
+}
+
 /* Add a raw string to the arrays */
 int value_add_to_arrays(const char *strvalue,
                         uint32_t len,
@@ -535,12 +812,26 @@ void value_destroy_arrays(struct ref_array *raw_lines,
 
 }
 
+/* Free the cached arrays */
+static void value_free_arrays(struct value_obj *vo)
+{
+    struct value_array *array;
+
+    while (vo->arrays) {
+        array = vo->arrays;
+        vo->arrays = array->next;
+        free(array);
+    }
+}
+
 /* Destroy a value object */
 void value_destroy(struct value_obj *vo)
 {
     TRACE_FLOW_ENTRY();
 
     if (vo) {
+        /* Free cached arrays if any */
+        value_free_arrays(vo);
         /* Free arrays if any */
         value_destroy_arrays(vo->raw_lines,
                              vo->raw_lengths);
@@ -548,7 +839,8 @@ void value_destroy(struct value_obj *vo)
         simplebuffer_free(vo->unfolded);
         /* Function checks validity inside */
         ini_comment_destroy(vo->ic);
-        free(vo);
+        /* Arena memory is freed together with the arena */
+        if (!(vo->flags & VALUE_ARENA_OBJ)) free(vo);
     }
 
     TRACE_FLOW_EXIT();
@@ -609,27 +901,11 @@ int value_create_new(const char *strvalue,
     new_vo->boundary = boundary;
     new_vo->raw_lines = NULL;
     new_vo->raw_lengths = NULL;
-
-    error = value_create_arrays(&(new_vo->raw_lines),
-                                &(new_vo->raw_lengths));
-
-    if (error) {
-        TRACE_ERROR_NUMBER("Failed to fold", error);
-        value_destroy(new_vo);
-        return error;
-    }
-
-    /* Create arrays by folding the value */
-    error = value_fold(new_vo->unfolded,
-                       new_vo->keylen,
-                       new_vo->boundary,
-                       new_vo->raw_lines,
-                       new_vo->raw_lengths);
-    if (error) {
-        TRACE_ERROR_NUMBER("Failed to fold", error);
-        value_destroy(new_vo);
-        return error;
-    }
+    new_vo->cache_state = 0;
+    new_vo->arrays = NULL;
+    /* Arrays are created when the value is folded */
+    new_vo->flags = 0;
+    new_vo->fold_pending = 1;
 
     *vo = new_vo;
 
@@ -646,6 +922,7 @@ int value_copy(struct value_obj *vo,
     int error = EOK;
     struct value_obj *new_vo = NULL;
     struct simplebuffer *oneline = NULL;
+    struct ini_comment *ic = NULL;
 
     TRACE_FLOW_ENTRY();
 
@@ -654,6 +931,37 @@ int value_copy(struct value_obj *vo,
         return EINVAL;
     }
 
+    /* Short value would be folded into the same single line */
+    if ((vo->flags & VALUE_INLINE) &&
+        (vo->inline_len) &&
+        (vo->boundary > vo->keylen + INI_FOLDING_OVERHEAD) &&
+        (vo->inline_len <=
+         vo->boundary - vo->keylen - INI_FOLDING_OVERHEAD)) {
+        if (vo->ic) {
+            error = ini_comment_copy(vo->ic, &ic);
+            if (error) {
+                TRACE_ERROR_NUMBER("Failed to copy comment", error);
+                return error;
+            }
+        }
+        error = value_create_from_line(NULL,
+                                       vo->inline_val,
+                                       vo->inline_len,
+                                       vo->line,
+                                       vo->origin,
+                                       vo->keylen,
+                                       vo->boundary,
+                                       ic,
+                                       copy_vo);
+        if (error) {
+            TRACE_ERROR_NUMBER("Failed to create copy", error);
+            ini_comment_destroy(ic);
+            return error;
+        }
+        TRACE_FLOW_EXIT();
+        return EOK;
+    }
+
     /* Create buffer to hold the value */
     error = simplebuffer_alloc(&oneline);
     if (error) {
@@ -663,8 +971,8 @@ int value_copy(struct value_obj *vo,
 
     /* Put value into the buffer */
     error = simplebuffer_add_str(oneline,
-                                 (const char *)simplebuffer_get_buf(vo->unfolded),
-                                 simplebuffer_get_len(vo->unfolded),
+                                 VALUE_STR(vo),
+                                 VALUE_LEN(vo),
                                  INI_VALUE_BLOCK);
     if (error) {
         TRACE_ERROR_NUMBER("Failed to add string", error);
@@ -688,27 +996,11 @@ int value_copy(struct value_obj *vo,
     new_vo->raw_lines = NULL;
     new_vo->raw_lengths = NULL;
     new_vo->ic = NULL;
-
-    error = value_create_arrays(&(new_vo->raw_lines),
-                                &(new_vo->raw_lengths));
-
-    if (error) {
-        TRACE_ERROR_NUMBER("Failed to fold", error);
-        value_destroy(new_vo);
-        return error;
-    }
-
-    /* Create arrays by folding the value */
-    error = value_fold(new_vo->unfolded,
-                       new_vo->keylen,
-                       new_vo->boundary,
-                       new_vo->raw_lines,
-                       new_vo->raw_lengths);
-    if (error) {
-        TRACE_ERROR_NUMBER("Failed to fold", error);
-        value_destroy(new_vo);
-        return error;
-    }
+    new_vo->cache_state = 0;
+    new_vo->arrays = NULL;
+    /* Arrays are created when the value is folded */
+    new_vo->flags = 0;
+    new_vo->fold_pending = 1;
 
     /* Copy comment */
     if (vo->ic) {
@@ -723,15 +1015,10 @@ int value_copy(struct value_obj *vo,
     *copy_vo = new_vo;
 
     TRACE_INFO_STRING("Orig value:",
-                      (const char *)simplebuffer_get_buf(vo->unfolded));
+                      VALUE_STR(vo));
     TRACE_INFO_STRING("Copy value:",
                       (const char *)simplebuffer_get_buf(new_vo->unfolded));
 
-    TRACE_INFO_NUMBER("Orig value num lines:",
-                      ref_array_len(vo->raw_lengths));
-    TRACE_INFO_NUMBER("Copy value num lines:",
-                      ref_array_len(new_vo->raw_lengths));
-
     TRACE_FLOW_EXIT();
     return error;
 }
@@ -753,7 +1040,7 @@ int value_get_concatenated(struct value_obj *vo,
         return EINVAL;
     }
 
-    *fullstr = (const char *)simplebuffer_get_buf(vo->unfolded);
+    *fullstr = VALUE_STR(vo);
 
     TRACE_FLOW_EXIT();
     return EOK;
@@ -776,7 +1063,7 @@ int value_get_concatenated_len(struct value_obj *vo,
         return EINVAL;
     }
 
-    *len = simplebuffer_get_len(vo->unfolded);
+    *len = VALUE_LEN(vo);
 
     TRACE_FLOW_EXIT();
     return EOK;
@@ -840,19 +1127,15 @@ int value_set_keylen(struct value_obj *vo, uint32_t key_len)
 
     vo->keylen = key_len;
 
-    /* Fold in new value */
-    error = value_fold(vo->unfolded,
-                       vo->keylen,
-                       vo->boundary,
-                       vo->raw_lines,
-                       vo->raw_lengths);
+    error = value_own_lines(vo);
     if (error) {
-        TRACE_ERROR_NUMBER("Failed to fold", error);
-        /* In this case nothing to free here but
-         * the object might be unsiable */
+        TRACE_ERROR_NUMBER("Failed to own lines", error);
         return error;
     }
 
+    /* Fold in new value when it is needed */
+    vo->fold_pending = 1;
+
     TRACE_FLOW_EXIT();
     return EOK;
 }
@@ -870,19 +1153,15 @@ int value_set_boundary(struct value_obj *vo, uint32_t boundary)
 
     vo->boundary = boundary;
 
-    /* Fold in new value */
-    error = value_fold(vo->unfolded,
-                       vo->keylen,
-                       vo->boundary,
-                       vo->raw_lines,
-                       vo->raw_lengths);
+    error = value_own_lines(vo);
     if (error) {
-        TRACE_ERROR_NUMBER("Failed to fold", error);
-        /* In this case nothing to free here but
-         * the object might be unusable */
+        TRACE_ERROR_NUMBER("Failed to own lines", error);
         return error;
     }
 
+    /* Fold in new value when it is needed */
+    vo->fold_pending = 1;
+
     TRACE_FLOW_EXIT();
     return EOK;
 }
@@ -902,6 +1181,12 @@ int value_update(struct value_obj *vo,
         return EINVAL;
     }
 
+    error = value_own_lines(vo);
+    if (error) {
+        TRACE_ERROR_NUMBER("Failed to own lines", error);
+        return error;
+    }
+
     /* Create buffer to hold the value */
     error = simplebuffer_alloc(&oneline);
     if (error) {
@@ -925,24 +1210,197 @@ int value_update(struct value_obj *vo,
     vo->origin = origin;
     vo->unfolded = oneline;
     vo->boundary = boundary;
+    /* Cached conversions are not valid any more */
+    vo->cache_state = 0;
+    value_free_arrays(vo);
+    /* Fold in new value when it is needed */
+    vo->fold_pending = 1;
 
-    /* Fold in new value */
-    error = value_fold(vo->unfolded,
-                       vo->keylen,
-                       vo->boundary,
-                       vo->raw_lines,
-                       vo->raw_lengths);
+    TRACE_FLOW_EXIT();
+
+    return error;
+
+}
+
+/* Get internal parts of the value */
+int value_get_raw_parts(struct value_obj *vo,
+                        uint32_t *num_lines,
+                        struct ini_comment **ic)
+{
+    int error = EOK;
+
+    TRACE_FLOW_ENTRY();
+
+    if ((!vo) || (!num_lines) || (!ic)) {
+        TRACE_ERROR_NUMBER("Invalid argument", EINVAL);
+        return EINVAL;
+    }
+
+    error = value_fold_lines(vo);
     if (error) {
-        TRACE_ERROR_NUMBER("Failed to fold", error);
-        /* In this case nothing to free here but
-         * the object might be unsiable */
+        TRACE_ERROR_NUMBER("Failed to fold value", error);
         return error;
     }
 
+    if (vo->flags & VALUE_INLINE) *num_lines = 1;
+    else *num_lines = ref_array_len(vo->raw_lines);
+    *ic = vo->ic;
+
     TRACE_FLOW_EXIT();
+    return EOK;
+}
 
-    return error;
+/* Get one raw line of the value */
+void value_get_raw_line(struct value_obj *vo,
+                        uint32_t idx,
+                        const char **line,
+                        uint32_t *len)
+{
+    TRACE_FLOW_ENTRY();
+
+    if (vo->flags & VALUE_INLINE) {
+        *line = vo->inline_val;
+        *len = vo->inline_len;
+    }
+    else {
+        ref_array_get(vo->raw_lines, idx, (void *)line);
+        ref_array_get(vo->raw_lengths, idx, (void *)len);
+    }
+
+    TRACE_FLOW_EXIT();
+}
+
+/* Get cached conversion result */
+int value_get_cache(struct value_obj *vo,
+                    enum value_cache_type type,
+                    struct value_cache *cache)
+{
+    uint32_t state;
+
+    TRACE_FLOW_ENTRY();
+
+    if ((!vo) || (!cache)) {
+        TRACE_ERROR_NUMBER("Invalid argument", EINVAL);
+        return EINVAL;
+    }
+
+#ifdef HAVE_ATOMIC_BUILTINS
+    state = __atomic_load_n(&(vo->cache_state), __ATOMIC_ACQUIRE);
+#else
+    /* Without atomic operations the cache is never filled */
+    state = 0;
+#endif
+
+    if (state != (uint32_t)type) {
+        TRACE_FLOW_EXIT();
+        return ENOENT;
+    }
+
+    *cache = vo->cache;
 
+    TRACE_FLOW_EXIT();
+    return EOK;
+}
+
+/* Save conversion result */
+void value_set_cache(struct value_obj *vo,
+                     enum value_cache_type type,
+                     const struct value_cache *cache)
+{
+#ifdef HAVE_ATOMIC_BUILTINS
+    uint32_t expected = 0;
+#endif
+
+    TRACE_FLOW_ENTRY();
+
+    if ((!vo) || (!cache)) {
+        TRACE_FLOW_EXIT();
+        return;
+    }
+
+#ifdef HAVE_ATOMIC_BUILTINS
+    /* Only the first thread gets to fill the cache.
+     * Others keep using their own result.
+     */
+    if (__atomic_compare_exchange_n(&(vo->cache_state),
+                                    &expected,
+                                    INI_CACHE_BUSY,
+                                    0,
+                                    __ATOMIC_ACQ_REL,
+                                    __ATOMIC_ACQUIRE)) {
+        vo->cache = *cache;
+        __atomic_store_n(&(vo->cache_state),
+                         (uint32_t)type,
+                         __ATOMIC_RELEASE);
+    }
+#endif
+
+    TRACE_FLOW_EXIT();
+}
+
+/* Find cached array */
+struct value_array *value_get_array(struct value_obj *vo,
+                                    enum value_array_type type,
+                                    const char *sep)
+{
+    struct value_array *array;
+
+    TRACE_FLOW_ENTRY();
+
+#ifdef HAVE_ATOMIC_BUILTINS
+    array = __atomic_load_n(&(vo->arrays), __ATOMIC_ACQUIRE);
+#elif defined(HAVE_PTHREAD)
+    pthread_mutex_lock(&array_lock);
+    array = vo->arrays;
+    pthread_mutex_unlock(&array_lock);
+#else
+    array = vo->arrays;
+#endif
+
+    /* Arrays are never removed from the list
+     * while the value is not changed, so the list
+     * can be walked without a lock.
+     */
+    for (; array; array = array->next) {
+        if ((array->type == type) &&
+            (((type != VALUE_ARRAY_STRING) &&
+              (type != VALUE_ARRAY_RAW_STRING)) ||
+             (strcmp(array->sep, sep) == 0))) break;
+    }
+
+    TRACE_FLOW_EXIT();
+    return array;
+}
+
+/* Add array to the value */
+void value_add_array(struct value_obj *vo,
+                     struct value_array *array)
+{
+    TRACE_FLOW_ENTRY();
+
+    /* Two threads can add the same array,
+     * the first one in the list is used then.
+     */
+#ifdef HAVE_ATOMIC_BUILTINS
+    array->next = __atomic_load_n(&(vo->arrays), __ATOMIC_ACQUIRE);
+    while (!__atomic_compare_exchange_n(&(vo->arrays),
+                                        &(array->next),
+                                        array,
+                                        0,
+                                        __ATOMIC_ACQ_REL,
+                                        __ATOMIC_ACQUIRE));
+#else
+#ifdef HAVE_PTHREAD
+    pthread_mutex_lock(&array_lock);
+#endif
+    array->next = vo->arrays;
+    vo->arrays = array;
+#ifdef HAVE_PTHREAD
+    pthread_mutex_unlock(&array_lock);
+#endif
+#endif
+
+    TRACE_FLOW_EXIT();
 }
 
 /* Get comment from the value */
@@ -965,6 +1423,13 @@ int value_extract_comment(struct value_obj *vo, struct ini_comment **ic)
 
 }
 
+/* Get comment without taking it from the value */
+struct ini_comment *value_get_comment(struct value_obj *vo)
+{
+    if (!vo) return NULL;
+    return vo->ic;
+}
+
 /* Set comment into the value */
 int value_put_comment(struct value_obj *vo, struct ini_comment *ic)
 {
@@ -1010,6 +1475,12 @@ int value_serialize(struct value_obj *vo,
         return EINVAL;
     }
 
+    error = value_fold_lines(vo);
+    if (error) {
+        TRACE_ERROR_NUMBER("Failed to fold value", error);
+        return error;
+    }
+
     /* Put comment first */
     if (vo->ic) {
         error = ini_comment_serialize(vo->ic, sbobj);
@@ -1057,7 +1528,18 @@ int value_serialize(struct value_obj *vo,
 
     }
 
-    if (vo->raw_lines) {
+    if (vo->flags & VALUE_INLINE) {
+        error = simplebuffer_add_raw(sbobj,
+                                     vo->inline_val,
+                                     vo->inline_len,
+                                     INI_VALUE_BLOCK);
+        if ((!error) && (!sec)) error = simplebuffer_add_cr(sbobj);
+        if (error) {
+            TRACE_ERROR_NUMBER("Failed to add value", error);
+            return error;
+        }
+    }
+    else if (vo->raw_lines) {
 
         vln = ref_array_len(vo->raw_lines);
         TRACE_INFO_NUMBER("Number of lines:", vln);
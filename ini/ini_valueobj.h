@@ -136,7 +136,11 @@ int value_put_comment(struct value_obj *vo,
 int value_merge_comment(struct value_obj *vo_donor,
                         struct value_obj *vo);
 
-/* Serialize value */
+/* Serialize value.
+ * A value that was created or changed by the caller
+ * is folded here, so such value should not be
+ * serialized by several threads at the same time.
+ */
 int value_serialize(struct value_obj *vo,
                     const char *key,
                     struct simplebuffer *sbobj);
@@ -26,6 +26,7 @@
 #include <limits.h>
 
 #include "ini_valueobj.h"
+#include "ini_configobj.h"
 #include "ini_defines.h"
 #define TRACE_HOME
 #include "trace.h"
@@ -708,6 +709,220 @@ static int vo_mc_test(void)
     return EOK;
 }
 
+/* Conversion results must follow the value updates */
+static int vo_conv_test(void)
+{
+    int error = EOK;
+    struct value_obj *vo = NULL;
+    int number;
+    double dnumber;
+    unsigned char flag;
+
+    TRACE_FLOW_ENTRY();
+
+    VOOUT(printf("<=== Conversion Test ===>\n"));
+
+    error = value_create_new("10abc", 5, INI_VALUE_CREATED,
+                             3, 80, NULL, &vo);
+    if (error) {
+        printf("Failed to create the value object %d.\n", error);
+        return error;
+    }
+
+    /* Read twice to get the converted value from the cache */
+    number = ini_get_int_config_value(vo, 0, -1, &error);
+    if ((error) || (number != 10)) {
+        printf("Expected 10 got %d error %d.\n", number, error);
+        value_destroy(vo);
+        return EINVAL;
+    }
+
+    number = ini_get_int_config_value(vo, 1, -1, &error);
+    if ((error != EIO) || (number != -1)) {
+        printf("Expected EIO got %d error %d.\n", number, error);
+        value_destroy(vo);
+        return EINVAL;
+    }
+
+    number = ini_get_int_config_value(vo, 0, -1, &error);
+    if ((error) || (number != 10)) {
+        printf("Expected 10 got %d error %d.\n", number, error);
+        value_destroy(vo);
+        return EINVAL;
+    }
+
+    /* Value of the other type is converted every time */
+    dnumber = ini_get_double_config_value(vo, 0, -1, &error);
+    if ((error) || (dnumber != 10)) {
+        printf("Expected 10 got %f error %d.\n", dnumber, error);
+        value_destroy(vo);
+        return EINVAL;
+    }
+
+    error = value_update(vo, "20", 2, INI_VALUE_CREATED, 80);
+    if (error) {
+        printf("Failed to update value %d.\n", error);
+        value_destroy(vo);
+        return error;
+    }
+
+    number = ini_get_int_config_value(vo, 1, -1, &error);
+    if ((error) || (number != 20)) {
+        printf("Expected 20 got %d error %d.\n", number, error);
+        value_destroy(vo);
+        return EINVAL;
+    }
+
+    error = value_update(vo, "yes", 3, INI_VALUE_CREATED, 80);
+    if (error) {
+        printf("Failed to update value %d.\n", error);
+        value_destroy(vo);
+        return error;
+    }
+
+    flag = ini_get_bool_config_value(vo, 0, &error);
+    if ((error) || (!flag)) {
+        printf("Expected true got %d error %d.\n", flag, error);
+        value_destroy(vo);
+        return EINVAL;
+    }
+
+    number = ini_get_int_config_value(vo, 0, -1, &error);
+    if ((error != EIO) || (number != -1)) {
+        printf("Expected EIO got %d error %d.\n", number, error);
+        value_destroy(vo);
+        return EINVAL;
+    }
+
+    value_destroy(vo);
+
+    TRACE_FLOW_EXIT();
+    return EOK;
+}
+
+
+/* Serialize value into a new buffer */
+static int serialize_value(const char *key, struct value_obj *vo,
+                           struct simplebuffer **sbobj)
+{
+    int error = EOK;
+
+    simplebuffer_free(*sbobj);
+    *sbobj = NULL;
+
+    error = simplebuffer_alloc(sbobj);
+    if (error) {
+        printf("Failed to allocate buffer %d.\n", error);
+        return error;
+    }
+
+    error = value_serialize(vo, key, *sbobj);
+    if (error) {
+        printf("Failed to serialize value %d.\n", error);
+        return error;
+    }
+
+    VOOUT(printf("%s", simplebuffer_get_buf(*sbobj)));
+    return EOK;
+}
+
+/* Folding is done when the value is serialized */
+static int vo_fold_test(void)
+{
+    int error = EOK;
+    struct value_obj *vo = NULL;
+    struct value_obj *copy = NULL;
+    struct simplebuffer *sbobj = NULL;
+    const char *value = "first second third fourth fifth sixth";
+    const char *folded = "key = first second\n"
+                         " third fourth fifth\n"
+                         " sixth\n";
+    const char *refolded = "key = first second third fourth\n"
+                           " fifth sixth\n";
+    const char *fullstr = NULL;
+
+    TRACE_FLOW_ENTRY();
+
+    VOOUT(printf("<=== Fold Test ===>\n"));
+
+    error = value_create_new("short", 5, INI_VALUE_CREATED,
+                             3, 20, NULL, &vo);
+    if (error) {
+        printf("Failed to create the value object %d.\n", error);
+        return error;
+    }
+
+    /* Only the last update is folded */
+    error = value_update(vo, "something else", 14, INI_VALUE_CREATED, 80);
+    if (!error) error = value_update(vo, value, strlen(value),
+                                     INI_VALUE_CREATED, 20);
+    if (error) {
+        printf("Failed to update value %d.\n", error);
+        value_destroy(vo);
+        simplebuffer_free(sbobj);
+        return error;
+    }
+
+    /* Value is available before it is folded */
+    error = value_get_concatenated(vo, &fullstr);
+    if ((error) || (strcmp(fullstr, value) != 0)) {
+        printf("Expected [%s] got [%s] error %d.\n", value, fullstr, error);
+        value_destroy(vo);
+        simplebuffer_free(sbobj);
+        return EINVAL;
+    }
+
+    error = value_copy(vo, &copy);
+    if (error) {
+        printf("Failed to copy value %d.\n", error);
+        value_destroy(vo);
+        simplebuffer_free(sbobj);
+        return error;
+    }
+
+    /* Serialize twice to use the folded lines again */
+    if ((error = serialize_value("key", vo, &sbobj)) ||
+        (strcmp((const char *)simplebuffer_get_buf(sbobj), folded) != 0) ||
+        (error = serialize_value("key", vo, &sbobj)) ||
+        (strcmp((const char *)simplebuffer_get_buf(sbobj), folded) != 0) ||
+        (error = serialize_value("key", copy, &sbobj)) ||
+        (strcmp((const char *)simplebuffer_get_buf(sbobj), folded) != 0)) {
+        printf("Unexpected folding of the value:\n%s\n",
+               simplebuffer_get_buf(sbobj));
+        value_destroy(copy);
+        value_destroy(vo);
+        simplebuffer_free(sbobj);
+        return error ? error : EINVAL;
+    }
+
+    /* Folded value is folded again with the new boundary */
+    error = value_set_boundary(vo, 32);
+    if (error) {
+        printf("Failed to set boundary %d.\n", error);
+        value_destroy(copy);
+        value_destroy(vo);
+        simplebuffer_free(sbobj);
+        return error;
+    }
+
+    if ((error = serialize_value("key", vo, &sbobj)) ||
+        (strcmp((const char *)simplebuffer_get_buf(sbobj), refolded) != 0)) {
+        printf("Unexpected folding of the value:\n%s\n",
+               simplebuffer_get_buf(sbobj));
+        value_destroy(copy);
+        value_destroy(vo);
+        simplebuffer_free(sbobj);
+        return error ? error : EINVAL;
+    }
+
+    value_destroy(copy);
+    value_destroy(vo);
+    simplebuffer_free(sbobj);
+
+    TRACE_FLOW_EXIT();
+    return EOK;
+}
+
 
 /* Main function of the unit test */
 int main(int argc, char *argv[])
@@ -717,6 +932,8 @@ int main(int argc, char *argv[])
                         vo_copy_test,
                         vo_show_test,
                         vo_mc_test,
+                        vo_conv_test,
+                        vo_fold_test,
                         NULL };
     test_fn t;
     int i = 0;
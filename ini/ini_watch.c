@@ -0,0 +1,511 @@
+/*
+    INI LIBRARY
+
+    Watcher that reloads the configuration
+    when the configuration files change.
+
+    Copyright (C) Dmitri Pal <dpal@redhat.com> 2026
+
+    INI Library is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    INI Library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with INI Library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "config.h"
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#if defined(HAVE_PTHREAD) && defined(HAVE_SYS_INOTIFY_H)
+#define INI_WATCH_SUPPORTED 1
+#include <pthread.h>
+#include <sys/inotify.h>
+#endif
+#include "trace.h"
+#include "ini_defines.h"
+#include "ini_configobj.h"
+#include "ini_config_priv.h"
+#include "path_utils.h"
+
+#ifdef INI_WATCH_SUPPORTED
+
+/* Events that mean the main file might have changed.
+ * Editors and package managers often write a new file
+ * and rename it over the old one.
+ */
+#define INI_WATCH_FILE_EVENTS (IN_CLOSE_WRITE | IN_MOVED_TO | \
+                               IN_CREATE | IN_DELETE | IN_MOVED_FROM)
+
+/* Events in the snippet directory. The directory itself
+ * can be removed or renamed, then the watch is added again
+ * when a directory with the same name shows up.
+ */
+#define INI_WATCH_DIR_EVENTS (INI_WATCH_FILE_EVENTS | IN_ATTRIB | \
+                              IN_DELETE_SELF | IN_MOVE_SELF)
+
+/* Events in the directory that holds the snippet directory */
+#define INI_WATCH_PARENT_EVENTS (IN_CREATE | IN_MOVED_TO | \
+                                 IN_DELETE | IN_MOVED_FROM)
+
+/* Steady stream of events postpones the reload
+ * by at most this many debounce intervals.
+ */
+#define INI_WATCH_MAX_DELAY 10
+
+/* Watcher state */
+struct ini_watch {
+    /* Incremental reload state */
+    struct ini_reload *reload;
+    /* Configuration maintained by the watcher */
+    struct ini_cfgobj *cfg;
+    /* Main file name without the directory */
+    char base_name[PATH_MAX + 1];
+    /* Snippet directory and its name in the parent directory */
+    char *snip_dir;
+    char snip_base[PATH_MAX + 1];
+    /* inotify descriptor and watches */
+    int ifd;
+    int file_wd;
+    int snip_wd;
+    int parent_wd;
+    /* Pipe to stop the thread */
+    int stop_pipe[2];
+    pthread_t thread;
+    int started;
+    /* Quiet period before reload */
+    int debounce;
+    /* Reload failed and is tried once more in case the file
+     * was caught half written, the hash tells if it was.
+     */
+    int failed;
+    uint64_t failed_hash;
+    /* Where to publish the new configuration */
+    ini_watch_fn cb;
+    void *cb_data;
+};
+
+/* Reload and publish if anything changed.
+ * Returns 1 if the reload should be tried again.
+ */
+static int ini_watch_reload(struct ini_watch *watch)
+{
+    int error = EOK;
+    int error2 = EOK;
+    char **changed = NULL;
+    struct ref_array *error_list = NULL;
+    struct ini_cfgobj *new_cfg = NULL;
+    uint64_t hash;
+
+    TRACE_FLOW_ENTRY();
+
+    error = ini_config_reload(watch->reload, watch->cfg,
+                              &changed, &error_list);
+    if ((error) && (!changed)) {
+        /* A file that is written in place can be read
+         * before the writer is done. Such a file reads
+         * differently after the debounce, the error
+         * is reported only when it reads the same.
+         */
+        hash = ini_reload_hash(watch->reload);
+        if ((!(watch->failed)) || (watch->failed_hash != hash)) {
+            TRACE_INFO_NUMBER("Reload will be tried again", error);
+            watch->failed = 1;
+            watch->failed_hash = hash;
+            ref_array_destroy(error_list);
+            TRACE_FLOW_EXIT();
+            return 1;
+        }
+    }
+    watch->failed = 0;
+
+    if (changed) {
+        /* The published object is never modified by the watcher.
+         * With changes the error is only a warning about snippets.
+         */
+        error2 = ini_config_copy(watch->cfg, &new_cfg);
+        if (error2) error = error2;
+    }
+
+    if ((error) || (changed)) {
+        TRACE_INFO_NUMBER("Publishing reload result", error);
+        watch->cb(new_cfg, changed, error_list, error, watch->cb_data);
+    }
+
+    ini_free_section_list(changed);
+    ref_array_destroy(error_list);
+
+    TRACE_FLOW_EXIT();
+    return 0;
+}
+
+/* Start watching the snippet directory if it exists */
+static void ini_watch_arm_snip(struct ini_watch *watch)
+{
+    TRACE_FLOW_ENTRY();
+
+    if ((watch->snip_dir) && (watch->snip_wd == -1)) {
+        watch->snip_wd = inotify_add_watch(watch->ifd, watch->snip_dir,
+                                           INI_WATCH_DIR_EVENTS);
+        if (watch->snip_wd == -1) {
+            TRACE_INFO_NUMBER("Snippet directory is not watched", errno);
+        }
+    }
+
+    TRACE_FLOW_EXIT();
+}
+
+/* Stop watching the snippet directory that is gone */
+static void ini_watch_disarm_snip(struct ini_watch *watch, int ignored)
+{
+    TRACE_FLOW_ENTRY();
+
+    /* The watch of the renamed directory
+     * keeps following it, so remove it.
+     */
+    if ((!ignored) && (watch->snip_wd != -1)) {
+        inotify_rm_watch(watch->ifd, watch->snip_wd);
+    }
+    watch->snip_wd = -1;
+
+    TRACE_FLOW_EXIT();
+}
+
+/* Check if any of the events is relevant */
+static int ini_watch_events(struct ini_watch *watch)
+{
+    char buf[4096]
+        __attribute__ ((aligned(__alignof__(struct inotify_event))));
+    const struct inotify_event *event;
+    ssize_t len;
+    char *ptr;
+    int relevant = 0;
+
+    TRACE_FLOW_ENTRY();
+
+    for (;;) {
+        len = read(watch->ifd, buf, sizeof(buf));
+        if (len <= 0) break;
+
+        for (ptr = buf; ptr < buf + len;
+             ptr += sizeof(struct inotify_event) + event->len) {
+            event = (const struct inotify_event *)ptr;
+
+            if (event->wd == watch->snip_wd) {
+                relevant = 1;
+                if (event->mask & (IN_IGNORED | IN_DELETE_SELF |
+                                   IN_MOVE_SELF)) {
+                    ini_watch_disarm_snip(watch,
+                                          event->mask & IN_IGNORED);
+                }
+            }
+            else if ((event->wd == watch->file_wd) ||
+                     (event->wd == watch->parent_wd)) {
+                if ((event->len) && (watch->snip_dir) &&
+                    (strcmp(event->name, watch->snip_base) == 0)) {
+                    /* Snippet directory was created,
+                     * removed or renamed.
+                     */
+                    relevant = 1;
+                }
+                else if ((event->wd == watch->file_wd) &&
+                         (event->len) &&
+                         (strcmp(event->name, watch->base_name) == 0)) {
+                    relevant = 1;
+                }
+            }
+            /* Events were lost - better reload */
+            if (event->mask & IN_Q_OVERFLOW) relevant = 1;
+        }
+    }
+
+    /* The directory might be back under the same name */
+    if (relevant) ini_watch_arm_snip(watch);
+
+    TRACE_FLOW_EXIT();
+    return relevant;
+}
+
+/* Get time to wait before the reload */
+static int ini_watch_timeout(struct ini_watch *watch,
+                             const struct timespec *first)
+{
+    struct timespec now;
+    long long waited;
+    long long left;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    waited = (long long)(now.tv_sec - first->tv_sec) * 1000 +
+             (now.tv_nsec - first->tv_nsec) / 1000000;
+    left = (long long)watch->debounce * INI_WATCH_MAX_DELAY - waited;
+
+    if (left <= 0) return 0;
+    if (left < watch->debounce) return (int)left;
+    return watch->debounce;
+}
+
+/* Watcher thread */
+static void *ini_watch_thread(void *data)
+{
+    struct ini_watch *watch = (struct ini_watch *)data;
+    struct pollfd fds[2];
+    struct timespec first;
+    int pending = 0;
+    int timeout;
+    int ret;
+
+    TRACE_FLOW_ENTRY();
+
+    fds[0].fd = watch->ifd;
+    fds[0].events = POLLIN;
+    fds[1].fd = watch->stop_pipe[0];
+    fds[1].events = POLLIN;
+
+    for (;;) {
+        /* Wait for the burst of changes to settle down
+         * but not longer than the limit since the first change.
+         */
+        timeout = pending ? ini_watch_timeout(watch, &first) : -1;
+        if (timeout == 0) {
+            pending = ini_watch_reload(watch);
+            if (pending) clock_gettime(CLOCK_MONOTONIC, &first);
+            continue;
+        }
+
+        ret = poll(fds, 2, timeout);
+        if (ret == -1) {
+            if (errno == EINTR) continue;
+            TRACE_ERROR_NUMBER("Poll failed", errno);
+            break;
+        }
+
+        if (fds[1].revents) break;
+
+        if (ret == 0) {
+            pending = ini_watch_reload(watch);
+            if (pending) clock_gettime(CLOCK_MONOTONIC, &first);
+            continue;
+        }
+
+        if ((fds[0].revents & POLLIN) &&
+            (ini_watch_events(watch)) &&
+            (!pending)) {
+            clock_gettime(CLOCK_MONOTONIC, &first);
+            pending = 1;
+        }
+    }
+
+    TRACE_FLOW_EXIT();
+    return NULL;
+}
+
+/* Create a watcher */
+int ini_watch_create(struct ini_cfgfile *file_ctx,
+                     const char *snip_dir,
+                     struct ini_augment_ctx *ctx,
+                     struct access_check *check_perm,
+                     int error_level,
+                     uint32_t collision_flags,
+                     uint32_t parse_flags,
+                     uint32_t merge_flags,
+                     unsigned debounce_ms,
+                     ini_watch_fn cb,
+                     void *cb_data,
+                     struct ini_watch **watch)
+{
+    int error = EOK;
+    struct ini_watch *new_watch = NULL;
+    char dir_name[PATH_MAX + 1];
+    char parent_name[PATH_MAX + 1];
+    char **changed = NULL;
+
+    TRACE_FLOW_ENTRY();
+
+    if ((!file_ctx) || (!(file_ctx->filename)) || (!cb) || (!watch)) {
+        TRACE_ERROR_NUMBER("Invalid argument", EINVAL);
+        return EINVAL;
+    }
+
+    new_watch = calloc(1, sizeof(struct ini_watch));
+    if (!new_watch) {
+        TRACE_ERROR_NUMBER("Failed to allocate watcher", ENOMEM);
+        return ENOMEM;
+    }
+
+    new_watch->ifd = -1;
+    new_watch->file_wd = -1;
+    new_watch->snip_wd = -1;
+    new_watch->parent_wd = -1;
+    new_watch->stop_pipe[0] = -1;
+    new_watch->stop_pipe[1] = -1;
+    new_watch->debounce = (int)debounce_ms;
+    new_watch->cb = cb;
+    new_watch->cb_data = cb_data;
+
+    /* The directory is watched rather than the file
+     * so that replacing the file is noticed too.
+     */
+    error = get_directory_and_base_name(dir_name, PATH_MAX,
+                                        new_watch->base_name, PATH_MAX,
+                                        file_ctx->filename);
+    if (error) {
+        TRACE_ERROR_NUMBER("Failed to split file name", error);
+        ini_watch_destroy(new_watch);
+        return error;
+    }
+
+    if (snip_dir) {
+        new_watch->snip_dir = strdup(snip_dir);
+        if (!(new_watch->snip_dir)) {
+            TRACE_ERROR_NUMBER("Failed to copy directory name", ENOMEM);
+            ini_watch_destroy(new_watch);
+            return ENOMEM;
+        }
+
+        error = get_directory_and_base_name(parent_name, PATH_MAX,
+                                            new_watch->snip_base, PATH_MAX,
+                                            snip_dir);
+        if (error) {
+            TRACE_ERROR_NUMBER("Failed to split directory name", error);
+            ini_watch_destroy(new_watch);
+            return error;
+        }
+    }
+
+    error = ini_reload_create(file_ctx->filename, snip_dir, ctx, check_perm,
+                              error_level, collision_flags, parse_flags,
+                              merge_flags, &(new_watch->reload));
+    if (error) {
+        TRACE_ERROR_NUMBER("Failed to create reload state", error);
+        ini_watch_destroy(new_watch);
+        return error;
+    }
+
+    errno = 0;
+    new_watch->ifd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if ((new_watch->ifd == -1) ||
+        (pipe(new_watch->stop_pipe) == -1)) {
+        error = errno;
+        TRACE_ERROR_NUMBER("Failed to initialize", error);
+        ini_watch_destroy(new_watch);
+        return error;
+    }
+
+    new_watch->file_wd = inotify_add_watch(new_watch->ifd, dir_name,
+                                           INI_WATCH_FILE_EVENTS);
+    if (new_watch->file_wd == -1) {
+        error = errno;
+        TRACE_ERROR_NUMBER("Failed to watch directory", error);
+        ini_watch_destroy(new_watch);
+        return error;
+    }
+
+    /* The snippet directory might not exist yet,
+     * its parent tells when it is created.
+     */
+    if (snip_dir) {
+        new_watch->parent_wd = inotify_add_watch(new_watch->ifd,
+                                                 parent_name,
+                                                 INI_WATCH_PARENT_EVENTS |
+                                                 IN_MASK_ADD);
+        if (new_watch->parent_wd == -1) {
+            TRACE_INFO_NUMBER("Snippet parent is not watched", errno);
+        }
+        ini_watch_arm_snip(new_watch);
+    }
+
+    /* Files are read after they are watched so that
+     * no change is missed in between.
+     */
+    error = ini_config_create(&(new_watch->cfg));
+    if (!error) {
+        error = ini_config_reload(new_watch->reload, new_watch->cfg,
+                                  &changed, NULL);
+        ini_free_section_list(changed);
+    }
+    if (error) {
+        TRACE_ERROR_NUMBER("Failed to read configuration", error);
+        ini_watch_destroy(new_watch);
+        return error;
+    }
+
+    error = pthread_create(&(new_watch->thread), NULL,
+                           ini_watch_thread, new_watch);
+    if (error) {
+        TRACE_ERROR_NUMBER("Failed to start thread", error);
+        ini_watch_destroy(new_watch);
+        return error;
+    }
+    new_watch->started = 1;
+
+    *watch = new_watch;
+
+    TRACE_FLOW_EXIT();
+    return EOK;
+}
+
+/* Stop and free the watcher */
+void ini_watch_destroy(struct ini_watch *watch)
+{
+    TRACE_FLOW_ENTRY();
+
+    if (watch) {
+        if (watch->started) {
+            /* Wake up the thread, it exits on any input */
+            while ((write(watch->stop_pipe[1], "x", 1) == -1) &&
+                   (errno == EINTR));
+            pthread_join(watch->thread, NULL);
+        }
+        if (watch->stop_pipe[0] != -1) close(watch->stop_pipe[0]);
+        if (watch->stop_pipe[1] != -1) close(watch->stop_pipe[1]);
+        if (watch->ifd != -1) close(watch->ifd);
+        ini_reload_destroy(watch->reload);
+        ini_config_destroy(watch->cfg);
+        free(watch->snip_dir);
+        free(watch);
+    }
+
+    TRACE_FLOW_EXIT();
+}
+
+#else
+
+/* Create a watcher */
+int ini_watch_create(struct ini_cfgfile *file_ctx,
+                     const char *snip_dir,
+                     struct ini_augment_ctx *ctx,
+                     struct access_check *check_perm,
+                     int error_level,
+                     uint32_t collision_flags,
+                     uint32_t parse_flags,
+                     uint32_t merge_flags,
+                     unsigned debounce_ms,
+                     ini_watch_fn cb,
+                     void *cb_data,
+                     struct ini_watch **watch)
+{
+    TRACE_FLOW_ENTRY();
+    TRACE_ERROR_NUMBER("Watching is not supported", ENOSYS);
+    return ENOSYS;
+}
+
+/* Stop and free the watcher */
+void ini_watch_destroy(struct ini_watch *watch)
+{
+    TRACE_FLOW_ENTRY();
+    TRACE_FLOW_EXIT();
+}
+
+#endif
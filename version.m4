@@ -15,4 +15,4 @@ m4_define([DHASH_VERSION_NUMBER], [0.5.0])
 m4_define([COLLECTION_VERSION_NUMBER], [0.7.0])
 m4_define([REF_ARRAY_VERSION_NUMBER], [0.1.5])
 m4_define([BASICOBJECTS_VERSION_NUMBER], [0.1.1])
-m4_define([INI_CONFIG_VERSION_NUMBER], [1.3.1])
+m4_define([INI_CONFIG_VERSION_NUMBER], [1.4.0])